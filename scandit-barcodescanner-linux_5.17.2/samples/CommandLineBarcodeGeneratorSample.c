@@ -3,29 +3,1042 @@
  *
  * \brief ScanditSDK demo application
  *
+ * Without arguments one QR code containing BARCODE_DATA is written to output.png.
+ *
+ * With --batch the payloads of many codes are read from a file, or from standard
+ * input if the file name is -, and a pool of worker threads generates them. Every
+ * worker owns a recognition context and a barcode generator that are created once
+ * and reused for all codes, as are its encoding arrays and image buffers. The main
+ * thread reads the payloads and hands them to the workers in batches of BATCH_SIZE.
+ * Every line of the input is either a JSON object (NDJSON) or a CSV record:
+ *
+ * {"name": "label-0001", "data": "Hello World! | 1234567890"}
+ * label-0002,Hello World! | 1234567891
+ *
+ * Everything after the first comma of a CSV record is data. Lines without a name get
+ * their line number as name. The images are written in parallel, either as files
+ * into the directory given with --output-dir or into one tar archive given with
+ * --archive. The workers reserve their space in the archive and then write their
+ * entries at the same time, so the order of the entries in the archive may differ
+ * from the order of the input. At the end the number of codes per second is printed.
+ *
+ * The generator returns RGBA images. Since the codes are black and white, --format can
+ * store them with one bit per pixel instead:
+ *
+ * png   8 bit RGBA PNG, as generated (default)
+ * png1  1 bit grayscale PNG
+ * pbm   binary PBM (P4)
+ * raw   the rows of the PBM without header, each padded to a full byte. The width and
+ *       height are appended to the file name, as in label-0001-33x33.raw.
+ *
+ * The pixels are thresholded and packed into bits with SSE2 or NEON where available.
+ * --compression sets the zlib level of the PNG formats, from 0 (none) to 9 (smallest).
+ * Level 1 encodes a lot faster than the default and, for one bit images, is barely
+ * larger.
+ *
+ * Example:
+ * ./CommandLineBarcodeGeneratorSample --batch labels.ndjson -j 8 --archive labels.tar
+ * ./CommandLineBarcodeGeneratorSample --format png1 --compression 1 --batch - --output-dir labels
+ *
  * \copyright Copyright (c) 2018 Scandit AG. All rights reserved.
  */
 
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <setjmp.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
 #include <png.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 #include <Scandit/ScRecognitionContext.h>
+#include <Scandit/ScBarcode.h>
 #include <Scandit/ScBarcodeGenerator.h>
 
+#include "JsonParsing.h"
+
 // Please insert your app key here:
 #define SCANDIT_SDK_LICENSE_KEY "-- INSERT YOUR LICENSE KEY HERE --"
 
 #define BARCODE_DATA "Hello World! | 1234567890"
-#define OUTPUT_FILE "output.png"
+// Name of the output file without extension.
+#define OUTPUT_NAME "output"
+
+// Number of payloads handed to a worker at once.
+#define BATCH_SIZE 64
+// Number of batches the reader can be ahead of the workers.
+#define BATCH_QUEUE_SIZE 16
+#define MAX_WORKER_COUNT 64
+// Longer payloads are skipped. QR codes hold at most 2953 bytes.
+#define MAX_PAYLOAD_LENGTH 4096
+// Longer names are rejected. With the longest suffix they fit into a tar header.
+#define MAX_NAME_LENGTH 72
+#define TAR_BLOCK_SIZE 512
+#define TAR_NAME_SIZE 100
+
+static const char * const GENERATOR_OPTIONS =
+    "{"
+    "   \"foregroundColor\" : [0, 0, 0, 255],"
+    "   \"backgroundColor\" : [255, 255, 255, 255],"
+    "   \"errorCorrectionLevel\" : \"H\""
+    "}";
+
+/**
+ * Growable byte buffer. It only grows, so that it can be reused for all images.
+ */
+typedef struct ByteBuffer {
+    uint8_t *data;
+    size_t length;
+    size_t capacity;
+} ByteBuffer;
+
+typedef enum {
+    OUTPUT_FORMAT_PNG_RGBA,
+    OUTPUT_FORMAT_PNG_1BIT,
+    OUTPUT_FORMAT_PBM,
+    OUTPUT_FORMAT_RAW
+} OutputFormat;
+
+static const struct {
+    const char *name;
+    OutputFormat format;
+    const char *extension;
+} OUTPUT_FORMATS[] = {
+    { "png", OUTPUT_FORMAT_PNG_RGBA, "png" },
+    { "png1", OUTPUT_FORMAT_PNG_1BIT, "png" },
+    { "pbm", OUTPUT_FORMAT_PBM, "pbm" },
+    { "raw", OUTPUT_FORMAT_RAW, "raw" },
+};
+
+/**
+ * Encodes generated images in the chosen output format. The buffers are reused
+ * between images.
+ */
+typedef struct ImageEncoder {
+    OutputFormat format;
+    // zlib level of the PNG formats, -1 for the default of zlib.
+    int compression_level;
+    // Image packed to one bit per pixel.
+    ByteBuffer bits;
+    png_bytep *rows;
+    size_t row_capacity;
+} ImageEncoder;
+
+/**
+ * Payloads handed to a worker at once. The names and the data of all payloads are
+ * stored in the text buffer of the batch, which is reused for later batches.
+ */
+typedef struct PayloadBatch {
+    size_t count;
+    uint64_t line_numbers[BATCH_SIZE];
+    size_t name_offsets[BATCH_SIZE];
+    size_t data_offsets[BATCH_SIZE];
+    size_t data_lengths[BATCH_SIZE];
+    ByteBuffer text;
+} PayloadBatch;
+
+struct GeneratorPool;
+
+typedef struct GeneratorWorker {
+    struct GeneratorPool *pool;
+    pthread_t thread;
+    ScBool thread_started;
+
+    ScRecognitionContext *context;
+    ScBarcodeGenerator *generator;
+    // One range that covers the whole payload, for ASCII payloads and for payloads with
+    // other characters, which are UTF-8. Only its end changes between codes.
+    ScEncodingArray ascii_encoding;
+    ScEncodingArray utf8_encoding;
+    ImageEncoder encoder;
+    // The encoded image, preceded by space for the tar header in archive mode.
+    ByteBuffer output;
+
+    uint64_t generated_count;
+    uint64_t failed_count;
+    uint64_t written_bytes;
+} GeneratorWorker;
+
+typedef struct GeneratorPool {
+    GeneratorWorker *workers;
+    size_t worker_count;
+    ScSymbology symbology;
+    OutputFormat output_format;
+    int compression_level;
+
+    // Either the output directory or the archive is used.
+    const char *output_directory;
+    int archive_fd;
+    // End of the archive. Workers reserve the space for their entries by moving it.
+    uint64_t archive_end;
+
+    pthread_mutex_t lock;
+    pthread_cond_t batch_ready;
+    pthread_cond_t batch_free;
+    PayloadBatch batches[BATCH_QUEUE_SIZE];
+    // Ring of filled batches and stack of free batches.
+    PayloadBatch *ready[BATCH_QUEUE_SIZE];
+    size_t ready_head;
+    size_t ready_count;
+    PayloadBatch *free_batches[BATCH_QUEUE_SIZE];
+    size_t free_count;
+    ScBool input_finished;
+} GeneratorPool;
+
+static double now_seconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+static ScBool byte_buffer_reserve(ByteBuffer *buffer, size_t size)
+{
+    if (size <= buffer->capacity) {
+        return SC_TRUE;
+    }
+    size_t capacity = buffer->capacity > 0 ? buffer->capacity : 4096;
+    while (capacity < size) {
+        capacity *= 2;
+    }
+    uint8_t *data = realloc(buffer->data, capacity);
+    if (data == NULL) {
+        return SC_FALSE;
+    }
+    buffer->data = data;
+    buffer->capacity = capacity;
+    return SC_TRUE;
+}
+
+static ScBool byte_buffer_append(ByteBuffer *buffer, const void *data, size_t length)
+{
+    if (!byte_buffer_reserve(buffer, buffer->length + length)) {
+        return SC_FALSE;
+    }
+    memcpy(buffer->data + buffer->length, data, length);
+    buffer->length += length;
+    return SC_TRUE;
+}
+
+static void png_write_to_buffer(png_structp png, png_bytep data, png_size_t length)
+{
+    ByteBuffer *buffer = png_get_io_ptr(png);
+    if (!byte_buffer_append(buffer, data, length)) {
+        png_error(png, "out of memory");
+    }
+}
+
+static void png_flush_buffer(png_structp png)
+{
+    (void)png;
+}
+
+// Pixels are dark if the mean of red, blue and twice green is below this level, which
+// must be between 1 and 255. The mean is rounded like the averaging instructions of
+// SSE2 and NEON do.
+#define DARK_THRESHOLD 128
+
+static uint8_t rgba_level(const uint8_t *pixel)
+{
+    const uint32_t red_blue = (pixel[0] + pixel[2] + 1) / 2;
+    return (uint8_t)((red_blue + pixel[1] + 1) / 2);
+}
+
+// Pack 16 RGBA pixels per step into two bytes and return the number of pixels
+// packed. Light pixels are 1 bits, the first pixel is the highest bit.
+#if defined(__SSE2__)
+static uint32_t pack_light_pixels_sse2(const uint8_t *rgba, uint8_t *bits, uint32_t count,
+                                       uint8_t invert)
+{
+    const __m128i low_byte = _mm_set1_epi32(0xFF);
+    // SSE2 only compares signed bytes: level >= DARK_THRESHOLD is compared as
+    // (level - 128) > (DARK_THRESHOLD - 1 - 128).
+    const __m128i bias = _mm_set1_epi8((char)0x80);
+    const __m128i threshold = _mm_set1_epi8((char)((DARK_THRESHOLD - 1) ^ 0x80));
+    uint32_t x = 0;
+    for (; x + 16 <= count; x += 16) {
+        __m128i levels[4];
+        for (int i = 0; i < 4; ++i) {
+            const __m128i pixels = _mm_loadu_si128((const __m128i *)(rgba + (x + i * 4) * 4));
+            const __m128i red_blue = _mm_avg_epu8(pixels, _mm_srli_epi32(pixels, 16));
+            levels[i] = _mm_and_si128(_mm_avg_epu8(red_blue, _mm_srli_epi32(pixels, 8)), low_byte);
+        }
+        const __m128i level = _mm_packus_epi16(_mm_packs_epi32(levels[0], levels[1]),
+                                               _mm_packs_epi32(levels[2], levels[3]));
+        __m128i light = _mm_cmpgt_epi8(_mm_xor_si128(level, bias), threshold);
+        // Reverse the pixels of each group of 8, so that the first ends up in the
+        // highest bit of the mask.
+        light = _mm_shufflelo_epi16(light, _MM_SHUFFLE(0, 1, 2, 3));
+        light = _mm_shufflehi_epi16(light, _MM_SHUFFLE(0, 1, 2, 3));
+        light = _mm_or_si128(_mm_slli_epi16(light, 8), _mm_srli_epi16(light, 8));
+        const int mask = _mm_movemask_epi8(light);
+        bits[x / 8] = (uint8_t)mask ^ invert;
+        bits[x / 8 + 1] = (uint8_t)(mask >> 8) ^ invert;
+    }
+    return x;
+}
+#endif
+
+#if defined(__ARM_NEON)
+static uint32_t pack_light_pixels_neon(const uint8_t *rgba, uint8_t *bits, uint32_t count,
+                                       uint8_t invert)
+{
+    static const uint8_t BIT_VALUES[8] = { 128, 64, 32, 16, 8, 4, 2, 1 };
+    const uint8x8_t bit_values = vld1_u8(BIT_VALUES);
+    const uint8x16_t threshold = vdupq_n_u8(DARK_THRESHOLD);
+    uint32_t x = 0;
+    for (; x + 16 <= count; x += 16) {
+        const uint8x16x4_t pixels = vld4q_u8(rgba + x * 4);
+        const uint8x16_t level = vrhaddq_u8(vrhaddq_u8(pixels.val[0], pixels.val[2]),
+                                            pixels.val[1]);
+        const uint8x16_t light = vcgeq_u8(level, threshold);
+        uint8x8_t sum = vpadd_u8(vand_u8(vget_low_u8(light), bit_values),
+                                 vand_u8(vget_high_u8(light), bit_values));
+        sum = vpadd_u8(sum, sum);
+        sum = vpadd_u8(sum, sum);
+        bits[x / 8] = vget_lane_u8(sum, 0) ^ invert;
+        bits[x / 8 + 1] = vget_lane_u8(sum, 1) ^ invert;
+    }
+    return x;
+}
+#endif
 
-int main(int argc, const char *argv[])
+/**
+ * Packs a row of RGBA pixels to one bit per pixel, with SSE2 or NEON where available.
+ * Light pixels are 1 bits, unless invert is 0xFF. The bits of the last byte that are
+ * not covered by pixels are 0.
+ */
+static void pack_pixels(const uint8_t *rgba, uint8_t *bits, uint32_t count, uint8_t invert)
+{
+    uint32_t x = 0;
+#if defined(__SSE2__)
+    x = pack_light_pixels_sse2(rgba, bits, count, invert);
+#elif defined(__ARM_NEON)
+    x = pack_light_pixels_neon(rgba, bits, count, invert);
+#endif
+    for (; x < count; x += 8) {
+        uint8_t byte = 0;
+        const uint32_t end = x + 8 < count ? x + 8 : count;
+        for (uint32_t i = x; i < end; ++i) {
+            const uint8_t light = rgba_level(rgba + i * 4) >= DARK_THRESHOLD;
+            byte |= (uint8_t)((light ^ (invert & 1)) << (7 - (i - x)));
+        }
+        bits[x / 8] = byte;
+    }
+}
+
+/**
+ * Packs the generated RGBA image into the bit buffer of the encoder, one row every
+ * (width + 7) / 8 bytes.
+ */
+static ScBool image_encoder_pack(ImageEncoder *encoder, const ScImageBuffer *image,
+                                 uint8_t invert)
+{
+    const uint32_t width = sc_image_description_get_width(image->description);
+    const uint32_t height = sc_image_description_get_height(image->description);
+    const size_t row_bytes = (width + 7) / 8;
+    if (!byte_buffer_reserve(&encoder->bits, row_bytes * height)) {
+        return SC_FALSE;
+    }
+    for (uint32_t y = 0; y < height; ++y) {
+        pack_pixels(image->data + (size_t)width * 4 * y, encoder->bits.data + row_bytes * y,
+                    width, invert);
+    }
+    encoder->bits.length = row_bytes * height;
+    return SC_TRUE;
+}
+
+/**
+ * Encodes an image as PNG and appends it to the output buffer. The image is either
+ * the generated RGBA image or, with bit_depth 1, the packed image in the bit buffer.
+ */
+static ScBool image_encoder_write_png(ImageEncoder *encoder, const ScImageBuffer *image,
+                                      int bit_depth, ByteBuffer *output)
+{
+    const size_t width = sc_image_description_get_width(image->description);
+    const size_t height = sc_image_description_get_height(image->description);
+    if (height > encoder->row_capacity) {
+        png_bytep *grown = realloc(encoder->rows, height * sizeof(png_bytep));
+        if (grown == NULL) {
+            return SC_FALSE;
+        }
+        encoder->rows = grown;
+        encoder->row_capacity = height;
+    }
+    for (size_t i = 0; i < height; i++) {
+        if (bit_depth == 1) {
+            encoder->rows[i] = encoder->bits.data + (width + 7) / 8 * i;
+        } else {
+            encoder->rows[i] = (png_byte*) &(image->data[width*4*i]);
+        }
+    }
+
+    png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    if (png == NULL) {
+        printf("Failed to create png write struct.\n");
+        return SC_FALSE;
+    }
+    png_infop info = png_create_info_struct(png);
+    if (info == NULL) {
+        printf("Failed to create png info struct.\n");
+        png_destroy_write_struct(&png, NULL);
+        return SC_FALSE;
+    }
+    // libpng returns here when encoding fails.
+    if (setjmp(png_jmpbuf(png))) {
+        png_destroy_write_struct(&png, &info);
+        return SC_FALSE;
+    }
+    png_set_write_fn(png, output, png_write_to_buffer, png_flush_buffer);
+    if (encoder->compression_level >= 0) {
+        png_set_compression_level(png, encoder->compression_level);
+    }
+    png_set_IHDR(png,
+                  info,
+                  width, height,
+                  bit_depth,
+                  bit_depth == 1 ? PNG_COLOR_TYPE_GRAY : PNG_COLOR_TYPE_RGBA,
+                  PNG_INTERLACE_NONE,
+                  PNG_COMPRESSION_TYPE_DEFAULT,
+                  PNG_FILTER_TYPE_DEFAULT
+                 );
+    png_set_rows(png, info, encoder->rows);
+    png_write_png(png, info, 0, NULL);
+    png_destroy_write_struct(&png, &info);
+    return SC_TRUE;
+}
+
+/**
+ * Encodes the generated image in the format of the encoder and appends it to the
+ * output buffer.
+ */
+static ScBool image_encoder_encode(ImageEncoder *encoder, const ScImageBuffer *image,
+                                   ByteBuffer *output)
+{
+    switch (encoder->format) {
+        case OUTPUT_FORMAT_PNG_RGBA:
+            return image_encoder_write_png(encoder, image, 8, output);
+        case OUTPUT_FORMAT_PNG_1BIT:
+            // In a gray PNG 1 bits are white.
+            return image_encoder_pack(encoder, image, 0x00) &&
+                   image_encoder_write_png(encoder, image, 1, output);
+        case OUTPUT_FORMAT_PBM: {
+            // In a PBM 1 bits are black.
+            if (!image_encoder_pack(encoder, image, 0xFF)) {
+                return SC_FALSE;
+            }
+            char header[32];
+            const int header_length = snprintf(header, sizeof(header), "P4\n%u %u\n",
+                sc_image_description_get_width(image->description),
+                sc_image_description_get_height(image->description));
+            return byte_buffer_append(output, header, header_length) &&
+                   byte_buffer_append(output, encoder->bits.data, encoder->bits.length);
+        }
+        case OUTPUT_FORMAT_RAW:
+            return image_encoder_pack(encoder, image, 0xFF) &&
+                   byte_buffer_append(output, encoder->bits.data, encoder->bits.length);
+    }
+    return SC_FALSE;
+}
+
+/**
+ * Writes the file name of an image: the name with the extension of the format. Raw
+ * images have no header, so their width and height are part of the name.
+ */
+static void image_encoder_file_name(const ImageEncoder *encoder, const char *name,
+                                    const ScImageBuffer *image, char *file_name,
+                                    size_t file_name_size)
+{
+    const char *extension = "png";
+    for (size_t i = 0; i < sizeof(OUTPUT_FORMATS) / sizeof(OUTPUT_FORMATS[0]); ++i) {
+        if (OUTPUT_FORMATS[i].format == encoder->format) {
+            extension = OUTPUT_FORMATS[i].extension;
+        }
+    }
+    if (encoder->format == OUTPUT_FORMAT_RAW) {
+        snprintf(file_name, file_name_size, "%s-%ux%u.%s", name,
+                 sc_image_description_get_width(image->description),
+                 sc_image_description_get_height(image->description), extension);
+    } else {
+        snprintf(file_name, file_name_size, "%s.%s", name, extension);
+    }
+}
+
+static void image_encoder_release(ImageEncoder *encoder)
+{
+    free(encoder->bits.data);
+    free(encoder->rows);
+}
+
+static ScBool write_file(const char *path, const uint8_t *data, size_t length)
+{
+    const int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return SC_FALSE;
+    }
+    size_t written = 0;
+    while (written < length) {
+        const ssize_t result = write(fd, data + written, length - written);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            break;
+        }
+        written += result;
+    }
+    return close(fd) == 0 && written == length;
+}
+
+static ScBool pwrite_all(int fd, const uint8_t *data, size_t length, uint64_t offset)
+{
+    while (length > 0) {
+        const ssize_t result = pwrite(fd, data, length, (off_t)offset);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            return SC_FALSE;
+        }
+        data += result;
+        length -= result;
+        offset += result;
+    }
+    return SC_TRUE;
+}
+
+/**
+ * Fills a ustar header for a regular file.
+ */
+static void tar_header_init(uint8_t header[TAR_BLOCK_SIZE], const char *name, uint64_t size)
+{
+    memset(header, 0, TAR_BLOCK_SIZE);
+    const size_t name_length = strlen(name);
+    memcpy(header, name, name_length < TAR_NAME_SIZE ? name_length : TAR_NAME_SIZE);
+    snprintf((char *)header + 100, 8, "%07o", 0644);
+    snprintf((char *)header + 108, 8, "%07o", 0);
+    snprintf((char *)header + 116, 8, "%07o", 0);
+    snprintf((char *)header + 124, 12, "%011llo", (unsigned long long)size);
+    snprintf((char *)header + 136, 12, "%011llo", (unsigned long long)time(NULL));
+    header[156] = '0';
+    memcpy(header + 257, "ustar", 6);
+    memcpy(header + 263, "00", 2);
+
+    // The checksum is computed with the checksum field set to spaces.
+    memset(header + 148, ' ', 8);
+    unsigned checksum = 0;
+    for (int i = 0; i < TAR_BLOCK_SIZE; ++i) {
+        checksum += header[i];
+    }
+    snprintf((char *)header + 148, 8, "%06o", checksum);
+    header[155] = ' ';
+}
+
+/**
+ * Writes the encoded image in the output buffer of the worker. In archive mode the
+ * first block of the buffer is filled with the tar header.
+ */
+static ScBool generator_worker_write(GeneratorWorker *worker, const char *file_name)
+{
+    GeneratorPool *pool = worker->pool;
+    ByteBuffer *output = &worker->output;
+
+    if (pool->output_directory != NULL) {
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/%s", pool->output_directory, file_name);
+        if (!write_file(path, output->data, output->length)) {
+            printf("Could not write '%s': %s\n", path, strerror(errno));
+            return SC_FALSE;
+        }
+        worker->written_bytes += output->length;
+        return SC_TRUE;
+    }
+
+    const uint64_t data_size = output->length - TAR_BLOCK_SIZE;
+    const size_t padding = (TAR_BLOCK_SIZE - data_size % TAR_BLOCK_SIZE) % TAR_BLOCK_SIZE;
+    if (!byte_buffer_reserve(output, output->length + padding)) {
+        return SC_FALSE;
+    }
+    memset(output->data + output->length, 0, padding);
+    output->length += padding;
+    tar_header_init(output->data, file_name, data_size);
+
+    const uint64_t offset = __atomic_fetch_add(&pool->archive_end, output->length, __ATOMIC_RELAXED);
+    if (!pwrite_all(pool->archive_fd, output->data, output->length, offset)) {
+        printf("Could not write '%s' to the archive: %s\n", file_name, strerror(errno));
+        return SC_FALSE;
+    }
+    worker->written_bytes += output->length;
+    return SC_TRUE;
+}
+
+static void generator_worker_generate(GeneratorWorker *worker, const PayloadBatch *batch, size_t i)
+{
+    const char *name = (const char *)batch->text.data + batch->name_offsets[i];
+    const uint8_t *data = batch->text.data + batch->data_offsets[i];
+    const size_t data_length = batch->data_lengths[i];
+
+    ScEncodingArray *encoding = &worker->ascii_encoding;
+    for (size_t j = 0; j < data_length; ++j) {
+        if (data[j] >= 0x80) {
+            encoding = &worker->utf8_encoding;
+            break;
+        }
+    }
+    encoding->encodings[0].end = (uint32_t)data_length;
+    ScError error;
+    ScImageBuffer *image = sc_barcode_generator_generate(worker->generator, data, data_length,
+                                                         *encoding, &error);
+    if (image == NULL) {
+        printf("Could not generate image for line %llu ('%s'): %s\n",
+               (unsigned long long)batch->line_numbers[i], name, error.message);
+        sc_error_free(&error);
+        worker->failed_count++;
+        return;
+    }
+
+    ByteBuffer *output = &worker->output;
+    output->length = worker->pool->output_directory != NULL ? 0 : TAR_BLOCK_SIZE;
+    const ScBool encoded = byte_buffer_reserve(output, output->length) &&
+                           image_encoder_encode(&worker->encoder, image, output);
+    char file_name[TAR_NAME_SIZE];
+    image_encoder_file_name(&worker->encoder, name, image, file_name, sizeof(file_name));
+    sc_image_buffer_free(image);
+    if (!encoded) {
+        printf("Could not encode image for line %llu ('%s').\n",
+               (unsigned long long)batch->line_numbers[i], name);
+        worker->failed_count++;
+        return;
+    }
+    if (!generator_worker_write(worker, file_name)) {
+        worker->failed_count++;
+        return;
+    }
+    worker->generated_count++;
+}
+
+static void *generator_worker_run(void *argument)
+{
+    GeneratorWorker *worker = argument;
+    GeneratorPool *pool = worker->pool;
+
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        while (pool->ready_count == 0 && !pool->input_finished) {
+            pthread_cond_wait(&pool->batch_ready, &pool->lock);
+        }
+        if (pool->ready_count == 0) {
+            pthread_mutex_unlock(&pool->lock);
+            break;
+        }
+        PayloadBatch *batch = pool->ready[pool->ready_head];
+        pool->ready_head = (pool->ready_head + 1) % BATCH_QUEUE_SIZE;
+        pool->ready_count--;
+        pthread_mutex_unlock(&pool->lock);
+
+        for (size_t i = 0; i < batch->count; ++i) {
+            generator_worker_generate(worker, batch, i);
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        pool->free_batches[pool->free_count++] = batch;
+        pthread_cond_signal(&pool->batch_free);
+        pthread_mutex_unlock(&pool->lock);
+    }
+    return NULL;
+}
+
+/**
+ * Creates the recognition context and the barcode generator of a worker.
+ */
+static ScBool generator_worker_setup(GeneratorWorker *worker, ScSymbology symbology)
+{
+    worker->context = sc_recognition_context_new(SCANDIT_SDK_LICENSE_KEY, "/tmp", NULL);
+    if (worker->context == NULL) {
+        printf("Could not initialize context.\n");
+        return SC_FALSE;
+    }
+    ScError error;
+    worker->generator = sc_barcode_generator_new_with_options(worker->context, symbology,
+                                                              GENERATOR_OPTIONS, &error);
+    if (worker->generator == NULL) {
+        printf("Could create generator object: %s\n", error.message);
+        sc_error_free(&error);
+        return SC_FALSE;
+    }
+    // Payloads are ASCII unless they contain other characters, which are UTF-8 in the
+    // input and as written by json_parse_string().
+    worker->ascii_encoding = sc_encoding_array_new(1);
+    sc_encoding_array_assign(&worker->ascii_encoding, 0, "US-ASCII", 0, 0);
+    worker->utf8_encoding = sc_encoding_array_new(1);
+    sc_encoding_array_assign(&worker->utf8_encoding, 0, "UTF-8", 0, 0);
+    return SC_TRUE;
+}
+
+static void generator_worker_teardown(GeneratorWorker *worker)
+{
+    sc_barcode_generator_free(worker->generator);
+    if (worker->ascii_encoding.encodings != NULL) {
+        sc_encoding_array_free(worker->ascii_encoding);
+    }
+    if (worker->utf8_encoding.encodings != NULL) {
+        sc_encoding_array_free(worker->utf8_encoding);
+    }
+    sc_recognition_context_release(worker->context);
+    free(worker->output.data);
+    image_encoder_release(&worker->encoder);
+}
+
+/**
+ * Takes a free batch, waits for the workers if all batches are in use.
+ */
+static PayloadBatch *generator_pool_acquire_batch(GeneratorPool *pool)
+{
+    pthread_mutex_lock(&pool->lock);
+    while (pool->free_count == 0) {
+        pthread_cond_wait(&pool->batch_free, &pool->lock);
+    }
+    PayloadBatch *batch = pool->free_batches[--pool->free_count];
+    pthread_mutex_unlock(&pool->lock);
+    batch->count = 0;
+    batch->text.length = 0;
+    return batch;
+}
+
+static void generator_pool_submit_batch(GeneratorPool *pool, PayloadBatch *batch)
+{
+    pthread_mutex_lock(&pool->lock);
+    pool->ready[(pool->ready_head + pool->ready_count) % BATCH_QUEUE_SIZE] = batch;
+    pool->ready_count++;
+    pthread_cond_signal(&pool->batch_ready);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/**
+ * Parses one NDJSON payload, {"name": "...", "data": "..."}. The name is optional.
+ */
+static ScBool parse_json_payload(const char *line, char *name, char *data, size_t *data_length)
+{
+    const char *p = json_skip_whitespace(line);
+    if (*p++ != '{') {
+        return SC_FALSE;
+    }
+    ScBool has_data = SC_FALSE;
+    p = json_skip_whitespace(p);
+    while (*p != '}') {
+        char key[32];
+        size_t key_length;
+        p = json_parse_string(p, key, sizeof(key), &key_length);
+        if (p == NULL || *(p = json_skip_whitespace(p)) != ':') {
+            return SC_FALSE;
+        }
+        p = json_skip_whitespace(p + 1);
+
+        const char *value_end = json_skip_value(p);
+        if (value_end == NULL) {
+            return SC_FALSE;
+        }
+        size_t name_length;
+        if (strcmp(key, "name") == 0) {
+            if (json_parse_string(p, name, MAX_NAME_LENGTH + 1, &name_length) == NULL) {
+                return SC_FALSE;
+            }
+        } else if (strcmp(key, "data") == 0) {
+            if (json_parse_string(p, data, MAX_PAYLOAD_LENGTH + 1, data_length) == NULL) {
+                return SC_FALSE;
+            }
+            has_data = SC_TRUE;
+        }
+        // Unknown members are ignored.
+
+        p = json_skip_whitespace(value_end);
+        if (*p == ',') {
+            p = json_skip_whitespace(p + 1);
+        } else if (*p != '}') {
+            return SC_FALSE;
+        }
+    }
+    return has_data;
+}
+
+/**
+ * Parses one line of the input into the name and the data of a payload.
+ */
+static ScBool parse_payload(const char *line, size_t line_length, char *name, char *data,
+                            size_t *data_length)
+{
+    name[0] = '\0';
+    if (*json_skip_whitespace(line) == '{') {
+        return parse_json_payload(line, name, data, data_length);
+    }
+    const char *comma = memchr(line, ',', line_length);
+    const char *data_start = line;
+    if (comma != NULL) {
+        const size_t name_length = comma - line;
+        if (name_length > MAX_NAME_LENGTH) {
+            return SC_FALSE;
+        }
+        memcpy(name, line, name_length);
+        name[name_length] = '\0';
+        data_start = comma + 1;
+    }
+    *data_length = line + line_length - data_start;
+    if (*data_length > MAX_PAYLOAD_LENGTH) {
+        return SC_FALSE;
+    }
+    memcpy(data, data_start, *data_length);
+    return SC_TRUE;
+}
+
+/**
+ * Makes the name usable as a file name: path separators and a leading dot are
+ * replaced. Payloads without a name are named after their line.
+ */
+static void sanitize_name(char *name, uint64_t line_number)
+{
+    if (name[0] == '\0') {
+        snprintf(name, MAX_NAME_LENGTH + 1, "%08llu", (unsigned long long)line_number);
+        return;
+    }
+    for (char *c = name; *c != '\0'; ++c) {
+        if (*c == '/' || *c == '\\' || (unsigned char)*c < 0x20 || (c == name && *c == '.')) {
+            *c = '_';
+        }
+    }
+}
+
+/**
+ * Reads the payloads and hands them to the workers in batches.
+ *
+ * \returns the number of lines that could not be parsed.
+ */
+static uint64_t generator_pool_read_payloads(GeneratorPool *pool, FILE *input)
+{
+    char name[MAX_NAME_LENGTH + 1];
+    char data[MAX_PAYLOAD_LENGTH + 1];
+    char *line = NULL;
+    size_t line_capacity = 0;
+    ssize_t line_length;
+    uint64_t line_number = 0;
+    uint64_t invalid_count = 0;
+    PayloadBatch *batch = generator_pool_acquire_batch(pool);
+
+    while ((line_length = getline(&line, &line_capacity, input)) >= 0) {
+        line_number++;
+        while (line_length > 0 && (line[line_length - 1] == '\n' || line[line_length - 1] == '\r')) {
+            line[--line_length] = '\0';
+        }
+        if (line_length == 0) {
+            continue;
+        }
+        size_t data_length;
+        if (!parse_payload(line, line_length, name, data, &data_length)) {
+            printf("Skipping invalid or too long payload in line %llu.\n",
+                   (unsigned long long)line_number);
+            invalid_count++;
+            continue;
+        }
+        sanitize_name(name, line_number);
+
+        ByteBuffer *text = &batch->text;
+        const size_t i = batch->count;
+        batch->line_numbers[i] = line_number;
+        batch->name_offsets[i] = text->length;
+        batch->data_lengths[i] = data_length;
+        if (!byte_buffer_append(text, name, strlen(name) + 1)) {
+            printf("Out of memory while reading the payloads.\n");
+            break;
+        }
+        batch->data_offsets[i] = text->length;
+        if (!byte_buffer_append(text, data, data_length)) {
+            printf("Out of memory while reading the payloads.\n");
+            break;
+        }
+        if (++batch->count == BATCH_SIZE) {
+            generator_pool_submit_batch(pool, batch);
+            batch = generator_pool_acquire_batch(pool);
+        }
+    }
+    free(line);
+
+    if (batch->count > 0) {
+        generator_pool_submit_batch(pool, batch);
+    } else {
+        pthread_mutex_lock(&pool->lock);
+        pool->free_batches[pool->free_count++] = batch;
+        pthread_mutex_unlock(&pool->lock);
+    }
+    pthread_mutex_lock(&pool->lock);
+    pool->input_finished = SC_TRUE;
+    pthread_cond_broadcast(&pool->batch_ready);
+    pthread_mutex_unlock(&pool->lock);
+    return invalid_count;
+}
+
+static void generator_pool_release(GeneratorPool *pool)
+{
+    for (size_t i = 0; i < pool->worker_count; ++i) {
+        generator_worker_teardown(&pool->workers[i]);
+    }
+    for (size_t i = 0; i < BATCH_QUEUE_SIZE; ++i) {
+        free(pool->batches[i].text.data);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->batch_ready);
+    pthread_cond_destroy(&pool->batch_free);
+    free(pool->workers);
+    free(pool);
+}
+
+/**
+ * Generates the codes for all payloads of the input with a pool of workers.
+ */
+static int generate_batch(const char *input_path, size_t worker_count, ScSymbology symbology,
+                          OutputFormat output_format, int compression_level,
+                          const char *output_directory, const char *archive_path)
+{
+    FILE *input = strcmp(input_path, "-") == 0 ? stdin : fopen(input_path, "r");
+    if (input == NULL) {
+        printf("Could not open '%s': %s\n", input_path, strerror(errno));
+        return 1;
+    }
+
+    GeneratorPool *pool = calloc(1, sizeof(GeneratorPool));
+    if (pool == NULL || (pool->workers = calloc(worker_count, sizeof(GeneratorWorker))) == NULL) {
+        printf("Out of memory.\n");
+        free(pool);
+        if (input != stdin) {
+            fclose(input);
+        }
+        return 1;
+    }
+    pool->symbology = symbology;
+    pool->output_format = output_format;
+    pool->compression_level = compression_level;
+    pool->output_directory = output_directory;
+    pool->archive_fd = -1;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->batch_ready, NULL);
+    pthread_cond_init(&pool->batch_free, NULL);
+    for (size_t i = 0; i < BATCH_QUEUE_SIZE; ++i) {
+        pool->free_batches[pool->free_count++] = &pool->batches[i];
+    }
+
+    int return_code = 0;
+    if (output_directory != NULL) {
+        if (mkdir(output_directory, 0755) != 0 && errno != EEXIST) {
+            printf("Could not create '%s': %s\n", output_directory, strerror(errno));
+            return_code = 1;
+            goto cleanup;
+        }
+    } else {
+        pool->archive_fd = open(archive_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (pool->archive_fd < 0) {
+            printf("Could not create '%s': %s\n", archive_path, strerror(errno));
+            return_code = 1;
+            goto cleanup;
+        }
+    }
+
+    // The generators are created once and reused for all codes.
+    for (size_t i = 0; i < worker_count; ++i) {
+        GeneratorWorker *worker = &pool->workers[i];
+        worker->pool = pool;
+        worker->encoder.format = output_format;
+        worker->encoder.compression_level = compression_level;
+        pool->worker_count++;
+        if (!generator_worker_setup(worker, symbology)) {
+            return_code = 1;
+            goto cleanup;
+        }
+    }
+
+    const double start = now_seconds();
+    size_t started_count = 0;
+    for (size_t i = 0; i < worker_count; ++i) {
+        GeneratorWorker *worker = &pool->workers[i];
+        if (pthread_create(&worker->thread, NULL, generator_worker_run, worker) != 0) {
+            printf("Could not start worker thread.\n");
+            break;
+        }
+        worker->thread_started = SC_TRUE;
+        started_count++;
+    }
+
+    uint64_t invalid_count = 0;
+    if (started_count > 0) {
+        invalid_count = generator_pool_read_payloads(pool, input);
+    } else {
+        return_code = 1;
+    }
+    for (size_t i = 0; i < worker_count; ++i) {
+        if (pool->workers[i].thread_started) {
+            pthread_join(pool->workers[i].thread, NULL);
+        }
+    }
+    const double seconds = now_seconds() - start;
+
+    if (pool->archive_fd >= 0) {
+        // A tar archive ends with two empty blocks.
+        static const uint8_t end_blocks[2 * TAR_BLOCK_SIZE];
+        if (!pwrite_all(pool->archive_fd, end_blocks, sizeof(end_blocks), pool->archive_end)) {
+            printf("Could not finish the archive: %s\n", strerror(errno));
+            return_code = 1;
+        }
+    }
+
+    uint64_t generated_count = 0;
+    uint64_t failed_count = 0;
+    uint64_t written_bytes = 0;
+    for (size_t i = 0; i < pool->worker_count; ++i) {
+        generated_count += pool->workers[i].generated_count;
+        failed_count += pool->workers[i].failed_count;
+        written_bytes += pool->workers[i].written_bytes;
+    }
+    printf("Generated %llu codes in %.2f s (%.0f codes per second) with %zu workers, "
+           "%llu failed, %llu invalid payloads, %llu bytes written\n",
+           (unsigned long long)generated_count, seconds,
+           seconds > 0.0 ? generated_count / seconds : 0.0, started_count,
+           (unsigned long long)failed_count, (unsigned long long)invalid_count,
+           (unsigned long long)written_bytes);
+    if (failed_count > 0 || invalid_count > 0) {
+        return_code = 1;
+    }
+
+cleanup:
+    if (pool->archive_fd >= 0 && close(pool->archive_fd) != 0) {
+        printf("Could not write '%s': %s\n", archive_path, strerror(errno));
+        return_code = 1;
+    }
+    generator_pool_release(pool);
+    if (input != stdin) {
+        fclose(input);
+    }
+    return return_code;
+}
+
+/**
+ * Generates one code with BARCODE_DATA and writes it to OUTPUT_NAME, with the
+ * extension of the output format.
+ */
+static int generate_single_code(OutputFormat output_format, int compression_level)
 {
     const uint8_t* data = (uint8_t*) BARCODE_DATA;
     size_t data_length = strlen(BARCODE_DATA);
 
-    printf("Scandit SDK Version: %s\n", SC_VERSION_STRING);
-
     ScRecognitionContext *context = NULL;
     ScBarcodeGenerator *generator = NULL;
     ScImageBuffer *image = NULL;
@@ -42,18 +1055,12 @@ int main(int argc, const char *argv[])
 
     // Set the desired symbology and options.
     ScSymbology symbology = SC_SYMBOLOGY_QR;
-    const char * OPTIONS =
-        "{"
-        "   \"foregroundColor\" : [0, 0, 0, 255],"
-        "   \"backgroundColor\" : [255, 255, 255, 255],"
-        "   \"errorCorrectionLevel\" : \"H\""
-        "}";
     // The code is assumed to be ASCII from start to end.
     ScEncodingArray encoding = sc_encoding_array_new(1);
     sc_encoding_array_assign(&encoding, 0, "US-ASCII", 0, data_length);
 
     // Create the barcode generator object.
-    generator = sc_barcode_generator_new_with_options(context, symbology, OPTIONS, &error);
+    generator = sc_barcode_generator_new_with_options(context, symbology, GENERATOR_OPTIONS, &error);
     if (generator == NULL) {
         printf("Could create generator object: %s\n", error.message);
         return 1;
@@ -65,49 +1072,134 @@ int main(int argc, const char *argv[])
         printf("Could not generate image: %s\n", error.message);
         return 1;
     }
-    size_t width = sc_image_description_get_width(image->description);
-    size_t height = sc_image_description_get_height(image->description);
 
-
-    // Write image to file using libPNG
-    FILE *fp = fopen(OUTPUT_FILE, "wb");
-    if (fp == NULL) {
-        printf("Could not open file %s.\n", OUTPUT_FILE);
-        return 1;
+    // Encode the image and write it to the file.
+    ImageEncoder encoder = { output_format, compression_level, { NULL, 0, 0 }, NULL, 0 };
+    ByteBuffer output = { NULL, 0, 0 };
+    char file_name[TAR_NAME_SIZE];
+    image_encoder_file_name(&encoder, OUTPUT_NAME, image, file_name, sizeof(file_name));
+    int return_code = 0;
+    if (!image_encoder_encode(&encoder, image, &output)) {
+        printf("Could not encode the image.\n");
+        return_code = 1;
+    } else if (!write_file(file_name, output.data, output.length)) {
+        printf("Could not open file %s.\n", file_name);
+        return_code = 1;
     }
-    png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
-    if (png == NULL) {
-        printf("Failed to create png write struct.\n");
-        return 1;
-    }
-    png_infop info = png_create_info_struct(png);
-    if (info == NULL) {
-        printf("Failed to create png info struct.\n");
-        return 1;
-    }
-    png_init_io(png, fp);
-    png_set_IHDR(png,
-                  info,
-                  width, height,
-                  8,
-                  PNG_COLOR_TYPE_RGBA,
-                  PNG_INTERLACE_NONE,
-                  PNG_COMPRESSION_TYPE_DEFAULT,
-                  PNG_FILTER_TYPE_DEFAULT
-                 );
-    png_byte** rows = (png_byte**)malloc(height * sizeof(png_byte*));
-    for (size_t i = 0; i < height; i++) {
-        rows[i] = (png_byte*) &(image->data[width*4*i]);
-    }
-    png_set_rows(png, info, rows);
-    png_write_png(png, info, 0, NULL);
-    free(rows);
-    png_destroy_write_struct(&png, &info);
-    fclose(fp);
+    image_encoder_release(&encoder);
+    free(output.data);
 
     // Clean up.
     sc_image_buffer_free(image);
     sc_barcode_generator_free(generator);
     sc_encoding_array_free(encoding);
     sc_recognition_context_release(context);
+    return return_code;
+}
+
+static void print_usage(const char *program_name)
+{
+    printf("Usage: %s [--format png|png1|pbm|raw] [--compression 0-9]\n"
+           "       %s --batch payloads|- [-j workers] [--symbology name]\n"
+           "           [--format png|png1|pbm|raw] [--compression 0-9]\n"
+           "           (--output-dir directory | --archive file.tar)\n",
+           program_name, program_name);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *batch_path = NULL;
+    const char *output_directory = NULL;
+    const char *archive_path = NULL;
+    ScSymbology symbology = SC_SYMBOLOGY_QR;
+    OutputFormat output_format = OUTPUT_FORMAT_PNG_RGBA;
+    int compression_level = -1;
+    const long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+    long worker_count = cpu_count > 0 ? cpu_count : 1;
+    if (worker_count > MAX_WORKER_COUNT) {
+        worker_count = MAX_WORKER_COUNT;
+    }
+
+    static const struct option long_options[] = {
+        { "batch", required_argument, NULL, 'b' },
+        { "jobs", required_argument, NULL, 'j' },
+        { "symbology", required_argument, NULL, 's' },
+        { "output-dir", required_argument, NULL, 'o' },
+        { "archive", required_argument, NULL, 'a' },
+        { "format", required_argument, NULL, 'f' },
+        { "compression", required_argument, NULL, 'z' },
+        { "help", no_argument, NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+    int option;
+    while ((option = getopt_long(argc, argv, "b:j:s:o:a:f:z:h", long_options, NULL)) != -1) {
+        switch (option) {
+            case 'b':
+                batch_path = optarg;
+                break;
+            case 'j':
+                worker_count = strtol(optarg, NULL, 10);
+                if (worker_count < 1 || worker_count > MAX_WORKER_COUNT) {
+                    printf("The number of workers must be between 1 and %d.\n", MAX_WORKER_COUNT);
+                    return 1;
+                }
+                break;
+            case 's':
+                symbology = sc_symbology_from_string(optarg);
+                if (symbology == SC_SYMBOLOGY_UNKNOWN) {
+                    printf("Unknown symbology '%s'.\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'o':
+                output_directory = optarg;
+                break;
+            case 'a':
+                archive_path = optarg;
+                break;
+            case 'f': {
+                ScBool known = SC_FALSE;
+                for (size_t i = 0; i < sizeof(OUTPUT_FORMATS) / sizeof(OUTPUT_FORMATS[0]); ++i) {
+                    if (strcmp(optarg, OUTPUT_FORMATS[i].name) == 0) {
+                        output_format = OUTPUT_FORMATS[i].format;
+                        known = SC_TRUE;
+                    }
+                }
+                if (!known) {
+                    printf("Unknown output format '%s'.\n", optarg);
+                    return 1;
+                }
+                break;
+            }
+            case 'z': {
+                char *end;
+                compression_level = (int)strtol(optarg, &end, 10);
+                if (*optarg == '\0' || *end != '\0' || compression_level < 0 ||
+                    compression_level > 9) {
+                    printf("The compression level must be between 0 and 9.\n");
+                    return 1;
+                }
+                break;
+            }
+            case 'h':
+                print_usage(argv[0]);
+                return 0;
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+    if (optind < argc ||
+        (batch_path != NULL && (output_directory == NULL) == (archive_path == NULL))) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    printf("Scandit SDK Version: %s\n", SC_VERSION_STRING);
+
+    if (batch_path != NULL) {
+        return generate_batch(batch_path, (size_t)worker_count, symbology, output_format,
+                              compression_level, output_directory, archive_path);
+    }
+    return generate_single_code(output_format, compression_level);
 }
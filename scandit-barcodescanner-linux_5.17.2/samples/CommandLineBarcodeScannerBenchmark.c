@@ -0,0 +1,2557 @@
+/**
+ * \file CommandLineBarcodeScannerBenchmark.c
+ *
+ * \brief ScanditSDK benchmark application
+ *
+ * Runs the barcode scanner over a corpus of images and measures every stage of the
+ * processing separately:
+ *
+ * - load: reading and decoding the image file (SDL2_image)
+ * - convert: converting the decoded image to the 8 bit gray layout
+ * - recognition: sc_recognition_context_process_frame()
+ * - extraction: reading the newly recognized codes from the session
+ *
+ * The latencies of every stage are collected in histograms. The report contains
+ * p50/p90/p99/max per stage, the throughput and the recognition rate per symbology
+ * and is written as JSON, so that runs with different SDK releases or settings can be
+ * compared with a script. The report goes to stdout unless --output is given, all
+ * diagnostics go to stderr.
+ *
+ * The corpus is processed --warmup times without measuring and then --iterations
+ * times with measuring. Every image is processed as its own frame sequence.
+ *
+ * The corpus may also contain frame recordings (.rec) written by the camera sample with
+ * --record. All frames of a recording are processed as one frame sequence in the layout
+ * they were captured in, so they have no convert stage, and loading a frame is copying
+ * it out of the mapped recording. Recordings carry no labels and only one layout, so
+ * --tune and --layouts skip them.
+ *
+ * With --layouts the cost of process_frame is measured per ScImageLayout instead.
+ * Every image is scaled to each of the --resolutions and handed to the scanner as
+ * gray, RGB, RGBA, ARGB, NV12, NV21, YUYV, UYVY and I420 frame. The report compares
+ * the native layout with extracting the luma plane first (AVX2 or NEON where
+ * available) and scanning it as gray, and names the faster of the two per layout.
+ *
+ * With --round-trip no images are needed. A code with a known payload is generated with
+ * ScBarcodeGenerator for every symbology of ROUND_TRIP_CODES that is enabled in the
+ * settings. Each code is drawn into a gray frame, once undistorted and once for every
+ * level of every distortion in ROUND_TRIP_LEVELS: scale, rotation, blur, noise,
+ * perspective and contrast inversion. A frame counts as recognized if the scanner
+ * returns the code with the right symbology and data. The report contains the
+ * recognition rate and the process_frame latency per symbology and distortion level,
+ * so that SDK releases can be checked for speed and accuracy regressions without a
+ * corpus. Every iteration draws the codes with a different subpixel offset and noise.
+ * Inverted codes are only recognized if the settings enable color inverted codes.
+ *
+ * With --tune the benchmark searches for the fastest settings that still find the codes
+ * of a labelled corpus. The labels file given with --labels has one line per expected
+ * code, "path,symbology,data", and "path,," for images without codes. Relative paths
+ * are relative to the labels file. Starting from the default or --settings, every
+ * combination of the choices in the TUNE_* tables is applied: all or only the
+ * labelled symbologies, the Code128 symbol counts, the maximum number of codes per
+ * frame, the code direction hint and the location constraints. The images are decoded
+ * once, then only process_frame is timed. The recall is the share of the labelled
+ * codes found with the right symbology and data. The report lists all combinations and,
+ * with their settings as JSON, the ones no other combination beats in both mean
+ * latency and recall (the Pareto front). --tuned-settings writes the fastest
+ * combination that reaches --recall-target as a file that --settings and
+ * sc_barcode_scanner_settings_new_from_json() load.
+ *
+ * Example:
+ * ./CommandLineBarcodeScannerBenchmark --iterations 5 --output report.json /data/corpus
+ * ./CommandLineBarcodeScannerBenchmark --settings tuned.json /data/corpus
+ * ./CommandLineBarcodeScannerBenchmark --layouts --resolutions 640x480,1920x1080 /data/corpus
+ * ./CommandLineBarcodeScannerBenchmark --round-trip --iterations 10 --output round-trip.json
+ * ./CommandLineBarcodeScannerBenchmark --tune --labels labels.csv --tuned-settings fast.json /data/corpus
+ *
+ * \copyright Copyright (c) 2018 Scandit AG. All rights reserved.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <getopt.h>
+#include <libgen.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <SDL2/SDL_endian.h>
+#include <SDL2/SDL_image.h>
+#include <SDL2/SDL_surface.h>
+
+#include <Scandit/ScRecognitionContext.h>
+#include <Scandit/ScBarcodeScanner.h>
+#include <Scandit/ScBarcodeGenerator.h>
+
+#include "FrameRecording.h"
+#include "LumaConversion.h"
+
+// Please insert your app key here:
+#define SCANDIT_SDK_LICENSE_KEY "-- INSERT YOUR LICENSE KEY HERE --"
+
+// Histogram buckets are exact below 2^HISTOGRAM_SUB_BUCKET_BITS nanoseconds. Above,
+// every power of two is split into 2^HISTOGRAM_SUB_BUCKET_BITS buckets, which bounds
+// the relative error of the reported percentiles to about 3%.
+#define HISTOGRAM_SUB_BUCKET_BITS 5
+#define HISTOGRAM_SUB_BUCKETS (1u << HISTOGRAM_SUB_BUCKET_BITS)
+#define HISTOGRAM_BUCKET_COUNT ((64 - HISTOGRAM_SUB_BUCKET_BITS + 1) * HISTOGRAM_SUB_BUCKETS)
+
+#define MAX_SYMBOLOGY_COUNT 64
+
+#define LAYOUT_COUNT 9
+#define MAX_BENCHMARK_RESOLUTIONS 8
+#define DEFAULT_BENCHMARK_RESOLUTIONS "640x480,1280x720,1920x1080"
+
+#define ROUND_TRIP_FRAME_WIDTH 640
+#define ROUND_TRIP_FRAME_HEIGHT 480
+// Undistorted codes cover this part of the shorter frame side.
+#define ROUND_TRIP_CODE_SIZE 0.5
+
+typedef enum {
+    STAGE_LOAD,
+    STAGE_CONVERT,
+    STAGE_RECOGNITION,
+    STAGE_EXTRACTION,
+    STAGE_TOTAL,
+    STAGE_COUNT
+} Stage;
+
+static const char * const stage_names[STAGE_COUNT] = {
+    "load", "convert", "recognition", "extraction", "total"
+};
+
+/**
+ * Log-linear latency histogram with nanosecond resolution.
+ */
+typedef struct LatencyHistogram {
+    uint64_t counts[HISTOGRAM_BUCKET_COUNT];
+    uint64_t count;
+    uint64_t total_ns;
+    uint64_t min_ns;
+    uint64_t max_ns;
+} LatencyHistogram;
+
+typedef struct SymbologyStatistics {
+    ScSymbology symbology;
+    // Number of frames in which the symbology was recognized at least once.
+    uint64_t frames;
+    uint64_t codes;
+} SymbologyStatistics;
+
+typedef struct ImageList {
+    char **paths;
+    size_t count;
+    size_t capacity;
+} ImageList;
+
+/**
+ * 8 bit gray image. The buffer is reused for consecutive images and only grows.
+ */
+typedef struct GrayImage {
+    uint8_t *data;
+    size_t capacity;
+    uint32_t width;
+    uint32_t height;
+    uint32_t row_bytes;
+} GrayImage;
+
+typedef struct Benchmark {
+    ScRecognitionContext *context;
+    ScBarcodeScanner *scanner;
+    ScImageDescription *image_descr;
+    GrayImage image;
+
+    LatencyHistogram stages[STAGE_COUNT];
+    SymbologyStatistics symbologies[MAX_SYMBOLOGY_COUNT];
+    size_t symbology_count;
+
+    uint64_t frames;
+    uint64_t frames_with_codes;
+    uint64_t failed_loads;
+    uint64_t failed_frames;
+    ScContextStatusFlag last_failure;
+    double wall_seconds;
+} Benchmark;
+
+typedef struct LayoutStatistics {
+    LatencyHistogram recognition;
+    LatencyHistogram to_luma;
+    uint64_t frames_with_codes;
+} LayoutStatistics;
+
+/**
+ * Buffers and results of the per layout benchmark.
+ */
+typedef struct LayoutBenchmark {
+    ScSize resolutions[MAX_BENCHMARK_RESOLUTIONS];
+    uint32_t resolution_count;
+    LayoutStatistics statistics[MAX_BENCHMARK_RESOLUTIONS][LAYOUT_COUNT];
+    uint8_t *rgb;
+    uint8_t *frame;
+    uint8_t *luma;
+} LayoutBenchmark;
+
+typedef enum {
+    DISTORTION_NONE,
+    DISTORTION_SCALE,
+    DISTORTION_ROTATION,
+    DISTORTION_BLUR,
+    DISTORTION_NOISE,
+    DISTORTION_PERSPECTIVE,
+    DISTORTION_INVERSION
+} Distortion;
+
+/**
+ * Codes of the round trip benchmark. The payloads are valid for their symbology,
+ * including the check digits.
+ */
+static const struct {
+    ScSymbology symbology;
+    const char *data;
+} ROUND_TRIP_CODES[] = {
+    { SC_SYMBOLOGY_EAN13, "5901234123457" },
+    { SC_SYMBOLOGY_EAN8, "96385074" },
+    { SC_SYMBOLOGY_UPCA, "036000291452" },
+    { SC_SYMBOLOGY_CODE39, "SCANDIT-5172" },
+    { SC_SYMBOLOGY_CODE128, "Scandit round trip 5.17" },
+    { SC_SYMBOLOGY_INTERLEAVED_2_OF_5, "0123456789" },
+    { SC_SYMBOLOGY_QR, "https://www.scandit.com/ round trip 5.17" },
+    { SC_SYMBOLOGY_DATA_MATRIX, "Scandit round trip 5.17" },
+    { SC_SYMBOLOGY_PDF417, "Scandit round trip 5.17" },
+    { SC_SYMBOLOGY_AZTEC, "Scandit round trip 5.17" },
+};
+#define ROUND_TRIP_CODE_COUNT (sizeof(ROUND_TRIP_CODES) / sizeof(ROUND_TRIP_CODES[0]))
+
+/**
+ * Distortion levels of the round trip benchmark, each applied on its own. Scale is a
+ * factor of the undistorted size, rotation in degrees, blur the radius of two box
+ * blurs in pixels, noise the standard deviation in gray levels and perspective how
+ * much smaller the right edge of the code is drawn than the left one.
+ */
+static const struct {
+    const char *name;
+    Distortion distortion;
+    double level;
+} ROUND_TRIP_LEVELS[] = {
+    { "none", DISTORTION_NONE, 0.0 },
+    { "scale", DISTORTION_SCALE, 0.25 },
+    { "scale", DISTORTION_SCALE, 0.5 },
+    { "scale", DISTORTION_SCALE, 1.5 },
+    { "rotation", DISTORTION_ROTATION, 10.0 },
+    { "rotation", DISTORTION_ROTATION, 30.0 },
+    { "rotation", DISTORTION_ROTATION, 45.0 },
+    { "blur", DISTORTION_BLUR, 1.0 },
+    { "blur", DISTORTION_BLUR, 2.0 },
+    { "blur", DISTORTION_BLUR, 3.0 },
+    { "noise", DISTORTION_NOISE, 10.0 },
+    { "noise", DISTORTION_NOISE, 25.0 },
+    { "noise", DISTORTION_NOISE, 50.0 },
+    { "perspective", DISTORTION_PERSPECTIVE, 0.2 },
+    { "perspective", DISTORTION_PERSPECTIVE, 0.4 },
+    { "perspective", DISTORTION_PERSPECTIVE, 0.6 },
+    { "inversion", DISTORTION_INVERSION, 1.0 },
+};
+#define ROUND_TRIP_LEVEL_COUNT (sizeof(ROUND_TRIP_LEVELS) / sizeof(ROUND_TRIP_LEVELS[0]))
+
+typedef struct RoundTripStatistics {
+    uint64_t frames;
+    uint64_t recognized;
+    LatencyHistogram recognition;
+} RoundTripStatistics;
+
+/**
+ * Generated codes, frame buffers and results of the round trip benchmark.
+ */
+typedef struct RoundTripBenchmark {
+    // Gray versions of the generated codes. Codes that are not enabled in the
+    // settings or could not be generated have no data and a reason why they are
+    // skipped.
+    GrayImage codes[ROUND_TRIP_CODE_COUNT];
+    const char *skip_reasons[ROUND_TRIP_CODE_COUNT];
+    uint8_t *frame;
+    uint8_t *scratch;
+    uint64_t random_state;
+    RoundTripStatistics statistics[ROUND_TRIP_CODE_COUNT][ROUND_TRIP_LEVEL_COUNT];
+} RoundTripBenchmark;
+
+/**
+ * A code that is expected in an image of the tuning corpus. Images without codes have
+ * one label with symbology SC_SYMBOLOGY_UNKNOWN.
+ */
+typedef struct CorpusLabel {
+    char *path;
+    ScSymbology symbology;
+    char *data;
+    size_t data_length;
+} CorpusLabel;
+
+typedef struct LabelList {
+    CorpusLabel *labels;
+    size_t count;
+    size_t capacity;
+} LabelList;
+
+// Settings choices of the tuner. All combinations are measured.
+static const struct {
+    const char *name;
+    ScBool labelled_only;
+} TUNE_SYMBOLOGIES[] = {
+    { "settings", SC_FALSE },
+    { "labelled", SC_TRUE },
+};
+#define TUNE_SYMBOLOGY_CHOICES (sizeof(TUNE_SYMBOLOGIES) / sizeof(TUNE_SYMBOLOGIES[0]))
+
+// Code128 symbol counts, from and to. 0 keeps the counts of the settings.
+static const struct {
+    const char *name;
+    uint16_t from;
+    uint16_t to;
+} TUNE_CODE128_SYMBOL_COUNTS[] = {
+    { "settings", 0, 0 },
+    { "4-20", 4, 20 },
+};
+#define TUNE_CODE128_CHOICES (sizeof(TUNE_CODE128_SYMBOL_COUNTS) / sizeof(TUNE_CODE128_SYMBOL_COUNTS[0]))
+
+static const struct {
+    const char *name;
+    ScCodeDirection direction;
+} TUNE_DIRECTIONS[] = {
+    { "none", SC_CODE_DIRECTION_NONE },
+    { "left-to-right", SC_CODE_DIRECTION_LEFT_TO_RIGHT },
+    { "bottom-to-top", SC_CODE_DIRECTION_BOTTOM_TO_TOP },
+};
+#define TUNE_DIRECTION_CHOICES (sizeof(TUNE_DIRECTIONS) / sizeof(TUNE_DIRECTIONS[0]))
+
+static const struct {
+    const char *name;
+    ScCodeLocationConstraint constraint;
+} TUNE_LOCATIONS[] = {
+    { "ignore", SC_CODE_LOCATION_IGNORE },
+    { "hint", SC_CODE_LOCATION_HINT },
+    { "restrict", SC_CODE_LOCATION_RESTRICT },
+};
+#define TUNE_LOCATION_CHOICES (sizeof(TUNE_LOCATIONS) / sizeof(TUNE_LOCATIONS[0]))
+
+/**
+ * One combination of the settings choices and its results.
+ */
+typedef struct TuneCandidate {
+    size_t symbologies;
+    size_t code128_symbol_counts;
+    // The maximum number of codes per frame is 1 or the most codes in one image.
+    uint32_t max_codes_per_frame;
+    size_t direction;
+    size_t location;
+
+    LatencyHistogram recognition;
+    uint64_t expected_codes;
+    uint64_t found_codes;
+    uint64_t false_positives;
+    ScBool pareto;
+} TuneCandidate;
+
+/**
+ * Decoded corpus, labels and results of the tuner. The labels of an image follow each
+ * other, since the labels are sorted by path.
+ */
+typedef struct Tuner {
+    GrayImage *images;
+    size_t *first_labels;
+    size_t *label_counts;
+    size_t image_count;
+    LabelList labels;
+    // Symbologies that occur in the labels, as bit mask.
+    uint32_t labelled_symbologies;
+    uint32_t max_codes_per_image;
+    uint8_t *found;
+
+    TuneCandidate *candidates;
+    size_t candidate_count;
+} Tuner;
+
+// nftw() has no user data argument.
+static ImageList *collected_images;
+
+static uint64_t now_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + now.tv_nsec;
+}
+
+static size_t histogram_bucket_index(uint64_t value_ns)
+{
+    if (value_ns < HISTOGRAM_SUB_BUCKETS) {
+        return (size_t)value_ns;
+    }
+    const unsigned exponent = 63 - __builtin_clzll(value_ns);
+    const unsigned shift = exponent - HISTOGRAM_SUB_BUCKET_BITS;
+    const size_t sub_bucket = (size_t)(value_ns >> shift) - HISTOGRAM_SUB_BUCKETS;
+    return HISTOGRAM_SUB_BUCKETS + (size_t)shift * HISTOGRAM_SUB_BUCKETS + sub_bucket;
+}
+
+/**
+ * Returns the largest value that falls into the bucket.
+ */
+static uint64_t histogram_bucket_upper_bound(size_t index)
+{
+    if (index < HISTOGRAM_SUB_BUCKETS) {
+        return index;
+    }
+    const unsigned shift = (unsigned)(index / HISTOGRAM_SUB_BUCKETS) - 1;
+    const uint64_t sub_bucket = index % HISTOGRAM_SUB_BUCKETS;
+    return ((HISTOGRAM_SUB_BUCKETS + sub_bucket + 1) << shift) - 1;
+}
+
+static void histogram_record(LatencyHistogram *histogram, uint64_t value_ns)
+{
+    histogram->counts[histogram_bucket_index(value_ns)]++;
+    if (histogram->count == 0 || value_ns < histogram->min_ns) {
+        histogram->min_ns = value_ns;
+    }
+    if (value_ns > histogram->max_ns) {
+        histogram->max_ns = value_ns;
+    }
+    histogram->count++;
+    histogram->total_ns += value_ns;
+}
+
+static uint64_t histogram_percentile(const LatencyHistogram *histogram, double percentile)
+{
+    if (histogram->count == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(percentile / 100.0 * histogram->count + 0.5);
+    if (rank == 0) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (size_t i = 0; i < HISTOGRAM_BUCKET_COUNT; ++i) {
+        seen += histogram->counts[i];
+        if (seen >= rank) {
+            const uint64_t upper_bound = histogram_bucket_upper_bound(i);
+            return upper_bound < histogram->max_ns ? upper_bound : histogram->max_ns;
+        }
+    }
+    return histogram->max_ns;
+}
+
+static int compare_paths(const void *lhs, const void *rhs)
+{
+    return strcmp(*(char * const *)lhs, *(char * const *)rhs);
+}
+
+static int has_valid_extension(char const *file_name)
+{
+    static const char * const extensions[] = { ".png", ".jpg", ".jpeg", ".tif", ".tiff", ".rec" };
+    const char *extension = strrchr(file_name, '.');
+    if (extension == NULL) {
+        return 0;
+    }
+    for (size_t i = 0; i < sizeof(extensions) / sizeof(extensions[0]); ++i) {
+        if (strcasecmp(extension, extensions[i]) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Returns whether the file is a frame recording of the camera sample.
+ */
+static ScBool is_recording(const char *path)
+{
+    const char *extension = strrchr(path, '.');
+    return extension != NULL && strcasecmp(extension, ".rec") == 0;
+}
+
+static ScBool image_list_add(ImageList *list, const char *path)
+{
+    if (list->count == list->capacity) {
+        const size_t capacity = list->capacity == 0 ? 256 : list->capacity * 2;
+        char **paths = realloc(list->paths, capacity * sizeof(char *));
+        if (paths == NULL) {
+            return SC_FALSE;
+        }
+        list->paths = paths;
+        list->capacity = capacity;
+    }
+    list->paths[list->count] = strdup(path);
+    if (list->paths[list->count] == NULL) {
+        return SC_FALSE;
+    }
+    list->count++;
+    return SC_TRUE;
+}
+
+static void image_list_free(ImageList *list)
+{
+    for (size_t i = 0; i < list->count; ++i) {
+        free(list->paths[i]);
+    }
+    free(list->paths);
+}
+
+static int collect_image(const char *path, const struct stat *file_stat, int type, struct FTW *ftw)
+{
+    if (type == FTW_F && (ftw->level == 0 || has_valid_extension(path))) {
+        return image_list_add(collected_images, path) ? 0 : -1;
+    }
+    return 0;
+}
+
+/**
+ * Adds the image files and the images found in the directories (recursively) to the
+ * list. The list is sorted, so that all runs over a corpus process the same sequence.
+ */
+static ScBool collect_images(ImageList *list, char * const *arguments, int argument_count)
+{
+    collected_images = list;
+    for (int i = 0; i < argument_count; ++i) {
+        if (nftw(arguments[i], collect_image, 32, FTW_PHYS) != 0) {
+            fprintf(stderr, "Could not read '%s': %s\n", arguments[i], strerror(errno));
+            return SC_FALSE;
+        }
+    }
+    qsort(list->paths, list->count, sizeof(char *), compare_paths);
+    return SC_TRUE;
+}
+
+static ScBool gray_image_reserve(GrayImage *image, size_t size)
+{
+    if (size <= image->capacity) {
+        return SC_TRUE;
+    }
+    uint8_t *data = realloc(image->data, size);
+    if (data == NULL) {
+        return SC_FALSE;
+    }
+    image->data = data;
+    image->capacity = size;
+    return SC_TRUE;
+}
+
+/**
+ * Returns the byte position of a color channel inside a pixel.
+ */
+static uint32_t channel_byte_offset(uint32_t shift, uint32_t bytes_per_pixel)
+{
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+    return bytes_per_pixel - 1 - shift / 8;
+#else
+    (void)bytes_per_pixel;
+    return shift / 8;
+#endif
+}
+
+/**
+ * Returns the luma plane of a tightly packed frame in the given layout. The planar YUV
+ * layouts and gray already start with it and are returned as they are, all others
+ * are converted into target, which must hold width * height bytes.
+ */
+static const uint8_t *frame_to_luma(ScImageLayout layout, const uint8_t *frame, uint32_t width,
+                                    uint32_t height, uint8_t *target)
+{
+    PixelChannels channels = { 3, 0, 1, 2 };
+    switch (layout) {
+        case SC_IMAGE_LAYOUT_GRAY_8U:
+        case SC_IMAGE_LAYOUT_YPCBCR_8U:
+        case SC_IMAGE_LAYOUT_YPCRCB_8U:
+        case SC_IMAGE_LAYOUT_I420_8U:
+            return frame;
+        case SC_IMAGE_LAYOUT_YUYV_8U:
+        case SC_IMAGE_LAYOUT_UYVY_8U:
+            for (uint32_t y = 0; y < height; ++y) {
+                packed_yuv_to_luma(frame + (size_t)y * width * 2, target + (size_t)y * width, width,
+                                   layout == SC_IMAGE_LAYOUT_UYVY_8U ? 1 : 0);
+            }
+            return target;
+        case SC_IMAGE_LAYOUT_RGBA_8U:
+            channels.bytes_per_pixel = 4;
+            break;
+        case SC_IMAGE_LAYOUT_ARGB_8U:
+            channels = (PixelChannels){ 4, 1, 2, 3 };
+            break;
+        default:
+            break;
+    }
+    for (uint32_t y = 0; y < height; ++y) {
+        pixels_to_luma(frame + (size_t)y * width * channels.bytes_per_pixel, target + (size_t)y * width,
+                       width, &channels);
+    }
+    return target;
+}
+
+/**
+ * Writes the luma (ITU-R BT.601 weights) of the surface into the image buffer. Returns
+ * SC_FALSE if the pixel format of the surface is not handled directly.
+ */
+static ScBool convert_surface_to_luma(SDL_Surface *surface, GrayImage *image)
+{
+    const SDL_PixelFormat *format = surface->format;
+    const uint32_t width = surface->w;
+    const uint32_t height = surface->h;
+    const uint32_t bytes_per_pixel = format->BytesPerPixel;
+
+    uint8_t palette_luma[256];
+    if (format->palette != NULL && bytes_per_pixel == 1) {
+        const SDL_Palette *palette = format->palette;
+        memset(palette_luma, 0, sizeof(palette_luma));
+        for (int i = 0; i < palette->ncolors && i < 256; ++i) {
+            const SDL_Color color = palette->colors[i];
+            palette_luma[i] = rgb_to_luma(color.r, color.g, color.b);
+        }
+    } else if ((bytes_per_pixel != 3 && bytes_per_pixel != 4) ||
+               format->Rloss != 0 || format->Gloss != 0 || format->Bloss != 0 ||
+               format->Rshift % 8 != 0 || format->Gshift % 8 != 0 || format->Bshift % 8 != 0) {
+        return SC_FALSE;
+    }
+
+    if (!gray_image_reserve(image, (size_t)width * height)) {
+        return SC_FALSE;
+    }
+    image->width = width;
+    image->height = height;
+    image->row_bytes = width;
+
+    const PixelChannels channels = {
+        bytes_per_pixel,
+        channel_byte_offset(format->Rshift, bytes_per_pixel),
+        channel_byte_offset(format->Gshift, bytes_per_pixel),
+        channel_byte_offset(format->Bshift, bytes_per_pixel)
+    };
+    if (SDL_MUSTLOCK(surface)) {
+        SDL_LockSurface(surface);
+    }
+    for (uint32_t y = 0; y < height; ++y) {
+        const uint8_t *source = (const uint8_t *)surface->pixels + (size_t)y * surface->pitch;
+        uint8_t *target = image->data + (size_t)y * image->row_bytes;
+        if (bytes_per_pixel == 1) {
+            for (uint32_t x = 0; x < width; ++x) {
+                target[x] = palette_luma[source[x]];
+            }
+        } else {
+            pixels_to_luma(source, target, width, &channels);
+        }
+    }
+    if (SDL_MUSTLOCK(surface)) {
+        SDL_UnlockSurface(surface);
+    }
+    return SC_TRUE;
+}
+
+static ScBool convert_to_gray(SDL_Surface *surface, GrayImage *image)
+{
+    if (convert_surface_to_luma(surface, image)) {
+        return SC_TRUE;
+    }
+    // Uncommon pixel formats (e.g. 16 bit) take the detour over RGB24.
+    SDL_Surface *surface_rgb = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGB24, 0);
+    if (surface_rgb == NULL) {
+        return SC_FALSE;
+    }
+    const ScBool converted = convert_surface_to_luma(surface_rgb, image);
+    SDL_FreeSurface(surface_rgb);
+    return converted;
+}
+
+static ScBarcodeScannerSettings *create_scanner_settings(const char *settings_file)
+{
+    if (settings_file == NULL) {
+        // Same configuration as the image processing sample.
+        ScBarcodeScannerSettings *settings =
+                sc_barcode_scanner_settings_new_with_preset(SC_PRESET_ENABLE_SINGLE_FRAME_MODE);
+        if (settings == NULL) {
+            return NULL;
+        }
+        sc_barcode_scanner_settings_set_symbology_enabled(settings, SC_SYMBOLOGY_EAN13, SC_TRUE);
+        sc_barcode_scanner_settings_set_symbology_enabled(settings, SC_SYMBOLOGY_UPCA, SC_TRUE);
+        sc_barcode_scanner_settings_set_symbology_enabled(settings, SC_SYMBOLOGY_QR, SC_TRUE);
+        sc_barcode_scanner_settings_set_symbology_enabled(settings, SC_SYMBOLOGY_CODE128, SC_TRUE);
+        // Code 128 with 4 to 19 symbols.
+        ScSymbologySettings *code128 =
+                sc_barcode_scanner_settings_get_symbology_settings(settings, SC_SYMBOLOGY_CODE128);
+        uint16_t symbol_counts[16];
+        for (uint16_t i = 0; i < 16; ++i) {
+            symbol_counts[i] = 4 + i;
+        }
+        sc_symbology_settings_set_active_symbol_counts(code128, symbol_counts, 16);
+        sc_barcode_scanner_settings_set_max_number_of_codes_per_frame(settings, 1);
+        sc_barcode_scanner_settings_set_code_location_constraint_1d(settings, SC_CODE_LOCATION_IGNORE);
+        sc_barcode_scanner_settings_set_code_location_constraint_2d(settings, SC_CODE_LOCATION_IGNORE);
+        sc_barcode_scanner_settings_set_code_direction_hint(settings, SC_CODE_DIRECTION_NONE);
+        return settings;
+    }
+
+    // Settings exported with sc_barcode_scanner_settings_as_json() can be benchmarked
+    // against each other.
+    FILE *file = fopen(settings_file, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "Could not open settings '%s': %s\n", settings_file, strerror(errno));
+        return NULL;
+    }
+    char *json = NULL;
+    size_t json_length = 0;
+    FILE *json_stream = open_memstream(&json, &json_length);
+    char chunk[4096];
+    size_t read_bytes;
+    while (json_stream != NULL && (read_bytes = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        fwrite(chunk, 1, read_bytes, json_stream);
+    }
+    fclose(file);
+    if (json_stream == NULL) {
+        return NULL;
+    }
+    fclose(json_stream);
+
+    ScError error = { NULL, 0 };
+    ScBarcodeScannerSettings *settings = sc_barcode_scanner_settings_new_from_json(json, &error);
+    if (settings == NULL) {
+        fprintf(stderr, "Invalid settings '%s': %s\n", settings_file,
+                error.message != NULL ? error.message : "unknown error");
+        sc_error_free(&error);
+    }
+    free(json);
+    return settings;
+}
+
+static ScBool benchmark_setup(Benchmark *benchmark, const ScBarcodeScannerSettings *settings)
+{
+    benchmark->context = sc_recognition_context_new(SCANDIT_SDK_LICENSE_KEY, "/tmp", NULL);
+    if (benchmark->context == NULL) {
+        fprintf(stderr, "Could not initialize context.\n");
+        return SC_FALSE;
+    }
+    benchmark->image_descr = sc_image_description_new();
+    if (benchmark->image_descr == NULL) {
+        fprintf(stderr, "Could not initialize image description.\n");
+        return SC_FALSE;
+    }
+    benchmark->scanner = sc_barcode_scanner_new_with_settings(benchmark->context, settings);
+    if (benchmark->scanner == NULL) {
+        fprintf(stderr, "Could not initialize scanner.\n");
+        return SC_FALSE;
+    }
+    // The setup of the scanner must not end up in the measurements.
+    if (!sc_barcode_scanner_wait_for_setup_completed(benchmark->scanner)) {
+        fprintf(stderr, "barcode scanner setup failed.\n");
+        return SC_FALSE;
+    }
+    return SC_TRUE;
+}
+
+static void benchmark_teardown(Benchmark *benchmark)
+{
+    sc_barcode_scanner_release(benchmark->scanner);
+    sc_recognition_context_release(benchmark->context);
+    sc_image_description_release(benchmark->image_descr);
+    free(benchmark->image.data);
+}
+
+static SymbologyStatistics *benchmark_symbology(Benchmark *benchmark, ScSymbology symbology)
+{
+    for (size_t i = 0; i < benchmark->symbology_count; ++i) {
+        if (benchmark->symbologies[i].symbology == symbology) {
+            return &benchmark->symbologies[i];
+        }
+    }
+    if (benchmark->symbology_count == MAX_SYMBOLOGY_COUNT) {
+        return NULL;
+    }
+    SymbologyStatistics *statistics = &benchmark->symbologies[benchmark->symbology_count++];
+    statistics->symbology = symbology;
+    return statistics;
+}
+
+/**
+ * Reads the results of the last frame the way an application would: the data,
+ * symbology and location of every newly recognized code.
+ *
+ * \returns the symbologies found in the frame as a bit mask.
+ */
+static uint32_t extract_codes(Benchmark *benchmark, ScBool measure, uint32_t *code_count,
+                              uint64_t *checksum)
+{
+    ScBarcodeScannerSession *session = sc_barcode_scanner_get_session(benchmark->scanner);
+    ScBarcodeArray *new_codes = sc_barcode_scanner_session_get_newly_recognized_codes(session);
+    uint32_t symbologies = 0;
+    const uint32_t num_codes = sc_barcode_array_get_size(new_codes);
+    for (uint32_t i = 0; i < num_codes; ++i) {
+        const ScBarcode *barcode = sc_barcode_array_get_item_at(new_codes, i);
+        const ScByteArray data = sc_barcode_get_data(barcode);
+        const ScQuadrilateral location = sc_barcode_get_location(barcode);
+        const ScSymbology symbology = sc_barcode_get_symbology(barcode);
+        symbologies |= symbology;
+        SymbologyStatistics *statistics = measure ? benchmark_symbology(benchmark, symbology) : NULL;
+        if (statistics != NULL) {
+            statistics->codes++;
+        }
+        // Touch the data, so that the extraction can not be skipped. The checksum is printed.
+        for (uint32_t j = 0; j < data.length; ++j) {
+            *checksum = *checksum * 31 + (uint8_t)data.str[j];
+        }
+        *checksum += location.top_left.x + location.bottom_right.y;
+    }
+    sc_barcode_array_release(new_codes);
+    *code_count = num_codes;
+    return symbologies;
+}
+
+/**
+ * Adds the timings and the results of a measured frame to the statistics. The convert
+ * stage is only recorded for frames that were converted.
+ */
+static void benchmark_add_frame(Benchmark *benchmark, uint64_t *stage_ns, ScContextStatusFlag status,
+                                uint32_t code_count, uint32_t symbologies, ScBool converted)
+{
+    benchmark->frames++;
+    if (status != SC_RECOGNITION_CONTEXT_STATUS_SUCCESS) {
+        benchmark->failed_frames++;
+        benchmark->last_failure = status;
+    }
+    if (code_count > 0) {
+        benchmark->frames_with_codes++;
+    }
+    for (uint32_t bit = 1; bit != 0; bit <<= 1) {
+        if ((symbologies & bit) == 0) {
+            continue;
+        }
+        SymbologyStatistics *statistics = benchmark_symbology(benchmark, (ScSymbology)bit);
+        if (statistics != NULL) {
+            statistics->frames++;
+        }
+    }
+
+    for (int stage = 0; stage < STAGE_TOTAL; ++stage) {
+        stage_ns[STAGE_TOTAL] += stage_ns[stage];
+        if ((stage != STAGE_EXTRACTION || status == SC_RECOGNITION_CONTEXT_STATUS_SUCCESS) &&
+            (stage != STAGE_CONVERT || converted)) {
+            histogram_record(&benchmark->stages[stage], stage_ns[stage]);
+        }
+    }
+    histogram_record(&benchmark->stages[STAGE_TOTAL], stage_ns[STAGE_TOTAL]);
+}
+
+/**
+ * Processes one image. The timings are only recorded when measure is set.
+ */
+static void benchmark_image(Benchmark *benchmark, const char *path, ScBool measure,
+                            uint64_t *checksum)
+{
+    uint64_t stage_ns[STAGE_COUNT] = { 0 };
+
+    uint64_t start = now_ns();
+    SDL_Surface *surface = IMG_Load(path);
+    stage_ns[STAGE_LOAD] = now_ns() - start;
+    if (surface == NULL) {
+        if (measure) {
+            fprintf(stderr, "IMG_Load '%s' failed: %s\n", path, IMG_GetError());
+            benchmark->failed_loads++;
+        }
+        return;
+    }
+
+    start = now_ns();
+    const ScBool converted = convert_to_gray(surface, &benchmark->image);
+    stage_ns[STAGE_CONVERT] = now_ns() - start;
+    SDL_FreeSurface(surface);
+    if (!converted) {
+        if (measure) {
+            fprintf(stderr, "Image '%s' convertion failed.\n", path);
+            benchmark->failed_loads++;
+        }
+        return;
+    }
+
+    const GrayImage *image = &benchmark->image;
+    ScImageDescription *image_descr = benchmark->image_descr;
+    sc_image_description_set_layout(image_descr, SC_IMAGE_LAYOUT_GRAY_8U);
+    sc_image_description_set_width(image_descr, image->width);
+    sc_image_description_set_height(image_descr, image->height);
+    sc_image_description_set_first_plane_row_bytes(image_descr, image->row_bytes);
+    sc_image_description_set_memory_size(image_descr, image->row_bytes * image->height);
+
+    sc_recognition_context_start_new_frame_sequence(benchmark->context);
+    start = now_ns();
+    const ScProcessFrameResult result =
+            sc_recognition_context_process_frame(benchmark->context, image_descr, image->data);
+    stage_ns[STAGE_RECOGNITION] = now_ns() - start;
+
+    uint32_t code_count = 0;
+    uint32_t symbologies = 0;
+    if (result.status == SC_RECOGNITION_CONTEXT_STATUS_SUCCESS) {
+        start = now_ns();
+        symbologies = extract_codes(benchmark, measure, &code_count, checksum);
+        stage_ns[STAGE_EXTRACTION] = now_ns() - start;
+    }
+    sc_recognition_context_end_frame_sequence(benchmark->context);
+
+    if (measure) {
+        benchmark_add_frame(benchmark, stage_ns, result.status, code_count, symbologies, SC_TRUE);
+    }
+}
+
+/**
+ * Maps a frame recording and returns the offsets of its records, or NULL if it is not a
+ * recording or one of its records is damaged. The records of a recording that was not
+ * closed properly are found by walking the file.
+ */
+static uint64_t *map_recording(const char *path, const uint8_t **data, size_t *size,
+                               uint64_t *frame_count)
+{
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || (size_t)file_stat.st_size < sizeof(RecordingHeader)) {
+        close(fd);
+        return NULL;
+    }
+    void *mapping = mmap(NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return NULL;
+    }
+    *data = mapping;
+    *size = file_stat.st_size;
+
+    const RecordingHeader *header = mapping;
+    uint64_t *offsets = NULL;
+    *frame_count = 0;
+    if (memcmp(header->magic, RECORDING_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != RECORDING_VERSION || header->alignment != RECORDING_ALIGNMENT) {
+        munmap(mapping, *size);
+        return NULL;
+    }
+    if (header->index_offset != 0) {
+        if (header->index_offset <= *size &&
+            (*size - header->index_offset) / sizeof(uint64_t) >= header->frame_count) {
+            offsets = malloc((header->frame_count + 1) * sizeof(uint64_t));
+        }
+        if (offsets != NULL) {
+            memcpy(offsets, *data + header->index_offset, header->frame_count * sizeof(uint64_t));
+            *frame_count = header->frame_count;
+        }
+    } else {
+        uint64_t capacity = 1024;
+        offsets = malloc(capacity * sizeof(uint64_t));
+        uint64_t offset = recording_align(sizeof(RecordingHeader));
+        uint64_t end;
+        while (offsets != NULL && (end = frame_record_end(*data, *size, offset)) != 0) {
+            if (*frame_count == capacity) {
+                capacity *= 2;
+                uint64_t *grown = realloc(offsets, capacity * sizeof(uint64_t));
+                if (grown == NULL) {
+                    break;
+                }
+                offsets = grown;
+            }
+            offsets[(*frame_count)++] = offset;
+            offset = recording_align(end);
+        }
+    }
+    for (uint64_t i = 0; offsets != NULL && i < *frame_count; ++i) {
+        if (frame_record_end(*data, *size, offsets[i]) == 0) {
+            free(offsets);
+            offsets = NULL;
+        }
+    }
+    if (offsets == NULL) {
+        munmap(mapping, *size);
+    }
+    return offsets;
+}
+
+/**
+ * Processes all frames of a recording of the camera sample as one frame sequence, the
+ * way the camera sample scans them. Loading a frame is copying it out of the mapped
+ * recording. The frames are scanned in their recorded layout, so nothing is converted.
+ */
+static void benchmark_recording(Benchmark *benchmark, const char *path, ScBool measure,
+                                uint64_t *checksum)
+{
+    const uint8_t *data = NULL;
+    size_t size = 0;
+    uint64_t frame_count = 0;
+    uint64_t *offsets = map_recording(path, &data, &size, &frame_count);
+    if (offsets == NULL) {
+        if (measure) {
+            fprintf(stderr, "'%s' is not a valid frame recording.\n", path);
+            benchmark->failed_loads++;
+        }
+        return;
+    }
+
+    // The frames are copied into the image buffer, which is only gray for images.
+    GrayImage *frame = &benchmark->image;
+    ScImageDescription *image_descr = benchmark->image_descr;
+    sc_recognition_context_start_new_frame_sequence(benchmark->context);
+    for (uint64_t i = 0; i < frame_count; ++i) {
+        uint64_t stage_ns[STAGE_COUNT] = { 0 };
+        const FrameRecord *record = (const FrameRecord *)(data + offsets[i]);
+
+        uint64_t start = now_ns();
+        if (!gray_image_reserve(frame, record->memory_size)) {
+            if (measure) {
+                fprintf(stderr, "Frame %llu of '%s' does not fit into memory.\n",
+                        (unsigned long long)i, path);
+                benchmark->failed_loads++;
+            }
+            continue;
+        }
+        memcpy(frame->data, data + recording_align(offsets[i] + sizeof(FrameRecord)),
+               record->memory_size);
+        stage_ns[STAGE_LOAD] = now_ns() - start;
+
+        sc_image_description_set_layout(image_descr, (ScImageLayout)record->layout);
+        sc_image_description_set_width(image_descr, record->width);
+        sc_image_description_set_height(image_descr, record->height);
+        sc_image_description_set_first_plane_offset(image_descr, record->first_plane_offset);
+        sc_image_description_set_first_plane_row_bytes(image_descr, record->first_plane_row_bytes);
+        sc_image_description_set_second_plane_offset(image_descr, record->second_plane_offset);
+        sc_image_description_set_second_plane_row_bytes(image_descr, record->second_plane_row_bytes);
+        sc_image_description_set_memory_size(image_descr, record->memory_size);
+
+        start = now_ns();
+        const ScProcessFrameResult result =
+                sc_recognition_context_process_frame(benchmark->context, image_descr, frame->data);
+        stage_ns[STAGE_RECOGNITION] = now_ns() - start;
+
+        uint32_t code_count = 0;
+        uint32_t symbologies = 0;
+        if (result.status == SC_RECOGNITION_CONTEXT_STATUS_SUCCESS) {
+            start = now_ns();
+            symbologies = extract_codes(benchmark, measure, &code_count, checksum);
+            stage_ns[STAGE_EXTRACTION] = now_ns() - start;
+        }
+        if (measure) {
+            benchmark_add_frame(benchmark, stage_ns, result.status, code_count, symbologies, SC_FALSE);
+        }
+    }
+    sc_recognition_context_end_frame_sequence(benchmark->context);
+    munmap((void *)data, size);
+    free(offsets);
+}
+
+static void write_stage_json(FILE *out, const LatencyHistogram *histogram)
+{
+    const double ms = 1e-6;
+    const double mean = histogram->count > 0 ? (double)histogram->total_ns / histogram->count : 0.0;
+    fprintf(out, "{\"count\": %llu, \"mean_ms\": %.4f, \"min_ms\": %.4f, \"p50_ms\": %.4f, "
+                 "\"p90_ms\": %.4f, \"p99_ms\": %.4f, \"max_ms\": %.4f, \"histogram_us\": [",
+            (unsigned long long)histogram->count, mean * ms, histogram->min_ns * ms,
+            histogram_percentile(histogram, 50.0) * ms, histogram_percentile(histogram, 90.0) * ms,
+            histogram_percentile(histogram, 99.0) * ms, histogram->max_ns * ms);
+    // Only the occupied buckets as [upper bound in microseconds, count] pairs.
+    const char *separator = "";
+    for (size_t i = 0; i < HISTOGRAM_BUCKET_COUNT; ++i) {
+        if (histogram->counts[i] != 0) {
+            fprintf(out, "%s[%.3f, %llu]", separator, histogram_bucket_upper_bound(i) * 1e-3,
+                    (unsigned long long)histogram->counts[i]);
+            separator = ", ";
+        }
+    }
+    fprintf(out, "]}");
+}
+
+static void write_report_json(FILE *out, const Benchmark *benchmark, const char *settings_name,
+                              size_t image_count, int iterations, int warmup)
+{
+    const double frames = benchmark->frames > 0 ? (double)benchmark->frames : 1.0;
+    fprintf(out, "{\n");
+    fprintf(out, "  \"sdk_version\": \"%s\",\n",
+            sc_get_information_string(SC_INFORMATION_KEY_SDK_VERSION));
+    fprintf(out, "  \"settings\": \"%s\",\n", settings_name);
+    fprintf(out, "  \"images\": %zu,\n", image_count);
+    fprintf(out, "  \"iterations\": %d,\n", iterations);
+    fprintf(out, "  \"warmup\": %d,\n", warmup);
+    fprintf(out, "  \"frames\": %llu,\n", (unsigned long long)benchmark->frames);
+    fprintf(out, "  \"failed_loads\": %llu,\n", (unsigned long long)benchmark->failed_loads);
+    fprintf(out, "  \"failed_frames\": %llu,\n", (unsigned long long)benchmark->failed_frames);
+    fprintf(out, "  \"wall_seconds\": %.4f,\n", benchmark->wall_seconds);
+    fprintf(out, "  \"throughput_fps\": %.3f,\n",
+            benchmark->wall_seconds > 0.0 ? benchmark->frames / benchmark->wall_seconds : 0.0);
+    fprintf(out, "  \"stages\": {\n");
+    for (int stage = 0; stage < STAGE_COUNT; ++stage) {
+        fprintf(out, "    \"%s\": ", stage_names[stage]);
+        write_stage_json(out, &benchmark->stages[stage]);
+        fprintf(out, "%s\n", stage + 1 < STAGE_COUNT ? "," : "");
+    }
+    fprintf(out, "  },\n");
+    fprintf(out, "  \"recognition\": {\n");
+    fprintf(out, "    \"frames_with_codes\": %llu,\n",
+            (unsigned long long)benchmark->frames_with_codes);
+    fprintf(out, "    \"rate\": %.4f,\n", benchmark->frames_with_codes / frames);
+    fprintf(out, "    \"symbologies\": {");
+    for (size_t i = 0; i < benchmark->symbology_count; ++i) {
+        const SymbologyStatistics *statistics = &benchmark->symbologies[i];
+        fprintf(out, "%s\n      \"%s\": {\"frames\": %llu, \"codes\": %llu, \"rate\": %.4f}",
+                i > 0 ? "," : "", sc_symbology_to_string(statistics->symbology),
+                (unsigned long long)statistics->frames, (unsigned long long)statistics->codes,
+                statistics->frames / frames);
+    }
+    fprintf(out, "%s}\n", benchmark->symbology_count > 0 ? "\n    " : "");
+    fprintf(out, "  }\n");
+    fprintf(out, "}\n");
+}
+
+static const struct {
+    ScImageLayout layout;
+    const char *name;
+} benchmark_layouts[LAYOUT_COUNT] = {
+    { SC_IMAGE_LAYOUT_GRAY_8U, "gray" },
+    { SC_IMAGE_LAYOUT_RGB_8U, "rgb" },
+    { SC_IMAGE_LAYOUT_RGBA_8U, "rgba" },
+    { SC_IMAGE_LAYOUT_ARGB_8U, "argb" },
+    { SC_IMAGE_LAYOUT_YPCBCR_8U, "nv12" },
+    { SC_IMAGE_LAYOUT_YPCRCB_8U, "nv21" },
+    { SC_IMAGE_LAYOUT_YUYV_8U, "yuyv" },
+    { SC_IMAGE_LAYOUT_UYVY_8U, "uyvy" },
+    { SC_IMAGE_LAYOUT_I420_8U, "i420" }
+};
+
+static ScBool parse_resolutions(const char *text, LayoutBenchmark *layouts)
+{
+    layouts->resolution_count = 0;
+    while (*text != '\0') {
+        unsigned width;
+        unsigned height;
+        int length;
+        if (layouts->resolution_count == MAX_BENCHMARK_RESOLUTIONS ||
+            sscanf(text, "%ux%u%n", &width, &height, &length) != 2 ||
+            width < 2 || height < 2 || width % 2 != 0 || height % 2 != 0) {
+            return SC_FALSE;
+        }
+        layouts->resolutions[layouts->resolution_count].width = width;
+        layouts->resolutions[layouts->resolution_count].height = height;
+        layouts->resolution_count++;
+        text += length;
+        if (*text == ',') {
+            text++;
+        } else if (*text != '\0') {
+            return SC_FALSE;
+        }
+    }
+    return layouts->resolution_count > 0;
+}
+
+static ScBool layout_benchmark_reserve(LayoutBenchmark *layouts)
+{
+    size_t pixels = 0;
+    for (uint32_t i = 0; i < layouts->resolution_count; ++i) {
+        const size_t count = (size_t)layouts->resolutions[i].width * layouts->resolutions[i].height;
+        pixels = count > pixels ? count : pixels;
+    }
+    layouts->rgb = malloc(pixels * 3);
+    layouts->frame = malloc(pixels * 4);
+    layouts->luma = malloc(pixels);
+    return layouts->rgb != NULL && layouts->frame != NULL && layouts->luma != NULL;
+}
+
+/**
+ * Scales an RGB24 surface into a width x height RGB frame, keeping the aspect ratio.
+ * The remaining border is white.
+ */
+static void letterbox_rgb(const SDL_Surface *surface, uint8_t *target, uint32_t width, uint32_t height)
+{
+    const double scale_x = (double)width / surface->w;
+    const double scale_y = (double)height / surface->h;
+    const double scale = scale_x < scale_y ? scale_x : scale_y;
+    uint32_t scaled_width = (uint32_t)(surface->w * scale);
+    uint32_t scaled_height = (uint32_t)(surface->h * scale);
+    scaled_width = scaled_width > 0 ? scaled_width : 1;
+    scaled_height = scaled_height > 0 ? scaled_height : 1;
+    const uint32_t left = (width - scaled_width) / 2;
+    const uint32_t top = (height - scaled_height) / 2;
+
+    memset(target, 0xff, (size_t)width * height * 3);
+    for (uint32_t y = 0; y < scaled_height; ++y) {
+        const uint8_t *source = (const uint8_t *)surface->pixels +
+                (size_t)(y * (uint64_t)surface->h / scaled_height) * surface->pitch;
+        uint8_t *row = target + ((size_t)(top + y) * width + left) * 3;
+        for (uint32_t x = 0; x < scaled_width; ++x) {
+            memcpy(row + x * 3, source + (size_t)(x * (uint64_t)surface->w / scaled_width) * 3, 3);
+        }
+    }
+}
+
+static uint8_t clamp_byte(int value)
+{
+    return (uint8_t)(value < 0 ? 0 : (value > 255 ? 255 : value));
+}
+
+// ITU-R BT.601 full range YCbCr of one RGB pixel.
+static void rgb_to_ycbcr(const uint8_t *rgb, uint8_t *y, uint8_t *cb, uint8_t *cr)
+{
+    const int r = rgb[0];
+    const int g = rgb[1];
+    const int b = rgb[2];
+    *y = rgb_to_luma(r, g, b);
+    if (cb != NULL) {
+        *cb = clamp_byte(((-43 * r - 85 * g + 128 * b + 128) >> 8) + 128);
+        *cr = clamp_byte(((128 * r - 107 * g - 21 * b + 128) >> 8) + 128);
+    }
+}
+
+/**
+ * Writes the RGB frame in the given layout into target and describes it. The chroma
+ * of subsampled layouts is taken from the top left pixel of each block.
+ */
+static void fill_layout(const uint8_t *rgb, uint32_t width, uint32_t height, ScImageLayout layout,
+                        uint8_t *target, ScImageDescription *image_descr)
+{
+    const size_t pixels = (size_t)width * height;
+    uint32_t row_bytes = width;
+    size_t memory_size = pixels * 3 / 2;
+    switch (layout) {
+        case SC_IMAGE_LAYOUT_GRAY_8U:
+            for (size_t i = 0; i < pixels; ++i) {
+                rgb_to_ycbcr(rgb + i * 3, &target[i], NULL, NULL);
+            }
+            memory_size = pixels;
+            break;
+        case SC_IMAGE_LAYOUT_RGB_8U:
+            memcpy(target, rgb, pixels * 3);
+            row_bytes = width * 3;
+            memory_size = pixels * 3;
+            break;
+        case SC_IMAGE_LAYOUT_RGBA_8U:
+        case SC_IMAGE_LAYOUT_ARGB_8U: {
+            const uint32_t color_offset = layout == SC_IMAGE_LAYOUT_ARGB_8U ? 1 : 0;
+            for (size_t i = 0; i < pixels; ++i) {
+                target[i * 4 + 3 - color_offset * 3] = 0xff;
+                memcpy(target + i * 4 + color_offset, rgb + i * 3, 3);
+            }
+            row_bytes = width * 4;
+            memory_size = pixels * 4;
+            break;
+        }
+        case SC_IMAGE_LAYOUT_YUYV_8U:
+        case SC_IMAGE_LAYOUT_UYVY_8U: {
+            const uint32_t luma_offset = layout == SC_IMAGE_LAYOUT_UYVY_8U ? 1 : 0;
+            for (size_t i = 0; i < pixels; i += 2) {
+                uint8_t *pair = target + i * 2;
+                rgb_to_ycbcr(rgb + i * 3, &pair[luma_offset], &pair[1 - luma_offset],
+                             &pair[3 - luma_offset]);
+                rgb_to_ycbcr(rgb + i * 3 + 3, &pair[2 + luma_offset], NULL, NULL);
+            }
+            row_bytes = width * 2;
+            memory_size = pixels * 2;
+            break;
+        }
+        default: {
+            // The 4:2:0 layouts: one luma plane followed by the subsampled chroma.
+            uint8_t *chroma = target + pixels;
+            for (uint32_t y = 0; y < height; ++y) {
+                for (uint32_t x = 0; x < width; ++x) {
+                    const uint8_t *pixel = rgb + ((size_t)y * width + x) * 3;
+                    uint8_t *luma = &target[(size_t)y * width + x];
+                    if (x % 2 != 0 || y % 2 != 0) {
+                        rgb_to_ycbcr(pixel, luma, NULL, NULL);
+                        continue;
+                    }
+                    const size_t block = (size_t)(y / 2) * (width / 2) + x / 2;
+                    uint8_t cb;
+                    uint8_t cr;
+                    rgb_to_ycbcr(pixel, luma, &cb, &cr);
+                    if (layout == SC_IMAGE_LAYOUT_I420_8U) {
+                        chroma[block] = cb;
+                        chroma[pixels / 4 + block] = cr;
+                    } else {
+                        const uint32_t cb_offset = layout == SC_IMAGE_LAYOUT_YPCBCR_8U ? 0 : 1;
+                        chroma[block * 2 + cb_offset] = cb;
+                        chroma[block * 2 + 1 - cb_offset] = cr;
+                    }
+                }
+            }
+            break;
+        }
+    }
+
+    sc_image_description_set_layout(image_descr, layout);
+    sc_image_description_set_width(image_descr, width);
+    sc_image_description_set_height(image_descr, height);
+    sc_image_description_set_first_plane_offset(image_descr, 0);
+    sc_image_description_set_first_plane_row_bytes(image_descr, row_bytes);
+    if (layout == SC_IMAGE_LAYOUT_YPCBCR_8U || layout == SC_IMAGE_LAYOUT_YPCRCB_8U) {
+        sc_image_description_set_second_plane_offset(image_descr, (uint32_t)pixels);
+        sc_image_description_set_second_plane_row_bytes(image_descr, width);
+    } else {
+        sc_image_description_set_second_plane_offset(image_descr, 0);
+        sc_image_description_set_second_plane_row_bytes(image_descr, 0);
+    }
+    sc_image_description_set_memory_size(image_descr, (uint32_t)memory_size);
+}
+
+/**
+ * Scans one image at every resolution in every layout. The frames are generated
+ * before the measurement, only process_frame and the conversion back to luma are timed.
+ */
+static void benchmark_image_layouts(Benchmark *benchmark, LayoutBenchmark *layouts, const char *path,
+                                    ScBool measure, uint64_t *checksum)
+{
+    if (is_recording(path)) {
+        // The frames of a recording are only available in the layout they were captured in.
+        if (measure) {
+            fprintf(stderr, "Recording '%s' skipped, --layouts needs images.\n", path);
+        }
+        return;
+    }
+    SDL_Surface *surface = IMG_Load(path);
+    SDL_Surface *surface_rgb = surface != NULL ?
+            SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGB24, 0) : NULL;
+    SDL_FreeSurface(surface);
+    if (surface_rgb == NULL) {
+        if (measure) {
+            fprintf(stderr, "Loading '%s' as RGB failed: %s\n", path, IMG_GetError());
+            benchmark->failed_loads++;
+        }
+        return;
+    }
+    if (SDL_MUSTLOCK(surface_rgb)) {
+        SDL_LockSurface(surface_rgb);
+    }
+
+    for (uint32_t r = 0; r < layouts->resolution_count; ++r) {
+        const uint32_t width = layouts->resolutions[r].width;
+        const uint32_t height = layouts->resolutions[r].height;
+        letterbox_rgb(surface_rgb, layouts->rgb, width, height);
+        for (uint32_t l = 0; l < LAYOUT_COUNT; ++l) {
+            const ScImageLayout layout = benchmark_layouts[l].layout;
+            LayoutStatistics *statistics = &layouts->statistics[r][l];
+            fill_layout(layouts->rgb, width, height, layout, layouts->frame, benchmark->image_descr);
+
+            sc_recognition_context_start_new_frame_sequence(benchmark->context);
+            uint64_t start = now_ns();
+            const ScProcessFrameResult result = sc_recognition_context_process_frame(
+                    benchmark->context, benchmark->image_descr, layouts->frame);
+            const uint64_t recognition_ns = now_ns() - start;
+            uint32_t code_count = 0;
+            if (result.status == SC_RECOGNITION_CONTEXT_STATUS_SUCCESS) {
+                extract_codes(benchmark, SC_FALSE, &code_count, checksum);
+            }
+            sc_recognition_context_end_frame_sequence(benchmark->context);
+
+            start = now_ns();
+            const uint8_t *luma = frame_to_luma(layout, layouts->frame, width, height, layouts->luma);
+            const uint64_t to_luma_ns = now_ns() - start;
+            *checksum += luma[(size_t)width * (height / 2) + width / 2];
+
+            if (!measure) {
+                continue;
+            }
+            benchmark->frames++;
+            if (result.status != SC_RECOGNITION_CONTEXT_STATUS_SUCCESS) {
+                benchmark->failed_frames++;
+                benchmark->last_failure = result.status;
+            }
+            statistics->frames_with_codes += code_count > 0 ? 1 : 0;
+            histogram_record(&statistics->recognition, recognition_ns);
+            histogram_record(&statistics->to_luma, to_luma_ns);
+        }
+    }
+
+    if (SDL_MUSTLOCK(surface_rgb)) {
+        SDL_UnlockSurface(surface_rgb);
+    }
+    SDL_FreeSurface(surface_rgb);
+}
+
+static void write_layout_report_json(FILE *out, const Benchmark *benchmark, const LayoutBenchmark *layouts,
+                                     const char *settings_name, size_t image_count, int iterations,
+                                     int warmup)
+{
+    fprintf(out, "{\n");
+    fprintf(out, "  \"sdk_version\": \"%s\",\n",
+            sc_get_information_string(SC_INFORMATION_KEY_SDK_VERSION));
+    fprintf(out, "  \"settings\": \"%s\",\n", settings_name);
+    fprintf(out, "  \"images\": %zu,\n", image_count);
+    fprintf(out, "  \"iterations\": %d,\n", iterations);
+    fprintf(out, "  \"warmup\": %d,\n", warmup);
+    fprintf(out, "  \"frames\": %llu,\n", (unsigned long long)benchmark->frames);
+    fprintf(out, "  \"failed_loads\": %llu,\n", (unsigned long long)benchmark->failed_loads);
+    fprintf(out, "  \"failed_frames\": %llu,\n", (unsigned long long)benchmark->failed_frames);
+    fprintf(out, "  \"resolutions\": [");
+    for (uint32_t r = 0; r < layouts->resolution_count; ++r) {
+        const LatencyHistogram *gray = &layouts->statistics[r][0].recognition;
+        fprintf(out, "%s\n    {\"width\": %u, \"height\": %u, \"layouts\": {", r > 0 ? "," : "",
+                layouts->resolutions[r].width, layouts->resolutions[r].height);
+        for (uint32_t l = 0; l < LAYOUT_COUNT; ++l) {
+            const LayoutStatistics *statistics = &layouts->statistics[r][l];
+            // Passing the frame as it is against extracting the luma and scanning that.
+            const double native_ms = histogram_percentile(&statistics->recognition, 50.0) * 1e-6;
+            const double via_luma_ms = (histogram_percentile(&statistics->to_luma, 50.0) +
+                                        histogram_percentile(gray, 50.0)) * 1e-6;
+            fprintf(out, "%s\n      \"%s\": {\"frames_with_codes\": %llu, \"native_p50_ms\": %.4f, "
+                         "\"via_luma_p50_ms\": %.4f, \"fastest\": \"%s\",\n",
+                    l > 0 ? "," : "", benchmark_layouts[l].name,
+                    (unsigned long long)statistics->frames_with_codes, native_ms, via_luma_ms,
+                    native_ms <= via_luma_ms ? "native" : "luma");
+            fprintf(out, "        \"recognition\": ");
+            write_stage_json(out, &statistics->recognition);
+            fprintf(out, ",\n        \"to_luma\": ");
+            write_stage_json(out, &statistics->to_luma);
+            fprintf(out, "}");
+        }
+        fprintf(out, "\n    }}");
+    }
+    fprintf(out, "\n  ]\n");
+    fprintf(out, "}\n");
+}
+
+static ScBool symbology_enabled(ScBarcodeScannerSettings *settings, ScSymbology symbology)
+{
+    const ScSymbologySettings *symbology_settings =
+            sc_barcode_scanner_settings_get_symbology_settings(settings, symbology);
+    return symbology_settings != NULL && sc_symbology_settings_is_enabled(symbology_settings);
+}
+
+/**
+ * Generates the code with the default options of the generator and stores it as gray
+ * image.
+ */
+static ScBool generate_gray_code(ScRecognitionContext *context, ScSymbology symbology,
+                                 const char *text, GrayImage *code)
+{
+    ScError error = { NULL, 0 };
+    ScBarcodeGenerator *generator = sc_barcode_generator_new(context, symbology, &error);
+    if (generator == NULL) {
+        fprintf(stderr, "Could not create generator for %s: %s\n", sc_symbology_to_string(symbology),
+                error.message != NULL ? error.message : "unknown error");
+        sc_error_free(&error);
+        return SC_FALSE;
+    }
+    const size_t length = strlen(text);
+    ScEncodingArray encoding = sc_encoding_array_new(1);
+    sc_encoding_array_assign(&encoding, 0, "US-ASCII", 0, length);
+    ScImageBuffer *image = sc_barcode_generator_generate(generator, (const uint8_t *)text, length,
+                                                         encoding, &error);
+    sc_encoding_array_free(encoding);
+    sc_barcode_generator_free(generator);
+    if (image == NULL) {
+        fprintf(stderr, "Could not generate %s: %s\n", sc_symbology_to_string(symbology),
+                error.message != NULL ? error.message : "unknown error");
+        sc_error_free(&error);
+        return SC_FALSE;
+    }
+
+    // The generator returns RGBA images.
+    const PixelChannels channels = { 4, 0, 1, 2 };
+    code->width = sc_image_description_get_width(image->description);
+    code->height = sc_image_description_get_height(image->description);
+    code->row_bytes = code->width;
+    const ScBool reserved = code->width > 0 && code->height > 0 &&
+                            gray_image_reserve(code, (size_t)code->width * code->height);
+    if (reserved) {
+        for (uint32_t y = 0; y < code->height; ++y) {
+            pixels_to_luma(image->data + (size_t)y * code->width * 4,
+                           code->data + (size_t)y * code->width, code->width, &channels);
+        }
+    }
+    sc_image_buffer_free(image);
+    return reserved;
+}
+
+/**
+ * Generates the codes of all enabled symbologies and allocates the frame buffers.
+ *
+ * \returns the number of generated codes.
+ */
+static size_t round_trip_setup(RoundTripBenchmark *round_trip, ScRecognitionContext *context,
+                               ScBarcodeScannerSettings *settings)
+{
+    const size_t frame_size = (size_t)ROUND_TRIP_FRAME_WIDTH * ROUND_TRIP_FRAME_HEIGHT;
+    round_trip->frame = malloc(frame_size);
+    round_trip->scratch = malloc(frame_size);
+    if (round_trip->frame == NULL || round_trip->scratch == NULL) {
+        fprintf(stderr, "Could not allocate the frame buffers.\n");
+        return 0;
+    }
+    size_t generated = 0;
+    for (size_t i = 0; i < ROUND_TRIP_CODE_COUNT; ++i) {
+        const ScSymbology symbology = ROUND_TRIP_CODES[i].symbology;
+        if (!symbology_enabled(settings, symbology)) {
+            round_trip->skip_reasons[i] = "not enabled in the settings";
+        } else if (!generate_gray_code(context, symbology, ROUND_TRIP_CODES[i].data,
+                                       &round_trip->codes[i])) {
+            round_trip->skip_reasons[i] = "could not be generated";
+        } else {
+            generated++;
+        }
+    }
+    return generated;
+}
+
+static void round_trip_teardown(RoundTripBenchmark *round_trip)
+{
+    for (size_t i = 0; i < ROUND_TRIP_CODE_COUNT; ++i) {
+        free(round_trip->codes[i].data);
+    }
+    free(round_trip->frame);
+    free(round_trip->scratch);
+}
+
+// xorshift64*, so that every run draws the same frames.
+static uint64_t round_trip_random(RoundTripBenchmark *round_trip)
+{
+    uint64_t x = round_trip->random_state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    round_trip->random_state = x;
+    return x * 0x2545F4914F6CDD1Dull;
+}
+
+static double round_trip_uniform(RoundTripBenchmark *round_trip)
+{
+    return (round_trip_random(round_trip) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Pixels outside of the code are white, like the quiet zone around it.
+static double code_pixel(const GrayImage *code, int x, int y)
+{
+    if (x < 0 || y < 0 || (uint32_t)x >= code->width || (uint32_t)y >= code->height) {
+        return 255.0;
+    }
+    return code->data[(size_t)y * code->row_bytes + x];
+}
+
+static double sample_bilinear(const GrayImage *code, double u, double v)
+{
+    const double floor_u = floor(u);
+    const double floor_v = floor(v);
+    const int x = (int)floor_u;
+    const int y = (int)floor_v;
+    const double fx = u - floor_u;
+    const double fy = v - floor_v;
+    const double top = code_pixel(code, x, y) * (1.0 - fx) + code_pixel(code, x + 1, y) * fx;
+    const double bottom = code_pixel(code, x, y + 1) * (1.0 - fx) + code_pixel(code, x + 1, y + 1) * fx;
+    return top * (1.0 - fy) + bottom * fy;
+}
+
+/**
+ * Blurs the image with a box filter of the given radius, first along the rows into
+ * scratch, then along the columns back into the image. The borders are repeated.
+ */
+static void box_blur(uint8_t *image, uint8_t *scratch, uint32_t width, uint32_t height, int radius)
+{
+    const int size = 2 * radius + 1;
+    for (uint32_t y = 0; y < height; ++y) {
+        const uint8_t *row = image + (size_t)y * width;
+        int sum = 0;
+        for (int i = -radius; i <= radius; ++i) {
+            sum += row[i < 0 ? 0 : (i >= (int)width ? (int)width - 1 : i)];
+        }
+        for (int x = 0; x < (int)width; ++x) {
+            scratch[(size_t)y * width + x] = (uint8_t)((sum + size / 2) / size);
+            const int leaving = x - radius;
+            const int entering = x + radius + 1;
+            sum += row[entering >= (int)width ? (int)width - 1 : entering];
+            sum -= row[leaving < 0 ? 0 : leaving];
+        }
+    }
+    for (uint32_t x = 0; x < width; ++x) {
+        int sum = 0;
+        for (int i = -radius; i <= radius; ++i) {
+            sum += scratch[(size_t)(i < 0 ? 0 : (i >= (int)height ? (int)height - 1 : i)) * width + x];
+        }
+        for (int y = 0; y < (int)height; ++y) {
+            image[(size_t)y * width + x] = (uint8_t)((sum + size / 2) / size);
+            const int leaving = y - radius;
+            const int entering = y + radius + 1;
+            sum += scratch[(size_t)(entering >= (int)height ? (int)height - 1 : entering) * width + x];
+            sum -= scratch[(size_t)(leaving < 0 ? 0 : leaving) * width + x];
+        }
+    }
+}
+
+/**
+ * Draws the code centered into the frame of the round trip benchmark, with the
+ * distortion of the given level.
+ */
+static void round_trip_draw(RoundTripBenchmark *round_trip, const GrayImage *code, size_t level)
+{
+    const uint32_t width = ROUND_TRIP_FRAME_WIDTH;
+    const uint32_t height = ROUND_TRIP_FRAME_HEIGHT;
+    const Distortion distortion = ROUND_TRIP_LEVELS[level].distortion;
+    const double amount = ROUND_TRIP_LEVELS[level].level;
+
+    const uint32_t longer_side = code->width > code->height ? code->width : code->height;
+    double scale = ROUND_TRIP_CODE_SIZE * (width < height ? width : height) / longer_side;
+    if (distortion == DISTORTION_SCALE) {
+        scale *= amount;
+    }
+    const double angle = distortion == DISTORTION_ROTATION ? amount * M_PI / 180.0 : 0.0;
+    const double cos_angle = cos(angle);
+    const double sin_angle = sin(angle);
+    // A code point u (relative to the code center) is drawn at scale * u / (1 + tilt * u).
+    const double tilt = distortion == DISTORTION_PERSPECTIVE ? amount / code->width : 0.0;
+    const double center_x = width / 2.0 + round_trip_uniform(round_trip) - 0.5;
+    const double center_y = height / 2.0 + round_trip_uniform(round_trip) - 0.5;
+
+    for (uint32_t y = 0; y < height; ++y) {
+        uint8_t *row = round_trip->frame + (size_t)y * width;
+        for (uint32_t x = 0; x < width; ++x) {
+            // Map the pixel center back into the code.
+            const double dx = x + 0.5 - center_x;
+            const double dy = y + 0.5 - center_y;
+            const double a = cos_angle * dx + sin_angle * dy;
+            const double b = -sin_angle * dx + cos_angle * dy;
+            const double divisor = scale - a * tilt;
+            if (divisor <= 0.0) {
+                row[x] = 255;
+                continue;
+            }
+            const double u = a / divisor;
+            const double v = b * (1.0 + tilt * u) / scale;
+            const double value = sample_bilinear(code, u + code->width / 2.0 - 0.5,
+                                                 v + code->height / 2.0 - 0.5);
+            row[x] = (uint8_t)(value + 0.5);
+        }
+    }
+
+    if (distortion == DISTORTION_BLUR) {
+        // Two box blurs come close to a gaussian blur.
+        box_blur(round_trip->frame, round_trip->scratch, width, height, (int)amount);
+        box_blur(round_trip->frame, round_trip->scratch, width, height, (int)amount);
+    } else if (distortion == DISTORTION_NOISE) {
+        for (size_t i = 0; i < (size_t)width * height; ++i) {
+            // The sum of 4 uniform numbers is nearly normal, with a variance of 1/3.
+            double normal = -2.0;
+            for (int j = 0; j < 4; ++j) {
+                normal += round_trip_uniform(round_trip);
+            }
+            const double value = round_trip->frame[i] + normal * 1.7320508 * amount;
+            round_trip->frame[i] = (uint8_t)(value < 0.0 ? 0.0 : (value > 255.0 ? 255.0 : value + 0.5));
+        }
+    } else if (distortion == DISTORTION_INVERSION) {
+        for (size_t i = 0; i < (size_t)width * height; ++i) {
+            round_trip->frame[i] = 255 - round_trip->frame[i];
+        }
+    }
+}
+
+/**
+ * Returns whether the last frame recognized the code with the right symbology and data.
+ */
+static ScBool round_trip_recognized(Benchmark *benchmark, size_t code)
+{
+    const size_t expected_length = strlen(ROUND_TRIP_CODES[code].data);
+    ScBarcodeScannerSession *session = sc_barcode_scanner_get_session(benchmark->scanner);
+    ScBarcodeArray *new_codes = sc_barcode_scanner_session_get_newly_recognized_codes(session);
+    ScBool recognized = SC_FALSE;
+    const uint32_t num_codes = sc_barcode_array_get_size(new_codes);
+    for (uint32_t i = 0; i < num_codes; ++i) {
+        const ScBarcode *barcode = sc_barcode_array_get_item_at(new_codes, i);
+        const ScByteArray data = sc_barcode_get_data(barcode);
+        if (sc_barcode_get_symbology(barcode) == ROUND_TRIP_CODES[code].symbology &&
+            data.length == expected_length &&
+            memcmp(data.str, ROUND_TRIP_CODES[code].data, expected_length) == 0) {
+            recognized = SC_TRUE;
+        }
+    }
+    sc_barcode_array_release(new_codes);
+    return recognized;
+}
+
+/**
+ * Scans all generated codes at all distortion levels once. Only process_frame is timed.
+ */
+static void benchmark_round_trip(Benchmark *benchmark, RoundTripBenchmark *round_trip, int pass,
+                                 ScBool measure)
+{
+    ScImageDescription *image_descr = benchmark->image_descr;
+    sc_image_description_set_layout(image_descr, SC_IMAGE_LAYOUT_GRAY_8U);
+    sc_image_description_set_width(image_descr, ROUND_TRIP_FRAME_WIDTH);
+    sc_image_description_set_height(image_descr, ROUND_TRIP_FRAME_HEIGHT);
+    sc_image_description_set_first_plane_row_bytes(image_descr, ROUND_TRIP_FRAME_WIDTH);
+    sc_image_description_set_memory_size(image_descr, ROUND_TRIP_FRAME_WIDTH * ROUND_TRIP_FRAME_HEIGHT);
+
+    for (size_t code = 0; code < ROUND_TRIP_CODE_COUNT; ++code) {
+        if (round_trip->codes[code].data == NULL) {
+            continue;
+        }
+        for (size_t level = 0; level < ROUND_TRIP_LEVEL_COUNT; ++level) {
+            // Every pass draws different frames, but the same ones in every run.
+            round_trip->random_state = 0x9E3779B97F4A7C15ull *
+                    ((uint64_t)pass * ROUND_TRIP_CODE_COUNT * ROUND_TRIP_LEVEL_COUNT +
+                     code * ROUND_TRIP_LEVEL_COUNT + level + 1);
+            round_trip_draw(round_trip, &round_trip->codes[code], level);
+
+            sc_recognition_context_start_new_frame_sequence(benchmark->context);
+            const uint64_t start = now_ns();
+            const ScProcessFrameResult result = sc_recognition_context_process_frame(
+                    benchmark->context, image_descr, round_trip->frame);
+            const uint64_t recognition_ns = now_ns() - start;
+            const ScBool recognized = result.status == SC_RECOGNITION_CONTEXT_STATUS_SUCCESS &&
+                                      round_trip_recognized(benchmark, code);
+            sc_recognition_context_end_frame_sequence(benchmark->context);
+
+            if (!measure) {
+                continue;
+            }
+            RoundTripStatistics *statistics = &round_trip->statistics[code][level];
+            benchmark->frames++;
+            if (result.status != SC_RECOGNITION_CONTEXT_STATUS_SUCCESS) {
+                benchmark->failed_frames++;
+                benchmark->last_failure = result.status;
+            }
+            if (recognized) {
+                benchmark->frames_with_codes++;
+                statistics->recognized++;
+            }
+            statistics->frames++;
+            histogram_record(&statistics->recognition, recognition_ns);
+        }
+    }
+}
+
+static void write_round_trip_report_json(FILE *out, const Benchmark *benchmark,
+                                         const RoundTripBenchmark *round_trip,
+                                         const char *settings_name, int iterations, int warmup)
+{
+    fprintf(out, "{\n");
+    fprintf(out, "  \"sdk_version\": \"%s\",\n",
+            sc_get_information_string(SC_INFORMATION_KEY_SDK_VERSION));
+    fprintf(out, "  \"settings\": \"%s\",\n", settings_name);
+    fprintf(out, "  \"frame_width\": %d,\n", ROUND_TRIP_FRAME_WIDTH);
+    fprintf(out, "  \"frame_height\": %d,\n", ROUND_TRIP_FRAME_HEIGHT);
+    fprintf(out, "  \"iterations\": %d,\n", iterations);
+    fprintf(out, "  \"warmup\": %d,\n", warmup);
+    fprintf(out, "  \"frames\": %llu,\n", (unsigned long long)benchmark->frames);
+    fprintf(out, "  \"failed_frames\": %llu,\n", (unsigned long long)benchmark->failed_frames);
+    fprintf(out, "  \"wall_seconds\": %.4f,\n", benchmark->wall_seconds);
+    fprintf(out, "  \"recognition_rate\": %.4f,\n",
+            benchmark->frames > 0 ? (double)benchmark->frames_with_codes / benchmark->frames : 0.0);
+    fprintf(out, "  \"symbologies\": {");
+    for (size_t code = 0; code < ROUND_TRIP_CODE_COUNT; ++code) {
+        fprintf(out, "%s\n    \"%s\": {\"data\": \"%s\"", code > 0 ? "," : "",
+                sc_symbology_to_string(ROUND_TRIP_CODES[code].symbology), ROUND_TRIP_CODES[code].data);
+        if (round_trip->codes[code].data == NULL) {
+            fprintf(out, ", \"skipped\": \"%s\"}", round_trip->skip_reasons[code]);
+            continue;
+        }
+        fprintf(out, ", \"code_width\": %u, \"code_height\": %u, \"distortions\": {",
+                round_trip->codes[code].width, round_trip->codes[code].height);
+        // The levels of a distortion follow each other in ROUND_TRIP_LEVELS.
+        for (size_t level = 0; level < ROUND_TRIP_LEVEL_COUNT; ++level) {
+            const ScBool first_of_distortion = level == 0 ||
+                    ROUND_TRIP_LEVELS[level].distortion != ROUND_TRIP_LEVELS[level - 1].distortion;
+            if (first_of_distortion) {
+                fprintf(out, "%s\n      \"%s\": [", level > 0 ? "]," : "", ROUND_TRIP_LEVELS[level].name);
+            }
+            const RoundTripStatistics *statistics = &round_trip->statistics[code][level];
+            fprintf(out, "%s\n        {\"level\": %g, \"frames\": %llu, \"recognized\": %llu, "
+                         "\"rate\": %.4f, \"recognition\": ",
+                    first_of_distortion ? "" : ",", ROUND_TRIP_LEVELS[level].level,
+                    (unsigned long long)statistics->frames,
+                    (unsigned long long)statistics->recognized,
+                    statistics->frames > 0 ? (double)statistics->recognized / statistics->frames : 0.0);
+            write_stage_json(out, &statistics->recognition);
+            fprintf(out, "}");
+        }
+        fprintf(out, "]\n    }}");
+    }
+    fprintf(out, "\n  }\n");
+    fprintf(out, "}\n");
+}
+
+static int compare_labels(const void *lhs, const void *rhs)
+{
+    return strcmp(((const CorpusLabel *)lhs)->path, ((const CorpusLabel *)rhs)->path);
+}
+
+static void label_list_free(LabelList *list)
+{
+    for (size_t i = 0; i < list->count; ++i) {
+        free(list->labels[i].path);
+        free(list->labels[i].data);
+    }
+    free(list->labels);
+}
+
+/**
+ * Adds one line of the labels file, "path,symbology,data", to the list.
+ */
+static ScBool label_list_add_line(LabelList *list, char *line, const char *directory)
+{
+    char *symbology_name = strchr(line, ',');
+    char *data = symbology_name != NULL ? strchr(symbology_name + 1, ',') : NULL;
+    if (data == NULL) {
+        fprintf(stderr, "Invalid label '%s', expected path,symbology,data.\n", line);
+        return SC_FALSE;
+    }
+    *symbology_name++ = '\0';
+    *data++ = '\0';
+
+    char joined[PATH_MAX];
+    snprintf(joined, sizeof(joined), "%s%s%s", line[0] == '/' ? "" : directory,
+             line[0] == '/' ? "" : "/", line);
+    char *path = realpath(joined, NULL);
+    if (path == NULL) {
+        fprintf(stderr, "Labelled image '%s' not found: %s\n", joined, strerror(errno));
+        return SC_FALSE;
+    }
+    ScSymbology symbology = SC_SYMBOLOGY_UNKNOWN;
+    if (symbology_name[0] != '\0') {
+        symbology = sc_symbology_from_string(symbology_name);
+        if (symbology == SC_SYMBOLOGY_UNKNOWN) {
+            fprintf(stderr, "Unknown symbology '%s' in the labels of '%s'.\n", symbology_name, path);
+            free(path);
+            return SC_FALSE;
+        }
+    }
+
+    if (list->count == list->capacity) {
+        const size_t capacity = list->capacity == 0 ? 256 : list->capacity * 2;
+        CorpusLabel *labels = realloc(list->labels, capacity * sizeof(CorpusLabel));
+        if (labels == NULL) {
+            free(path);
+            return SC_FALSE;
+        }
+        list->labels = labels;
+        list->capacity = capacity;
+    }
+    CorpusLabel *label = &list->labels[list->count];
+    label->path = path;
+    label->symbology = symbology;
+    label->data = strdup(data);
+    label->data_length = strlen(data);
+    if (label->data == NULL) {
+        free(path);
+        return SC_FALSE;
+    }
+    list->count++;
+    return SC_TRUE;
+}
+
+/**
+ * Reads the labels file and sorts the labels by the real path of their image.
+ */
+static ScBool label_list_load(LabelList *list, const char *labels_file)
+{
+    FILE *file = fopen(labels_file, "r");
+    if (file == NULL) {
+        fprintf(stderr, "Could not open labels '%s': %s\n", labels_file, strerror(errno));
+        return SC_FALSE;
+    }
+    char *labels_path = strdup(labels_file);
+    const char *directory = labels_path != NULL ? dirname(labels_path) : ".";
+    char *line = NULL;
+    size_t line_capacity = 0;
+    ssize_t length;
+    ScBool loaded = SC_TRUE;
+    while (loaded && (length = getline(&line, &line_capacity, file)) >= 0) {
+        while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r')) {
+            line[--length] = '\0';
+        }
+        if (length > 0 && line[0] != '#') {
+            loaded = label_list_add_line(list, line, directory);
+        }
+    }
+    free(line);
+    free(labels_path);
+    fclose(file);
+    qsort(list->labels, list->count, sizeof(CorpusLabel), compare_labels);
+    return loaded;
+}
+
+/**
+ * Returns the index of the first label of the image, or the label count if there is
+ * none.
+ */
+static size_t label_list_find(const LabelList *list, const char *path)
+{
+    size_t low = 0;
+    size_t high = list->count;
+    while (low < high) {
+        const size_t middle = low + (high - low) / 2;
+        if (strcmp(list->labels[middle].path, path) < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low < list->count && strcmp(list->labels[low].path, path) == 0 ? low : list->count;
+}
+
+/**
+ * Decodes all images of the corpus to gray and assigns them their labels.
+ */
+static ScBool tuner_load_corpus(Tuner *tuner, const ImageList *images)
+{
+    tuner->images = calloc(images->count, sizeof(GrayImage));
+    tuner->first_labels = calloc(images->count, sizeof(size_t));
+    tuner->label_counts = calloc(images->count, sizeof(size_t));
+    if (tuner->images == NULL || tuner->first_labels == NULL || tuner->label_counts == NULL) {
+        return SC_FALSE;
+    }
+    size_t max_labels = 0;
+    size_t labelled_images = 0;
+    for (size_t i = 0; i < images->count; ++i) {
+        if (is_recording(images->paths[i])) {
+            fprintf(stderr, "Recording '%s' skipped, it has no labels.\n", images->paths[i]);
+            continue;
+        }
+        SDL_Surface *surface = IMG_Load(images->paths[i]);
+        if (surface == NULL) {
+            fprintf(stderr, "IMG_Load '%s' failed: %s\n", images->paths[i], IMG_GetError());
+            continue;
+        }
+        GrayImage *image = &tuner->images[tuner->image_count];
+        const ScBool converted = convert_to_gray(surface, image);
+        SDL_FreeSurface(surface);
+        if (!converted) {
+            fprintf(stderr, "Image '%s' convertion failed.\n", images->paths[i]);
+            continue;
+        }
+
+        char *path = realpath(images->paths[i], NULL);
+        const size_t first = path != NULL ? label_list_find(&tuner->labels, path) : tuner->labels.count;
+        size_t count = 0;
+        uint32_t codes = 0;
+        while (first + count < tuner->labels.count &&
+               strcmp(tuner->labels.labels[first + count].path, path) == 0) {
+            const ScSymbology symbology = tuner->labels.labels[first + count].symbology;
+            if (symbology != SC_SYMBOLOGY_UNKNOWN) {
+                tuner->labelled_symbologies |= symbology;
+                codes++;
+            }
+            count++;
+        }
+        free(path);
+        labelled_images += count > 0 ? 1 : 0;
+        tuner->first_labels[tuner->image_count] = first;
+        tuner->label_counts[tuner->image_count] = count;
+        tuner->image_count++;
+        max_labels = count > max_labels ? count : max_labels;
+        if (codes > tuner->max_codes_per_image) {
+            tuner->max_codes_per_image = codes;
+        }
+    }
+    if (labelled_images < tuner->image_count) {
+        fprintf(stderr, "%zu images have no labels, codes found in them count as false positives.\n",
+                tuner->image_count - labelled_images);
+    }
+    tuner->found = malloc(max_labels + 1);
+    return tuner->image_count > 0 && tuner->found != NULL;
+}
+
+/**
+ * Lists all combinations of the settings choices. Choices that can not make a
+ * difference for the corpus are left out.
+ */
+static ScBool tuner_build_candidates(Tuner *tuner)
+{
+    const ScBool has_code128 = (tuner->labelled_symbologies & SC_SYMBOLOGY_CODE128) != 0;
+    const uint32_t max_codes[2] = { 1, tuner->max_codes_per_image };
+    const size_t max_codes_choices = tuner->max_codes_per_image > 1 ? 2 : 1;
+    const size_t code128_choices = has_code128 ? TUNE_CODE128_CHOICES : 1;
+    tuner->candidates = calloc(TUNE_SYMBOLOGY_CHOICES * code128_choices * max_codes_choices *
+                               TUNE_DIRECTION_CHOICES * TUNE_LOCATION_CHOICES, sizeof(TuneCandidate));
+    if (tuner->candidates == NULL) {
+        return SC_FALSE;
+    }
+    for (size_t symbologies = 0; symbologies < TUNE_SYMBOLOGY_CHOICES; ++symbologies) {
+        for (size_t counts = 0; counts < code128_choices; ++counts) {
+            for (size_t codes = 0; codes < max_codes_choices; ++codes) {
+                for (size_t direction = 0; direction < TUNE_DIRECTION_CHOICES; ++direction) {
+                    for (size_t location = 0; location < TUNE_LOCATION_CHOICES; ++location) {
+                        TuneCandidate *candidate = &tuner->candidates[tuner->candidate_count++];
+                        candidate->symbologies = symbologies;
+                        candidate->code128_symbol_counts = counts;
+                        candidate->max_codes_per_frame = max_codes[codes];
+                        candidate->direction = direction;
+                        candidate->location = location;
+                    }
+                }
+            }
+        }
+    }
+    return SC_TRUE;
+}
+
+/**
+ * Returns a copy of the base settings with the choices of the candidate applied.
+ */
+static ScBarcodeScannerSettings *tuner_create_settings(const Tuner *tuner, ScBarcodeScannerSettings *base,
+                                                       const TuneCandidate *candidate)
+{
+    ScBarcodeScannerSettings *settings = sc_barcode_scanner_settings_clone(base);
+    if (settings == NULL) {
+        return NULL;
+    }
+    if (TUNE_SYMBOLOGIES[candidate->symbologies].labelled_only) {
+        for (uint32_t bit = SC_SYMBOLOGY_EAN13; bit <= SC_SYMBOLOGY_IATA_2_OF_5; bit <<= 1) {
+            sc_barcode_scanner_settings_set_symbology_enabled(
+                    settings, (ScSymbology)bit, (tuner->labelled_symbologies & bit) != 0);
+        }
+    }
+    const uint16_t from = TUNE_CODE128_SYMBOL_COUNTS[candidate->code128_symbol_counts].from;
+    const uint16_t to = TUNE_CODE128_SYMBOL_COUNTS[candidate->code128_symbol_counts].to;
+    if (from > 0) {
+        uint16_t counts[64];
+        uint16_t count_count = 0;
+        for (uint16_t count = from; count <= to && count_count < 64; ++count) {
+            counts[count_count++] = count;
+        }
+        ScSymbologySettings *code128 =
+                sc_barcode_scanner_settings_get_symbology_settings(settings, SC_SYMBOLOGY_CODE128);
+        sc_symbology_settings_set_active_symbol_counts(code128, counts, count_count);
+    }
+    sc_barcode_scanner_settings_set_max_number_of_codes_per_frame(settings,
+                                                                  candidate->max_codes_per_frame);
+    sc_barcode_scanner_settings_set_code_direction_hint(settings,
+                                                        TUNE_DIRECTIONS[candidate->direction].direction);
+    sc_barcode_scanner_settings_set_code_location_constraint_1d(
+            settings, TUNE_LOCATIONS[candidate->location].constraint);
+    sc_barcode_scanner_settings_set_code_location_constraint_2d(
+            settings, TUNE_LOCATIONS[candidate->location].constraint);
+    return settings;
+}
+
+/**
+ * Matches the newly recognized codes of the last frame against the labels of the image.
+ */
+static void tuner_match_codes(Benchmark *benchmark, Tuner *tuner, size_t image,
+                              TuneCandidate *candidate)
+{
+    const CorpusLabel *labels = &tuner->labels.labels[tuner->first_labels[image]];
+    const size_t label_count = tuner->label_counts[image];
+    memset(tuner->found, 0, label_count);
+
+    ScBarcodeScannerSession *session = sc_barcode_scanner_get_session(benchmark->scanner);
+    ScBarcodeArray *new_codes = sc_barcode_scanner_session_get_newly_recognized_codes(session);
+    const uint32_t num_codes = sc_barcode_array_get_size(new_codes);
+    for (uint32_t i = 0; i < num_codes; ++i) {
+        const ScBarcode *barcode = sc_barcode_array_get_item_at(new_codes, i);
+        const ScByteArray data = sc_barcode_get_data(barcode);
+        const ScSymbology symbology = sc_barcode_get_symbology(barcode);
+        ScBool matched = SC_FALSE;
+        for (size_t j = 0; j < label_count && !matched; ++j) {
+            if (!tuner->found[j] && labels[j].symbology == symbology &&
+                labels[j].data_length == data.length &&
+                memcmp(labels[j].data, data.str, data.length) == 0) {
+                tuner->found[j] = 1;
+                matched = SC_TRUE;
+            }
+        }
+        if (matched) {
+            candidate->found_codes++;
+        } else {
+            candidate->false_positives++;
+        }
+    }
+    sc_barcode_array_release(new_codes);
+}
+
+/**
+ * Scans the corpus with the settings of the candidate, warmup times without and
+ * iterations times with measuring. The first frame after the settings were applied
+ * is never measured, even without warmup, since it also reconfigures the scanner.
+ */
+static void tuner_evaluate(Benchmark *benchmark, Tuner *tuner, TuneCandidate *candidate,
+                           const ScBarcodeScannerSettings *settings, int warmup, int iterations)
+{
+    sc_barcode_scanner_apply_settings(benchmark->scanner, settings);
+    ScImageDescription *image_descr = benchmark->image_descr;
+    sc_image_description_set_layout(image_descr, SC_IMAGE_LAYOUT_GRAY_8U);
+    for (int pass = -1; pass < warmup + iterations; ++pass) {
+        const ScBool measure = pass >= warmup;
+        // The settling pass only scans the first image.
+        const size_t image_count = pass < 0 ? 1 : tuner->image_count;
+        for (size_t i = 0; i < image_count; ++i) {
+            const GrayImage *image = &tuner->images[i];
+            sc_image_description_set_width(image_descr, image->width);
+            sc_image_description_set_height(image_descr, image->height);
+            sc_image_description_set_first_plane_row_bytes(image_descr, image->row_bytes);
+            sc_image_description_set_memory_size(image_descr, image->row_bytes * image->height);
+
+            sc_recognition_context_start_new_frame_sequence(benchmark->context);
+            const uint64_t start = now_ns();
+            const ScProcessFrameResult result =
+                    sc_recognition_context_process_frame(benchmark->context, image_descr, image->data);
+            const uint64_t recognition_ns = now_ns() - start;
+            if (measure && result.status == SC_RECOGNITION_CONTEXT_STATUS_SUCCESS) {
+                tuner_match_codes(benchmark, tuner, i, candidate);
+            }
+            sc_recognition_context_end_frame_sequence(benchmark->context);
+
+            if (!measure) {
+                continue;
+            }
+            benchmark->frames++;
+            if (result.status != SC_RECOGNITION_CONTEXT_STATUS_SUCCESS) {
+                benchmark->failed_frames++;
+                benchmark->last_failure = result.status;
+            }
+            for (size_t j = 0; j < tuner->label_counts[i]; ++j) {
+                const CorpusLabel *label = &tuner->labels.labels[tuner->first_labels[i] + j];
+                candidate->expected_codes += label->symbology != SC_SYMBOLOGY_UNKNOWN ? 1 : 0;
+            }
+            histogram_record(&candidate->recognition, recognition_ns);
+        }
+    }
+}
+
+static double tune_candidate_recall(const TuneCandidate *candidate)
+{
+    if (candidate->expected_codes == 0) {
+        return 1.0;
+    }
+    return (double)candidate->found_codes / candidate->expected_codes;
+}
+
+static double tune_candidate_mean_ms(const TuneCandidate *candidate)
+{
+    const LatencyHistogram *histogram = &candidate->recognition;
+    return histogram->count > 0 ? histogram->total_ns * 1e-6 / histogram->count : 0.0;
+}
+
+/**
+ * Marks the candidates that no other candidate beats in both mean latency and recall.
+ *
+ * \returns the index of the fastest candidate that reaches the recall target, or the
+ * candidate count if none does.
+ */
+static size_t tuner_select(Tuner *tuner, double recall_target)
+{
+    size_t best = tuner->candidate_count;
+    for (size_t i = 0; i < tuner->candidate_count; ++i) {
+        TuneCandidate *candidate = &tuner->candidates[i];
+        const double recall = tune_candidate_recall(candidate);
+        const double mean_ms = tune_candidate_mean_ms(candidate);
+        candidate->pareto = SC_TRUE;
+        for (size_t j = 0; j < tuner->candidate_count && candidate->pareto; ++j) {
+            const double other_recall = tune_candidate_recall(&tuner->candidates[j]);
+            const double other_mean_ms = tune_candidate_mean_ms(&tuner->candidates[j]);
+            if (other_recall >= recall && other_mean_ms <= mean_ms &&
+                (other_recall > recall || other_mean_ms < mean_ms)) {
+                candidate->pareto = SC_FALSE;
+            }
+        }
+        if (recall >= recall_target &&
+            (best == tuner->candidate_count || mean_ms < tune_candidate_mean_ms(&tuner->candidates[best]))) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+static void tuner_free(Tuner *tuner)
+{
+    for (size_t i = 0; i < tuner->image_count; ++i) {
+        free(tuner->images[i].data);
+    }
+    free(tuner->images);
+    free(tuner->first_labels);
+    free(tuner->label_counts);
+    label_list_free(&tuner->labels);
+    free(tuner->found);
+    free(tuner->candidates);
+}
+
+static void write_tune_candidate_json(FILE *out, const TuneCandidate *candidate)
+{
+    fprintf(out, "\"symbologies\": \"%s\", \"code128_symbol_counts\": \"%s\", "
+                 "\"max_codes_per_frame\": %u, \"direction\": \"%s\", \"location\": \"%s\", "
+                 "\"recall\": %.4f, \"found_codes\": %llu, \"expected_codes\": %llu, "
+                 "\"false_positives\": %llu, \"pareto\": %s,\n      \"recognition\": ",
+            TUNE_SYMBOLOGIES[candidate->symbologies].name,
+            TUNE_CODE128_SYMBOL_COUNTS[candidate->code128_symbol_counts].name,
+            candidate->max_codes_per_frame, TUNE_DIRECTIONS[candidate->direction].name,
+            TUNE_LOCATIONS[candidate->location].name, tune_candidate_recall(candidate),
+            (unsigned long long)candidate->found_codes, (unsigned long long)candidate->expected_codes,
+            (unsigned long long)candidate->false_positives, candidate->pareto ? "true" : "false");
+    write_stage_json(out, &candidate->recognition);
+}
+
+static void write_tune_report_json(FILE *out, const Benchmark *benchmark, const Tuner *tuner,
+                                   ScBarcodeScannerSettings *base, const char *settings_name,
+                                   int iterations, int warmup, double recall_target, size_t best)
+{
+    fprintf(out, "{\n");
+    fprintf(out, "  \"sdk_version\": \"%s\",\n",
+            sc_get_information_string(SC_INFORMATION_KEY_SDK_VERSION));
+    fprintf(out, "  \"settings\": \"%s\",\n", settings_name);
+    fprintf(out, "  \"images\": %zu,\n", tuner->image_count);
+    fprintf(out, "  \"iterations\": %d,\n", iterations);
+    fprintf(out, "  \"warmup\": %d,\n", warmup);
+    fprintf(out, "  \"frames\": %llu,\n", (unsigned long long)benchmark->frames);
+    fprintf(out, "  \"failed_frames\": %llu,\n", (unsigned long long)benchmark->failed_frames);
+    fprintf(out, "  \"wall_seconds\": %.4f,\n", benchmark->wall_seconds);
+    fprintf(out, "  \"recall_target\": %.4f,\n", recall_target);
+    if (best < tuner->candidate_count) {
+        fprintf(out, "  \"fastest_reaching_target\": %zu,\n", best);
+    } else {
+        fprintf(out, "  \"fastest_reaching_target\": null,\n");
+    }
+    fprintf(out, "  \"candidates\": [");
+    for (size_t i = 0; i < tuner->candidate_count; ++i) {
+        fprintf(out, "%s\n    {\"index\": %zu, ", i > 0 ? "," : "", i);
+        write_tune_candidate_json(out, &tuner->candidates[i]);
+        fprintf(out, "}");
+    }
+    fprintf(out, "\n  ],\n");
+    // The Pareto front from fast to thorough, with the settings to load. Each step
+    // takes the next slower candidate of the front, ties in the order of the candidates.
+    fprintf(out, "  \"pareto\": [");
+    const char *separator = "";
+    double last_mean_ms = -1.0;
+    size_t last = 0;
+    for (;;) {
+        size_t i = tuner->candidate_count;
+        for (size_t j = 0; j < tuner->candidate_count; ++j) {
+            const double mean_ms = tune_candidate_mean_ms(&tuner->candidates[j]);
+            if (tuner->candidates[j].pareto &&
+                (mean_ms > last_mean_ms || (mean_ms == last_mean_ms && j > last)) &&
+                (i == tuner->candidate_count || mean_ms < tune_candidate_mean_ms(&tuner->candidates[i]))) {
+                i = j;
+            }
+        }
+        if (i == tuner->candidate_count) {
+            break;
+        }
+        const TuneCandidate *candidate = &tuner->candidates[i];
+        last_mean_ms = tune_candidate_mean_ms(candidate);
+        last = i;
+        ScBarcodeScannerSettings *settings = tuner_create_settings(tuner, base, candidate);
+        char *json = settings != NULL ? sc_barcode_scanner_settings_as_json(settings) : NULL;
+        fprintf(out, "%s\n    {\"index\": %zu, \"recall\": %.4f, \"mean_ms\": %.4f, \"settings\": %s}",
+                separator, i, tune_candidate_recall(candidate), tune_candidate_mean_ms(candidate),
+                json != NULL ? json : "null");
+        separator = ",";
+        sc_free(json);
+        sc_barcode_scanner_settings_release(settings);
+    }
+    fprintf(out, "\n  ]\n");
+    fprintf(out, "}\n");
+}
+
+/**
+ * Writes the settings of the candidate in the format that --settings loads.
+ */
+static ScBool write_tuned_settings(const Tuner *tuner, ScBarcodeScannerSettings *base,
+                                   const TuneCandidate *candidate, const char *path)
+{
+    ScBarcodeScannerSettings *settings = tuner_create_settings(tuner, base, candidate);
+    char *json = settings != NULL ? sc_barcode_scanner_settings_as_json(settings) : NULL;
+    sc_barcode_scanner_settings_release(settings);
+    if (json == NULL) {
+        fprintf(stderr, "Could not serialize the tuned settings.\n");
+        return SC_FALSE;
+    }
+    FILE *file = fopen(path, "w");
+    ScBool written = file != NULL && fputs(json, file) >= 0;
+    if (file != NULL && fclose(file) != 0) {
+        written = SC_FALSE;
+    }
+    if (!written) {
+        fprintf(stderr, "Could not write '%s': %s\n", path, strerror(errno));
+    }
+    sc_free(json);
+    return written;
+}
+
+static void print_usage(const char *program_name)
+{
+    printf("Usage: %s [--iterations N] [--warmup N] [--settings settings.json]\n"
+           "       [--output report.json] [--layouts [--resolutions WxH,...]]\n"
+           "       image-or-directory...\n"
+           "       %s --round-trip [--iterations N] [--warmup N] [--settings settings.json]\n"
+           "       [--output report.json]\n"
+           "       %s --tune --labels labels.csv [--recall-target R] [--tuned-settings tuned.json]\n"
+           "       [--iterations N] [--warmup N] [--settings settings.json] [--output report.json]\n"
+           "       image-or-directory...\n", program_name, program_name, program_name);
+}
+
+int main(int argc, char **argv)
+{
+    int iterations = 3;
+    int warmup = 1;
+    const char *settings_file = NULL;
+    const char *output_file = NULL;
+    ScBool layouts_enabled = SC_FALSE;
+    const char *resolutions = DEFAULT_BENCHMARK_RESOLUTIONS;
+    ScBool round_trip_enabled = SC_FALSE;
+    ScBool tune_enabled = SC_FALSE;
+    const char *labels_file = NULL;
+    const char *tuned_settings_file = NULL;
+    double recall_target = 0.99;
+
+    static const struct option long_options[] = {
+        { "iterations", required_argument, NULL, 'i' },
+        { "warmup", required_argument, NULL, 'w' },
+        { "settings", required_argument, NULL, 's' },
+        { "output", required_argument, NULL, 'o' },
+        { "layouts", no_argument, NULL, 'l' },
+        { "resolutions", required_argument, NULL, 'r' },
+        { "round-trip", no_argument, NULL, 't' },
+        { "tune", no_argument, NULL, 'T' },
+        { "labels", required_argument, NULL, 'L' },
+        { "recall-target", required_argument, NULL, 'R' },
+        { "tuned-settings", required_argument, NULL, 'S' },
+        { "help", no_argument, NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+    int option;
+    while ((option = getopt_long(argc, argv, "i:w:s:o:lr:tTL:R:S:h", long_options, NULL)) != -1) {
+        switch (option) {
+            case 'i':
+                iterations = atoi(optarg);
+                break;
+            case 'w':
+                warmup = atoi(optarg);
+                break;
+            case 's':
+                settings_file = optarg;
+                break;
+            case 'o':
+                output_file = optarg;
+                break;
+            case 'l':
+                layouts_enabled = SC_TRUE;
+                break;
+            case 'r':
+                resolutions = optarg;
+                break;
+            case 't':
+                round_trip_enabled = SC_TRUE;
+                break;
+            case 'T':
+                tune_enabled = SC_TRUE;
+                break;
+            case 'L':
+                labels_file = optarg;
+                break;
+            case 'R':
+                recall_target = atof(optarg);
+                break;
+            case 'S':
+                tuned_settings_file = optarg;
+                break;
+            case 'h':
+                print_usage(argv[0]);
+                return 0;
+            default:
+                print_usage(argv[0]);
+                return -1;
+        }
+    }
+    // The round trip benchmark generates its own images.
+    if ((optind >= argc) != round_trip_enabled || layouts_enabled + round_trip_enabled + tune_enabled > 1 ||
+        tune_enabled != (labels_file != NULL) || (tuned_settings_file != NULL && !tune_enabled) ||
+        recall_target < 0.0 || recall_target > 1.0 || iterations < 1 || warmup < 0) {
+        print_usage(argv[0]);
+        return -1;
+    }
+
+    int return_code = 0;
+    ImageList images = { NULL, 0, 0 };
+    ScBarcodeScannerSettings *settings = NULL;
+    Benchmark *benchmark = calloc(1, sizeof(Benchmark));
+    LayoutBenchmark *layouts = NULL;
+    RoundTripBenchmark *round_trip = NULL;
+    Tuner *tuner = NULL;
+    size_t best = 0;
+    IMG_Init(IMG_INIT_JPG | IMG_INIT_PNG | IMG_INIT_TIF);
+
+    if (benchmark == NULL || !collect_images(&images, argv + optind, argc - optind)) {
+        return_code = -1;
+        goto cleanup;
+    }
+    if (images.count == 0 && !round_trip_enabled) {
+        fprintf(stderr, "No images found.\n");
+        return_code = -1;
+        goto cleanup;
+    }
+
+    if (layouts_enabled) {
+        layouts = calloc(1, sizeof(LayoutBenchmark));
+        if (layouts == NULL || !parse_resolutions(resolutions, layouts)) {
+            fprintf(stderr, "Invalid resolutions '%s', expected e.g. 640x480,1280x720.\n", resolutions);
+            return_code = -1;
+            goto cleanup;
+        }
+        if (!layout_benchmark_reserve(layouts)) {
+            fprintf(stderr, "Could not allocate the frame buffers.\n");
+            return_code = -1;
+            goto cleanup;
+        }
+    }
+
+    settings = create_scanner_settings(settings_file);
+    if (settings == NULL || !benchmark_setup(benchmark, settings)) {
+        return_code = -1;
+        goto cleanup;
+    }
+
+    if (round_trip_enabled) {
+        round_trip = calloc(1, sizeof(RoundTripBenchmark));
+        if (round_trip == NULL || round_trip_setup(round_trip, benchmark->context, settings) == 0) {
+            fprintf(stderr, "No codes could be generated for the enabled symbologies.\n");
+            return_code = -1;
+            goto cleanup;
+        }
+    }
+
+    if (tune_enabled) {
+        tuner = calloc(1, sizeof(Tuner));
+        if (tuner == NULL || !label_list_load(&tuner->labels, labels_file)) {
+            return_code = -1;
+            goto cleanup;
+        }
+        if (!tuner_load_corpus(tuner, &images) || !tuner_build_candidates(tuner)) {
+            fprintf(stderr, "Could not load the corpus.\n");
+            return_code = -1;
+            goto cleanup;
+        }
+    }
+
+    uint64_t checksum = 0;
+    for (int pass = 0; pass < warmup && tuner == NULL; ++pass) {
+        if (round_trip != NULL) {
+            benchmark_round_trip(benchmark, round_trip, pass, SC_FALSE);
+        }
+        for (size_t i = 0; i < images.count; ++i) {
+            if (layouts != NULL) {
+                benchmark_image_layouts(benchmark, layouts, images.paths[i], SC_FALSE, &checksum);
+            } else if (is_recording(images.paths[i])) {
+                benchmark_recording(benchmark, images.paths[i], SC_FALSE, &checksum);
+            } else {
+                benchmark_image(benchmark, images.paths[i], SC_FALSE, &checksum);
+            }
+        }
+    }
+    const uint64_t run_start = now_ns();
+    for (size_t i = 0; tuner != NULL && i < tuner->candidate_count; ++i) {
+        TuneCandidate *candidate = &tuner->candidates[i];
+        ScBarcodeScannerSettings *candidate_settings = tuner_create_settings(tuner, settings, candidate);
+        if (candidate_settings == NULL) {
+            fprintf(stderr, "Could not create the settings of candidate %zu.\n", i);
+            return_code = -1;
+            goto cleanup;
+        }
+        tuner_evaluate(benchmark, tuner, candidate, candidate_settings, warmup, iterations);
+        sc_barcode_scanner_settings_release(candidate_settings);
+        fprintf(stderr, "Candidate %zu of %zu: mean %.3f ms, recall %.4f\n", i + 1,
+                tuner->candidate_count, tune_candidate_mean_ms(candidate),
+                tune_candidate_recall(candidate));
+    }
+    for (int pass = 0; pass < iterations && tuner == NULL; ++pass) {
+        if (round_trip != NULL) {
+            benchmark_round_trip(benchmark, round_trip, warmup + pass, SC_TRUE);
+        }
+        for (size_t i = 0; i < images.count; ++i) {
+            if (layouts != NULL) {
+                benchmark_image_layouts(benchmark, layouts, images.paths[i], SC_TRUE, &checksum);
+            } else if (is_recording(images.paths[i])) {
+                benchmark_recording(benchmark, images.paths[i], SC_TRUE, &checksum);
+            } else {
+                benchmark_image(benchmark, images.paths[i], SC_TRUE, &checksum);
+            }
+        }
+    }
+    benchmark->wall_seconds = (now_ns() - run_start) * 1e-9;
+    if (tuner == NULL) {
+        // Printing the checksum of everything that was read keeps the compiler from
+        // dropping the reads.
+        fprintf(stderr, "Result checksum %016llx\n", (unsigned long long)checksum);
+    }
+
+    if (benchmark->failed_frames > 0) {
+        fprintf(stderr, "%llu frames failed, last error %d: '%s'\n",
+                (unsigned long long)benchmark->failed_frames, benchmark->last_failure,
+                sc_context_status_flag_get_message(benchmark->last_failure));
+    }
+
+    FILE *out = stdout;
+    if (output_file != NULL) {
+        out = fopen(output_file, "w");
+        if (out == NULL) {
+            fprintf(stderr, "Could not open '%s': %s\n", output_file, strerror(errno));
+            return_code = -1;
+            goto cleanup;
+        }
+    }
+    const char *settings_name = settings_file != NULL ? settings_file : "default";
+    if (tuner != NULL) {
+        best = tuner_select(tuner, recall_target);
+        write_tune_report_json(out, benchmark, tuner, settings, settings_name, iterations, warmup,
+                               recall_target, best);
+    } else if (round_trip != NULL) {
+        write_round_trip_report_json(out, benchmark, round_trip, settings_name, iterations, warmup);
+    } else if (layouts != NULL) {
+        write_layout_report_json(out, benchmark, layouts, settings_name, images.count, iterations, warmup);
+    } else {
+        write_report_json(out, benchmark, settings_name, images.count, iterations, warmup);
+    }
+    if (out != stdout && tuner != NULL) {
+        fclose(out);
+        printf("%zu candidates on %zu images, report written to '%s'\n", tuner->candidate_count,
+               tuner->image_count, output_file);
+    } else if (out != stdout && round_trip != NULL) {
+        fclose(out);
+        printf("%llu frames, %llu recognized (%.1f%%), report written to '%s'\n",
+               (unsigned long long)benchmark->frames, (unsigned long long)benchmark->frames_with_codes,
+               benchmark->frames > 0 ? 100.0 * benchmark->frames_with_codes / benchmark->frames : 0.0,
+               output_file);
+    } else if (out != stdout && layouts != NULL) {
+        fclose(out);
+        printf("%llu frames in %u layouts, report written to '%s'\n",
+               (unsigned long long)benchmark->frames, LAYOUT_COUNT, output_file);
+    } else if (out != stdout) {
+        fclose(out);
+        const LatencyHistogram *recognition = &benchmark->stages[STAGE_RECOGNITION];
+        printf("%llu frames in %.3f s, recognition p50 %.3f ms, p99 %.3f ms, report written to '%s'\n",
+               (unsigned long long)benchmark->frames, benchmark->wall_seconds,
+               histogram_percentile(recognition, 50.0) * 1e-6,
+               histogram_percentile(recognition, 99.0) * 1e-6, output_file);
+    }
+    if (tuner != NULL && best == tuner->candidate_count) {
+        fprintf(stderr, "No candidate reaches a recall of %.4f.\n", recall_target);
+        return_code = -1;
+    } else if (tuner != NULL) {
+        const TuneCandidate *candidate = &tuner->candidates[best];
+        fprintf(stderr, "Fastest candidate with a recall of at least %.4f: %zu, mean %.3f ms, recall %.4f\n",
+                recall_target, best, tune_candidate_mean_ms(candidate), tune_candidate_recall(candidate));
+        if (tuned_settings_file != NULL &&
+            !write_tuned_settings(tuner, settings, candidate, tuned_settings_file)) {
+            return_code = -1;
+        }
+    }
+
+cleanup:
+    if (benchmark != NULL) {
+        benchmark_teardown(benchmark);
+    }
+    sc_barcode_scanner_settings_release(settings);
+    image_list_free(&images);
+    if (layouts != NULL) {
+        free(layouts->rgb);
+        free(layouts->frame);
+        free(layouts->luma);
+        free(layouts);
+    }
+    if (round_trip != NULL) {
+        round_trip_teardown(round_trip);
+        free(round_trip);
+    }
+    if (tuner != NULL) {
+        tuner_free(tuner);
+        free(tuner);
+    }
+    free(benchmark);
+    IMG_Quit();
+    return return_code;
+}
@@ -14,34 +14,2367 @@
  * Example:
  * ./CommandLineBarcodeScannerCameraSample /dev/video1 640 480
  *
+ * Capturing and scanning run on separate threads. The capture thread always holds
+ * the newest frame. When the scanner is still busy with the previous frame, the
+ * frame that is waiting is given back to the camera and counted as dropped, so that
+ * the scanner always picks up the most recent image and a slow frame never stalls
+ * the capture. All camera calls are made from the capture thread. The scanner hands
+ * the buffers it is done with back to the capture thread.
+ *
+ * With --budget the camera mode is adapted at runtime. A governor compares the time
+ * process_frame takes against the budget (in milliseconds) and steps the resolution
+ * down or up among the modes the camera supports. The framerate follows the rate at
+ * which the scanner can keep up and the camera is reopened with a matching number of
+ * buffers, so that the scan rate stays steady on slow and fast machines alike.
+ *
+ * Example:
+ * ./CommandLineBarcodeScannerCameraSample --budget 40 /dev/video0 1280 720
+ *
+ * With --adaptive-area the code location areas follow the codes. The locations of
+ * recently recognized codes are collected in a decaying heat map, separately for 1d
+ * and 2d codes. The hot parts of the map become the code location areas and most
+ * frames are only scanned there. The full image is still searched every few frames.
+ *
+ * The scanned codes are written by a separate writer thread, so a slow reader on
+ * the other end of a pipe does not hold up the scanning. With --ndjson one JSON
+ * object is written per code, with the symbology, the data, the location, the frame
+ * id and the capture and recognition times. --when-full selects what happens when
+ * the writer falls behind by more than RESULT_RING_SIZE codes: block waits for it,
+ * drop discards the codes and spill appends them to the --spill-file instead. The
+ * spill file is written by a thread of its own, codes that do not fit into its
+ * buffer either are dropped.
+ *
+ * With --skip-static frames of a static scene are not scanned. Every fourth row of
+ * the first image plane (the luma plane for YUV layouts) is compared with the last
+ * scanned frame using SIMD sums of absolute differences. If no tile of the image
+ * differs by more than the given level (mean absolute difference per byte, 4 to 8 is
+ * a good start for most cameras), the frame is given back without scanning. After a
+ * change, --static-hold more frames are scanned in any case.
+ *
+ * Example:
+ * ./CommandLineBarcodeScannerCameraSample --skip-static 6 /dev/video0 1280 720
+ *
+ * Example:
+ * ./CommandLineBarcodeScannerCameraSample --ndjson --when-full spill /dev/video0 | collector
+ *
+ * With --record the captured frames are written to a recording file together with
+ * their image description and capture time, and with --replay a recording is played
+ * back in place of the camera. The frames are replayed at the recorded pace, or with
+ * --replay-pace max as fast as the scanner takes them, without dropping any. This
+ * makes throughput and latency measurements repeatable and possible on machines
+ * without a camera. The recording is mapped into memory and the frames are scanned
+ * in place. Every frame starts at an aligned offset and an index at the end of the
+ * file makes it seekable, a recording that was cut short is still readable.
+ *
+ * Example:
+ * ./CommandLineBarcodeScannerCameraSample --record shift.rec /dev/video0 1280 720
+ * ./CommandLineBarcodeScannerCameraSample --replay shift.rec --replay-pace max
+ *
+ * With --parse the payloads of GS1 data carriers and HIBC codes (data starting with
+ * '+') are split into their fields with the Scandit parser. The writer thread hands
+ * these codes to a parse thread, which writes them together with their fields, so
+ * neither the scan thread nor the writer waits for the parser. Parsed codes may
+ * therefore appear after codes that were found later. Codes that arrive while
+ * PARSE_QUEUE_SIZE codes wait for the parser are written without their fields. The
+ * parsers are created once per format with a recognition context of their own and
+ * the fields of the last PARSE_CACHE_SIZE distinct payloads are kept, so a code that
+ * stays in view for many frames is only parsed once. The fields are printed below the
+ * code, or as a "fields" object with --ndjson.
+ *
+ * Example:
+ * ./CommandLineBarcodeScannerCameraSample --parse gs1,hibc --ndjson /dev/video0
+ *
  * \copyright Copyright (c) 2018 Scandit AG. All rights reserved.
  */
 
-#include <signal.h>
-#include <stdio.h>
-#include <stdlib.h>
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <math.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include <Scandit/ScRecognitionContext.h>
+#include <Scandit/ScBarcodeScanner.h>
+#include <Scandit/ScCamera.h>
+
+#include "FrameRecording.h"
+
+// The parser headers of the SDK package include headers from Scandit/Parser/, which the
+// package does not install. The parser functions used here are declared locally instead.
+typedef int SpBool;
+typedef ScByteArray SpData;
+typedef struct SpOpaqueParser SpParser;
+typedef struct SpOpaqueParserResult SpParserResult;
+typedef struct SpOpaqueField SpField;
+
+typedef enum {
+    SP_PARSER_TYPE_GS1_AI = 1,
+    SP_PARSER_TYPE_HIBC = 2
+} SpParserType;
+
+SpParser *sp_parser_new_with_context(ScRecognitionContext *context, SpParserType type,
+                                     ScContextStatusFlag *status);
+void sp_parser_free(SpParser *parser);
+SpBool sp_parser_parse_string(SpParser *parser, const char *str, size_t length,
+                              SpParserResult **result);
+void sp_parser_result_free(SpParserResult *result);
+SpBool sp_parser_result_is_ok(const SpParserResult *result);
+SpData sp_parser_result_get_error_message(const SpParserResult *result);
+size_t sp_parser_result_get_fields_count(const SpParserResult *result);
+const SpField *sp_parser_result_get_field_by_index(const SpParserResult *result, size_t index);
+SpData sp_field_get_name(const SpField *field);
+SpData sp_field_get_string_value(const SpField *field);
+void sp_data_free(SpData data);
+
+// Please insert your app key here:
+#define SCANDIT_SDK_LICENSE_KEY "-- INSERT YOUR LICENSE KEY HERE --"
+
+// Please insert the desired default camera resolution here:
+#define DEFAULT_RESOLUTION_WIDTH 1280
+#define DEFAULT_RESOLUTION_HEIGHT 720
+
+// Set this define to 1 of you run the demo on a device with slow hardware or no GPU support
+// such as a Raspberry Pi Zero.
+// It disables barcode search and only scans codes in the center image area.
+#define LOW_END_DEVICE_CONFIGURATION 0
+
+// Number of image buffers of the camera. One is held by the scanner, one waits for it.
+#define CAMERA_BUFFER_COUNT 4
+#define MIN_CAMERA_BUFFER_COUNT 2
+#define MAX_CAMERA_BUFFER_COUNT 8
+
+#define MAX_CAMERA_RESOLUTIONS 30
+#define MAX_CAMERA_FRAMERATES 10
+
+// The governor decides once per GOVERNOR_WINDOW frames.
+#define GOVERNOR_WINDOW 30
+// A larger resolution is tried when the 90th percentile of the processing time stayed
+// below this fraction of the budget for GOVERNOR_STEP_UP_WINDOWS windows.
+#define GOVERNOR_STEP_UP_RATIO 0.6f
+#define GOVERNOR_STEP_UP_WINDOWS 3
+// A resolution that exceeded the budget is not tried again for this long.
+#define GOVERNOR_BLOCK_SECONDS 30.0
+
+// Resolution of the heat maps of the adaptive code location area.
+#define HEAT_MAP_SIZE 16
+// Heat that remains after a frame. Codes fade out of the map after a few seconds.
+#define HEAT_MAP_DECAY 0.98f
+// Codes (weighted by their age) needed before the scanner focuses on an area.
+#define HEAT_MAP_MIN_CODES 3.f
+// Cells with at least this fraction of the peak heat belong to the hot area.
+#define HEAT_MAP_HOT_FRACTION 0.2f
+// The areas are recomputed every ADAPTIVE_AREA_UPDATE_INTERVAL frames. Every
+// ADAPTIVE_FULL_SEARCH_INTERVAL frames the whole image is searched.
+#define ADAPTIVE_AREA_UPDATE_INTERVAL 15
+#define ADAPTIVE_FULL_SEARCH_INTERVAL 10
+
+typedef struct LocationHeatMap {
+    float cells[HEAT_MAP_SIZE][HEAT_MAP_SIZE];
+    float total;
+} LocationHeatMap;
+
+/**
+ * Moves the code location areas to where codes were found recently.
+ */
+typedef struct AdaptiveArea {
+    ScBarcodeScannerSettings *settings;
+    ScRectangleF default_area_1d;
+    ScRectangleF default_area_2d;
+    // The configured constraints, used whenever the search is not focused.
+    ScCodeLocationConstraint default_constraint_1d;
+    ScCodeLocationConstraint default_constraint_2d;
+
+    LocationHeatMap heat_1d;
+    LocationHeatMap heat_2d;
+    ScBool hot_1d;
+    ScBool hot_2d;
+    ScRectangleF area_1d;
+    ScRectangleF area_2d;
+
+    ScBool full_search;
+    uint64_t frame_count;
+} AdaptiveArea;
+
+typedef struct CameraConfiguration {
+    ScSize resolution;
+    ScFramerate framerate;
+    // Without a framerate the camera keeps its default.
+    ScBool has_framerate;
+    uint32_t buffer_count;
+} CameraConfiguration;
+
+typedef struct CameraResolution {
+    ScSize size;
+    // Supported framerates, slowest first.
+    ScFramerate framerates[MAX_CAMERA_FRAMERATES];
+    uint32_t framerate_count;
+    double blocked_until;
+} CameraResolution;
+
+/**
+ * Adapts the camera mode to the time the scanner needs per frame.
+ */
+typedef struct Governor {
+    // Supported resolutions, smallest first.
+    CameraResolution resolutions[MAX_CAMERA_RESOLUTIONS];
+    uint32_t resolution_count;
+    uint32_t current;
+    CameraConfiguration configuration;
+
+    float budget_ms;
+    float latencies[GOVERNOR_WINDOW];
+    uint32_t latency_count;
+    uint32_t fast_windows;
+} Governor;
+
+/**
+ * Writes the captured frames into a recording file.
+ */
+typedef struct FrameRecorder {
+    FILE *file;
+    uint64_t offset;
+    uint64_t *index;
+    uint64_t frame_count;
+    uint64_t index_capacity;
+    double first_capture_time;
+    ScBool failed;
+} FrameRecorder;
+
+/**
+ * Plays back a recording in place of the camera. The recording is mapped into
+ * memory and the frames are handed out without copying.
+ */
+typedef struct FrameReplay {
+    const uint8_t *data;
+    size_t size;
+    // Offsets of the frame records.
+    uint64_t *offsets;
+    uint64_t frame_count;
+    uint64_t next_frame;
+    // Frames are handed out at the recorded pace, otherwise as fast as they are taken.
+    ScBool realtime;
+    double start_time;
+} FrameReplay;
+
+/**
+ * Hand-over between the capture thread and the scan thread. It holds at most one
+ * frame, the newest one.
+ */
+typedef struct FrameExchange {
+    // Exactly one of camera and replay is set.
+    ScCamera *camera;
+    FrameReplay *replay;
+    // NULL if the captured frames are not recorded.
+    FrameRecorder *recorder;
+    // NULL if the camera was detected automatically.
+    const char *device_path;
+    CameraConfiguration configuration;
+
+    pthread_mutex_t lock;
+    pthread_cond_t frame_available;
+    pthread_cond_t frame_returned;
+
+    // The newest frame that has not been taken by the scanner yet.
+    const uint8_t *pending_frame;
+    ScImageDescription *pending_descr;
+    double pending_capture_time;
+
+    // The frame the scanner is working on.
+    const uint8_t *scanner_frame;
+    // Buffers the scanner is done with. They are re-queued by the capture thread.
+    const uint8_t *returned_frames[MAX_CAMERA_BUFFER_COUNT];
+    uint32_t returned_count;
+
+    ScBool reconfigure_requested;
+    CameraConfiguration requested_configuration;
+
+    ScBool capture_running;
+
+    uint64_t captured_count;
+    uint64_t dropped_count;
+} FrameExchange;
+
+// Results the scan thread can hand to the writer thread without waiting.
+// Must be a power of two.
+#define RESULT_RING_SIZE 1024
+// Barcode data up to this length is copied into the ring, longer data is allocated.
+#define RESULT_INLINE_DATA_SIZE 240
+// The writer collects output lines in a buffer of this size and writes them at once.
+#define RESULT_WRITE_BUFFER_SIZE (64 * 1024)
+#define DEFAULT_SPILL_PATH "/tmp/scandit-results.spill"
+
+typedef enum ResultSinkPolicy {
+    // The scan thread waits for the writer.
+    RESULT_SINK_BLOCK,
+    // Results that do not fit into the ring are counted and discarded.
+    RESULT_SINK_DROP,
+    // Results that do not fit into the ring are appended to the spill file.
+    RESULT_SINK_SPILL
+} ResultSinkPolicy;
+
+typedef struct ResultRecord {
+    uint32_t frame_id;
+    ScSymbology symbology;
+    ScQuadrilateral location;
+    // Unix time in seconds.
+    double capture_time;
+    double recognition_time;
+    ScBool gs1_data_carrier;
+    uint32_t data_length;
+    // NULL if the data fits into the record.
+    char *long_data;
+    char data[RESULT_INLINE_DATA_SIZE];
+} ResultRecord;
+
+typedef struct LineBuffer {
+    FILE *file;
+    size_t length;
+    // End of the last complete line. A full buffer is only written up to here, so that
+    // the lines of the writer and the parse thread do not mix on the same stream.
+    size_t line_end;
+    char text[RESULT_WRITE_BUFFER_SIZE];
+} LineBuffer;
+
+// The parse stage keeps the fields of this many distinct payloads.
+#define PARSE_CACHE_SIZE 256
+// Codes that can wait for the parse thread. Must be a power of two.
+#define PARSE_QUEUE_SIZE 256
+// Must be a power of two.
+#define PARSE_CACHE_BUCKETS 512
+
+typedef enum ParseFormat {
+    PARSE_FORMAT_GS1,
+    PARSE_FORMAT_HIBC,
+    PARSE_FORMAT_COUNT
+} ParseFormat;
+
+typedef struct ParseFormatInfo {
+    const char *name;
+    SpParserType type;
+} ParseFormatInfo;
+
+static const ParseFormatInfo PARSE_FORMATS[PARSE_FORMAT_COUNT] = {
+    { "gs1", SP_PARSER_TYPE_GS1_AI },
+    { "hibc", SP_PARSER_TYPE_HIBC }
+};
+
+typedef struct ParseCacheEntry {
+    uint64_t hash;
+    ParseFormat format;
+    char *payload;
+    uint32_t payload_length;
+    // The fields formatted for the output, ready to be appended to the line.
+    char *fields;
+    size_t fields_length;
+    // Entry indices in the least recently used list and the bucket chain, -1 at the end.
+    int32_t newer;
+    int32_t older;
+    int32_t next_in_bucket;
+} ParseCacheEntry;
+
+/**
+ * Splits payloads into their fields on a parse thread of its own. The writer thread
+ * queues the codes that have to be parsed and the parse thread writes them, so a slow
+ * parse never holds up the result ring. The parsers are created with their own
+ * recognition context on the main thread and are only used by the parse thread after
+ * that. The formatted fields of recent payloads are kept in a least recently used
+ * cache, a hash table chained through the entries.
+ */
+typedef struct ParseStage {
+    // Not the context of the scanner, which is only used by the scan thread.
+    ScRecognitionContext *context;
+    SpParser *parsers[PARSE_FORMAT_COUNT];
+    ScBool ndjson;
+
+    // Written by the writer thread, read by the parse thread.
+    ResultRecord queue[PARSE_QUEUE_SIZE];
+    uint32_t queue_head;
+    uint32_t queue_tail;
+    pthread_t thread;
+    ScBool thread_started;
+    pthread_mutex_t lock;
+    pthread_cond_t records_available;
+    ScBool closing;
+    // Counted by the writer thread.
+    uint64_t skipped_count;
+
+    // Everything below is owned by the parse thread.
+    LineBuffer output;
+    ParseCacheEntry entries[PARSE_CACHE_SIZE];
+    int32_t buckets[PARSE_CACHE_BUCKETS];
+    int32_t newest;
+    int32_t oldest;
+    uint32_t entry_count;
+    // Collects the fields of the payload that is being parsed.
+    LineBuffer scratch;
+
+    uint64_t parsed_count;
+    uint64_t cache_hit_count;
+    uint64_t failed_count;
+} ParseStage;
+
+/**
+ * Takes the results off the scan thread. The scan thread puts them into a single
+ * producer, single consumer ring and a writer thread formats and writes them in
+ * batches, so a slow reader of the output does not slow down scanning. The lock is
+ * only taken when one of the threads has to wait for the other.
+ */
+typedef struct ResultSink {
+    ResultRecord records[RESULT_RING_SIZE];
+    // Only written by the scan thread.
+    uint32_t head;
+    // Only written by the writer thread.
+    uint32_t tail;
+
+    ResultSinkPolicy policy;
+    ScBool ndjson;
+    LineBuffer output;
+    // Spilled results are formatted by the scan thread into spill_scratch and moved to
+    // spill_pending, which the spill thread writes to the spill file. The scan thread
+    // never touches the file. Results that do not fit into spill_pending are dropped.
+    LineBuffer spill_scratch;
+    LineBuffer spill_pending;
+    uint64_t spill_pending_count;
+    // Owned by the spill thread, opened when the first result is spilled.
+    LineBuffer spill;
+    const char *spill_path;
+    pthread_t spill_thread;
+    ScBool spill_thread_started;
+    pthread_mutex_t spill_lock;
+    pthread_cond_t spill_available;
+    ScBool spill_closing;
+    // Set by the spill thread if the spill file can not be opened.
+    ScBool spill_failed;
+    // NULL if the codes are not parsed. Spilled codes are never parsed.
+    ParseStage *parse_stage;
+
+    pthread_mutex_t lock;
+    pthread_cond_t space_available;
+    pthread_cond_t records_available;
+    ScBool scanner_waiting;
+    ScBool writer_waiting;
+    ScBool closing;
+
+    uint64_t written_count;
+    uint64_t dropped_count;
+    uint64_t spilled_count;
+    // Counted by the spill thread.
+    uint64_t spill_lost_count;
+    uint64_t blocked_count;
+} ResultSink;
+
+// The static scene filter compares every STATIC_ROW_STEP-th row of the first image
+// plane with the last scanned frame. The compared rows are divided into tiles of
+// STATIC_TILE_COLUMNS columns and STATIC_TILE_ROWS compared rows each, so that a small
+// change is not averaged away over the whole image.
+#define STATIC_ROW_STEP 4
+#define STATIC_TILE_COLUMNS 16
+#define STATIC_TILE_ROWS 8
+// Frames that are scanned after a change, while a code may still be moving.
+#define DEFAULT_STATIC_HOLD_FRAMES 10
+
+typedef uint32_t (*SadFunction)(const uint8_t *a, const uint8_t *b, size_t length);
+
+/**
+ * Skips frames that do not differ from the last scanned frame.
+ */
+typedef struct StaticSceneFilter {
+    // Mean absolute difference per byte above which a tile has changed.
+    float threshold;
+    uint32_t hold_frames;
+    uint32_t hold_remaining;
+    SadFunction sad;
+
+    // Geometry of the reference frame.
+    uint32_t width;
+    uint32_t height;
+    ScImageLayout layout;
+    // Compared bytes per row and tile, a multiple of 32.
+    size_t tile_bytes;
+    uint32_t row_count;
+    // The compared rows of the last scanned frame, row_count * STATIC_TILE_COLUMNS * tile_bytes.
+    uint8_t *reference;
+    ScBool has_reference;
+
+    uint64_t processed_count;
+    uint64_t skipped_count;
+} StaticSceneFilter;
+
+static volatile ScBool process_frames;
+
+static void catch_exit(int signo) {
+    printf("SIGINT received.\n");
+    process_frames = SC_FALSE;
+}
+
+static double now_seconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+/**
+ * Gives the buffers the scanner has returned back to the camera. Must be called with
+ * the lock held.
+ */
+static void frame_exchange_requeue_returned(FrameExchange *exchange)
+{
+    if (exchange->camera == NULL) {
+        // Replayed frames stay in the mapped recording.
+        exchange->returned_count = 0;
+        return;
+    }
+    for (uint32_t i = 0; i < exchange->returned_count; ++i) {
+        sc_camera_enqueue_frame_data(exchange->camera, exchange->returned_frames[i]);
+    }
+    exchange->returned_count = 0;
+}
+
+static int compare_floats(const void *lhs, const void *rhs)
+{
+    const float a = *(const float *)lhs;
+    const float b = *(const float *)rhs;
+    return (a > b) - (a < b);
+}
+
+static int compare_resolutions(const void *lhs, const void *rhs)
+{
+    const CameraResolution *a = lhs;
+    const CameraResolution *b = rhs;
+    const uint64_t a_pixels = (uint64_t)a->size.width * a->size.height;
+    const uint64_t b_pixels = (uint64_t)b->size.width * b->size.height;
+    return (a_pixels > b_pixels) - (a_pixels < b_pixels);
+}
+
+static int compare_framerates(const void *lhs, const void *rhs)
+{
+    const float a = sc_framerate_get_fps((const ScFramerate *)lhs);
+    const float b = sc_framerate_get_fps((const ScFramerate *)rhs);
+    return (a > b) - (a < b);
+}
+
+static ScBool framerates_equal(ScFramerate a, ScFramerate b)
+{
+    return (uint64_t)a.numerator * b.denominator == (uint64_t)b.numerator * a.denominator;
+}
+
+static void governor_add_resolution(Governor *governor, const ScCamera *camera, ScSize size)
+{
+    if (governor->resolution_count == MAX_CAMERA_RESOLUTIONS) {
+        return;
+    }
+    CameraResolution *resolution = &governor->resolutions[governor->resolution_count++];
+    memset(resolution, 0, sizeof(CameraResolution));
+    resolution->size = size;
+
+    ScStepwiseFramerate stepwise;
+    switch (sc_camera_get_framerate_mode(camera)) {
+        case SC_CAMERA_MODE_DISCRETE: {
+            const int32_t found = sc_camera_query_supported_framerates(
+                    camera, size, resolution->framerates, MAX_CAMERA_FRAMERATES);
+            resolution->framerate_count = found > 0 ? found : 0;
+            break;
+        }
+        case SC_CAMERA_MODE_STEPWISE:
+            // The end points of the range are enough to pick from.
+            if (sc_camera_query_supported_framerates_stepwise(camera, size, &stepwise)) {
+                resolution->framerates[resolution->framerate_count++] = stepwise.min;
+                if (!framerates_equal(stepwise.min, stepwise.max)) {
+                    resolution->framerates[resolution->framerate_count++] = stepwise.max;
+                }
+            }
+            break;
+        default:
+            // The framerate is left to the camera.
+            break;
+    }
+    qsort(resolution->framerates, resolution->framerate_count, sizeof(ScFramerate),
+          compare_framerates);
+}
+
+/**
+ * Collects the modes the camera supports, ordered from the smallest to the largest
+ * resolution. The governor starts at the given resolution.
+ */
+static ScBool governor_init(Governor *governor, const ScCamera *camera, ScSize initial_resolution,
+                            uint32_t initial_buffer_count, float budget_ms)
+{
+    memset(governor, 0, sizeof(Governor));
+    governor->budget_ms = budget_ms;
+
+    ScSize sizes[MAX_CAMERA_RESOLUTIONS];
+    ScStepwiseResolution stepwise;
+    switch (sc_camera_get_resolution_mode(camera)) {
+        case SC_CAMERA_MODE_DISCRETE: {
+            const int32_t found = sc_camera_query_supported_resolutions(camera, sizes,
+                                                                        MAX_CAMERA_RESOLUTIONS);
+            for (int32_t i = 0; i < found; ++i) {
+                governor_add_resolution(governor, camera, sizes[i]);
+            }
+            break;
+        }
+        case SC_CAMERA_MODE_STEPWISE: {
+            // Common sizes are picked from the range. The initial resolution is always included.
+            static const ScSize candidates[] = {
+                { 320, 240 }, { 640, 360 }, { 640, 480 }, { 800, 600 }, { 960, 540 },
+                { 1280, 720 }, { 1600, 900 }, { 1920, 1080 }, { 2560, 1440 }, { 3840, 2160 }
+            };
+            if (!sc_camera_query_supported_resolutions_stepwise(camera, &stepwise)) {
+                break;
+            }
+            for (size_t i = 0; i < sizeof(candidates) / sizeof(candidates[0]); ++i) {
+                const ScSize size = candidates[i];
+                if (size.width >= stepwise.min_width && size.width <= stepwise.max_width &&
+                    size.height >= stepwise.min_height && size.height <= stepwise.max_height &&
+                    size.width % stepwise.step_width == 0 && size.height % stepwise.step_height == 0 &&
+                    (size.width != initial_resolution.width ||
+                     size.height != initial_resolution.height)) {
+                    governor_add_resolution(governor, camera, size);
+                }
+            }
+            governor_add_resolution(governor, camera, initial_resolution);
+            break;
+        }
+        default:
+            break;
+    }
+    qsort(governor->resolutions, governor->resolution_count, sizeof(CameraResolution),
+          compare_resolutions);
+
+    for (uint32_t i = 0; i < governor->resolution_count; ++i) {
+        if (governor->resolutions[i].size.width == initial_resolution.width &&
+            governor->resolutions[i].size.height == initial_resolution.height) {
+            governor->current = i;
+            governor->configuration.resolution = initial_resolution;
+            governor->configuration.buffer_count = initial_buffer_count;
+            return SC_TRUE;
+        }
+    }
+    return SC_FALSE;
+}
+
+/**
+ * Records the processing time of a frame. After every GOVERNOR_WINDOW frames the
+ * 90th percentile is compared against the budget:
+ *
+ * - above the budget the next smaller resolution is used. The resolution that was too
+ *   slow is not tried again for GOVERNOR_BLOCK_SECONDS.
+ * - well below the budget for GOVERNOR_STEP_UP_WINDOWS windows in a row the next
+ *   larger resolution is used.
+ *
+ * The framerate is then set to the lowest one that still delivers frames as fast as
+ * the scanner processes them, since faster capturing only produces dropped frames.
+ * The number of buffers covers the frames that arrive while one frame is processed.
+ *
+ * \returns SC_TRUE if the camera should be switched to *next.
+ */
+static ScBool governor_update(Governor *governor, float latency_ms, CameraConfiguration *next)
+{
+    governor->latencies[governor->latency_count++] = latency_ms;
+    if (governor->latency_count < GOVERNOR_WINDOW) {
+        return SC_FALSE;
+    }
+    governor->latency_count = 0;
+    qsort(governor->latencies, GOVERNOR_WINDOW, sizeof(float), compare_floats);
+    const float p90_ms = governor->latencies[GOVERNOR_WINDOW * 9 / 10];
+
+    const double now = now_seconds();
+    uint32_t index = governor->current;
+    if (p90_ms > governor->budget_ms) {
+        governor->fast_windows = 0;
+        if (index > 0) {
+            governor->resolutions[index].blocked_until = now + GOVERNOR_BLOCK_SECONDS;
+            index--;
+        }
+    } else if (p90_ms < governor->budget_ms * GOVERNOR_STEP_UP_RATIO) {
+        governor->fast_windows++;
+        if (governor->fast_windows >= GOVERNOR_STEP_UP_WINDOWS &&
+            index + 1 < governor->resolution_count &&
+            governor->resolutions[index + 1].blocked_until <= now) {
+            governor->fast_windows = 0;
+            index++;
+        }
+    } else {
+        governor->fast_windows = 0;
+    }
+
+    // Processing time grows roughly with the number of pixels.
+    const CameraResolution *resolution = &governor->resolutions[index];
+    const CameraResolution *current = &governor->resolutions[governor->current];
+    const float expected_ms = p90_ms * ((float)resolution->size.width * resolution->size.height) /
+                              ((float)current->size.width * current->size.height);
+    const float scan_fps = expected_ms > 0.f ? 1000.f / expected_ms : 1000.f;
+
+    *next = governor->configuration;
+    next->resolution = resolution->size;
+    float frame_interval_ms = 1000.f / 30.f;
+    if (resolution->framerate_count > 0) {
+        uint32_t choice = resolution->framerate_count - 1;
+        for (uint32_t i = 0; i < resolution->framerate_count; ++i) {
+            if (sc_framerate_get_fps(&resolution->framerates[i]) >= scan_fps) {
+                choice = i;
+                break;
+            }
+        }
+        next->framerate = resolution->framerates[choice];
+        next->has_framerate = SC_TRUE;
+        frame_interval_ms = sc_framerate_get_frame_interval(&next->framerate) * 1000.f;
+    }
+    uint32_t buffer_count = (uint32_t)ceilf(expected_ms / frame_interval_ms) + 2;
+    if (buffer_count < MIN_CAMERA_BUFFER_COUNT) {
+        buffer_count = MIN_CAMERA_BUFFER_COUNT;
+    } else if (buffer_count > MAX_CAMERA_BUFFER_COUNT) {
+        buffer_count = MAX_CAMERA_BUFFER_COUNT;
+    }
+    next->buffer_count = buffer_count;
+
+    const CameraConfiguration *configured = &governor->configuration;
+    const ScBool changed = index != governor->current ||
+                           next->buffer_count != configured->buffer_count ||
+                           next->has_framerate != configured->has_framerate ||
+                           (next->has_framerate &&
+                            !framerates_equal(next->framerate, configured->framerate));
+    if (changed) {
+        printf("Governor: p90 %.1f ms (budget %.1f ms), switching to %ux%u @ %.1f FPS with %u buffers\n",
+               p90_ms, governor->budget_ms, next->resolution.width, next->resolution.height,
+               next->has_framerate ? sc_framerate_get_fps(&next->framerate) : 0.f,
+               next->buffer_count);
+        governor->current = index;
+        governor->configuration = *next;
+    }
+    return changed;
+}
+
+/**
+ * Writes the padding up to the next aligned offset and then the data.
+ */
+static ScBool frame_recorder_write(FrameRecorder *recorder, const void *data, size_t size)
+{
+    static const uint8_t padding[RECORDING_ALIGNMENT];
+    const uint64_t aligned = recording_align(recorder->offset);
+    if (fwrite(padding, 1, aligned - recorder->offset, recorder->file) != aligned - recorder->offset ||
+        fwrite(data, 1, size, recorder->file) != size) {
+        return SC_FALSE;
+    }
+    recorder->offset = aligned + size;
+    return SC_TRUE;
+}
+
+static FrameRecorder *frame_recorder_open(const char *path)
+{
+    FrameRecorder *recorder = calloc(1, sizeof(FrameRecorder));
+    if (recorder == NULL) {
+        return NULL;
+    }
+    recorder->file = fopen(path, "wb");
+    if (recorder->file == NULL) {
+        free(recorder);
+        return NULL;
+    }
+    RecordingHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, RECORDING_MAGIC, sizeof(header.magic));
+    header.version = RECORDING_VERSION;
+    header.alignment = RECORDING_ALIGNMENT;
+    if (!frame_recorder_write(recorder, &header, sizeof(header))) {
+        fclose(recorder->file);
+        free(recorder);
+        return NULL;
+    }
+    return recorder;
+}
+
+/**
+ * Appends a frame to the recording. After a write error the recorder stops recording.
+ */
+static void frame_recorder_add(FrameRecorder *recorder, const ScImageDescription *image_descr,
+                               const uint8_t *frame, double capture_time)
+{
+    if (recorder->failed) {
+        return;
+    }
+    if (recorder->frame_count == recorder->index_capacity) {
+        const uint64_t capacity = recorder->index_capacity > 0 ? recorder->index_capacity * 2 : 1024;
+        uint64_t *index = realloc(recorder->index, capacity * sizeof(uint64_t));
+        if (index == NULL) {
+            recorder->failed = SC_TRUE;
+            return;
+        }
+        recorder->index = index;
+        recorder->index_capacity = capacity;
+    }
+    if (recorder->frame_count == 0) {
+        recorder->first_capture_time = capture_time;
+    }
+
+    FrameRecord record;
+    memset(&record, 0, sizeof(record));
+    record.layout = sc_image_description_get_layout(image_descr);
+    record.width = sc_image_description_get_width(image_descr);
+    record.height = sc_image_description_get_height(image_descr);
+    record.first_plane_offset = sc_image_description_get_first_plane_offset(image_descr);
+    record.first_plane_row_bytes = sc_image_description_get_first_plane_row_bytes(image_descr);
+    record.second_plane_offset = sc_image_description_get_second_plane_offset(image_descr);
+    record.second_plane_row_bytes = sc_image_description_get_second_plane_row_bytes(image_descr);
+    record.memory_size = sc_image_description_get_memory_size(image_descr);
+    record.capture_time_ns = (uint64_t)((capture_time - recorder->first_capture_time) * 1e9);
+    struct timespec wall_time;
+    clock_gettime(CLOCK_REALTIME, &wall_time);
+    record.wall_time_ns = (uint64_t)wall_time.tv_sec * 1000000000ull + (uint64_t)wall_time.tv_nsec;
+    record.sequence = recorder->frame_count;
+
+    const uint64_t record_offset = recording_align(recorder->offset);
+    if (!frame_recorder_write(recorder, &record, sizeof(record)) ||
+        !frame_recorder_write(recorder, frame, record.memory_size)) {
+        printf("Writing the recording failed, recording stopped.\n");
+        recorder->failed = SC_TRUE;
+        return;
+    }
+    recorder->index[recorder->frame_count++] = record_offset;
+}
+
+/**
+ * Writes the index and the final header and closes the recording.
+ */
+static ScBool frame_recorder_close(FrameRecorder *recorder)
+{
+    RecordingHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, RECORDING_MAGIC, sizeof(header.magic));
+    header.version = RECORDING_VERSION;
+    header.alignment = RECORDING_ALIGNMENT;
+    header.frame_count = recorder->frame_count;
+    header.index_offset = recording_align(recorder->offset);
+
+    // After a failed write the file may end in a partial record.
+    ScBool written = fseeko(recorder->file, (off_t)recorder->offset, SEEK_SET) == 0 &&
+                     frame_recorder_write(recorder, recorder->index,
+                                          recorder->frame_count * sizeof(uint64_t)) &&
+                     fseek(recorder->file, 0, SEEK_SET) == 0 &&
+                     fwrite(&header, sizeof(header), 1, recorder->file) == 1;
+    written = fclose(recorder->file) == 0 && written;
+    printf("Recorded %llu frames.\n", (unsigned long long)recorder->frame_count);
+    free(recorder->index);
+    free(recorder);
+    return written;
+}
+
+static void frame_replay_close(FrameReplay *replay)
+{
+    if (replay == NULL) {
+        return;
+    }
+    munmap((void *)replay->data, replay->size);
+    free(replay->offsets);
+    free(replay);
+}
+
+/**
+ * Maps a recording and reads its index. The records of a recording that was not closed
+ * properly are found by walking the file.
+ */
+static FrameReplay *frame_replay_open(const char *path, ScBool realtime)
+{
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        printf("Could not open the recording '%s': %s\n", path, strerror(errno));
+        return NULL;
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || (size_t)file_stat.st_size < sizeof(RecordingHeader)) {
+        printf("'%s' is not a frame recording.\n", path);
+        close(fd);
+        return NULL;
+    }
+    void *data = mmap(NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        printf("Could not map the recording '%s': %s\n", path, strerror(errno));
+        return NULL;
+    }
+    // The frames are read once from start to end.
+    madvise(data, file_stat.st_size, MADV_SEQUENTIAL);
+
+    FrameReplay *replay = calloc(1, sizeof(FrameReplay));
+    if (replay == NULL) {
+        munmap(data, file_stat.st_size);
+        return NULL;
+    }
+    replay->data = data;
+    replay->size = file_stat.st_size;
+    replay->realtime = realtime;
+
+    const RecordingHeader *header = data;
+    if (memcmp(header->magic, RECORDING_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != RECORDING_VERSION || header->alignment != RECORDING_ALIGNMENT) {
+        printf("'%s' is not a frame recording of version %d.\n", path, RECORDING_VERSION);
+        frame_replay_close(replay);
+        return NULL;
+    }
+
+    if (header->index_offset != 0) {
+        if (header->index_offset > replay->size ||
+            (replay->size - header->index_offset) / sizeof(uint64_t) < header->frame_count) {
+            printf("The index of the recording '%s' is damaged.\n", path);
+            frame_replay_close(replay);
+            return NULL;
+        }
+        replay->frame_count = header->frame_count;
+        replay->offsets = malloc((header->frame_count + 1) * sizeof(uint64_t));
+        if (replay->offsets != NULL) {
+            memcpy(replay->offsets, replay->data + header->index_offset,
+                   header->frame_count * sizeof(uint64_t));
+        }
+    } else {
+        uint64_t capacity = 1024;
+        replay->offsets = malloc(capacity * sizeof(uint64_t));
+        uint64_t offset = recording_align(sizeof(RecordingHeader));
+        uint64_t end;
+        while (replay->offsets != NULL &&
+               (end = frame_record_end(replay->data, replay->size, offset)) != 0) {
+            if (replay->frame_count == capacity) {
+                capacity *= 2;
+                uint64_t *offsets = realloc(replay->offsets, capacity * sizeof(uint64_t));
+                if (offsets == NULL) {
+                    break;
+                }
+                replay->offsets = offsets;
+            }
+            replay->offsets[replay->frame_count++] = offset;
+            offset = recording_align(end);
+        }
+        printf("The recording '%s' was not closed properly, %llu complete frames found.\n",
+               path, (unsigned long long)replay->frame_count);
+    }
+    if (replay->offsets == NULL) {
+        frame_replay_close(replay);
+        return NULL;
+    }
+    for (uint64_t i = 0; i < replay->frame_count; ++i) {
+        if (frame_record_end(replay->data, replay->size, replay->offsets[i]) == 0) {
+            printf("Frame %llu of the recording '%s' is damaged.\n", (unsigned long long)i, path);
+            frame_replay_close(replay);
+            return NULL;
+        }
+    }
+    return replay;
+}
+
+/**
+ * Returns the next frame of the recording and fills the image description. In real
+ * time mode this waits until the frame is due.
+ *
+ * \returns the frame data or NULL at the end of the recording.
+ */
+static const uint8_t *frame_replay_next(FrameReplay *replay, ScImageDescription *image_descr)
+{
+    if (replay->next_frame == replay->frame_count) {
+        return NULL;
+    }
+    const uint64_t offset = replay->offsets[replay->next_frame++];
+    const FrameRecord *record = (const FrameRecord *)(replay->data + offset);
+
+    if (replay->realtime) {
+        if (replay->next_frame == 1) {
+            replay->start_time = now_seconds();
+        }
+        const double due = replay->start_time + record->capture_time_ns * 1e-9;
+        const double wait = due - now_seconds();
+        if (wait > 0.0) {
+            struct timespec delay = { (time_t)wait, (long)((wait - (time_t)wait) * 1e9) };
+            nanosleep(&delay, NULL);
+        }
+    }
+
+    sc_image_description_set_layout(image_descr, (ScImageLayout)record->layout);
+    sc_image_description_set_width(image_descr, record->width);
+    sc_image_description_set_height(image_descr, record->height);
+    sc_image_description_set_first_plane_offset(image_descr, record->first_plane_offset);
+    sc_image_description_set_first_plane_row_bytes(image_descr, record->first_plane_row_bytes);
+    sc_image_description_set_second_plane_offset(image_descr, record->second_plane_offset);
+    sc_image_description_set_second_plane_row_bytes(image_descr, record->second_plane_row_bytes);
+    sc_image_description_set_memory_size(image_descr, record->memory_size);
+    return replay->data + recording_align(offset + sizeof(FrameRecord));
+}
+
+/**
+ * Opens and starts the camera in the given configuration.
+ */
+static ScCamera *open_camera(const char *device_path, const CameraConfiguration *configuration)
+{
+    ScCamera *camera = device_path != NULL ?
+                       sc_camera_new_from_path(device_path, configuration->buffer_count) :
+                       sc_camera_new_with_buffer_count(configuration->buffer_count);
+    if (camera == NULL) {
+        return NULL;
+    }
+    if (!sc_camera_request_resolution(camera, configuration->resolution) ||
+        (configuration->has_framerate &&
+         !sc_camera_request_framerate(camera, configuration->framerate)) ||
+        !sc_camera_start_stream(camera)) {
+        sc_camera_release(camera);
+        return NULL;
+    }
+    return camera;
+}
+
+/**
+ * Switches the camera to the requested configuration. The buffer count is fixed when
+ * a camera is created, so the camera is opened again. Waits until the scanner has
+ * returned its frame, no buffer of the old camera may be in use.
+ *
+ * \returns SC_FALSE if the camera could not be opened again.
+ */
+static ScBool frame_exchange_reconfigure(FrameExchange *exchange)
+{
+    pthread_mutex_lock(&exchange->lock);
+    exchange->pending_frame = NULL;
+    while (exchange->scanner_frame != NULL) {
+        pthread_cond_wait(&exchange->frame_returned, &exchange->lock);
+    }
+    exchange->returned_count = 0;
+    const CameraConfiguration configuration = exchange->requested_configuration;
+    exchange->reconfigure_requested = SC_FALSE;
+    pthread_mutex_unlock(&exchange->lock);
+
+    sc_camera_stop_stream(exchange->camera);
+    sc_camera_release(exchange->camera);
+
+    exchange->camera = open_camera(exchange->device_path, &configuration);
+    if (exchange->camera != NULL) {
+        exchange->configuration = configuration;
+        return SC_TRUE;
+    }
+    printf("Switching the camera mode failed, going back to the previous mode.\n");
+    exchange->camera = open_camera(exchange->device_path, &exchange->configuration);
+    return exchange->camera != NULL;
+}
+
+/**
+ * Asks the capture thread to switch the camera to a new configuration.
+ */
+static void frame_exchange_request_configuration(FrameExchange *exchange,
+                                                 const CameraConfiguration *configuration)
+{
+    pthread_mutex_lock(&exchange->lock);
+    exchange->requested_configuration = *configuration;
+    exchange->reconfigure_requested = SC_TRUE;
+    pthread_mutex_unlock(&exchange->lock);
+}
+
+static void *capture_thread_run(void *argument)
+{
+    FrameExchange *exchange = argument;
+    ScImageDescription *capture_descr = sc_image_description_new();
+
+    while (process_frames) {
+        pthread_mutex_lock(&exchange->lock);
+        const ScBool reconfigure = exchange->reconfigure_requested;
+        pthread_mutex_unlock(&exchange->lock);
+        if (reconfigure && !frame_exchange_reconfigure(exchange)) {
+            printf("Could not open the camera again. Exiting.\n");
+            break;
+        }
+
+        // Blocks until the camera delivers the next frame.
+        const uint8_t *frame = exchange->replay != NULL ?
+                               frame_replay_next(exchange->replay, capture_descr) :
+                               sc_camera_get_frame(exchange->camera, capture_descr);
+        const double capture_time = now_seconds();
+        if (frame == NULL) {
+            printf(exchange->replay != NULL ? "End of the recording.\n" : "Frame access failed. Exiting.\n");
+            break;
+        }
+        if (exchange->recorder != NULL) {
+            frame_recorder_add(exchange->recorder, capture_descr, frame, capture_time);
+        }
+
+        pthread_mutex_lock(&exchange->lock);
+        exchange->captured_count++;
+        if (exchange->replay != NULL && !exchange->replay->realtime) {
+            // Replaying as fast as possible: every frame is scanned, none is dropped.
+            while (exchange->pending_frame != NULL && process_frames) {
+                pthread_cond_wait(&exchange->frame_returned, &exchange->lock);
+            }
+        }
+        if (exchange->pending_frame != NULL) {
+            // The scanner did not pick up the previous frame in time. It is stale now.
+            if (exchange->camera != NULL) {
+                sc_camera_enqueue_frame_data(exchange->camera, exchange->pending_frame);
+            }
+            exchange->dropped_count++;
+        }
+        frame_exchange_requeue_returned(exchange);
+
+        // The description of the new frame becomes the pending one. The old pending
+        // description is reused for the next capture.
+        ScImageDescription *descr = exchange->pending_descr;
+        exchange->pending_descr = capture_descr;
+        capture_descr = descr;
+        exchange->pending_frame = frame;
+        exchange->pending_capture_time = capture_time;
+        pthread_cond_signal(&exchange->frame_available);
+        pthread_mutex_unlock(&exchange->lock);
+    }
+
+    pthread_mutex_lock(&exchange->lock);
+    exchange->capture_running = SC_FALSE;
+    pthread_cond_signal(&exchange->frame_available);
+    pthread_mutex_unlock(&exchange->lock);
+
+    sc_image_description_release(capture_descr);
+    return NULL;
+}
+
+/**
+ * Waits for the newest frame. The description of the frame is swapped into
+ * *image_descr.
+ *
+ * \returns the frame data or NULL when capturing has stopped.
+ */
+static const uint8_t *frame_exchange_take(FrameExchange *exchange, ScImageDescription **image_descr,
+                                          double *capture_time)
+{
+    pthread_mutex_lock(&exchange->lock);
+    while (exchange->pending_frame == NULL && exchange->capture_running) {
+        pthread_cond_wait(&exchange->frame_available, &exchange->lock);
+    }
+    const uint8_t *frame = exchange->pending_frame;
+    if (frame != NULL) {
+        ScImageDescription *descr = exchange->pending_descr;
+        exchange->pending_descr = *image_descr;
+        *image_descr = descr;
+        *capture_time = exchange->pending_capture_time;
+        exchange->pending_frame = NULL;
+        exchange->scanner_frame = frame;
+    }
+    pthread_mutex_unlock(&exchange->lock);
+    return frame;
+}
+
+/**
+ * Hands a scanned buffer back to the capture thread.
+ */
+static void frame_exchange_return(FrameExchange *exchange, const uint8_t *frame)
+{
+    pthread_mutex_lock(&exchange->lock);
+    if (exchange->capture_running) {
+        exchange->returned_frames[exchange->returned_count++] = frame;
+    }
+    exchange->scanner_frame = NULL;
+    pthread_cond_signal(&exchange->frame_returned);
+    pthread_mutex_unlock(&exchange->lock);
+}
+
+static double wall_seconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+/**
+ * Writes the first length bytes of the buffer and keeps the rest.
+ */
+static void line_buffer_write(LineBuffer *buffer, size_t length)
+{
+    if (length > 0 && buffer->file != NULL) {
+        // Keeps the lines together with the output of other threads to the same stream.
+        flockfile(buffer->file);
+        fwrite(buffer->text, 1, length, buffer->file);
+        fflush(buffer->file);
+        funlockfile(buffer->file);
+    }
+    memmove(buffer->text, buffer->text + length, buffer->length - length);
+    buffer->length -= length;
+    buffer->line_end = 0;
+}
+
+static void line_buffer_flush(LineBuffer *buffer)
+{
+    line_buffer_write(buffer, buffer->length);
+}
+
+static void line_buffer_end_line(LineBuffer *buffer)
+{
+    buffer->line_end = buffer->length;
+}
+
+static void line_buffer_append(LineBuffer *buffer, const char *text, size_t length)
+{
+    while (length > 0) {
+        if (buffer->length == RESULT_WRITE_BUFFER_SIZE) {
+            if (buffer->file == NULL) {
+                // A buffer without a file only collects up to its size.
+                return;
+            }
+            // Only a line longer than the buffer is written in parts.
+            line_buffer_write(buffer, buffer->line_end > 0 ? buffer->line_end : buffer->length);
+        }
+        size_t chunk = RESULT_WRITE_BUFFER_SIZE - buffer->length;
+        if (chunk > length) {
+            chunk = length;
+        }
+        memcpy(buffer->text + buffer->length, text, chunk);
+        buffer->length += chunk;
+        text += chunk;
+        length -= chunk;
+    }
+}
+
+static void line_buffer_printf(LineBuffer *buffer, const char *format, ...)
+{
+    char text[256];
+    va_list arguments;
+    va_start(arguments, format);
+    const int length = vsnprintf(text, sizeof(text), format, arguments);
+    va_end(arguments);
+    if (length > 0) {
+        line_buffer_append(buffer, text, (size_t)length < sizeof(text) ? (size_t)length : sizeof(text) - 1);
+    }
+}
+
+static void line_buffer_append_json_string(LineBuffer *buffer, const char *data, size_t length)
+{
+    line_buffer_append(buffer, "\"", 1);
+    for (size_t i = 0; i < length; ++i) {
+        const unsigned char c = (unsigned char)data[i];
+        if (c == '"' || c == '\\') {
+            const char escaped[2] = { '\\', (char)c };
+            line_buffer_append(buffer, escaped, 2);
+        } else if (c < 0x20) {
+            line_buffer_printf(buffer, "\\u%04x", c);
+        } else {
+            line_buffer_append(buffer, &data[i], 1);
+        }
+    }
+    line_buffer_append(buffer, "\"", 1);
+}
+
+static uint64_t parse_cache_hash(ParseFormat format, const char *data, uint32_t length)
+{
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ull ^ (uint64_t)format;
+    for (uint32_t i = 0; i < length; ++i) {
+        hash ^= (uint8_t)data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static int32_t parse_cache_find(const ParseStage *stage, uint64_t hash, ParseFormat format,
+                                const char *data, uint32_t length)
+{
+    int32_t index = stage->buckets[hash & (PARSE_CACHE_BUCKETS - 1)];
+    while (index >= 0) {
+        const ParseCacheEntry *entry = &stage->entries[index];
+        if (entry->hash == hash && entry->format == format && entry->payload_length == length &&
+            memcmp(entry->payload, data, length) == 0) {
+            return index;
+        }
+        index = entry->next_in_bucket;
+    }
+    return -1;
+}
+
+static void parse_cache_unlink(ParseStage *stage, int32_t index)
+{
+    ParseCacheEntry *entry = &stage->entries[index];
+    if (entry->newer >= 0) {
+        stage->entries[entry->newer].older = entry->older;
+    } else {
+        stage->newest = entry->older;
+    }
+    if (entry->older >= 0) {
+        stage->entries[entry->older].newer = entry->newer;
+    } else {
+        stage->oldest = entry->newer;
+    }
+}
+
+static void parse_cache_push_newest(ParseStage *stage, int32_t index)
+{
+    ParseCacheEntry *entry = &stage->entries[index];
+    entry->newer = -1;
+    entry->older = stage->newest;
+    if (stage->newest >= 0) {
+        stage->entries[stage->newest].newer = index;
+    } else {
+        stage->oldest = index;
+    }
+    stage->newest = index;
+}
+
+/**
+ * Frees the least recently used entry and returns its index for reuse.
+ */
+static int32_t parse_cache_evict(ParseStage *stage)
+{
+    const int32_t index = stage->oldest;
+    ParseCacheEntry *entry = &stage->entries[index];
+    parse_cache_unlink(stage, index);
+
+    int32_t *link = &stage->buckets[entry->hash & (PARSE_CACHE_BUCKETS - 1)];
+    while (*link != index) {
+        link = &stage->entries[*link].next_in_bucket;
+    }
+    *link = entry->next_in_bucket;
+
+    free(entry->payload);
+    free(entry->fields);
+    return index;
+}
+
+/**
+ * Stores the formatted fields of a payload. Returns -1 if they could not be stored.
+ */
+static int32_t parse_cache_insert(ParseStage *stage, uint64_t hash, ParseFormat format,
+                                  const char *data, uint32_t length,
+                                  const char *fields, size_t fields_length)
+{
+    char *payload = malloc(length > 0 ? length : 1);
+    char *fields_copy = malloc(fields_length > 0 ? fields_length : 1);
+    if (payload == NULL || fields_copy == NULL) {
+        free(payload);
+        free(fields_copy);
+        return -1;
+    }
+    memcpy(payload, data, length);
+    memcpy(fields_copy, fields, fields_length);
+
+    const int32_t index = stage->entry_count < PARSE_CACHE_SIZE ?
+            (int32_t)stage->entry_count++ : parse_cache_evict(stage);
+    ParseCacheEntry *entry = &stage->entries[index];
+    entry->hash = hash;
+    entry->format = format;
+    entry->payload = payload;
+    entry->payload_length = length;
+    entry->fields = fields_copy;
+    entry->fields_length = fields_length;
+    int32_t *bucket = &stage->buckets[hash & (PARSE_CACHE_BUCKETS - 1)];
+    entry->next_in_bucket = *bucket;
+    *bucket = index;
+    parse_cache_push_newest(stage, index);
+    return index;
+}
+
+/**
+ * Writes the queued codes, stops the parse thread and frees the stage.
+ */
+static void parse_stage_free(ParseStage *stage)
+{
+    if (stage == NULL) {
+        return;
+    }
+    if (stage->thread_started) {
+        pthread_mutex_lock(&stage->lock);
+        stage->closing = SC_TRUE;
+        pthread_cond_signal(&stage->records_available);
+        pthread_mutex_unlock(&stage->lock);
+        pthread_join(stage->thread, NULL);
+    }
+    fprintf(stderr, "Parsing: %llu payloads parsed, %llu taken from the cache, %llu failed, "
+            "%llu written without fields\n",
+            (unsigned long long)stage->parsed_count, (unsigned long long)stage->cache_hit_count,
+            (unsigned long long)stage->failed_count, (unsigned long long)stage->skipped_count);
+    for (uint32_t i = 0; i < stage->entry_count; ++i) {
+        free(stage->entries[i].payload);
+        free(stage->entries[i].fields);
+    }
+    for (int format = 0; format < PARSE_FORMAT_COUNT; ++format) {
+        sp_parser_free(stage->parsers[format]);
+    }
+    sc_recognition_context_release(stage->context);
+    pthread_mutex_destroy(&stage->lock);
+    pthread_cond_destroy(&stage->records_available);
+    free(stage);
+}
+
+/**
+ * Creates a parser for every format in the mask. Returns NULL if none could be created.
+ */
+static ParseStage *parse_stage_new(uint32_t format_mask, ScBool ndjson)
+{
+    ParseStage *stage = calloc(1, sizeof(ParseStage));
+    if (stage == NULL) {
+        return NULL;
+    }
+    stage->context = sc_recognition_context_new(SCANDIT_SDK_LICENSE_KEY, "/tmp", NULL);
+    if (stage->context == NULL) {
+        printf("Could not initialize the context of the parsers.\n");
+        free(stage);
+        return NULL;
+    }
+    stage->ndjson = ndjson;
+    stage->output.file = stdout;
+    stage->newest = -1;
+    stage->oldest = -1;
+    for (uint32_t i = 0; i < PARSE_CACHE_BUCKETS; ++i) {
+        stage->buckets[i] = -1;
+    }
+
+    ScBool any_parser = SC_FALSE;
+    for (int format = 0; format < PARSE_FORMAT_COUNT; ++format) {
+        if ((format_mask & (1u << format)) == 0) {
+            continue;
+        }
+        ScContextStatusFlag status = SC_RECOGNITION_CONTEXT_STATUS_SUCCESS;
+        stage->parsers[format] =
+                sp_parser_new_with_context(stage->context, PARSE_FORMATS[format].type, &status);
+        if (stage->parsers[format] == NULL) {
+            printf("Could not create the %s parser: %s\n", PARSE_FORMATS[format].name,
+                   sc_context_status_flag_get_message(status));
+            continue;
+        }
+        any_parser = SC_TRUE;
+    }
+    if (!any_parser) {
+        sc_recognition_context_release(stage->context);
+        free(stage);
+        return NULL;
+    }
+    pthread_mutex_init(&stage->lock, NULL);
+    pthread_cond_init(&stage->records_available, NULL);
+    return stage;
+}
+
+static ParseFormat parse_stage_select_format(const ParseStage *stage, const ResultRecord *record,
+                                             const char *data)
+{
+    if (record->gs1_data_carrier && stage->parsers[PARSE_FORMAT_GS1] != NULL) {
+        return PARSE_FORMAT_GS1;
+    }
+    if (record->data_length > 0 && data[0] == '+' && stage->parsers[PARSE_FORMAT_HIBC] != NULL) {
+        return PARSE_FORMAT_HIBC;
+    }
+    return PARSE_FORMAT_COUNT;
+}
+
+/**
+ * Parses the payload and formats its fields, or the reason parsing failed, into the
+ * scratch buffer of the stage.
+ */
+static void parse_stage_format_fields(ParseStage *stage, ParseFormat format, const char *data,
+                                      uint32_t length)
+{
+    LineBuffer *fields = &stage->scratch;
+    fields->length = 0;
+
+    SpParserResult *result = NULL;
+    if (!sp_parser_parse_string(stage->parsers[format], data, length, &result) ||
+        result == NULL || !sp_parser_result_is_ok(result)) {
+        stage->failed_count++;
+        SpData message;
+        memset(&message, 0, sizeof(message));
+        if (result != NULL) {
+            message = sp_parser_result_get_error_message(result);
+        }
+        const char *text = message.str != NULL ? message.str : "unknown error";
+        if (stage->ndjson) {
+            line_buffer_printf(fields, ",\"parse_error\":");
+            line_buffer_append_json_string(fields, text, strlen(text));
+        } else {
+            line_buffer_printf(fields, "    %s parse error: %s\n", PARSE_FORMATS[format].name, text);
+        }
+        if (message.str != NULL) {
+            sp_data_free(message);
+        }
+        sp_parser_result_free(result);
+        return;
+    }
+
+    const size_t field_count = sp_parser_result_get_fields_count(result);
+    size_t emitted_count = 0;
+    if (stage->ndjson) {
+        line_buffer_printf(fields, ",\"format\":\"%s\",\"fields\":{", PARSE_FORMATS[format].name);
+    }
+    for (size_t i = 0; i < field_count; ++i) {
+        const SpField *field = sp_parser_result_get_field_by_index(result, i);
+        if (field == NULL) {
+            continue;
+        }
+        SpData name = sp_field_get_name(field);
+        SpData value = sp_field_get_string_value(field);
+        const char *name_text = name.str != NULL ? name.str : "";
+        const char *value_text = value.str != NULL ? value.str : "";
+        if (stage->ndjson) {
+            if (emitted_count > 0) {
+                line_buffer_append(fields, ",", 1);
+            }
+            line_buffer_append_json_string(fields, name_text, strlen(name_text));
+            line_buffer_append(fields, ":", 1);
+            line_buffer_append_json_string(fields, value_text, strlen(value_text));
+        } else {
+            line_buffer_printf(fields, "    %s: ", name_text);
+            line_buffer_append(fields, value_text, strlen(value_text));
+            line_buffer_append(fields, "\n", 1);
+        }
+        emitted_count++;
+        if (name.str != NULL) {
+            sp_data_free(name);
+        }
+        if (value.str != NULL) {
+            sp_data_free(value);
+        }
+    }
+    if (stage->ndjson) {
+        line_buffer_append(fields, "}", 1);
+    }
+    sp_parser_result_free(result);
+}
+
+/**
+ * Returns the formatted fields of a record, parsed or from the cache. The fields stay
+ * valid until the next call. Called from the parse thread only.
+ */
+static void parse_stage_fields(ParseStage *stage, const ResultRecord *record, const char **fields,
+                               size_t *fields_length)
+{
+    *fields = NULL;
+    *fields_length = 0;
+    const char *data = record->long_data != NULL ? record->long_data : record->data;
+    const ParseFormat format = parse_stage_select_format(stage, record, data);
+    if (format == PARSE_FORMAT_COUNT) {
+        return;
+    }
+
+    const uint64_t hash = parse_cache_hash(format, data, record->data_length);
+    int32_t index = parse_cache_find(stage, hash, format, data, record->data_length);
+    if (index >= 0) {
+        stage->cache_hit_count++;
+        parse_cache_unlink(stage, index);
+        parse_cache_push_newest(stage, index);
+    } else {
+        stage->parsed_count++;
+        parse_stage_format_fields(stage, format, data, record->data_length);
+        index = parse_cache_insert(stage, hash, format, data, record->data_length,
+                                   stage->scratch.text, stage->scratch.length);
+        if (index < 0) {
+            *fields = stage->scratch.text;
+            *fields_length = stage->scratch.length;
+            return;
+        }
+    }
+    *fields = stage->entries[index].fields;
+    *fields_length = stage->entries[index].fields_length;
+}
+
+/**
+ * Formats one record. The fields of the parse stage are appended if there are any.
+ */
+static void result_record_format(LineBuffer *buffer, const ResultRecord *record, ScBool ndjson,
+                                 const char *fields, size_t fields_length)
+{
+    const char *data = record->long_data != NULL ? record->long_data : record->data;
+    if (!ndjson) {
+        line_buffer_append(buffer, "Barcode found: '", 16);
+        line_buffer_append(buffer, data, record->data_length);
+        line_buffer_append(buffer, "'\n", 2);
+        line_buffer_append(buffer, fields, fields_length);
+        line_buffer_end_line(buffer);
+        return;
+    }
+    const char *symbology_name = sc_symbology_to_string(record->symbology);
+    const ScQuadrilateral *location = &record->location;
+    line_buffer_printf(buffer, "{\"frame_id\":%u,\"symbology\":", record->frame_id);
+    line_buffer_append_json_string(buffer, symbology_name, strlen(symbology_name));
+    line_buffer_printf(buffer, ",\"data\":");
+    line_buffer_append_json_string(buffer, data, record->data_length);
+    line_buffer_printf(buffer, ",\"location\":[[%d,%d],[%d,%d],[%d,%d],[%d,%d]]",
+                       location->top_left.x, location->top_left.y,
+                       location->top_right.x, location->top_right.y,
+                       location->bottom_right.x, location->bottom_right.y,
+                       location->bottom_left.x, location->bottom_left.y);
+    line_buffer_printf(buffer, ",\"captured_at\":%.3f,\"recognized_at\":%.3f",
+                       record->capture_time, record->recognition_time);
+    line_buffer_append(buffer, fields, fields_length);
+    line_buffer_append(buffer, "}\n", 2);
+    line_buffer_end_line(buffer);
+}
+
+static void *parse_stage_run(void *argument)
+{
+    ParseStage *stage = argument;
+    for (;;) {
+        pthread_mutex_lock(&stage->lock);
+        if (stage->queue_head == stage->queue_tail && !stage->closing) {
+            // Write out the parsed codes before waiting for more.
+            pthread_mutex_unlock(&stage->lock);
+            line_buffer_flush(&stage->output);
+            pthread_mutex_lock(&stage->lock);
+            while (stage->queue_head == stage->queue_tail && !stage->closing) {
+                pthread_cond_wait(&stage->records_available, &stage->lock);
+            }
+        }
+        if (stage->queue_head == stage->queue_tail) {
+            pthread_mutex_unlock(&stage->lock);
+            break;
+        }
+        const ResultRecord record = stage->queue[stage->queue_tail & (PARSE_QUEUE_SIZE - 1)];
+        stage->queue_tail++;
+        pthread_mutex_unlock(&stage->lock);
+
+        const char *fields = NULL;
+        size_t fields_length = 0;
+        parse_stage_fields(stage, &record, &fields, &fields_length);
+        result_record_format(&stage->output, &record, stage->ndjson, fields, fields_length);
+        free(record.long_data);
+    }
+    line_buffer_flush(&stage->output);
+    return NULL;
+}
+
+static ScBool parse_stage_start(ParseStage *stage)
+{
+    stage->thread_started = pthread_create(&stage->thread, NULL, parse_stage_run, stage) == 0;
+    return stage->thread_started;
+}
+
+/**
+ * Hands a record that has to be parsed to the parse thread, together with its long
+ * data. Returns SC_FALSE if the record is not parsed or the queue is full. Called from
+ * the writer thread only.
+ */
+static ScBool parse_stage_submit(ParseStage *stage, ResultRecord *record)
+{
+    const char *data = record->long_data != NULL ? record->long_data : record->data;
+    if (parse_stage_select_format(stage, record, data) == PARSE_FORMAT_COUNT) {
+        return SC_FALSE;
+    }
+    pthread_mutex_lock(&stage->lock);
+    const ScBool queued = stage->queue_head - stage->queue_tail < PARSE_QUEUE_SIZE;
+    if (queued) {
+        stage->queue[stage->queue_head & (PARSE_QUEUE_SIZE - 1)] = *record;
+        stage->queue_head++;
+        record->long_data = NULL;
+        pthread_cond_signal(&stage->records_available);
+    }
+    pthread_mutex_unlock(&stage->lock);
+    if (!queued) {
+        stage->skipped_count++;
+    }
+    return queued;
+}
+
+static void *result_writer_run(void *argument)
+{
+    ResultSink *sink = argument;
+    uint32_t tail = sink->tail;
+    for (;;) {
+        const uint32_t head = __atomic_load_n(&sink->head, __ATOMIC_SEQ_CST);
+        if (head == tail) {
+            // The ring is empty, write out the batch and wait for more.
+            line_buffer_flush(&sink->output);
+            pthread_mutex_lock(&sink->lock);
+            __atomic_store_n(&sink->writer_waiting, SC_TRUE, __ATOMIC_SEQ_CST);
+            while (__atomic_load_n(&sink->head, __ATOMIC_SEQ_CST) == tail && !sink->closing) {
+                pthread_cond_wait(&sink->records_available, &sink->lock);
+            }
+            __atomic_store_n(&sink->writer_waiting, SC_FALSE, __ATOMIC_SEQ_CST);
+            const ScBool finished = sink->closing &&
+                    __atomic_load_n(&sink->head, __ATOMIC_SEQ_CST) == tail;
+            pthread_mutex_unlock(&sink->lock);
+            if (finished) {
+                break;
+            }
+            continue;
+        }
+
+        ResultRecord *record = &sink->records[tail & (RESULT_RING_SIZE - 1)];
+        // Codes with fields are written by the parse thread.
+        if (sink->parse_stage == NULL || !parse_stage_submit(sink->parse_stage, record)) {
+            result_record_format(&sink->output, record, sink->ndjson, NULL, 0);
+        }
+        free(record->long_data);
+        record->long_data = NULL;
+        sink->written_count++;
+
+        // Hand the slot back to the scan thread and wake it up if it waits for space.
+        tail++;
+        __atomic_store_n(&sink->tail, tail, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&sink->scanner_waiting, __ATOMIC_SEQ_CST)) {
+            pthread_mutex_lock(&sink->lock);
+            pthread_cond_signal(&sink->space_available);
+            pthread_mutex_unlock(&sink->lock);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Writes the spilled results to the spill file until the sink is closed.
+ */
+static void *result_spill_run(void *argument)
+{
+    ResultSink *sink = argument;
+    for (;;) {
+        pthread_mutex_lock(&sink->spill_lock);
+        while (sink->spill_pending.length == 0 && !sink->spill_closing) {
+            pthread_cond_wait(&sink->spill_available, &sink->spill_lock);
+        }
+        if (sink->spill_pending.length == 0) {
+            pthread_mutex_unlock(&sink->spill_lock);
+            break;
+        }
+        memcpy(sink->spill.text, sink->spill_pending.text, sink->spill_pending.length);
+        sink->spill.length = sink->spill_pending.length;
+        const uint64_t count = sink->spill_pending_count;
+        sink->spill_pending.length = 0;
+        sink->spill_pending_count = 0;
+        pthread_mutex_unlock(&sink->spill_lock);
+
+        if (sink->spill.file == NULL && !sink->spill_failed) {
+            sink->spill.file = fopen(sink->spill_path, "a");
+            if (sink->spill.file == NULL) {
+                fprintf(stderr, "Could not open the spill file '%s', results are dropped.\n",
+                        sink->spill_path);
+                __atomic_store_n(&sink->spill_failed, SC_TRUE, __ATOMIC_RELAXED);
+            }
+        }
+        if (sink->spill.file == NULL) {
+            sink->spill.length = 0;
+            sink->spill_lost_count += count;
+            continue;
+        }
+        line_buffer_flush(&sink->spill);
+        sink->spilled_count += count;
+    }
+    if (sink->spill.file != NULL) {
+        fclose(sink->spill.file);
+        sink->spill.file = NULL;
+    }
+    return NULL;
+}
 
-#include <Scandit/ScRecognitionContext.h>
-#include <Scandit/ScBarcodeScanner.h>
-#include <Scandit/ScCamera.h>
+static ResultSink *result_sink_new(ScBool ndjson, ResultSinkPolicy policy, const char *spill_path)
+{
+    ResultSink *sink = calloc(1, sizeof(ResultSink));
+    if (sink == NULL) {
+        return NULL;
+    }
+    sink->ndjson = ndjson;
+    sink->policy = policy;
+    sink->spill_path = spill_path;
+    sink->output.file = stdout;
+    pthread_mutex_init(&sink->lock, NULL);
+    pthread_cond_init(&sink->space_available, NULL);
+    pthread_cond_init(&sink->records_available, NULL);
+    pthread_mutex_init(&sink->spill_lock, NULL);
+    pthread_cond_init(&sink->spill_available, NULL);
+    return sink;
+}
 
-// Please insert your app key here:
-#define SCANDIT_SDK_LICENSE_KEY "-- INSERT YOUR LICENSE KEY HERE --"
+static void result_sink_stop_spill_thread(ResultSink *sink)
+{
+    if (!sink->spill_thread_started) {
+        return;
+    }
+    pthread_mutex_lock(&sink->spill_lock);
+    sink->spill_closing = SC_TRUE;
+    pthread_cond_signal(&sink->spill_available);
+    pthread_mutex_unlock(&sink->spill_lock);
+    pthread_join(sink->spill_thread, NULL);
+    sink->spill_thread_started = SC_FALSE;
+}
 
-// Please insert the desired default camera resolution here:
-#define DEFAULT_RESOLUTION_WIDTH 1280
-#define DEFAULT_RESOLUTION_HEIGHT 720
+/**
+ * Frees a sink whose threads have stopped.
+ */
+static void result_sink_free(ResultSink *sink)
+{
+    parse_stage_free(sink->parse_stage);
+    pthread_mutex_destroy(&sink->lock);
+    pthread_cond_destroy(&sink->space_available);
+    pthread_cond_destroy(&sink->records_available);
+    pthread_mutex_destroy(&sink->spill_lock);
+    pthread_cond_destroy(&sink->spill_available);
+    free(sink);
+}
 
-// Set this define to 1 of you run the demo on a device with slow hardware or no GPU support
-// such as a Raspberry Pi Zero.
-// It disables barcode search and only scans codes in the center image area.
-#define LOW_END_DEVICE_CONFIGURATION 0
+static ScBool result_sink_start(ResultSink *sink, pthread_t *writer_thread)
+{
+    if (sink->parse_stage != NULL && !parse_stage_start(sink->parse_stage)) {
+        return SC_FALSE;
+    }
+    if (sink->policy == RESULT_SINK_SPILL) {
+        if (pthread_create(&sink->spill_thread, NULL, result_spill_run, sink) != 0) {
+            return SC_FALSE;
+        }
+        sink->spill_thread_started = SC_TRUE;
+    }
+    if (pthread_create(writer_thread, NULL, result_writer_run, sink) != 0) {
+        result_sink_stop_spill_thread(sink);
+        return SC_FALSE;
+    }
+    return SC_TRUE;
+}
 
-static volatile ScBool process_frames;
+/**
+ * Hands a result that does not fit into the ring to the spill thread. Called from
+ * the scan thread only, the record is formatted but not written here.
+ */
+static void result_sink_spill(ResultSink *sink, const ResultRecord *record)
+{
+    if (__atomic_load_n(&sink->spill_failed, __ATOMIC_RELAXED)) {
+        sink->dropped_count++;
+        return;
+    }
+    sink->spill_scratch.length = 0;
+    result_record_format(&sink->spill_scratch, record, sink->ndjson, NULL, 0);
+    const size_t length = sink->spill_scratch.length;
 
-static void catch_exit(int signo) {
-    printf("SIGINT received.\n");
-    process_frames = SC_FALSE;
+    pthread_mutex_lock(&sink->spill_lock);
+    // A full scratch buffer holds a truncated line.
+    const ScBool fits = length < RESULT_WRITE_BUFFER_SIZE &&
+                        RESULT_WRITE_BUFFER_SIZE - sink->spill_pending.length >= length;
+    if (fits) {
+        memcpy(sink->spill_pending.text + sink->spill_pending.length, sink->spill_scratch.text,
+               length);
+        if (sink->spill_pending.length == 0) {
+            pthread_cond_signal(&sink->spill_available);
+        }
+        sink->spill_pending.length += length;
+        sink->spill_pending_count++;
+    }
+    pthread_mutex_unlock(&sink->spill_lock);
+    if (!fits) {
+        sink->dropped_count++;
+    }
+}
+
+/**
+ * Queues a recognized code. Called from the scan thread only.
+ */
+static void result_sink_push(ResultSink *sink, const ScBarcode *code, double capture_time,
+                             double recognition_time)
+{
+    ResultRecord record;
+    const ScByteArray data = sc_barcode_get_data(code);
+    record.frame_id = sc_barcode_get_frame_id(code);
+    record.symbology = sc_barcode_get_symbology(code);
+    record.location = sc_barcode_get_location(code);
+    record.capture_time = capture_time;
+    record.recognition_time = recognition_time;
+    record.gs1_data_carrier = sink->parse_stage != NULL && sc_barcode_is_gs1_data_carrier(code);
+    record.data_length = data.length;
+    record.long_data = NULL;
+
+    const uint32_t head = sink->head;
+    if (head - __atomic_load_n(&sink->tail, __ATOMIC_SEQ_CST) == RESULT_RING_SIZE) {
+        if (sink->policy == RESULT_SINK_DROP) {
+            sink->dropped_count++;
+            return;
+        }
+        if (sink->policy == RESULT_SINK_SPILL) {
+            // The spilled record is formatted right away, it can refer to the barcode data.
+            record.long_data = (char *)data.str;
+            result_sink_spill(sink, &record);
+            return;
+        }
+        sink->blocked_count++;
+        pthread_mutex_lock(&sink->lock);
+        __atomic_store_n(&sink->scanner_waiting, SC_TRUE, __ATOMIC_SEQ_CST);
+        while (head - __atomic_load_n(&sink->tail, __ATOMIC_SEQ_CST) == RESULT_RING_SIZE) {
+            pthread_cond_wait(&sink->space_available, &sink->lock);
+        }
+        __atomic_store_n(&sink->scanner_waiting, SC_FALSE, __ATOMIC_SEQ_CST);
+        pthread_mutex_unlock(&sink->lock);
+    }
+
+    ResultRecord *slot = &sink->records[head & (RESULT_RING_SIZE - 1)];
+    *slot = record;
+    if (data.length < RESULT_INLINE_DATA_SIZE) {
+        memcpy(slot->data, data.str, data.length);
+    } else {
+        slot->long_data = malloc(data.length);
+        if (slot->long_data == NULL) {
+            sink->dropped_count++;
+            return;
+        }
+        memcpy(slot->long_data, data.str, data.length);
+    }
+
+    // Publish the record and wake up the writer if it waits for records.
+    __atomic_store_n(&sink->head, head + 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&sink->writer_waiting, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&sink->lock);
+        pthread_cond_signal(&sink->records_available);
+        pthread_mutex_unlock(&sink->lock);
+    }
+}
+
+/**
+ * Writes the remaining results, stops the writer thread and frees the sink.
+ */
+static void result_sink_close(ResultSink *sink, pthread_t writer_thread)
+{
+    pthread_mutex_lock(&sink->lock);
+    sink->closing = SC_TRUE;
+    pthread_cond_signal(&sink->records_available);
+    pthread_mutex_unlock(&sink->lock);
+    pthread_join(writer_thread, NULL);
+    result_sink_stop_spill_thread(sink);
+
+    // The statistics go to stderr to keep the result stream clean.
+    fprintf(stderr, "Results: %llu written, %llu dropped, %llu spilled to '%s', "
+            "scanner waited for the writer %llu times\n",
+            (unsigned long long)sink->written_count,
+            (unsigned long long)(sink->dropped_count + sink->spill_lost_count),
+            (unsigned long long)sink->spilled_count, sink->spill_path,
+            (unsigned long long)sink->blocked_count);
+    result_sink_free(sink);
+}
+
+// Sums of absolute differences. The lengths passed in are multiples of 32.
+#if !defined(__SSE2__) && !defined(__ARM_NEON)
+static uint32_t sad_bytes_scalar(const uint8_t *a, const uint8_t *b, size_t length)
+{
+    uint32_t sum = 0;
+    for (size_t i = 0; i < length; ++i) {
+        sum += a[i] > b[i] ? a[i] - b[i] : b[i] - a[i];
+    }
+    return sum;
+}
+#endif
+
+#if defined(__SSE2__)
+static uint32_t sad_bytes_sse2(const uint8_t *a, const uint8_t *b, size_t length)
+{
+    __m128i sum = _mm_setzero_si128();
+    for (size_t i = 0; i < length; i += 16) {
+        const __m128i x = _mm_loadu_si128((const __m128i *)(a + i));
+        const __m128i y = _mm_loadu_si128((const __m128i *)(b + i));
+        sum = _mm_add_epi64(sum, _mm_sad_epu8(x, y));
+    }
+    return (uint32_t)(_mm_cvtsi128_si32(sum) + _mm_cvtsi128_si32(_mm_srli_si128(sum, 8)));
+}
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2")))
+static uint32_t sad_bytes_avx2(const uint8_t *a, const uint8_t *b, size_t length)
+{
+    __m256i sum = _mm256_setzero_si256();
+    for (size_t i = 0; i < length; i += 32) {
+        const __m256i x = _mm256_loadu_si256((const __m256i *)(a + i));
+        const __m256i y = _mm256_loadu_si256((const __m256i *)(b + i));
+        sum = _mm256_add_epi64(sum, _mm256_sad_epu8(x, y));
+    }
+    const __m128i half = _mm_add_epi64(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    return (uint32_t)(_mm_cvtsi128_si32(half) + _mm_cvtsi128_si32(_mm_srli_si128(half, 8)));
+}
+#endif
+
+#if defined(__ARM_NEON)
+static uint32_t sad_bytes_neon(const uint8_t *a, const uint8_t *b, size_t length)
+{
+    uint32x4_t sum = vdupq_n_u32(0);
+    for (size_t i = 0; i < length; i += 16) {
+        const uint8x16_t difference = vabdq_u8(vld1q_u8(a + i), vld1q_u8(b + i));
+        sum = vpadalq_u16(sum, vpaddlq_u8(difference));
+    }
+    const uint64x2_t pairs = vpaddlq_u32(sum);
+    return (uint32_t)(vgetq_lane_u64(pairs, 0) + vgetq_lane_u64(pairs, 1));
+}
+#endif
+
+static SadFunction select_sad_function(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    if (__builtin_cpu_supports("avx2")) {
+        return sad_bytes_avx2;
+    }
+#endif
+#if defined(__SSE2__)
+    return sad_bytes_sse2;
+#elif defined(__ARM_NEON)
+    return sad_bytes_neon;
+#else
+    return sad_bytes_scalar;
+#endif
+}
+
+// Bytes per pixel in the first plane. 0 for layouts the filter does not know.
+static uint32_t first_plane_pixel_bytes(ScImageLayout layout)
+{
+    switch (layout) {
+        case SC_IMAGE_LAYOUT_GRAY_8U:
+        case SC_IMAGE_LAYOUT_YPCBCR_8U:
+        case SC_IMAGE_LAYOUT_YPCRCB_8U:
+        case SC_IMAGE_LAYOUT_I420_8U:
+            return 1;
+        case SC_IMAGE_LAYOUT_YUYV_8U:
+        case SC_IMAGE_LAYOUT_UYVY_8U:
+            return 2;
+        case SC_IMAGE_LAYOUT_RGB_8U:
+            return 3;
+        case SC_IMAGE_LAYOUT_RGBA_8U:
+        case SC_IMAGE_LAYOUT_ARGB_8U:
+            return 4;
+        default:
+            return 0;
+    }
+}
+
+static void static_scene_filter_init(StaticSceneFilter *filter, float threshold, uint32_t hold_frames)
+{
+    memset(filter, 0, sizeof(*filter));
+    filter->threshold = threshold;
+    filter->hold_frames = hold_frames;
+    filter->sad = select_sad_function();
+}
+
+static void static_scene_filter_copy_rows(StaticSceneFilter *filter, const uint8_t *plane, size_t row_bytes)
+{
+    const size_t compared_bytes = filter->tile_bytes * STATIC_TILE_COLUMNS;
+    for (uint32_t row = 0; row < filter->row_count; ++row) {
+        memcpy(filter->reference + row * compared_bytes,
+               plane + (size_t)row * STATIC_ROW_STEP * row_bytes, compared_bytes);
+    }
+    filter->has_reference = SC_TRUE;
+}
+
+/**
+ * Returns whether the frame has to be scanned. Frames that differ from the last scanned
+ * frame and the next hold_frames frames after them are scanned, all others are skipped.
+ */
+static ScBool static_scene_filter_check(StaticSceneFilter *filter, const ScImageDescription *image_descr,
+                                        const uint8_t *image_data)
+{
+    const uint32_t width = sc_image_description_get_width(image_descr);
+    const uint32_t height = sc_image_description_get_height(image_descr);
+    const ScImageLayout layout = sc_image_description_get_layout(image_descr);
+    const uint32_t pixel_bytes = first_plane_pixel_bytes(layout);
+    size_t row_bytes = sc_image_description_get_first_plane_row_bytes(image_descr);
+    if (row_bytes == 0) {
+        row_bytes = (size_t)width * pixel_bytes;
+    }
+    const uint8_t *plane = image_data + sc_image_description_get_first_plane_offset(image_descr);
+
+    if (width != filter->width || height != filter->height || layout != filter->layout) {
+        // The camera mode changed, start over with the next frame as reference.
+        free(filter->reference);
+        filter->reference = NULL;
+        filter->has_reference = SC_FALSE;
+        filter->width = width;
+        filter->height = height;
+        filter->layout = layout;
+        filter->tile_bytes = ((size_t)width * pixel_bytes / STATIC_TILE_COLUMNS) & ~(size_t)31;
+        filter->row_count = (height + STATIC_ROW_STEP - 1) / STATIC_ROW_STEP;
+        if (filter->tile_bytes > 0) {
+            filter->reference = malloc(filter->row_count * STATIC_TILE_COLUMNS * filter->tile_bytes);
+        }
+    }
+    if (filter->reference == NULL) {
+        // Unknown layout or tiny image.
+        filter->processed_count++;
+        return SC_TRUE;
+    }
+
+    ScBool changed = !filter->has_reference;
+    const size_t compared_bytes = filter->tile_bytes * STATIC_TILE_COLUMNS;
+    for (uint32_t band = 0; band < filter->row_count && !changed; band += STATIC_TILE_ROWS) {
+        const uint32_t band_rows = filter->row_count - band < STATIC_TILE_ROWS ?
+                filter->row_count - band : STATIC_TILE_ROWS;
+        uint32_t tile_sums[STATIC_TILE_COLUMNS] = { 0 };
+        for (uint32_t row = band; row < band + band_rows; ++row) {
+            const uint8_t *current = plane + (size_t)row * STATIC_ROW_STEP * row_bytes;
+            const uint8_t *reference = filter->reference + row * compared_bytes;
+            for (uint32_t column = 0; column < STATIC_TILE_COLUMNS; ++column) {
+                const size_t offset = column * filter->tile_bytes;
+                tile_sums[column] += filter->sad(current + offset, reference + offset, filter->tile_bytes);
+            }
+        }
+        const float limit = filter->threshold * (float)(filter->tile_bytes * band_rows);
+        for (uint32_t column = 0; column < STATIC_TILE_COLUMNS; ++column) {
+            if ((float)tile_sums[column] > limit) {
+                changed = SC_TRUE;
+                break;
+            }
+        }
+    }
+
+    if (changed) {
+        filter->hold_remaining = filter->hold_frames;
+    } else if (filter->hold_remaining > 0) {
+        filter->hold_remaining--;
+    } else {
+        // Skipped frames keep the reference, so slow changes add up until they count.
+        filter->skipped_count++;
+        return SC_FALSE;
+    }
+    static_scene_filter_copy_rows(filter, plane, row_bytes);
+    filter->processed_count++;
+    return SC_TRUE;
+}
+
+static ScBool is_2d_symbology(ScSymbology symbology)
+{
+    switch (symbology) {
+        case SC_SYMBOLOGY_QR:
+        case SC_SYMBOLOGY_MICRO_QR:
+        case SC_SYMBOLOGY_DATA_MATRIX:
+        case SC_SYMBOLOGY_AZTEC:
+        case SC_SYMBOLOGY_MAXICODE:
+        case SC_SYMBOLOGY_DOTCODE:
+        case SC_SYMBOLOGY_PDF417:
+        case SC_SYMBOLOGY_MICRO_PDF417:
+            return SC_TRUE;
+        default:
+            return SC_FALSE;
+    }
+}
+
+static float clamp_unit(float value)
+{
+    return value < 0.f ? 0.f : (value > 1.f ? 1.f : value);
+}
+
+/**
+ * Adds the bounding box of a code location (in pixels) to the heat map.
+ */
+static void heat_map_add(LocationHeatMap *map, const ScQuadrilateral *location,
+                         uint32_t frame_width, uint32_t frame_height)
+{
+    const ScPoint corners[4] = {
+        location->top_left, location->top_right, location->bottom_right, location->bottom_left
+    };
+    float min_x = 1.f, min_y = 1.f, max_x = 0.f, max_y = 0.f;
+    for (int i = 0; i < 4; ++i) {
+        const float x = clamp_unit((float)corners[i].x / frame_width);
+        const float y = clamp_unit((float)corners[i].y / frame_height);
+        min_x = x < min_x ? x : min_x;
+        min_y = y < min_y ? y : min_y;
+        max_x = x > max_x ? x : max_x;
+        max_y = y > max_y ? y : max_y;
+    }
+    const int first_column = (int)(min_x * (HEAT_MAP_SIZE - 1e-3f));
+    const int last_column = (int)(max_x * (HEAT_MAP_SIZE - 1e-3f));
+    const int first_row = (int)(min_y * (HEAT_MAP_SIZE - 1e-3f));
+    const int last_row = (int)(max_y * (HEAT_MAP_SIZE - 1e-3f));
+    for (int row = first_row; row <= last_row; ++row) {
+        for (int column = first_column; column <= last_column; ++column) {
+            map->cells[row][column] += 1.f;
+        }
+    }
+    map->total += 1.f;
+}
+
+static void heat_map_decay(LocationHeatMap *map)
+{
+    for (int row = 0; row < HEAT_MAP_SIZE; ++row) {
+        for (int column = 0; column < HEAT_MAP_SIZE; ++column) {
+            map->cells[row][column] *= HEAT_MAP_DECAY;
+        }
+    }
+    map->total *= HEAT_MAP_DECAY;
+}
+
+/**
+ * Finds the area where codes showed up recently: the bounding box of all cells with
+ * a noticeable part of the peak heat, grown by one cell on every side.
+ *
+ * \returns SC_FALSE if there were not enough codes recently.
+ */
+static ScBool heat_map_hot_area(const LocationHeatMap *map, ScRectangleF *area)
+{
+    if (map->total < HEAT_MAP_MIN_CODES) {
+        return SC_FALSE;
+    }
+    float peak = 0.f;
+    for (int row = 0; row < HEAT_MAP_SIZE; ++row) {
+        for (int column = 0; column < HEAT_MAP_SIZE; ++column) {
+            peak = map->cells[row][column] > peak ? map->cells[row][column] : peak;
+        }
+    }
+    int first_column = HEAT_MAP_SIZE, last_column = -1;
+    int first_row = HEAT_MAP_SIZE, last_row = -1;
+    for (int row = 0; row < HEAT_MAP_SIZE; ++row) {
+        for (int column = 0; column < HEAT_MAP_SIZE; ++column) {
+            if (map->cells[row][column] >= peak * HEAT_MAP_HOT_FRACTION) {
+                first_column = column < first_column ? column : first_column;
+                last_column = column > last_column ? column : last_column;
+                first_row = row < first_row ? row : first_row;
+                last_row = row > last_row ? row : last_row;
+            }
+        }
+    }
+    first_column = first_column > 0 ? first_column - 1 : 0;
+    first_row = first_row > 0 ? first_row - 1 : 0;
+    last_column = last_column < HEAT_MAP_SIZE - 1 ? last_column + 1 : HEAT_MAP_SIZE - 1;
+    last_row = last_row < HEAT_MAP_SIZE - 1 ? last_row + 1 : HEAT_MAP_SIZE - 1;
+
+    const float cell = 1.f / HEAT_MAP_SIZE;
+    area->position.x = first_column * cell;
+    area->position.y = first_row * cell;
+    area->size.width = (last_column - first_column + 1) * cell;
+    area->size.height = (last_row - first_row + 1) * cell;
+    return SC_TRUE;
+}
+
+static ScBool rectangles_equal(ScRectangleF a, ScRectangleF b)
+{
+    return a.position.x == b.position.x && a.position.y == b.position.y &&
+           a.size.width == b.size.width && a.size.height == b.size.height;
+}
+
+static ScRectangleF rectangle_union(ScRectangleF a, ScRectangleF b)
+{
+    const float left = a.position.x < b.position.x ? a.position.x : b.position.x;
+    const float top = a.position.y < b.position.y ? a.position.y : b.position.y;
+    const float a_right = a.position.x + a.size.width, b_right = b.position.x + b.size.width;
+    const float a_bottom = a.position.y + a.size.height, b_bottom = b.position.y + b.size.height;
+    ScRectangleF result;
+    result.position.x = left;
+    result.position.y = top;
+    result.size.width = (a_right > b_right ? a_right : b_right) - left;
+    result.size.height = (a_bottom > b_bottom ? a_bottom : b_bottom) - top;
+    return result;
+}
+
+/**
+ * Returns the part of the area inside the bounds, or the bounds if they do not overlap.
+ */
+static ScRectangleF rectangle_clamp(ScRectangleF area, ScRectangleF bounds)
+{
+    const float left = area.position.x > bounds.position.x ? area.position.x : bounds.position.x;
+    const float top = area.position.y > bounds.position.y ? area.position.y : bounds.position.y;
+    const float a_right = area.position.x + area.size.width;
+    const float b_right = bounds.position.x + bounds.size.width;
+    const float a_bottom = area.position.y + area.size.height;
+    const float b_bottom = bounds.position.y + bounds.size.height;
+    const float right = a_right < b_right ? a_right : b_right;
+    const float bottom = a_bottom < b_bottom ? a_bottom : b_bottom;
+    if (right <= left || bottom <= top) {
+        return bounds;
+    }
+    ScRectangleF result;
+    result.position.x = left;
+    result.position.y = top;
+    result.size.width = right - left;
+    result.size.height = bottom - top;
+    return result;
+}
+
+static void adaptive_area_init(AdaptiveArea *adaptive, const ScBarcodeScannerSettings *settings)
+{
+    memset(adaptive, 0, sizeof(AdaptiveArea));
+    adaptive->settings = sc_barcode_scanner_settings_clone((ScBarcodeScannerSettings *)settings);
+    adaptive->default_area_1d = sc_barcode_scanner_settings_get_code_location_area_1d(settings);
+    adaptive->default_area_2d = sc_barcode_scanner_settings_get_code_location_area_2d(settings);
+    adaptive->default_constraint_1d = sc_barcode_scanner_settings_get_code_location_constraint_1d(settings);
+    adaptive->default_constraint_2d = sc_barcode_scanner_settings_get_code_location_constraint_2d(settings);
+    adaptive->full_search = SC_TRUE;
+}
+
+/**
+ * Records the codes of the last frame and applies new settings when the areas to
+ * focus on or the kind of search changes.
+ *
+ * Most frames are scanned in the hot areas only (SC_CODE_LOCATION_RESTRICT). Every
+ * ADAPTIVE_FULL_SEARCH_INTERVAL frames, and while there are no hot areas yet, the
+ * configured constraint applies again: with SC_CODE_LOCATION_HINT the whole image is
+ * searched with the hot areas as hints, with SC_CODE_LOCATION_RESTRICT the configured
+ * areas are searched, so that codes at new positions are still found and move the hot
+ * areas. Hot areas never reach outside of restricted configured areas.
+ */
+static void adaptive_area_update(AdaptiveArea *adaptive, ScBarcodeScanner *scanner,
+                                 const ScBarcodeArray *codes, uint32_t frame_width,
+                                 uint32_t frame_height)
+{
+    heat_map_decay(&adaptive->heat_1d);
+    heat_map_decay(&adaptive->heat_2d);
+    const uint32_t code_count = sc_barcode_array_get_size(codes);
+    for (uint32_t i = 0; i < code_count; ++i) {
+        const ScBarcode *code = sc_barcode_array_get_item_at(codes, i);
+        const ScQuadrilateral location = sc_barcode_get_location(code);
+        LocationHeatMap *map = is_2d_symbology(sc_barcode_get_symbology(code)) ?
+                               &adaptive->heat_2d : &adaptive->heat_1d;
+        heat_map_add(map, &location, frame_width, frame_height);
+    }
+
+    adaptive->frame_count++;
+    ScBool areas_changed = SC_FALSE;
+    if (adaptive->frame_count % ADAPTIVE_AREA_UPDATE_INTERVAL == 0) {
+        ScRectangleF area_1d = adaptive->default_area_1d;
+        ScRectangleF area_2d = adaptive->default_area_2d;
+        const ScBool hot_1d = heat_map_hot_area(&adaptive->heat_1d, &area_1d);
+        const ScBool hot_2d = heat_map_hot_area(&adaptive->heat_2d, &area_2d);
+        if (adaptive->default_constraint_1d == SC_CODE_LOCATION_RESTRICT) {
+            area_1d = rectangle_clamp(area_1d, adaptive->default_area_1d);
+        }
+        if (adaptive->default_constraint_2d == SC_CODE_LOCATION_RESTRICT) {
+            area_2d = rectangle_clamp(area_2d, adaptive->default_area_2d);
+        }
+        areas_changed = hot_1d != adaptive->hot_1d || hot_2d != adaptive->hot_2d ||
+                        !rectangles_equal(area_1d, adaptive->area_1d) ||
+                        !rectangles_equal(area_2d, adaptive->area_2d);
+        adaptive->hot_1d = hot_1d;
+        adaptive->hot_2d = hot_2d;
+        adaptive->area_1d = area_1d;
+        adaptive->area_2d = area_2d;
+    }
+
+    const ScBool focused = adaptive->hot_1d || adaptive->hot_2d;
+    const ScBool full_search = !focused ||
+                               adaptive->frame_count % ADAPTIVE_FULL_SEARCH_INTERVAL == 0;
+    if (!areas_changed && full_search == adaptive->full_search) {
+        return;
+    }
+    adaptive->full_search = full_search;
+
+    ScBarcodeScannerSettings *settings = adaptive->settings;
+    const ScRectangleF full_image = { { 0.f, 0.f }, { 1.f, 1.f } };
+    const ScBool focused_1d = !full_search && adaptive->hot_1d;
+    const ScBool focused_2d = !full_search && adaptive->hot_2d;
+    // A restricted full search covers the configured area, not only the hot one.
+    const ScBool default_area_1d = !focused_1d &&
+                                   adaptive->default_constraint_1d == SC_CODE_LOCATION_RESTRICT;
+    const ScBool default_area_2d = !focused_2d &&
+                                   adaptive->default_constraint_2d == SC_CODE_LOCATION_RESTRICT;
+    sc_barcode_scanner_settings_set_code_location_area_1d(
+            settings, default_area_1d ? adaptive->default_area_1d : adaptive->area_1d);
+    sc_barcode_scanner_settings_set_code_location_area_2d(
+            settings, default_area_2d ? adaptive->default_area_2d : adaptive->area_2d);
+    sc_barcode_scanner_settings_set_code_location_constraint_1d(
+            settings, focused_1d ? SC_CODE_LOCATION_RESTRICT : adaptive->default_constraint_1d);
+    sc_barcode_scanner_settings_set_code_location_constraint_2d(
+            settings, focused_2d ? SC_CODE_LOCATION_RESTRICT : adaptive->default_constraint_2d);
+    // Outside of full searches nothing outside of the hot areas is searched at all.
+    ScRectangleF search_area = full_image;
+    if (!full_search && adaptive->hot_1d && adaptive->hot_2d) {
+        search_area = rectangle_union(adaptive->area_1d, adaptive->area_2d);
+    }
+    sc_barcode_scanner_settings_set_search_area(settings, search_area);
+    sc_barcode_scanner_apply_settings(scanner, settings);
+
+    if (areas_changed) {
+        printf("Focusing on 1d area %.2f,%.2f %.2fx%.2f%s, 2d area %.2f,%.2f %.2fx%.2f%s\n",
+               adaptive->area_1d.position.x, adaptive->area_1d.position.y,
+               adaptive->area_1d.size.width, adaptive->area_1d.size.height,
+               adaptive->hot_1d ? "" : " (default)",
+               adaptive->area_2d.position.x, adaptive->area_2d.position.y,
+               adaptive->area_2d.size.width, adaptive->area_2d.size.height,
+               adaptive->hot_2d ? "" : " (default)");
+    }
 }
 
 static void print_all_discrete_resolutions(const ScCamera *cam) {
@@ -58,35 +2391,25 @@ static void print_all_discrete_resolutions(const ScCamera *cam) {
     }
 }
 
-int main(int argc, const char *argv[]) {
-    // Handle ctrl+c events.
-    if (signal(SIGINT, catch_exit) == SIG_ERR) {
-        printf("Could not set up signal handler.\n");
-        return -1;
-    }
-
+/**
+ * Creates the camera and requests the desired resolution if the camera supports it.
+ */
+static ScCamera *create_camera(const char *device_path, ScSize desired_resolution)
+{
     // Create the camera object.
     ScCamera *camera = NULL;
-    if (argc > 1) {
+    if (device_path != NULL) {
         // Setup the camera from a device path. E.g. /dev/video1
-        // We use 4 image buffers.
-        camera = sc_camera_new_from_path(argv[1], 4);
+        // We use CAMERA_BUFFER_COUNT image buffers.
+        camera = sc_camera_new_from_path(device_path, CAMERA_BUFFER_COUNT);
     } else {
         // When no parameters are given, the camera is automatically detected.
-        camera = sc_camera_new();
+        camera = sc_camera_new_with_buffer_count(CAMERA_BUFFER_COUNT);
     }
 
     if (camera == NULL) {
         printf("No camera available.\n");
-        return -1;
-    }
-
-    uint32_t resolution_width = DEFAULT_RESOLUTION_WIDTH;
-    uint32_t resolution_height = DEFAULT_RESOLUTION_HEIGHT;
-    // Read the desired resolution form the command line.
-    if (argc == 4) {
-        resolution_width = atoi(argv[2]);
-        resolution_height = atoi(argv[3]);
+        return NULL;
     }
 
     // Get the supported resolutions and check
@@ -106,12 +2429,12 @@ int main(int argc, const char *argv[]) {
              resolutions_found = sc_camera_query_supported_resolutions(camera, &resolutions[0], resolutions_size);
             if (!resolutions_found) {
                 printf("There was an error getting the discrete resolution capabilities of the camera.\n");
-                return -1;
+                return NULL;
             }
 
             for (int i = 0; i < resolutions_found; i++) {
-                if (resolutions[i].width == resolution_width &&
-                    resolutions[i].height == resolution_height) {
+                if (resolutions[i].width == desired_resolution.width &&
+                    resolutions[i].height == desired_resolution.height) {
                     supported = SC_TRUE;
                     break;
                 }
@@ -124,48 +2447,209 @@ int main(int argc, const char *argv[]) {
             // explanation.
             if (!sc_camera_query_supported_resolutions_stepwise(camera, &swres)) {
                 printf("There was an error getting the stepwise resolution capabilities of the camera.\n");
-                return -1;
+                return NULL;
             }
 
             printf("This camera uses step-wise resolutions:\n");
             printf("\tx: %u:%u:%u\n", swres.min_width, swres.step_width, swres.max_width);
             printf("\ty: %u:%u:%u\n", swres.min_height, swres.step_height, swres.max_height);
 
-            if (swres.min_width <= resolution_width &&
-                resolution_width <= swres.max_width &&
-                swres.min_height <= resolution_height &&
-                resolution_height <= swres.max_height &&
-                resolution_width % swres.step_width == 0 &&
-                resolution_height % swres.step_height == 0) {
+            if (swres.min_width <= desired_resolution.width &&
+                desired_resolution.width <= swres.max_width &&
+                swres.min_height <= desired_resolution.height &&
+                desired_resolution.height <= swres.max_height &&
+                desired_resolution.width % swres.step_width == 0 &&
+                desired_resolution.height % swres.step_height == 0) {
                 supported = SC_TRUE;
             }
             break;
 
         default:
             printf("Could not get camera resolution mode.\n");
-            return -1;
+            return NULL;
     }
 
     // Set the resolution
     if (!supported) {
-        printf("%dx%d is not supported by this camera.\nPlease specify a supported resolution on the command line or in the source code.\n", resolution_width, resolution_height);
+        printf("%dx%d is not supported by this camera.\nPlease specify a supported resolution on the command line or in the source code.\n", desired_resolution.width, desired_resolution.height);
         sc_camera_release(camera);
-        return -1;
+        return NULL;
     }
 
-    ScSize desired_resolution;
-    desired_resolution.width = resolution_width;
-    desired_resolution.height =  resolution_height;
     if (!sc_camera_request_resolution(camera, desired_resolution)) {
         printf("Setting resolution failed.\n");
         sc_camera_release(camera);
+        return NULL;
+    }
+    return camera;
+}
+
+/**
+ * Reads a comma separated list of parse formats, e.g. "gs1,hibc".
+ */
+static ScBool parse_format_mask(const char *list, uint32_t *mask)
+{
+    *mask = 0;
+    while (*list != '\0') {
+        const size_t length = strcspn(list, ",");
+        int format = 0;
+        while (format < PARSE_FORMAT_COUNT &&
+               (strlen(PARSE_FORMATS[format].name) != length ||
+                strncmp(PARSE_FORMATS[format].name, list, length) != 0)) {
+            format++;
+        }
+        if (format == PARSE_FORMAT_COUNT) {
+            return SC_FALSE;
+        }
+        *mask |= 1u << format;
+        list += length;
+        if (*list == ',') {
+            list++;
+        }
+    }
+    return *mask != 0;
+}
+
+int main(int argc, char *argv[]) {
+    // Handle ctrl+c events.
+    if (signal(SIGINT, catch_exit) == SIG_ERR) {
+        printf("Could not set up signal handler.\n");
+        return -1;
+    }
+
+    // A processing time budget enables the governor.
+    float budget_ms = 0.f;
+    ScBool adaptive_area_enabled = SC_FALSE;
+    ScBool ndjson = SC_FALSE;
+    ResultSinkPolicy sink_policy = RESULT_SINK_BLOCK;
+    const char *spill_path = DEFAULT_SPILL_PATH;
+    // A change level enables skipping frames of a static scene.
+    float static_threshold = 0.f;
+    uint32_t static_hold_frames = DEFAULT_STATIC_HOLD_FRAMES;
+    const char *record_path = NULL;
+    const char *replay_path = NULL;
+    ScBool replay_realtime = SC_TRUE;
+    uint32_t parse_formats = 0;
+    static const struct option long_options[] = {
+        { "budget", required_argument, NULL, 'b' },
+        { "adaptive-area", no_argument, NULL, 'a' },
+        { "ndjson", no_argument, NULL, 'n' },
+        { "when-full", required_argument, NULL, 'w' },
+        { "spill-file", required_argument, NULL, 's' },
+        { "skip-static", required_argument, NULL, 'k' },
+        { "static-hold", required_argument, NULL, 'H' },
+        { "record", required_argument, NULL, 'r' },
+        { "replay", required_argument, NULL, 'p' },
+        { "replay-pace", required_argument, NULL, 'P' },
+        { "parse", required_argument, NULL, 'f' },
+        { NULL, 0, NULL, 0 }
+    };
+    int option;
+    while ((option = getopt_long(argc, argv, "b:anw:s:k:H:r:p:P:f:", long_options, NULL)) != -1) {
+        ScBool valid = SC_TRUE;
+        if (option == 'a') {
+            adaptive_area_enabled = SC_TRUE;
+        } else if (option == 'b') {
+            valid = (budget_ms = strtof(optarg, NULL)) > 0.f;
+        } else if (option == 'n') {
+            ndjson = SC_TRUE;
+        } else if (option == 'w') {
+            if (strcmp(optarg, "block") == 0) {
+                sink_policy = RESULT_SINK_BLOCK;
+            } else if (strcmp(optarg, "drop") == 0) {
+                sink_policy = RESULT_SINK_DROP;
+            } else if (strcmp(optarg, "spill") == 0) {
+                sink_policy = RESULT_SINK_SPILL;
+            } else {
+                valid = SC_FALSE;
+            }
+        } else if (option == 's') {
+            spill_path = optarg;
+        } else if (option == 'k') {
+            valid = (static_threshold = strtof(optarg, NULL)) > 0.f;
+        } else if (option == 'H') {
+            static_hold_frames = (uint32_t)strtoul(optarg, NULL, 10);
+        } else if (option == 'r') {
+            record_path = optarg;
+        } else if (option == 'p') {
+            replay_path = optarg;
+        } else if (option == 'P') {
+            if (strcmp(optarg, "realtime") == 0) {
+                replay_realtime = SC_TRUE;
+            } else if (strcmp(optarg, "max") == 0) {
+                replay_realtime = SC_FALSE;
+            } else {
+                valid = SC_FALSE;
+            }
+        } else if (option == 'f') {
+            valid = parse_format_mask(optarg, &parse_formats);
+        } else {
+            valid = SC_FALSE;
+        }
+        if (!valid) {
+            printf("Usage: %s [--budget milliseconds] [--adaptive-area] [--ndjson] "
+                   "[--when-full block|drop|spill] [--spill-file path] "
+                   "[--skip-static level] [--static-hold frames] [--record file] "
+                   "[--replay file [--replay-pace realtime|max]] [--parse gs1,hibc] "
+                   "[device-path [width height]]\n", argv[0]);
+            return -1;
+        }
+    }
+    const int argument_count = argc - optind;
+    char **arguments = argv + optind;
+    const char *device_path = argument_count > 0 ? arguments[0] : NULL;
+
+    if (replay_path != NULL && budget_ms > 0.f) {
+        printf("The governor can not change the mode of a recording, --budget and --replay "
+               "can not be combined.\n");
         return -1;
     }
 
+    ScSize desired_resolution;
+    desired_resolution.width = DEFAULT_RESOLUTION_WIDTH;
+    desired_resolution.height = DEFAULT_RESOLUTION_HEIGHT;
+    // Read the desired resolution form the command line.
+    if (argument_count == 3) {
+        desired_resolution.width = atoi(arguments[1]);
+        desired_resolution.height = atoi(arguments[2]);
+    }
+
+    // The frames come either from the camera or from a recording.
+    ScCamera *camera = NULL;
+    FrameReplay *replay = NULL;
+    if (replay_path != NULL) {
+        replay = frame_replay_open(replay_path, replay_realtime);
+        if (replay == NULL) {
+            return -1;
+        }
+        printf("Replaying %llu frames from '%s' %s.\n", (unsigned long long)replay->frame_count,
+               replay_path, replay_realtime ? "at the recorded pace" : "as fast as possible");
+    } else {
+        camera = create_camera(device_path, desired_resolution);
+        if (camera == NULL) {
+            return -1;
+        }
+    }
+
+    // The governor starts from the requested resolution.
+    Governor *governor = NULL;
+    if (budget_ms > 0.f) {
+        governor = malloc(sizeof(Governor));
+        if (governor == NULL ||
+            !governor_init(governor, camera, desired_resolution, CAMERA_BUFFER_COUNT, budget_ms)) {
+            printf("Could not determine the camera modes for the governor.\n");
+            free(governor);
+            sc_camera_release(camera);
+            return -1;
+        }
+    }
+
     // Start streaming.
-    if (!sc_camera_start_stream(camera)) {
+    if (camera != NULL && !sc_camera_start_stream(camera)) {
         printf("Start the camera failed.\n");
         sc_camera_release(camera);
+        frame_replay_close(replay);
+        free(governor);
         return -1;
     }
 
@@ -177,6 +2661,8 @@ int main(int argc, const char *argv[]) {
     if (context == NULL) {
         printf("Could not initialize context.\n");
         sc_camera_release(camera);
+        frame_replay_close(replay);
+        free(governor);
         return -1;
     }
 
@@ -188,6 +2674,8 @@ int main(int argc, const char *argv[]) {
     if (settings == NULL) {
         sc_recognition_context_release(context);
         sc_camera_release(camera);
+        frame_replay_close(replay);
+        free(governor);
         return -1;
     }
     sc_barcode_scanner_settings_set_symbology_enabled(settings, SC_SYMBOLOGY_EAN13, SC_TRUE);
@@ -225,10 +2713,20 @@ int main(int argc, const char *argv[]) {
 
     // Create a barcode scanner for our context and settings.
     ScBarcodeScanner *scanner = sc_barcode_scanner_new_with_settings(context ,settings);
+    // The adaptive code location area works on its own copy of the settings.
+    AdaptiveArea *adaptive_area = NULL;
+    if (scanner != NULL && adaptive_area_enabled) {
+        adaptive_area = malloc(sizeof(AdaptiveArea));
+        if (adaptive_area != NULL) {
+            adaptive_area_init(adaptive_area, settings);
+        }
+    }
     sc_barcode_scanner_settings_release(settings);
     if (scanner == NULL) {
         sc_recognition_context_release(context);
         sc_camera_release(camera);
+        frame_replay_close(replay);
+        free(governor);
         return -1;
     }
     // The scanner is setup asynchronous.
@@ -240,46 +2738,167 @@ int main(int argc, const char *argv[]) {
     // Signal a new frame sequence to the context.
     sc_recognition_context_start_new_frame_sequence(context);
 
-    // Create an image description that is reused for every frame.
+    // Image descriptions are passed between the threads together with the frames.
     ScImageDescription * image_descr = sc_image_description_new();
+    FrameExchange exchange = {
+        .camera = camera,
+        .replay = replay,
+        .device_path = device_path,
+        .configuration = { .resolution = desired_resolution, .buffer_count = CAMERA_BUFFER_COUNT },
+        .pending_descr = sc_image_description_new(),
+        .capture_running = SC_TRUE
+    };
+    pthread_mutex_init(&exchange.lock, NULL);
+    pthread_cond_init(&exchange.frame_available, NULL);
+    pthread_cond_init(&exchange.frame_returned, NULL);
+
+    // Results are written by the writer thread of the sink. Without it they are printed
+    // from the scan loop.
+    pthread_t writer_thread;
+    ResultSink *sink = result_sink_new(ndjson, sink_policy, spill_path);
+    if (sink != NULL && parse_formats != 0) {
+        sink->parse_stage = parse_stage_new(parse_formats, ndjson);
+    }
+    if (sink != NULL && !result_sink_start(sink, &writer_thread)) {
+        printf("Could not start the result writer thread.\n");
+        result_sink_free(sink);
+        sink = NULL;
+    }
+
+    if (record_path != NULL) {
+        exchange.recorder = frame_recorder_open(record_path);
+        if (exchange.recorder == NULL) {
+            printf("Could not create the recording '%s', frames are not recorded.\n", record_path);
+        }
+    }
+
     process_frames = SC_TRUE;
-    while (process_frames) {
-        // Get the latest camera frame data and description.
-        const uint8_t *image_data = sc_camera_get_frame(camera, image_descr);
+    pthread_t capture_thread;
+    const ScBool capture_thread_started =
+            pthread_create(&capture_thread, NULL, capture_thread_run, &exchange) == 0;
+    if (!capture_thread_started) {
+        printf("Could not start capture thread.\n");
+        exchange.capture_running = SC_FALSE;
+    }
+
+    StaticSceneFilter *static_filter = NULL;
+    if (static_threshold > 0.f) {
+        static_filter = malloc(sizeof(StaticSceneFilter));
+        if (static_filter != NULL) {
+            static_scene_filter_init(static_filter, static_threshold, static_hold_frames);
+        }
+    }
+
+    uint64_t scanned_count = 0;
+    double frame_age_sum = 0.0;
+    double processing_seconds = 0.0;
+    const double scan_start_time = now_seconds();
+    for (;;) {
+        // Get the newest camera frame data and description.
+        double capture_time;
+        const uint8_t *image_data = frame_exchange_take(&exchange, &image_descr, &capture_time);
         if (image_data == NULL) {
-            printf("Frame access failed. Exiting.\n");
             break;
         }
+        if (static_filter != NULL && !static_scene_filter_check(static_filter, image_descr, image_data)) {
+            // Nothing moved since the last scanned frame.
+            frame_exchange_return(&exchange, image_data);
+            continue;
+        }
+        scanned_count++;
+        frame_age_sum += now_seconds() - capture_time;
 
         // Process the frame.
+        const double process_start = now_seconds();
         ScProcessFrameResult result = sc_recognition_context_process_frame(context, image_descr, image_data);
+        const double process_seconds = now_seconds() - process_start;
+        const float latency_ms = (float)(process_seconds * 1000.0);
+        processing_seconds += process_seconds;
         if (result.status != SC_RECOGNITION_CONTEXT_STATUS_SUCCESS) {
             printf("Processing frame failed with error %d: '%s'\n", result.status,
                    sc_context_status_flag_get_message(result.status));
         }
 
-        // Get the results. If there is a barcode, print it!
+        // Frames captured before a mode switch are not counted for the new mode.
+        CameraConfiguration next_configuration;
+        if (governor != NULL &&
+            sc_image_description_get_width(image_descr) == governor->configuration.resolution.width &&
+            sc_image_description_get_height(image_descr) == governor->configuration.resolution.height &&
+            governor_update(governor, latency_ms, &next_configuration)) {
+            frame_exchange_request_configuration(&exchange, &next_configuration);
+        }
+
+        // Get the results. If there is a barcode, hand it to the writer!
         ScBarcodeArray * new_codes = sc_barcode_scanner_session_get_newly_recognized_codes(session);
         int code_count = sc_barcode_array_get_size(new_codes);
+        const double recognition_time = code_count > 0 ? wall_seconds() : 0.0;
+        const double frame_capture_time = recognition_time - (now_seconds() - capture_time);
         for (int i = 0; i < code_count; i++) {
             const ScBarcode * code = sc_barcode_array_get_item_at(new_codes, i);
-            ScByteArray data = sc_barcode_get_data(code);
-            printf("Barcode found: '%s'\n", data.str);
+            if (sink != NULL) {
+                result_sink_push(sink, code, frame_capture_time, recognition_time);
+            } else {
+                ScByteArray data = sc_barcode_get_data(code);
+                printf("Barcode found: '%s'\n", data.str);
+            }
+        }
+
+        if (adaptive_area != NULL && result.status == SC_RECOGNITION_CONTEXT_STATUS_SUCCESS) {
+            adaptive_area_update(adaptive_area, scanner, new_codes,
+                                 sc_image_description_get_width(image_descr),
+                                 sc_image_description_get_height(image_descr));
         }
 
         // Signal the camera that we are done reading the image buffer.
-        sc_camera_enqueue_frame_data(camera, image_data);
+        frame_exchange_return(&exchange, image_data);
 
         // Cleanup the memory we used.
         sc_barcode_array_release(new_codes);
     }
 
+    const double scan_seconds = now_seconds() - scan_start_time;
+    if (capture_thread_started) {
+        pthread_join(capture_thread, NULL);
+    }
+    if (exchange.recorder != NULL && !frame_recorder_close(exchange.recorder)) {
+        printf("Writing the recording '%s' failed.\n", record_path);
+    }
+    if (sink != NULL) {
+        result_sink_close(sink, writer_thread);
+    }
+    if (static_filter != NULL) {
+        printf("Static scene filter: %llu frames processed, %llu skipped\n",
+               (unsigned long long)static_filter->processed_count,
+               (unsigned long long)static_filter->skipped_count);
+        free(static_filter->reference);
+        free(static_filter);
+    }
+    printf("Captured %llu frames, scanned %llu, dropped %llu stale frames. "
+           "Mean frame age when scanning started: %.1f ms\n",
+           (unsigned long long)exchange.captured_count, (unsigned long long)scanned_count,
+           (unsigned long long)exchange.dropped_count,
+           scanned_count > 0 ? frame_age_sum / scanned_count * 1000.0 : 0.0);
+    printf("Scanned %.1f frames per second, mean processing time %.2f ms\n",
+           scan_seconds > 0.0 ? scanned_count / scan_seconds : 0.0,
+           scanned_count > 0 ? processing_seconds / scanned_count * 1000.0 : 0.0);
+
     // Signal to the context that the frame sequence is finished.
     sc_recognition_context_end_frame_sequence(context);
 
     // Cleanup all objects.
+    pthread_mutex_destroy(&exchange.lock);
+    pthread_cond_destroy(&exchange.frame_available);
+    pthread_cond_destroy(&exchange.frame_returned);
+    sc_image_description_release(exchange.pending_descr);
     sc_image_description_release(image_descr);
     sc_barcode_scanner_release(scanner);
     sc_recognition_context_release(context);
-    sc_camera_release(camera);
+    // The capture thread may have opened the camera again.
+    sc_camera_release(exchange.camera);
+    frame_replay_close(replay);
+    free(governor);
+    if (adaptive_area != NULL) {
+        sc_barcode_scanner_settings_release(adaptive_area->settings);
+        free(adaptive_area);
+    }
 }
@@ -1,6 +1,8 @@
 #!/usr/bin/env python
 
+import asyncio
 import scanditsdk as sc
+import scanditsdk_async
 import sys
 import tempfile
 
@@ -68,6 +70,25 @@ def setup_camera():
     return camera
 
 
+async def scan_codes(camera, context, scanner):
+    # Frames are captured and scanned on a background thread. Each camera buffer is
+    # handed back as soon as its frame is scanned. Only frames with codes arrive here.
+    async with scanditsdk_async.AsyncCameraScanner(camera, context, scanner) as frames:
+        try:
+            async for scan in frames:
+                for code in scan.codes:
+                    print(
+                        "Barcode found: ",
+                        code.data,
+                        " (",
+                        code.symbology_string,
+                        ")",
+                        sep="",
+                    )
+        except RuntimeError as error:
+            print(error)
+
+
 def run():
     #  Create a recognition context. Files created by the recognition context and the
     #  attached scanner will be written to a temporary directory. In production environment,
@@ -79,38 +100,10 @@ def run():
 
     scanner_settings = generate_settings()
     camera = setup_camera()
-    camera.start_streaming()
     scanner = sc.BarcodeScanner(context, scanner_settings)
     scanner.wait_for_setup_completed()
 
-    frame_seq = context.start_new_frame_sequence()
-
-    no_error = True
-    while no_error:
-        frame = camera.frame
-        status = frame_seq.process_frame(frame.description, frame.data)
-
-        if status.status != sc.RECOGNITION_CONTEXT_STATUS_SUCCESS:
-            print(
-                "Processing frame failed with code {}: {}".format(
-                    status.status, status.get_status_flag_message()
-                )
-            )
-            no_error = False
-
-        codes = scanner.session.newly_recognized_codes
-        if len(codes):
-            for code in codes:
-                print(
-                    "Barcode found: ",
-                    code.data,
-                    " (",
-                    code.symbology_string,
-                    ")",
-                    sep="",
-                )
-
-    frame_seq.end()
+    asyncio.run(scan_codes(camera, context, scanner))
 
 
 if __name__ == "__main__":
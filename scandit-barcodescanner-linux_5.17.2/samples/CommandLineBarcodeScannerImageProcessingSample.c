@@ -4,54 +4,481 @@
  * \brief ScanditSDK demo application
  *
  * Takes a list of input images and directories (containing images) as argument.
- * The resulting input images are processed in reverse order by the barcode
- * scanner.
+ * Directories are walked recursively. The resulting input images are processed by
+ * the barcode scanner and the results are printed in the order in which the images
+ * were found. Scanning starts as soon as the first images are found, the directory
+ * trees are enumerated while the scanner is already running.
  *
  * This example is configured to achieve a good scan performance on a single image
  * (not a video stream). We assume that we have infinite processing power and no
  * real time requirements.
  *
+ * Large image collections can be processed in batch mode by passing the number of
+ * worker threads with -j (e.g. -j 8). Every worker owns its own recognition context
+ * and barcode scanner. The images are handed out in small chunks, largest file of a
+ * chunk first, and idle workers steal images from busy ones, so that all cores stay
+ * busy until the end of the batch.
+ * In batch mode an image that can not be loaded or processed does not stop the run.
+ *
+ * Every worker is a small pipeline: a decode thread reads and decodes the images and
+ * passes them to the scan thread through a bounded lock-free ring. File I/O and
+ * decoding therefore overlap with recognition. When the queue is full the decode
+ * thread waits, so no more than DECODE_QUEUE_SIZE decoded images per worker are held
+ * in memory. The main thread reports the results. With --stats the time every stage
+ * spent working and waiting is printed at the end, which shows the bottleneck.
+ *
+ * Example:
+ * ./CommandLineBarcodeScannerImageProcessingSample -j 8 --stats /data/archive
+ *
+ * Images that are already decoded are scanned without decoding or copying: binary
+ * PGM files (.pgm) and raw Y8 (.y8), NV12 (.nv12) and I420 (.i420) frames are mapped
+ * into memory and passed to the recognition context as they are. A raw frame needs a
+ * header file next to it, named like the frame with ".hdr" appended, that holds the
+ * width, the height and optionally the bytes per row of the luma plane, e.g. "1280 720".
+ *
+ * Large images with many small codes (pallets, shelves, document scans) are scanned
+ * in overlapping tiles with --tile SIZE. Every image wider or higher than SIZE pixels
+ * is split into tiles of SIZE x SIZE that overlap by --tile-overlap pixels, and the
+ * tiles are scanned in parallel by the worker and a pool of tile helper threads that
+ * use the cores left over by the workers. The tiles point into the decoded image, no
+ * pixels are copied. Codes that are found in two neighbouring tiles are reported once,
+ * their locations are given in image coordinates. The overlap must be larger than the
+ * largest code, otherwise a code on a tile border may be found in no tile at all.
+ *
+ * Example:
+ * ./CommandLineBarcodeScannerImageProcessingSample --tile 1024 pallet.png
+ *
+ * With --daemon the sample runs as a scan service instead. The workers set up their
+ * recognition contexts and scanners once and then serve requests from a Unix domain
+ * socket, so the time per request is spent on recognition only. Every request is a
+ * JSON object on one line naming either an image file or a POSIX shared memory
+ * object together with the ScImageDescription fields of the image in it:
+ *
+ * {"id": 1, "path": "/data/image.png"}
+ * {"id": 2, "shm": "/frame", "layout": "gray", "width": 1280, "height": 720,
+ *  "first_plane_row_bytes": 1280, "memory_size": 921600}
+ *
+ * Each request is answered with one line of JSON (NDJSON) that repeats the id:
+ *
+ * {"id":1,"status":"ok","recognition_ms":12.345,"codes":[{"symbology":"ean13",
+ *  "data":"9781234567897","location":[[10,20],[200,20],[200,80],[10,80]]}]}
+ *
+ * Example:
+ * ./CommandLineBarcodeScannerImageProcessingSample -j 4 --daemon /tmp/scan.sock
+ *
  * \copyright Copyright (c) 2018 Scandit AG. All rights reserved.
  */
 
+#define _GNU_SOURCE
+
+#include <ctype.h>
 #include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <string.h>
+#include <strings.h>
 #include <stdlib.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#include <SDL2/SDL_endian.h>
 #include <SDL2/SDL_image.h>
 #include <SDL2/SDL_surface.h>
 
 #include <Scandit/ScRecognitionContext.h>
 #include <Scandit/ScBarcodeScanner.h>
 
+#include "JsonParsing.h"
+#include "LumaConversion.h"
+
 // Please insert your app key here:
 #define SCANDIT_SDK_LICENSE_KEY "-- INSERT YOUR LICENSE KEY HERE --"
 
+// Upper limit for the number of worker threads in batch mode.
+#define MAX_WORKER_COUNT 256
+
+// Directories nested deeper than this are skipped.
+#define MAX_DIRECTORY_DEPTH 64
+// Size of the buffer for the directory entries of one directory level.
+#define DIRECTORY_BUFFER_SIZE (32 * 1024)
+
+// Images are scheduled in chunks of CHUNK_SIZE_PER_WORKER * worker count images.
+// At most LOOKAHEAD_CHUNKS chunks are enumerated ahead of the printed results.
+#define CHUNK_SIZE_PER_WORKER 4
+#define LOOKAHEAD_CHUNKS 8
+
+// Maximum number of codes per frame when scanning in tiles.
+#define TILE_MAX_CODES_PER_FRAME 64
+#define DEFAULT_TILE_OVERLAP 256
+#define MIN_TILE_SIZE 64
+
+// Number of decoded images that can wait for the scan thread of a worker.
+#define DECODE_QUEUE_SIZE 4
+// Marks the entry that tells the scan thread to stop.
+#define END_OF_INPUT ((size_t)-1)
+
+// Number of requests that can wait for a free scanner in daemon mode.
+#define DAEMON_JOB_QUEUE_SIZE 256
+// Maximum length of one request line in daemon mode.
+#define DAEMON_MAX_REQUEST_LENGTH 8192
+#define DAEMON_MAX_CLIENTS 64
+
 static char const * const ENABLED_FILE_EXTENSIONS[] = {
     "png",
     "jpg",
     "jpeg",
     "tif",
     "bmp",
+    "pgm",
+    "y8",
+    "nv12",
+    "i420",
     NULL
 };
 
+typedef struct MappedImageFormat {
+    const char *extension;
+    ScImageLayout layout;
+} MappedImageFormat;
+
+// Formats that are mapped into memory and scanned without decoding. All but PGM
+// are raw frames that need a header file with their dimensions.
+static const MappedImageFormat MAPPED_IMAGE_FORMATS[] = {
+    { "pgm", SC_IMAGE_LAYOUT_GRAY_8U },
+    { "y8", SC_IMAGE_LAYOUT_GRAY_8U },
+    { "nv12", SC_IMAGE_LAYOUT_YPCBCR_8U },
+    { "i420", SC_IMAGE_LAYOUT_I420_8U },
+    { NULL, SC_IMAGE_LAYOUT_UNKNOWN }
+};
+
 typedef struct InputImage {
-    char const *file_name;
-    struct InputImage const *next;
+    char *file_name;
+    // Size of the file on disk. Used to schedule the largest images first.
+    off_t file_size;
 } InputImage;
 
+/**
+ * One open directory of the input enumerator. The entries are read in chunks
+ * with getdents64.
+ */
+typedef struct DirectoryLevel {
+    int fd;
+    long buffer_length;
+    long buffer_offset;
+    // Length of the directory path in InputEnumerator::path.
+    size_t path_length;
+    char buffer[DIRECTORY_BUFFER_SIZE];
+} DirectoryLevel;
+
+/**
+ * Lazily walks the command line arguments and the directory trees below them. The
+ * memory used only depends on the depth of the trees, not on the number of files.
+ */
+typedef struct InputEnumerator {
+    char const * const *arguments;
+    int argument_count;
+    int next_argument;
+    DirectoryLevel *levels[MAX_DIRECTORY_DEPTH];
+    int depth;
+    char path[PATH_MAX];
+} InputEnumerator;
+
+// Directory entry as returned by the getdents64 system call.
+struct linux_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+/**
+ * Growable text buffer. Workers write their output into it so that the results
+ * can be printed in input order.
+ */
+typedef struct TextBuffer {
+    char *text;
+    size_t length;
+    size_t capacity;
+} TextBuffer;
+
+/**
+ * 8 bit gray image. The buffer is reused for consecutive images and only grows.
+ */
+typedef struct GrayImage {
+    uint8_t *data;
+    size_t capacity;
+    uint32_t width;
+    uint32_t height;
+    uint32_t row_bytes;
+} GrayImage;
+
+/**
+ * A raw or PGM image file mapped into memory. The offsets are relative to the start
+ * of the mapping, which is passed to the recognition context as image data.
+ */
+typedef struct MappedImage {
+    void *mapping;
+    size_t mapping_size;
+    ScImageLayout layout;
+    uint32_t width;
+    uint32_t height;
+    uint32_t first_plane_offset;
+    uint32_t first_plane_row_bytes;
+    uint32_t second_plane_offset;
+    uint32_t second_plane_row_bytes;
+    uint32_t memory_size;
+} MappedImage;
+
+typedef struct ScanResult {
+    TextBuffer output;
+    ScBool failed;
+    ScBool done;
+} ScanResult;
+
+/**
+ * An image that has been enumerated but whose result has not been printed yet.
+ */
+typedef struct BatchSlot {
+    InputImage input;
+    ScanResult result;
+} BatchSlot;
+
+/**
+ * Work-stealing queue of slot indices. The owning worker takes images from the
+ * head, other workers steal from the tail. Head and tail only grow, the indices
+ * are stored in a ring buffer that is as large as the number of slots.
+ */
+typedef struct WorkQueue {
+    size_t *indices;
+    size_t capacity;
+    size_t head;
+    size_t tail;
+    pthread_mutex_t lock;
+} WorkQueue;
+
+/**
+ * An image on its way from the decode thread to the scan thread of a worker.
+ */
+typedef struct DecodedImage {
+    // Index of the batch slot of the image, END_OF_INPUT to stop the scan thread.
+    size_t slot_index;
+    ScBool loaded;
+    GrayImage image;
+    // Used instead of the image for raw and PGM files. Unmapped by the scan thread.
+    MappedImage mapped;
+} DecodedImage;
+
+/**
+ * Bounded lock-free single producer, single consumer ring between the decode and the
+ * scan thread. The entries are filled and read in place, their image buffers are
+ * reused. The counters only grow. A thread that finds the ring full or empty sets its
+ * waiting flag and sleeps on an eventfd, which the other thread only writes to while
+ * the flag is set, so a queue that keeps flowing costs no system calls.
+ */
+typedef struct DecodeQueue {
+    DecodedImage entries[DECODE_QUEUE_SIZE];
+    // Advanced by the decode thread only.
+    uint64_t tail;
+    // Advanced by the scan thread only.
+    uint64_t head;
+    int decode_waiting;
+    int scan_waiting;
+    // Written when the ring stops being full or empty, -1 if not created.
+    int not_full_fd;
+    int not_empty_fd;
+} DecodeQueue;
+
+/**
+ * Time a pipeline stage spent working and waiting.
+ */
+typedef struct StageStatistics {
+    uint64_t items;
+    double busy_seconds;
+    // Waiting for the previous stage (starved).
+    double input_wait_seconds;
+    // Waiting for the next stage (backpressure).
+    double output_wait_seconds;
+} StageStatistics;
+
+struct WorkerPool;
+
+typedef struct ScanWorker {
+    struct WorkerPool *pool;
+    size_t index;
+    pthread_t scan_thread;
+    pthread_t decode_thread;
+    ScBool scan_thread_started;
+    ScBool decode_thread_started;
+    WorkQueue work_queue;
+    DecodeQueue decode_queue;
+
+    ScRecognitionContext *context;
+    ScBarcodeScanner *scanner;
+    ScImageDescription *image_descr;
+    // The settings of the scanner, applied again when the maximum number of codes per
+    // frame changes between whole images and tiles.
+    ScBarcodeScannerSettings *settings;
+    uint32_t default_max_codes_per_frame;
+    uint32_t max_codes_per_frame;
+
+    StageStatistics decode_statistics;
+    StageStatistics scan_statistics;
+    // Sum of the number of queued images, sampled whenever the scan thread takes one.
+    uint64_t queue_occupancy_sum;
+} ScanWorker;
+
+/**
+ * A code found in a tile. The location is in full image coordinates.
+ */
+typedef struct TileCode {
+    ScSymbology symbology;
+    ScQuadrilateral location;
+    char *data;
+    uint32_t data_length;
+} TileCode;
+
+/**
+ * A large image that is scanned in overlapping tiles. The tiles are handed out one
+ * by one to the worker that submitted the job and to the tile helpers. All members
+ * except the image and the tile grid are protected by the lock of the tile pool.
+ */
+typedef struct TileJob {
+    const GrayImage *image;
+    uint32_t columns;
+    uint32_t rows;
+    uint32_t tile_count;
+    uint32_t next_tile;
+    uint32_t finished_tiles;
+
+    TileCode *codes;
+    size_t code_count;
+    size_t code_capacity;
+    ScBool failed;
+    ScContextStatusFlag failure;
+
+    struct TileJob *next;
+} TileJob;
+
+struct TilePool;
+
+typedef struct TileHelper {
+    struct TilePool *pool;
+    pthread_t thread;
+    ScBool thread_started;
+    ScanWorker scan;
+} TileHelper;
+
+/**
+ * Threads with their own recognition context and scanner that help scanning the
+ * tiles of large images.
+ */
+typedef struct TilePool {
+    uint32_t tile_size;
+    uint32_t overlap;
+    TileHelper *helpers;
+    size_t helper_count;
+    const ScBarcodeScannerSettings *settings;
+
+    pthread_mutex_t lock;
+    pthread_cond_t job_available;
+    pthread_cond_t tile_finished;
+    // Jobs that still have tiles to hand out.
+    TileJob *jobs;
+    size_t ready_count;
+    ScBool setup_failed;
+    ScBool shutting_down;
+} TilePool;
+
+typedef struct WorkerPool {
+    ScanWorker *workers;
+    size_t worker_count;
+    const ScBarcodeScannerSettings *settings;
+    // Helpers for scanning large images in tiles, NULL if tiling is disabled.
+    TilePool *tile_pool;
+
+    // Ring buffer of the images in flight.
+    BatchSlot *slots;
+    size_t slot_count;
+    size_t chunk_size;
+
+    pthread_mutex_t lock;
+    pthread_cond_t work_available;
+    pthread_cond_t result_ready;
+    uint64_t work_generation;
+    size_t ready_count;
+    // Start of the run. Waiting before this point is not counted in the statistics.
+    double run_start_seconds;
+    StageStatistics report_statistics;
+    ScBool setup_failed;
+    ScBool shutting_down;
+} WorkerPool;
+
+static void text_buffer_printf(TextBuffer *buffer, const char *format, ...)
+{
+    for (;;) {
+        const size_t available = buffer->capacity - buffer->length;
+        va_list args;
+        va_start(args, format);
+        const int written = vsnprintf(buffer->text + buffer->length, available,
+                                      format, args);
+        va_end(args);
+        if (written < 0) {
+            return;
+        }
+        if ((size_t)written < available) {
+            buffer->length += written;
+            return;
+        }
+        const size_t new_capacity = buffer->capacity * 2 + written + 1;
+        char *new_text = realloc(buffer->text, new_capacity);
+        if (new_text == NULL) {
+            return;
+        }
+        buffer->text = new_text;
+        buffer->capacity = new_capacity;
+    }
+}
+
+static void text_buffer_free(TextBuffer *buffer)
+{
+    free(buffer->text);
+    buffer->text = NULL;
+    buffer->length = 0;
+    buffer->capacity = 0;
+}
+
+/**
+ * Returns the extension of the file name without the dot, or an empty string.
+ */
+static const char *file_extension(const char *file_name)
+{
+    const char *dot = strrchr(file_name, '.');
+    const char *slash = strrchr(file_name, '/');
+    return dot != NULL && (slash == NULL || dot > slash) ? dot + 1 : "";
+}
+
+/**
+ * Returns whether the file has one of the enabled extensions, in any case.
+ */
 static int has_valid_extension(char const *file_name)
 {
+    const char *file_name_extension = file_extension(file_name);
     char const * const *extension = ENABLED_FILE_EXTENSIONS;
     for (; *extension != NULL; ++extension) {
-        const size_t file_name_length = strlen(file_name);
-        const size_t extension_length = strlen(*extension);
-
-        char const * const file_extension =
-                file_name + (file_name_length - extension_length);
-        if (file_name_length >= extension_length &&
-            strcmp(file_extension, *extension) == 0) {
+        if (strcasecmp(file_name_extension, *extension) == 0) {
             return SC_TRUE;
         }
     }
@@ -59,139 +486,501 @@ static int has_valid_extension(char const *file_name)
     return SC_FALSE;
 }
 
-static InputImage *push_if_valid_image(char const * filename,
-                                      InputImage *container)
+static void input_enumerator_init(InputEnumerator *enumerator, int argument_count,
+                                  char const * const *arguments)
 {
-    if (has_valid_extension(filename) == SC_TRUE) {
-        InputImage *new_image = malloc(sizeof(InputImage));
-        const size_t target_size = strlen(filename) + 1;
-        new_image->file_name = malloc(target_size);
-        strncpy((char*)new_image->file_name, filename, target_size);
+    memset(enumerator, 0, sizeof(InputEnumerator));
+    enumerator->arguments = arguments;
+    enumerator->argument_count = argument_count;
+}
 
-        new_image->next = container;
+static void input_enumerator_release(InputEnumerator *enumerator)
+{
+    while (enumerator->depth > 0) {
+        close(enumerator->levels[--enumerator->depth]->fd);
+    }
+    for (int i = 0; i < MAX_DIRECTORY_DEPTH; ++i) {
+        free(enumerator->levels[i]);
+        enumerator->levels[i] = NULL;
+    }
+}
 
-        container = new_image;
+/**
+ * Descends into the directory fd. The path of the directory has to be stored in
+ * the path buffer of the enumerator. Takes ownership of fd.
+ */
+static void input_enumerator_push_directory(InputEnumerator *enumerator, int fd,
+                                            size_t path_length)
+{
+    if (enumerator->depth == MAX_DIRECTORY_DEPTH) {
+        printf("Skipping '%s': directories are nested too deeply.\n", enumerator->path);
+        close(fd);
+        return;
+    }
+    DirectoryLevel *level = enumerator->levels[enumerator->depth];
+    if (level == NULL) {
+        level = malloc(sizeof(DirectoryLevel));
+        if (level == NULL) {
+            printf("Skipping '%s': out of memory.\n", enumerator->path);
+            close(fd);
+            return;
+        }
+        enumerator->levels[enumerator->depth] = level;
     }
+    level->fd = fd;
+    level->buffer_length = 0;
+    level->buffer_offset = 0;
+    level->path_length = path_length;
+    enumerator->depth++;
+}
 
-    return container;
+static void input_enumerator_set_image(InputEnumerator *enumerator, const struct stat *file_stat,
+                                       InputImage *image)
+{
+    image->file_name = strdup(enumerator->path);
+    image->file_size = file_stat != NULL ? file_stat->st_size : 0;
 }
 
-InputImage const *get_input_files(int argc, char const *argv[])
+/**
+ * Returns the next image of the command line arguments. Directories are entered
+ * recursively. Symbolic links to files are followed, symbolic links to directories
+ * are not, so that cycles can not occur.
+ *
+ * \returns SC_FALSE when all arguments have been enumerated.
+ */
+static ScBool input_enumerator_next(InputEnumerator *enumerator, InputImage *image)
 {
-    InputImage *ret = NULL;
+    for (;;) {
+        if (enumerator->depth == 0) {
+            if (enumerator->next_argument == enumerator->argument_count) {
+                return SC_FALSE;
+            }
+            char const * const current_arg = enumerator->arguments[enumerator->next_argument++];
+            size_t length = strlen(current_arg);
+            if (length >= sizeof(enumerator->path)) {
+                printf("Skipping '%s': path too long.\n", current_arg);
+                continue;
+            }
+            memcpy(enumerator->path, current_arg, length + 1);
+            while (length > 1 && enumerator->path[length - 1] == '/') {
+                enumerator->path[--length] = '\0';
+            }
 
-    // We skip the first argument
-    for (int arg_idx = 1; arg_idx < argc; ++arg_idx) {
-        char const * const current_arg = argv[arg_idx];
+            const int fd = open(current_arg, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if (fd >= 0) {
+                // We have a directory
+                input_enumerator_push_directory(enumerator, fd, length);
+            } else if (has_valid_extension(current_arg)) {
+                // We have a file
+                struct stat file_stat;
+                const ScBool exists = stat(current_arg, &file_stat) == 0;
+                input_enumerator_set_image(enumerator, exists ? &file_stat : NULL, image);
+                return SC_TRUE;
+            }
+            continue;
+        }
+
+        DirectoryLevel *level = enumerator->levels[enumerator->depth - 1];
+        if (level->buffer_offset >= level->buffer_length) {
+            const long read_bytes = syscall(SYS_getdents64, level->fd, level->buffer,
+                                            sizeof(level->buffer));
+            if (read_bytes <= 0) {
+                if (read_bytes < 0) {
+                    enumerator->path[level->path_length] = '\0';
+                    printf("Reading directory '%s' failed: %s\n", enumerator->path,
+                           strerror(errno));
+                }
+                close(level->fd);
+                enumerator->depth--;
+                continue;
+            }
+            level->buffer_length = read_bytes;
+            level->buffer_offset = 0;
+        }
+
+        const struct linux_dirent64 *entry =
+                (const struct linux_dirent64 *)(level->buffer + level->buffer_offset);
+        level->buffer_offset += entry->d_reclen;
+
+        char const * const name = entry->d_name;
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) {
+            continue;
+        }
+        const size_t name_length = strlen(name);
+        const size_t path_length = level->path_length + 1 + name_length;
+        if (path_length >= sizeof(enumerator->path)) {
+            continue;
+        }
+        enumerator->path[level->path_length] = '/';
+        memcpy(enumerator->path + level->path_length + 1, name, name_length + 1);
 
-        DIR *dir;
-        struct dirent *ent;
-        if ((dir = opendir(current_arg)) != NULL) {
-            // We have a directory
-            while ((ent = readdir (dir)) != NULL) {
-                char *combined_name = malloc(sizeof(current_arg) +
-                                             sizeof(ent->d_name) + 2);
-                combined_name[0] = '\0';
-                strcat(combined_name, current_arg);
-                strcat(combined_name, "/");
-                strcat(combined_name, ent->d_name);
+        unsigned char type = entry->d_type;
+        if (type == DT_UNKNOWN) {
+            // Not all file systems report the type of the entries.
+            struct stat link_stat;
+            if (fstatat(level->fd, name, &link_stat, AT_SYMLINK_NOFOLLOW) != 0) {
+                continue;
+            }
+            type = S_ISDIR(link_stat.st_mode) ? DT_DIR :
+                   S_ISREG(link_stat.st_mode) ? DT_REG :
+                   S_ISLNK(link_stat.st_mode) ? DT_LNK : DT_UNKNOWN;
+        }
 
-                ret = push_if_valid_image(combined_name, ret);
-                free(combined_name);
+        if (type == DT_DIR) {
+            const int fd = openat(level->fd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if (fd < 0) {
+                printf("Could not open directory '%s': %s\n", enumerator->path, strerror(errno));
+                continue;
             }
-            closedir (dir);
-        } else {
-            // We have a file
-            ret = push_if_valid_image(current_arg, ret);
+            input_enumerator_push_directory(enumerator, fd, path_length);
+            continue;
         }
+
+        if ((type != DT_REG && type != DT_LNK) || !has_valid_extension(name)) {
+            continue;
+        }
+        struct stat file_stat;
+        if (fstatat(level->fd, name, &file_stat, 0) != 0 || !S_ISREG(file_stat.st_mode)) {
+            continue;
+        }
+        input_enumerator_set_image(enumerator, &file_stat, image);
+        return SC_TRUE;
+    }
+}
+
+/**
+ * Returns the byte position of a color channel inside a pixel.
+ */
+static uint32_t channel_byte_offset(uint32_t shift, uint32_t bytes_per_pixel)
+{
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+    return bytes_per_pixel - 1 - shift / 8;
+#else
+    (void)bytes_per_pixel;
+    return shift / 8;
+#endif
+}
+
+/**
+ * Ensures that the buffer of the image can hold at least size bytes. The buffer
+ * only grows, so that it can be reused for all images of a run.
+ */
+static ScBool gray_image_reserve(GrayImage *image, size_t size)
+{
+    if (size <= image->capacity) {
+        return SC_TRUE;
+    }
+    uint8_t *data = realloc(image->data, size);
+    if (data == NULL) {
+        return SC_FALSE;
     }
+    image->data = data;
+    image->capacity = size;
+    return SC_TRUE;
+}
 
-    return ret;
+static void gray_image_free(GrayImage *image)
+{
+    free(image->data);
+    image->data = NULL;
+    image->capacity = 0;
 }
 
 /**
- * Helper function to load image from disk using SDL2
+ * Writes the luma (ITU-R BT.601 weights) of the surface into the image buffer. Returns SC_FALSE if the pixel
+ * format of the surface is not handled directly.
  */
-static ScBool load_image(const char* image_name, uint8_t** data,
-                         uint32_t* width, uint32_t *height,
-                         uint32_t* row_stride)
+static ScBool convert_surface_to_luma(SDL_Surface *surface, GrayImage *image)
 {
-    SDL_Surface *image = IMG_Load(image_name);
-    if (image == NULL) {
-        printf("IMG_Load '%s' failed: %s\n", image_name, IMG_GetError());
+    const SDL_PixelFormat *format = surface->format;
+    const uint32_t width = surface->w;
+    const uint32_t height = surface->h;
+    const uint32_t bytes_per_pixel = format->BytesPerPixel;
+
+    uint8_t palette_luma[256];
+    if (format->palette != NULL && bytes_per_pixel == 1) {
+        const SDL_Palette *palette = format->palette;
+        memset(palette_luma, 0, sizeof(palette_luma));
+        for (int i = 0; i < palette->ncolors && i < 256; ++i) {
+            const SDL_Color color = palette->colors[i];
+            palette_luma[i] = rgb_to_luma(color.r, color.g, color.b);
+        }
+    } else if ((bytes_per_pixel != 3 && bytes_per_pixel != 4) ||
+               format->Rloss != 0 || format->Gloss != 0 || format->Bloss != 0 ||
+               format->Rshift % 8 != 0 || format->Gshift % 8 != 0 || format->Bshift % 8 != 0) {
         return SC_FALSE;
     }
 
-    SDL_Surface* image_rgb = SDL_ConvertSurfaceFormat(image,
-                                                      SDL_PIXELFORMAT_RGB24,
-                                                      0);
-    SDL_FreeSurface(image);
-    if (image_rgb == NULL) {
-        printf("Image '%s' convertion failed: %s\n", image_name, IMG_GetError());
+    if (!gray_image_reserve(image, (size_t)width * height)) {
         return SC_FALSE;
     }
+    image->width = width;
+    image->height = height;
+    image->row_bytes = width;
 
-    *width = image_rgb->w;
-    *height = image_rgb->h;
-    *row_stride = image_rgb->pitch;
-    const int blob_size = *row_stride * *height;
+    const PixelChannels channels = {
+        bytes_per_pixel,
+        channel_byte_offset(format->Rshift, bytes_per_pixel),
+        channel_byte_offset(format->Gshift, bytes_per_pixel),
+        channel_byte_offset(format->Bshift, bytes_per_pixel)
+    };
+    if (SDL_MUSTLOCK(surface)) {
+        SDL_LockSurface(surface);
+    }
+    for (uint32_t y = 0; y < height; ++y) {
+        const uint8_t *source = (const uint8_t *)surface->pixels + (size_t)y * surface->pitch;
+        uint8_t *target = image->data + (size_t)y * image->row_bytes;
+        if (bytes_per_pixel == 1) {
+            for (uint32_t x = 0; x < width; ++x) {
+                target[x] = palette_luma[source[x]];
+            }
+        } else {
+            pixels_to_luma(source, target, width, &channels);
+        }
+    }
+    if (SDL_MUSTLOCK(surface)) {
+        SDL_UnlockSurface(surface);
+    }
+    return SC_TRUE;
+}
 
-    printf("Image '%s' size: %ux%u, stride %u (%u bytes)\n", image_name, *width, *height,
-           *row_stride, blob_size);
-    *data = malloc(blob_size);
-    memcpy(*data, image_rgb->pixels, blob_size);
+/**
+ * Helper function to load image from disk using SDL2
+ *
+ * The decoded image is converted to 8 bit gray, the layout the barcode scanner works
+ * on internally, and written into the reusable buffer of the image. The buffer can be
+ * passed to the recognition context as is.
+ */
+static ScBool load_image(const char* image_name, GrayImage *image, TextBuffer *output)
+{
+    SDL_Surface *surface = IMG_Load(image_name);
+    if (surface == NULL) {
+        text_buffer_printf(output, "IMG_Load '%s' failed: %s\n", image_name, IMG_GetError());
+        return SC_FALSE;
+    }
 
-    SDL_FreeSurface(image_rgb);
+    ScBool converted = convert_surface_to_luma(surface, image);
+    if (!converted) {
+        // Uncommon pixel formats (e.g. 16 bit) take the detour over RGB24.
+        SDL_Surface *surface_rgb = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGB24, 0);
+        if (surface_rgb != NULL) {
+            converted = convert_surface_to_luma(surface_rgb, image);
+            SDL_FreeSurface(surface_rgb);
+        }
+    }
+    SDL_FreeSurface(surface);
+    if (!converted) {
+        text_buffer_printf(output, "Image '%s' convertion failed: %s\n", image_name, IMG_GetError());
+        return SC_FALSE;
+    }
 
+    text_buffer_printf(output, "Image '%s' size: %ux%u, stride %u (%u bytes)\n", image_name,
+                       image->width, image->height, image->row_bytes,
+                       image->row_bytes * image->height);
     return SC_TRUE;
 }
 
-int main(int argc, const char *argv[])
+static ScBool is_mappable_image(const char *file_name)
 {
-    if (argc < 2) {
-        printf("Please provide paths to image files or directories as arguments.\n");
-        return -1;
+    const char *extension = file_extension(file_name);
+    for (size_t i = 0; MAPPED_IMAGE_FORMATS[i].extension != NULL; ++i) {
+        if (strcasecmp(extension, MAPPED_IMAGE_FORMATS[i].extension) == 0) {
+            return SC_TRUE;
+        }
     }
-    printf("Scandit SDK Version: %s\n", SC_VERSION_STRING);
+    return SC_FALSE;
+}
 
-    int return_code = 0;
+static void mapped_image_unmap(MappedImage *image)
+{
+    if (image->mapping != NULL) {
+        munmap(image->mapping, image->mapping_size);
+    }
+    memset(image, 0, sizeof(MappedImage));
+}
 
-    ScRecognitionContext *context = NULL;
-    ScBarcodeScanner *scanner = NULL;
-    ScImageDescription *image_descr = NULL;
-    ScBarcodeScannerSettings *settings = NULL;
-    uint8_t *image_data = NULL;
+/**
+ * Reads the header of a binary PGM file (P5 with at most 8 bit per pixel). Returns the
+ * offset of the pixels or 0 if the header is invalid.
+ */
+static size_t parse_pgm_header(const uint8_t *data, size_t size, uint32_t *width, uint32_t *height)
+{
+    if (size < 2 || data[0] != 'P' || data[1] != '5') {
+        return 0;
+    }
+    unsigned long values[3];
+    size_t position = 2;
+    for (int i = 0; i < 3; ++i) {
+        // Whitespace and comments may appear between all header fields.
+        while (position < size && (isspace(data[position]) || data[position] == '#')) {
+            if (data[position] == '#') {
+                while (position < size && data[position] != '\n') {
+                    position++;
+                }
+            } else {
+                position++;
+            }
+        }
+        if (position == size || !isdigit(data[position])) {
+            return 0;
+        }
+        values[i] = 0;
+        while (position < size && isdigit(data[position]) && values[i] <= UINT32_MAX) {
+            values[i] = values[i] * 10 + (data[position++] - '0');
+        }
+    }
+    // Exactly one whitespace character separates the header from the pixels.
+    if (position == size || !isspace(data[position]) || values[0] == 0 || values[1] == 0 ||
+        values[0] > UINT16_MAX || values[1] > UINT16_MAX || values[2] == 0 || values[2] > 255) {
+        return 0;
+    }
+    *width = (uint32_t)values[0];
+    *height = (uint32_t)values[1];
+    return position + 1;
+}
 
-    InputImage const * const images = get_input_files(argc, argv);
+/**
+ * Reads the sidecar header of a raw image, "<image>.hdr". It holds the width and the
+ * height of the image and optionally the number of bytes per row, e.g. "1280 720".
+ */
+static ScBool read_raw_image_header(const char *image_name, uint32_t *width, uint32_t *height,
+                                    uint32_t *row_bytes)
+{
+    char header_name[PATH_MAX];
+    if (snprintf(header_name, sizeof(header_name), "%s.hdr", image_name) >= (int)sizeof(header_name)) {
+        return SC_FALSE;
+    }
+    FILE *header = fopen(header_name, "r");
+    if (header == NULL) {
+        return SC_FALSE;
+    }
+    unsigned long values[3] = { 0, 0, 0 };
+    const int count = fscanf(header, "%lu %lu %lu", &values[0], &values[1], &values[2]);
+    fclose(header);
+    if (count < 2 || values[0] == 0 || values[1] == 0 ||
+        values[0] > UINT16_MAX || values[1] > UINT16_MAX || values[2] > UINT32_MAX) {
+        return SC_FALSE;
+    }
+    *width = (uint32_t)values[0];
+    *height = (uint32_t)values[1];
+    *row_bytes = count == 3 ? (uint32_t)values[2] : *width;
+    return *row_bytes >= *width;
+}
 
-    // Create a recognition context. Files created by the recognition context and the
-    // attached scanners will be written to this directory.  In production environment,
-    // it should be replaced with writable path which does not get removed between reboots
-    context = sc_recognition_context_new(SCANDIT_SDK_LICENSE_KEY, "/tmp", NULL);
-    if (context == NULL) {
-        printf("Could not initialize context.\n");
-        return_code = -1;
-        goto cleanup;
+/**
+ * Maps a raw Y8, NV12 or I420 image or a binary PGM file into memory and fills in the
+ * plane layout. The pixels are neither decoded nor copied, the recognition context reads
+ * them from the mapped pages. The pages are read in by the decode thread, so the scan
+ * thread does not wait for the disk.
+ */
+static ScBool map_image(const char *image_name, MappedImage *image, TextBuffer *output)
+{
+    const char *extension = file_extension(image_name);
+    const MappedImageFormat *format = MAPPED_IMAGE_FORMATS;
+    while (strcasecmp(extension, format->extension) != 0) {
+        format++;
     }
+    memset(image, 0, sizeof(MappedImage));
+    image->layout = format->layout;
 
+    const int fd = open(image_name, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        text_buffer_printf(output, "Could not open '%s': %s\n", image_name, strerror(errno));
+        return SC_FALSE;
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0 || file_stat.st_size > UINT32_MAX) {
+        text_buffer_printf(output, "Image '%s' is empty or too large.\n", image_name);
+        close(fd);
+        return SC_FALSE;
+    }
+    void *mapping = mmap(NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        text_buffer_printf(output, "Could not map '%s': %s\n", image_name, strerror(errno));
+        return SC_FALSE;
+    }
+    image->mapping = mapping;
+    image->mapping_size = file_stat.st_size;
 
-    image_descr = sc_image_description_new();
-    if (image_descr == NULL) {
-        printf("Could not initialize image description.\n");
-        return_code = -1;
-        goto cleanup;
+    uint64_t memory_size = 0;
+    if (image->layout == SC_IMAGE_LAYOUT_GRAY_8U && strcasecmp(extension, "pgm") == 0) {
+        image->first_plane_offset = (uint32_t)parse_pgm_header(mapping, image->mapping_size,
+                                                               &image->width, &image->height);
+        if (image->first_plane_offset == 0) {
+            text_buffer_printf(output, "Image '%s' is not a binary 8 bit PGM file.\n", image_name);
+            mapped_image_unmap(image);
+            return SC_FALSE;
+        }
+        image->first_plane_row_bytes = image->width;
+        memory_size = image->first_plane_offset + (uint64_t)image->width * image->height;
+    } else {
+        uint32_t row_bytes;
+        if (!read_raw_image_header(image_name, &image->width, &image->height, &row_bytes)) {
+            text_buffer_printf(output, "Image '%s' has no valid header file '%s.hdr'.\n",
+                               image_name, image_name);
+            mapped_image_unmap(image);
+            return SC_FALSE;
+        }
+        const uint64_t luma_size = (uint64_t)row_bytes * image->height;
+        image->first_plane_row_bytes = row_bytes;
+        if (image->layout == SC_IMAGE_LAYOUT_YPCBCR_8U) {
+            image->second_plane_offset = (uint32_t)luma_size;
+            image->second_plane_row_bytes = row_bytes;
+            memory_size = luma_size + (uint64_t)row_bytes * ((image->height + 1) / 2);
+        } else if (image->layout == SC_IMAGE_LAYOUT_I420_8U) {
+            // The chroma planes of I420 have no stride of their own.
+            if (row_bytes != image->width) {
+                text_buffer_printf(output, "Image '%s': I420 images can not have padded rows.\n",
+                                   image_name);
+                mapped_image_unmap(image);
+                return SC_FALSE;
+            }
+            memory_size = luma_size + 2 * (uint64_t)((image->width + 1) / 2) * ((image->height + 1) / 2);
+        } else {
+            memory_size = luma_size;
+        }
+    }
+    if (memory_size > image->mapping_size) {
+        text_buffer_printf(output, "Image '%s' is truncated: %llu bytes expected, %llu found.\n",
+                           image_name, (unsigned long long)memory_size,
+                           (unsigned long long)image->mapping_size);
+        mapped_image_unmap(image);
+        return SC_FALSE;
     }
+    image->memory_size = (uint32_t)memory_size;
+
+    text_buffer_printf(output, "Image '%s' size: %ux%u, %s, stride %u (%u bytes, mapped)\n",
+                       image_name, image->width, image->height, format->extension,
+                       image->first_plane_row_bytes, image->memory_size);
+    return SC_TRUE;
+}
+
+/**
+ * Returns the luma plane of a mapped image as gray image. The view does not own the pixels.
+ */
+static GrayImage mapped_image_luma(const MappedImage *image)
+{
+    GrayImage luma;
+    memset(&luma, 0, sizeof(luma));
+    luma.data = (uint8_t *)image->mapping + image->first_plane_offset;
+    luma.width = image->width;
+    luma.height = image->height;
+    luma.row_bytes = image->first_plane_row_bytes;
+    return luma;
+}
 
-    // The barcode scanner is configured by setting the appropriate properties on an 
-    // "barcode scanner settings" instance. This settings object is passed to the barcode 
+static ScBarcodeScannerSettings *create_scanner_settings(void)
+{
+    // The barcode scanner is configured by setting the appropriate properties on an
+    // "barcode scanner settings" instance. This settings object is passed to the barcode
     // scanner when it is constructed. We start with the settings preset for single frame processing
     // and enable only the symbologies we need. For the purpose of this demo, we would like to scan
     // EAN13/UPCA and QR codes
-    settings = sc_barcode_scanner_settings_new_with_preset(SC_PRESET_ENABLE_SINGLE_FRAME_MODE);
+    ScBarcodeScannerSettings *settings =
+            sc_barcode_scanner_settings_new_with_preset(SC_PRESET_ENABLE_SINGLE_FRAME_MODE);
     if (settings == NULL) {
-        printf("Could not initialize settings.\n");
-        return_code = -1;
-        goto cleanup;
+        return NULL;
     }
     sc_barcode_scanner_settings_set_symbology_enabled(settings, SC_SYMBOLOGY_EAN13, SC_TRUE);
     sc_barcode_scanner_settings_set_symbology_enabled(settings, SC_SYMBOLOGY_UPCA, SC_TRUE);
@@ -209,7 +998,8 @@ int main(int argc, const char *argv[])
     }
     sc_symbology_settings_set_active_symbol_counts(ss, sym_count, 16);
 
-    // Set the maximum number of codes to look for in an image, 1 in our case.
+    // Set the maximum number of codes to look for in an image, 1 in our case. The tiles
+    // of large images are scanned with TILE_MAX_CODES_PER_FRAME instead.
     sc_barcode_scanner_settings_set_max_number_of_codes_per_frame(settings, 1);
 
     // By setting the code location constraints to ignore, we tell
@@ -225,106 +1015,2031 @@ int main(int argc, const char *argv[])
     // effectively disables this duplicate filtering.
     //sc_barcode_scanner_settings_set_code_duplicate_filter(settings, 500);
 
-    // Create a barcode scanner for our context and settings.
-    scanner = sc_barcode_scanner_new_with_settings(context, settings);
-    if (scanner == NULL) {
-        printf("Could not initialize scanner.\n");
-        return_code = -1;
-        goto cleanup;
+    return settings;
+}
+
+/**
+ * Creates the recognition context and the barcode scanner owned by one worker.
+ */
+static ScBool scan_worker_setup(ScanWorker *worker, const ScBarcodeScannerSettings *settings)
+{
+    // Create a recognition context. Files created by the recognition context and the
+    // attached scanners will be written to this directory.  In production environment,
+    // it should be replaced with writable path which does not get removed between reboots
+    worker->context = sc_recognition_context_new(SCANDIT_SDK_LICENSE_KEY, "/tmp", NULL);
+    if (worker->context == NULL) {
+        printf("Could not initialize context.\n");
+        return SC_FALSE;
     }
 
-    // Wait for the initialization of the barcode scanner. We could omit this call
-    // and start scanning immediately, but there is no guarantee that the barcode scanner 
-    // operates at full capacity.
-    if (!sc_barcode_scanner_wait_for_setup_completed(scanner)) {
-        printf("barcode scanner setup failed.\n");
-        return_code = -1;
-        goto cleanup;
+    worker->image_descr = sc_image_description_new();
+    if (worker->image_descr == NULL) {
+        printf("Could not initialize image description.\n");
+        return SC_FALSE;
     }
 
-    for (InputImage const *current_image = images; current_image != NULL;
-            current_image = current_image->next) {
-        // Load the image from disc.
-        uint32_t image_width, image_height, row_stride;
-        if (load_image(current_image->file_name, &image_data, &image_width,
-                       &image_height, &row_stride) == SC_FALSE) {
-            printf("Failed to load image '%s'.\n", current_image->file_name);
-            return_code = -1;
-            goto cleanup;
+    worker->settings = sc_barcode_scanner_settings_clone((ScBarcodeScannerSettings *)settings);
+    if (worker->settings == NULL) {
+        printf("Could not initialize settings.\n");
+        return SC_FALSE;
+    }
+    worker->default_max_codes_per_frame =
+            sc_barcode_scanner_settings_get_max_number_of_codes_per_frame(settings);
+    worker->max_codes_per_frame = worker->default_max_codes_per_frame;
+
+    // Create a barcode scanner for our context and settings.
+    worker->scanner = sc_barcode_scanner_new_with_settings(worker->context, settings);
+    if (worker->scanner == NULL) {
+        printf("Could not initialize scanner.\n");
+        return SC_FALSE;
+    }
+
+    // Wait for the initialization of the barcode scanner. We could omit this call
+    // and start scanning immediately, but there is no guarantee that the barcode scanner
+    // operates at full capacity.
+    if (!sc_barcode_scanner_wait_for_setup_completed(worker->scanner)) {
+        printf("barcode scanner setup failed.\n");
+        return SC_FALSE;
+    }
+
+    return SC_TRUE;
+}
+
+static void scan_worker_teardown(ScanWorker *worker)
+{
+    // Cleanup allocated data and objects. These functions all check for null values,
+    // so it's save to pass in null objects.
+    sc_barcode_scanner_release(worker->scanner);
+    sc_recognition_context_release(worker->context);
+    sc_image_description_release(worker->image_descr);
+    sc_barcode_scanner_settings_release(worker->settings);
+
+    worker->scanner = NULL;
+    worker->context = NULL;
+    worker->image_descr = NULL;
+    worker->settings = NULL;
+}
+
+/**
+ * Applies a new maximum number of codes per frame to the scanner of the worker if it
+ * differs from the current one.
+ */
+static void scan_worker_set_max_codes_per_frame(ScanWorker *worker, uint32_t max_codes_per_frame)
+{
+    if (worker->max_codes_per_frame == max_codes_per_frame) {
+        return;
+    }
+    sc_barcode_scanner_settings_set_max_number_of_codes_per_frame(worker->settings,
+                                                                  max_codes_per_frame);
+    sc_barcode_scanner_apply_settings(worker->scanner, worker->settings);
+    worker->max_codes_per_frame = max_codes_per_frame;
+}
+
+/**
+ * Fills the image description of the worker for a gray image.
+ */
+static void scan_worker_describe_gray_image(ScanWorker *worker, const GrayImage *image)
+{
+    ScImageDescription *image_descr = worker->image_descr;
+    const uint32_t image_memory_size = image->row_bytes * image->height;
+    sc_image_description_set_layout(image_descr, SC_IMAGE_LAYOUT_GRAY_8U);
+    sc_image_description_set_width(image_descr, image->width);
+    sc_image_description_set_height(image_descr, image->height);
+    sc_image_description_set_first_plane_row_bytes(image_descr, image->row_bytes);
+    sc_image_description_set_memory_size(image_descr, image_memory_size);
+}
+
+/**
+ * Processes the image described by the image description of the worker.
+ *
+ * \returns the codes recognized in the image, NULL if processing failed. The returned
+ *      array must be released with sc_barcode_array_release().
+ */
+static ScBarcodeArray *scan_worker_process_frame(ScanWorker *worker, const uint8_t *image_data,
+                                                 ScContextStatusFlag *status)
+{
+    // Signal to the context that a new sequence of frames starts. This call is mandatory,
+    // even if we are only going to process one image. Scanning will fail with
+    // SC_RECOGNITION_CONTEXT_STATUS_FRAME_SEQUENCE_NOT_STARTED otherwise.
+    sc_recognition_context_start_new_frame_sequence(worker->context);
+
+    ScProcessFrameResult frame_result =
+            sc_recognition_context_process_frame(worker->context, worker->image_descr,
+                                                 image_data);
+
+    // Signal to the context that the frame sequence is finished.
+    sc_recognition_context_end_frame_sequence(worker->context);
+
+    *status = frame_result.status;
+    if (frame_result.status != SC_RECOGNITION_CONTEXT_STATUS_SUCCESS) {
+        return NULL;
+    }
+
+    // Retrieve the barcode scanner object to get the list of codes that were recognized in
+    // the last frame.
+    ScBarcodeScannerSession *session = sc_barcode_scanner_get_session(worker->scanner);
+
+    // Get the list of codes that have been found in the last process frame call.
+    return sc_barcode_scanner_session_get_newly_recognized_codes(session);
+}
+
+/**
+ * Fills the image description of the worker for a mapped image.
+ */
+static void scan_worker_describe_mapped_image(ScanWorker *worker, const MappedImage *image)
+{
+    ScImageDescription *image_descr = worker->image_descr;
+    sc_image_description_set_layout(image_descr, image->layout);
+    sc_image_description_set_width(image_descr, image->width);
+    sc_image_description_set_height(image_descr, image->height);
+    sc_image_description_set_first_plane_offset(image_descr, image->first_plane_offset);
+    sc_image_description_set_first_plane_row_bytes(image_descr, image->first_plane_row_bytes);
+    sc_image_description_set_second_plane_offset(image_descr, image->second_plane_offset);
+    sc_image_description_set_second_plane_row_bytes(image_descr, image->second_plane_row_bytes);
+    sc_image_description_set_memory_size(image_descr, image->memory_size);
+}
+
+/**
+ * Scans the image described by the image description of the worker. All output is
+ * written to the result of the image.
+ */
+static void scan_described_image(ScanWorker *worker, const uint8_t *image_data, ScanResult *result)
+{
+    TextBuffer *output = &result->output;
+
+    scan_worker_set_max_codes_per_frame(worker, worker->default_max_codes_per_frame);
+    ScContextStatusFlag status;
+    ScBarcodeArray *new_codes = scan_worker_process_frame(worker, image_data, &status);
+    if (new_codes == NULL) {
+        text_buffer_printf(output, "Processing frame failed with error %d: '%s'\n",
+                           status, sc_context_status_flag_get_message(status));
+        result->failed = SC_TRUE;
+        return;
+    }
+
+    uint32_t num_codes = sc_barcode_array_get_size(new_codes);
+    if (num_codes == 0) {
+        text_buffer_printf(output, "no 1d or 2d barcodes found\n");
+    }
+
+    for (uint32_t i = 0; i < num_codes; ++i) {
+        const ScBarcode * barcode = sc_barcode_array_get_item_at(new_codes, i);
+        ScByteArray data = sc_barcode_get_data(barcode);
+        ScSymbology symbology = sc_barcode_get_symbology(barcode);
+        const char *symbology_name = sc_symbology_to_string(symbology);
+        // For simplicity it is assumed that the barcode contains textual data, even
+        // though it is possible to encode binary data in QR codes that contain null-
+        // bytes at any position. For applications expecting binary data, use
+        // sc_byte_array_get_data_size() to determine the length of the returned data.
+        text_buffer_printf(output, "barcode: symbology=%s, data='%s'\n", symbology_name, data.str);
+    }
+    sc_barcode_array_release(new_codes);
+}
+
+/**
+ * Scans one decoded image.
+ */
+static void scan_image(ScanWorker *worker, const GrayImage *image, ScanResult *result)
+{
+    // Fill the image description for our loaded image.
+    scan_worker_describe_gray_image(worker, image);
+    scan_described_image(worker, image->data, result);
+}
+
+/**
+ * Returns the position of the first tile along an axis of the given length. The last
+ * tile is moved back to end at the border of the image.
+ */
+static uint32_t tile_start(uint32_t index, uint32_t count, uint32_t length, const TilePool *pool)
+{
+    if (index + 1 == count) {
+        return length > pool->tile_size ? length - pool->tile_size : 0;
+    }
+    return index * (pool->tile_size - pool->overlap);
+}
+
+static uint32_t tile_count(uint32_t length, const TilePool *pool)
+{
+    if (length <= pool->tile_size) {
+        return 1;
+    }
+    const uint32_t step = pool->tile_size - pool->overlap;
+    return (length - pool->overlap + step - 1) / step;
+}
+
+/**
+ * Scans one tile of the job in place, the tile is described with the row stride of
+ * the full image.
+ */
+static ScBarcodeArray *scan_worker_process_tile(ScanWorker *worker, const TilePool *pool,
+                                                const TileJob *job, uint32_t tile,
+                                                ScPoint *origin, ScContextStatusFlag *status)
+{
+    const GrayImage *image = job->image;
+    const uint32_t x = tile_start(tile % job->columns, job->columns, image->width, pool);
+    const uint32_t y = tile_start(tile / job->columns, job->rows, image->height, pool);
+    const uint32_t width = image->width - x < pool->tile_size ? image->width - x : pool->tile_size;
+    const uint32_t height = image->height - y < pool->tile_size ? image->height - y : pool->tile_size;
+    origin->x = (int32_t)x;
+    origin->y = (int32_t)y;
+
+    // Only tiles are scanned for many codes, whole images keep the configured limit.
+    scan_worker_set_max_codes_per_frame(worker, TILE_MAX_CODES_PER_FRAME);
+    ScImageDescription *image_descr = worker->image_descr;
+    sc_image_description_set_layout(image_descr, SC_IMAGE_LAYOUT_GRAY_8U);
+    sc_image_description_set_width(image_descr, width);
+    sc_image_description_set_height(image_descr, height);
+    sc_image_description_set_first_plane_row_bytes(image_descr, image->row_bytes);
+    sc_image_description_set_memory_size(image_descr, (height - 1) * image->row_bytes + width);
+    return scan_worker_process_frame(worker, image->data + (size_t)y * image->row_bytes + x, status);
+}
+
+/**
+ * Adds the codes of a finished tile to the job. Must be called with the lock held.
+ */
+static void tile_job_add_codes(TileJob *job, const ScBarcodeArray *codes, ScPoint origin)
+{
+    const uint32_t num_codes = sc_barcode_array_get_size(codes);
+    for (uint32_t i = 0; i < num_codes; ++i) {
+        if (job->code_count == job->code_capacity) {
+            const size_t capacity = job->code_capacity > 0 ? job->code_capacity * 2 : 16;
+            TileCode *grown = realloc(job->codes, capacity * sizeof(TileCode));
+            if (grown == NULL) {
+                return;
+            }
+            job->codes = grown;
+            job->code_capacity = capacity;
+        }
+        const ScBarcode *barcode = sc_barcode_array_get_item_at(codes, i);
+        const ScByteArray data = sc_barcode_get_data(barcode);
+        TileCode *code = &job->codes[job->code_count];
+        code->data = malloc(data.length + 1);
+        if (code->data == NULL) {
+            return;
+        }
+        memcpy(code->data, data.str, data.length);
+        code->data[data.length] = '\0';
+        code->data_length = data.length;
+        code->symbology = sc_barcode_get_symbology(barcode);
+        code->location = sc_barcode_get_location(barcode);
+        ScPoint *corners[4] = { &code->location.top_left, &code->location.top_right,
+                                &code->location.bottom_right, &code->location.bottom_left };
+        for (int corner = 0; corner < 4; ++corner) {
+            corners[corner]->x += origin.x;
+            corners[corner]->y += origin.y;
+        }
+        job->code_count++;
+    }
+}
+
+/**
+ * Takes the next tile of a job and scans it with the given worker. Must be called with
+ * the lock held, the lock is released while scanning.
+ */
+static void tile_pool_scan_next_tile(TilePool *pool, TileJob *job, ScanWorker *worker)
+{
+    const uint32_t tile = job->next_tile++;
+    if (job->next_tile == job->tile_count) {
+        // All tiles are handed out, the job leaves the queue.
+        TileJob **link = &pool->jobs;
+        while (*link != job) {
+            link = &(*link)->next;
+        }
+        *link = job->next;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    ScPoint origin;
+    ScContextStatusFlag status;
+    ScBarcodeArray *codes = scan_worker_process_tile(worker, pool, job, tile, &origin, &status);
+
+    pthread_mutex_lock(&pool->lock);
+    if (codes != NULL) {
+        tile_job_add_codes(job, codes, origin);
+        sc_barcode_array_release(codes);
+    } else if (!job->failed) {
+        job->failed = SC_TRUE;
+        job->failure = status;
+    }
+    job->finished_tiles++;
+    if (job->finished_tiles == job->tile_count) {
+        pthread_cond_broadcast(&pool->tile_finished);
+    }
+}
+
+static void *tile_helper_run(void *argument)
+{
+    TileHelper *helper = argument;
+    TilePool *pool = helper->pool;
+
+    const ScBool setup_succeeded = scan_worker_setup(&helper->scan, pool->settings);
+
+    pthread_mutex_lock(&pool->lock);
+    pool->ready_count++;
+    if (!setup_succeeded) {
+        pool->setup_failed = SC_TRUE;
+    }
+    pthread_cond_broadcast(&pool->tile_finished);
+    while (setup_succeeded) {
+        while (!pool->shutting_down && pool->jobs == NULL) {
+            pthread_cond_wait(&pool->job_available, &pool->lock);
+        }
+        if (pool->jobs == NULL) {
+            break;
+        }
+        tile_pool_scan_next_tile(pool, pool->jobs, &helper->scan);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    scan_worker_teardown(&helper->scan);
+    return NULL;
+}
+
+static void tile_pool_release(TilePool *pool)
+{
+    if (pool == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&pool->lock);
+    pool->shutting_down = SC_TRUE;
+    pthread_cond_broadcast(&pool->job_available);
+    pthread_mutex_unlock(&pool->lock);
+    for (size_t i = 0; i < pool->helper_count; ++i) {
+        if (pool->helpers[i].thread_started) {
+            pthread_join(pool->helpers[i].thread, NULL);
+        }
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->job_available);
+    pthread_cond_destroy(&pool->tile_finished);
+    free(pool->helpers);
+    free(pool);
+}
+
+/**
+ * Starts the tile helpers and waits until all of them have set up their scanner.
+ */
+static TilePool *tile_pool_new(uint32_t tile_size, uint32_t overlap, size_t helper_count,
+                               const ScBarcodeScannerSettings *settings)
+{
+    TilePool *pool = calloc(1, sizeof(TilePool));
+    if (pool == NULL) {
+        return NULL;
+    }
+    pool->helpers = calloc(helper_count, sizeof(TileHelper));
+    if (pool->helpers == NULL) {
+        free(pool);
+        return NULL;
+    }
+    pool->tile_size = tile_size;
+    pool->overlap = overlap;
+    pool->helper_count = helper_count;
+    pool->settings = settings;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->job_available, NULL);
+    pthread_cond_init(&pool->tile_finished, NULL);
+
+    size_t started_count = 0;
+    for (size_t i = 0; i < helper_count; ++i) {
+        TileHelper *helper = &pool->helpers[i];
+        helper->pool = pool;
+        if (pthread_create(&helper->thread, NULL, tile_helper_run, helper) != 0) {
+            printf("Could not start tile helper thread.\n");
+            pool->setup_failed = SC_TRUE;
+            break;
+        }
+        helper->thread_started = SC_TRUE;
+        started_count++;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->ready_count < started_count) {
+        pthread_cond_wait(&pool->tile_finished, &pool->lock);
+    }
+    const ScBool setup_failed = pool->setup_failed;
+    pthread_mutex_unlock(&pool->lock);
+
+    if (setup_failed) {
+        tile_pool_release(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+static void quadrilateral_bounds(const ScQuadrilateral *quad, int32_t *min_x, int32_t *min_y,
+                                 int32_t *max_x, int32_t *max_y)
+{
+    const ScPoint corners[4] = { quad->top_left, quad->top_right, quad->bottom_right, quad->bottom_left };
+    *min_x = *max_x = corners[0].x;
+    *min_y = *max_y = corners[0].y;
+    for (int i = 1; i < 4; ++i) {
+        *min_x = corners[i].x < *min_x ? corners[i].x : *min_x;
+        *min_y = corners[i].y < *min_y ? corners[i].y : *min_y;
+        *max_x = corners[i].x > *max_x ? corners[i].x : *max_x;
+        *max_y = corners[i].y > *max_y ? corners[i].y : *max_y;
+    }
+}
+
+/**
+ * Two results are the same code if they have the same data and their bounding boxes
+ * cover each other by at least half. The same data at another place is another code.
+ */
+static ScBool tile_codes_are_duplicates(const TileCode *a, const TileCode *b)
+{
+    if (a->symbology != b->symbology || a->data_length != b->data_length ||
+        memcmp(a->data, b->data, a->data_length) != 0) {
+        return SC_FALSE;
+    }
+    int32_t a_min_x, a_min_y, a_max_x, a_max_y;
+    int32_t b_min_x, b_min_y, b_max_x, b_max_y;
+    quadrilateral_bounds(&a->location, &a_min_x, &a_min_y, &a_max_x, &a_max_y);
+    quadrilateral_bounds(&b->location, &b_min_x, &b_min_y, &b_max_x, &b_max_y);
+    const int64_t overlap_width = (int64_t)(a_max_x < b_max_x ? a_max_x : b_max_x) -
+                                  (a_min_x > b_min_x ? a_min_x : b_min_x);
+    const int64_t overlap_height = (int64_t)(a_max_y < b_max_y ? a_max_y : b_max_y) -
+                                   (a_min_y > b_min_y ? a_min_y : b_min_y);
+    if (overlap_width < 0 || overlap_height < 0) {
+        return SC_FALSE;
+    }
+    const int64_t a_area = (int64_t)(a_max_x - a_min_x) * (a_max_y - a_min_y);
+    const int64_t b_area = (int64_t)(b_max_x - b_min_x) * (b_max_y - b_min_y);
+    const int64_t smaller_area = a_area < b_area ? a_area : b_area;
+    return 2 * overlap_width * overlap_height >= smaller_area;
+}
+
+/**
+ * Scans an image that is larger than the tile size in overlapping tiles. The worker
+ * scans tiles itself while the tile helpers take the others. Codes on tile borders are
+ * complete in at least one tile as long as they are smaller than the overlap. Codes
+ * found in more than one tile are reported once.
+ */
+static void scan_image_tiled(ScanWorker *worker, TilePool *pool, const GrayImage *image,
+                             ScanResult *result)
+{
+    TextBuffer *output = &result->output;
+    TileJob job;
+    memset(&job, 0, sizeof(job));
+    job.image = image;
+    job.columns = tile_count(image->width, pool);
+    job.rows = tile_count(image->height, pool);
+    job.tile_count = job.columns * job.rows;
+
+    pthread_mutex_lock(&pool->lock);
+    TileJob **link = &pool->jobs;
+    while (*link != NULL) {
+        link = &(*link)->next;
+    }
+    *link = &job;
+    pthread_cond_broadcast(&pool->job_available);
+    while (job.next_tile < job.tile_count) {
+        tile_pool_scan_next_tile(pool, &job, worker);
+    }
+    while (job.finished_tiles < job.tile_count) {
+        pthread_cond_wait(&pool->tile_finished, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    if (job.failed) {
+        text_buffer_printf(output, "Processing frame failed with error %d: '%s'\n",
+                           job.failure, sc_context_status_flag_get_message(job.failure));
+        result->failed = SC_TRUE;
+    } else {
+        size_t unique_count = 0;
+        for (size_t i = 0; i < job.code_count; ++i) {
+            ScBool duplicate = SC_FALSE;
+            for (size_t j = 0; j < unique_count && !duplicate; ++j) {
+                duplicate = tile_codes_are_duplicates(&job.codes[i], &job.codes[j]);
+            }
+            if (duplicate) {
+                free(job.codes[i].data);
+            } else {
+                job.codes[unique_count++] = job.codes[i];
+            }
+        }
+        text_buffer_printf(output, "scanned %u tiles, %zu duplicates from the overlaps removed\n",
+                           job.tile_count, job.code_count - unique_count);
+        if (unique_count == 0) {
+            text_buffer_printf(output, "no 1d or 2d barcodes found\n");
+        }
+        for (size_t i = 0; i < unique_count; ++i) {
+            const TileCode *code = &job.codes[i];
+            const ScQuadrilateral *location = &code->location;
+            text_buffer_printf(output, "barcode: symbology=%s, data='%s', location=[[%d,%d],[%d,%d],[%d,%d],[%d,%d]]\n",
+                               sc_symbology_to_string(code->symbology), code->data,
+                               location->top_left.x, location->top_left.y,
+                               location->top_right.x, location->top_right.y,
+                               location->bottom_right.x, location->bottom_right.y,
+                               location->bottom_left.x, location->bottom_left.y);
+        }
+        job.code_count = unique_count;
+    }
+    for (size_t i = 0; i < job.code_count; ++i) {
+        free(job.codes[i].data);
+    }
+    free(job.codes);
+}
+
+static double now_seconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+static ScBool decode_queue_init(DecodeQueue *queue)
+{
+    queue->not_full_fd = eventfd(0, EFD_CLOEXEC);
+    queue->not_empty_fd = eventfd(0, EFD_CLOEXEC);
+    return queue->not_full_fd >= 0 && queue->not_empty_fd >= 0;
+}
+
+static void decode_queue_destroy(DecodeQueue *queue)
+{
+    if (queue->not_full_fd >= 0) {
+        close(queue->not_full_fd);
+    }
+    if (queue->not_empty_fd >= 0) {
+        close(queue->not_empty_fd);
+    }
+}
+
+static void decode_queue_wait(int fd)
+{
+    uint64_t value;
+    while (read(fd, &value, sizeof(value)) < 0 && errno == EINTR) {
+    }
+}
+
+static void decode_queue_wake(int fd)
+{
+    const uint64_t value = 1;
+    while (write(fd, &value, sizeof(value)) < 0 && errno == EINTR) {
+    }
+}
+
+/**
+ * Blocks until ready() holds. The waiting flag is set before the condition is checked
+ * again and the other thread reads it after advancing its counter, both sequentially
+ * consistent, so at least one of them sees the other and no wake-up is lost. A wake-up
+ * that was not needed any more only makes the next wait return early.
+ */
+static void decode_queue_block(DecodeQueue *queue, int *waiting, int fd,
+                               ScBool (*ready)(const DecodeQueue *queue))
+{
+    while (!ready(queue)) {
+        __atomic_store_n(waiting, 1, __ATOMIC_SEQ_CST);
+        if (!ready(queue)) {
+            decode_queue_wait(fd);
+        }
+        __atomic_store_n(waiting, 0, __ATOMIC_SEQ_CST);
+    }
+}
+
+static ScBool decode_queue_has_free_entry(const DecodeQueue *queue)
+{
+    return queue->tail - __atomic_load_n(&queue->head, __ATOMIC_SEQ_CST) < DECODE_QUEUE_SIZE;
+}
+
+static ScBool decode_queue_has_decoded_entry(const DecodeQueue *queue)
+{
+    return __atomic_load_n(&queue->tail, __ATOMIC_SEQ_CST) != queue->head;
+}
+
+/**
+ * Returns the next free entry of the queue. Blocks while the queue is full.
+ */
+static DecodedImage *decode_queue_acquire_free(DecodeQueue *queue)
+{
+    decode_queue_block(queue, &queue->decode_waiting, queue->not_full_fd,
+                       decode_queue_has_free_entry);
+    return &queue->entries[queue->tail % DECODE_QUEUE_SIZE];
+}
+
+/**
+ * Hands the entry returned by decode_queue_acquire_free to the scan thread.
+ */
+static void decode_queue_publish(DecodeQueue *queue)
+{
+    __atomic_store_n(&queue->tail, queue->tail + 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&queue->scan_waiting, __ATOMIC_SEQ_CST)) {
+        decode_queue_wake(queue->not_empty_fd);
+    }
+}
+
+/**
+ * Returns the oldest decoded entry of the queue. Blocks while the queue is empty.
+ * The number of decoded entries (including the returned one) is stored in occupancy.
+ */
+static DecodedImage *decode_queue_acquire_decoded(DecodeQueue *queue, uint64_t *occupancy)
+{
+    decode_queue_block(queue, &queue->scan_waiting, queue->not_empty_fd,
+                       decode_queue_has_decoded_entry);
+    *occupancy = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE) - queue->head;
+    return &queue->entries[queue->head % DECODE_QUEUE_SIZE];
+}
+
+/**
+ * Returns the entry returned by decode_queue_acquire_decoded to the decode thread.
+ */
+static void decode_queue_release(DecodeQueue *queue)
+{
+    __atomic_store_n(&queue->head, queue->head + 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&queue->decode_waiting, __ATOMIC_SEQ_CST)) {
+        decode_queue_wake(queue->not_full_fd);
+    }
+}
+
+static void decode_queue_push_end_of_input(DecodeQueue *queue)
+{
+    DecodedImage *entry = decode_queue_acquire_free(queue);
+    entry->slot_index = END_OF_INPUT;
+    decode_queue_publish(queue);
+}
+
+static void work_queue_push(WorkQueue *queue, size_t index)
+{
+    pthread_mutex_lock(&queue->lock);
+    queue->indices[queue->tail++ % queue->capacity] = index;
+    pthread_mutex_unlock(&queue->lock);
+}
+
+static ScBool work_queue_pop(WorkQueue *queue, size_t *index)
+{
+    ScBool found = SC_FALSE;
+    pthread_mutex_lock(&queue->lock);
+    if (queue->head < queue->tail) {
+        *index = queue->indices[queue->head++ % queue->capacity];
+        found = SC_TRUE;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return found;
+}
+
+static ScBool work_queue_steal(WorkQueue *queue, size_t *index)
+{
+    ScBool found = SC_FALSE;
+    pthread_mutex_lock(&queue->lock);
+    if (queue->head < queue->tail) {
+        *index = queue->indices[--queue->tail % queue->capacity];
+        found = SC_TRUE;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return found;
+}
+
+/**
+ * Takes the next image from the own queue. If it is empty, an image is stolen
+ * from one of the other workers.
+ */
+static ScBool scan_worker_next_image(ScanWorker *worker, size_t *index)
+{
+    if (work_queue_pop(&worker->work_queue, index)) {
+        return SC_TRUE;
+    }
+    const WorkerPool *pool = worker->pool;
+    for (size_t i = 1; i < pool->worker_count; ++i) {
+        ScanWorker *victim = &pool->workers[(worker->index + i) % pool->worker_count];
+        if (work_queue_steal(&victim->work_queue, index)) {
+            return SC_TRUE;
+        }
+    }
+    return SC_FALSE;
+}
+
+/**
+ * Returns the part of the waiting period that falls into the run.
+ */
+static double waiting_time(const WorkerPool *pool, double wait_start, double wait_end)
+{
+    if (pool->run_start_seconds == 0.0 || wait_end < pool->run_start_seconds) {
+        return 0.0;
+    }
+    return wait_start > pool->run_start_seconds ? wait_end - wait_start
+                                                : wait_end - pool->run_start_seconds;
+}
+
+/**
+ * Scan stage: scans the images decoded by the decode thread of the worker.
+ */
+static void *scan_worker_run(void *argument)
+{
+    ScanWorker *worker = argument;
+    WorkerPool *pool = worker->pool;
+    StageStatistics *statistics = &worker->scan_statistics;
+
+    const ScBool setup_succeeded = scan_worker_setup(worker, pool->settings);
+
+    pthread_mutex_lock(&pool->lock);
+    pool->ready_count++;
+    if (!setup_succeeded) {
+        pool->setup_failed = SC_TRUE;
+    }
+    pthread_cond_broadcast(&pool->result_ready);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (;;) {
+        const double wait_start = now_seconds();
+        uint64_t occupancy;
+        DecodedImage *decoded = decode_queue_acquire_decoded(&worker->decode_queue, &occupancy);
+        const double scan_start = now_seconds();
+        statistics->input_wait_seconds += waiting_time(pool, wait_start, scan_start);
+        if (decoded->slot_index == END_OF_INPUT) {
+            decode_queue_release(&worker->decode_queue);
+            break;
+        }
+        worker->queue_occupancy_sum += occupancy;
+
+        BatchSlot *slot = &pool->slots[decoded->slot_index];
+        const ScBool mapped = decoded->mapped.mapping != NULL;
+        // Tiles are cut from the luma plane, which is all the scanner looks at.
+        const GrayImage image = mapped ? mapped_image_luma(&decoded->mapped) : decoded->image;
+        const TilePool *tile_pool = pool->tile_pool;
+        if (decoded->loaded && tile_pool != NULL &&
+            (image.width > tile_pool->tile_size || image.height > tile_pool->tile_size)) {
+            scan_image_tiled(worker, pool->tile_pool, &image, &slot->result);
+        } else if (decoded->loaded && mapped) {
+            scan_worker_describe_mapped_image(worker, &decoded->mapped);
+            scan_described_image(worker, decoded->mapped.mapping, &slot->result);
+        } else if (decoded->loaded) {
+            scan_image(worker, &decoded->image, &slot->result);
+        } else {
+            slot->result.failed = SC_TRUE;
+        }
+        mapped_image_unmap(&decoded->mapped);
+        decode_queue_release(&worker->decode_queue);
+        statistics->busy_seconds += now_seconds() - scan_start;
+        statistics->items++;
+
+        pthread_mutex_lock(&pool->lock);
+        slot->result.done = SC_TRUE;
+        pthread_cond_broadcast(&pool->result_ready);
+        pthread_mutex_unlock(&pool->lock);
+    }
+
+    scan_worker_teardown(worker);
+    return NULL;
+}
+
+/**
+ * Decode stage: takes images from the work queues, decodes them and passes them
+ * to the scan thread of the worker.
+ */
+static void *decode_worker_run(void *argument)
+{
+    ScanWorker *worker = argument;
+    WorkerPool *pool = worker->pool;
+    DecodeQueue *decode_queue = &worker->decode_queue;
+    StageStatistics *statistics = &worker->decode_statistics;
+
+    for (;;) {
+        // The generation is read before looking at the queues, so that work that is
+        // queued while we look is never missed.
+        pthread_mutex_lock(&pool->lock);
+        const uint64_t generation = pool->work_generation;
+        const ScBool shutting_down = pool->shutting_down;
+        pthread_mutex_unlock(&pool->lock);
+
+        size_t index;
+        while (scan_worker_next_image(worker, &index)) {
+            const double wait_start = now_seconds();
+            DecodedImage *decoded = decode_queue_acquire_free(decode_queue);
+            const double decode_start = now_seconds();
+            statistics->output_wait_seconds += decode_start - wait_start;
+
+            // Load the image from disc.
+            BatchSlot *slot = &pool->slots[index];
+            decoded->slot_index = index;
+            if (is_mappable_image(slot->input.file_name)) {
+                decoded->loaded = map_image(slot->input.file_name, &decoded->mapped,
+                                            &slot->result.output);
+            } else {
+                decoded->loaded = load_image(slot->input.file_name, &decoded->image,
+                                             &slot->result.output);
+            }
+            if (!decoded->loaded) {
+                text_buffer_printf(&slot->result.output, "Failed to load image '%s'.\n",
+                                   slot->input.file_name);
+            }
+            // Counted before the image is handed on, the statistics are printed as
+            // soon as the last image is reported.
+            statistics->busy_seconds += now_seconds() - decode_start;
+            statistics->items++;
+            decode_queue_publish(decode_queue);
+        }
+        if (shutting_down) {
+            break;
+        }
+
+        const double wait_start = now_seconds();
+        pthread_mutex_lock(&pool->lock);
+        while (!pool->shutting_down && pool->work_generation == generation) {
+            pthread_cond_wait(&pool->work_available, &pool->lock);
+        }
+        pthread_mutex_unlock(&pool->lock);
+        statistics->input_wait_seconds += waiting_time(pool, wait_start, now_seconds());
+    }
+
+    decode_queue_push_end_of_input(decode_queue);
+    return NULL;
+}
+
+static void worker_pool_release(WorkerPool *pool)
+{
+    if (pool == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&pool->lock);
+    pool->shutting_down = SC_TRUE;
+    pthread_cond_broadcast(&pool->work_available);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (size_t i = 0; i < pool->worker_count; ++i) {
+        ScanWorker *worker = &pool->workers[i];
+        if (worker->decode_thread_started) {
+            pthread_join(worker->decode_thread, NULL);
+        } else if (worker->scan_thread_started) {
+            decode_queue_push_end_of_input(&worker->decode_queue);
+        }
+        if (worker->scan_thread_started) {
+            pthread_join(worker->scan_thread, NULL);
+        }
+    }
+    // The queues are destroyed after all threads have stopped, since every decode
+    // thread may steal from every queue.
+    for (size_t i = 0; i < pool->worker_count; ++i) {
+        ScanWorker *worker = &pool->workers[i];
+        pthread_mutex_destroy(&worker->work_queue.lock);
+        free(worker->work_queue.indices);
+        decode_queue_destroy(&worker->decode_queue);
+        for (size_t j = 0; j < DECODE_QUEUE_SIZE; ++j) {
+            gray_image_free(&worker->decode_queue.entries[j].image);
+        }
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->work_available);
+    pthread_cond_destroy(&pool->result_ready);
+    for (size_t i = 0; pool->slots != NULL && i < pool->slot_count; ++i) {
+        free(pool->slots[i].input.file_name);
+        text_buffer_free(&pool->slots[i].result.output);
+    }
+    free(pool->slots);
+    free(pool->workers);
+    free(pool);
+}
+
+/**
+ * Starts the workers and waits until all of them have set up their scanner.
+ */
+static WorkerPool *worker_pool_new(size_t worker_count,
+                                   const ScBarcodeScannerSettings *settings, TilePool *tile_pool)
+{
+    WorkerPool *pool = calloc(1, sizeof(WorkerPool));
+    if (pool == NULL) {
+        return NULL;
+    }
+    pool->chunk_size = CHUNK_SIZE_PER_WORKER * worker_count;
+    pool->slot_count = LOOKAHEAD_CHUNKS * pool->chunk_size;
+    pool->workers = calloc(worker_count, sizeof(ScanWorker));
+    pool->slots = calloc(pool->slot_count, sizeof(BatchSlot));
+    if (pool->workers == NULL || pool->slots == NULL) {
+        free(pool->workers);
+        free(pool->slots);
+        free(pool);
+        return NULL;
+    }
+    pool->settings = settings;
+    pool->tile_pool = tile_pool;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_available, NULL);
+    pthread_cond_init(&pool->result_ready, NULL);
+
+    // All queues exist before the first thread starts, the decode threads steal from
+    // each other right away.
+    pool->worker_count = worker_count;
+    ScBool queues_allocated = SC_TRUE;
+    for (size_t i = 0; i < worker_count; ++i) {
+        ScanWorker *worker = &pool->workers[i];
+        worker->pool = pool;
+        worker->index = i;
+        worker->work_queue.capacity = pool->slot_count;
+        worker->work_queue.indices = malloc(pool->slot_count * sizeof(size_t));
+        pthread_mutex_init(&worker->work_queue.lock, NULL);
+        if (!decode_queue_init(&worker->decode_queue) || worker->work_queue.indices == NULL) {
+            queues_allocated = SC_FALSE;
+        }
+    }
+    if (!queues_allocated) {
+        printf("Could not set up the worker queues.\n");
+        worker_pool_release(pool);
+        return NULL;
+    }
+
+    size_t started_count = 0;
+    for (size_t i = 0; i < worker_count; ++i) {
+        ScanWorker *worker = &pool->workers[i];
+        if (pthread_create(&worker->scan_thread, NULL, scan_worker_run, worker) != 0) {
+            printf("Could not start worker thread.\n");
+            pthread_mutex_lock(&pool->lock);
+            pool->setup_failed = SC_TRUE;
+            pthread_mutex_unlock(&pool->lock);
+            break;
+        }
+        worker->scan_thread_started = SC_TRUE;
+        started_count++;
+
+        if (pthread_create(&worker->decode_thread, NULL, decode_worker_run, worker) != 0) {
+            printf("Could not start decode thread.\n");
+            pthread_mutex_lock(&pool->lock);
+            pool->setup_failed = SC_TRUE;
+            pthread_mutex_unlock(&pool->lock);
+            break;
+        }
+        worker->decode_thread_started = SC_TRUE;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->ready_count < started_count) {
+        pthread_cond_wait(&pool->result_ready, &pool->lock);
+    }
+    const ScBool setup_failed = pool->setup_failed;
+    pthread_mutex_unlock(&pool->lock);
+
+    if (setup_failed) {
+        worker_pool_release(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+static const BatchSlot *sort_slots;
+
+static int compare_by_file_size_descending(const void *lhs, const void *rhs)
+{
+    const off_t lhs_size = sort_slots[*(const size_t *)lhs].input.file_size;
+    const off_t rhs_size = sort_slots[*(const size_t *)rhs].input.file_size;
+    return (lhs_size < rhs_size) - (lhs_size > rhs_size);
+}
+
+/**
+ * Enumerates the next chunk of images and hands it to the workers.
+ *
+ * \returns the number of images in the chunk, 0 if the enumerator is exhausted.
+ */
+static size_t worker_pool_schedule_chunk(WorkerPool *pool, InputEnumerator *enumerator,
+                                         uint64_t first_sequence_number, size_t *chunk)
+{
+    size_t count = 0;
+    while (count < pool->chunk_size) {
+        const size_t index = (first_sequence_number + count) % pool->slot_count;
+        BatchSlot *slot = &pool->slots[index];
+        if (!input_enumerator_next(enumerator, &slot->input)) {
+            break;
+        }
+        // The output buffer of the slot is reused.
+        slot->result.output.length = 0;
+        slot->result.failed = SC_FALSE;
+        slot->result.done = SC_FALSE;
+        chunk[count++] = index;
+    }
+    if (count == 0) {
+        return 0;
+    }
+
+    // Largest files first: the big images determine how long the batch takes, so they
+    // have to be started early. Dealing the sorted images round robin gives every worker
+    // a queue that is sorted as well.
+    sort_slots = pool->slots;
+    qsort(chunk, count, sizeof(size_t), compare_by_file_size_descending);
+    for (size_t i = 0; i < count; ++i) {
+        work_queue_push(&pool->workers[i % pool->worker_count].work_queue, chunk[i]);
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->work_generation++;
+    pthread_cond_broadcast(&pool->work_available);
+    pthread_mutex_unlock(&pool->lock);
+    return count;
+}
+
+/**
+ * Scans all images of the enumerator with the worker pool and prints the results in
+ * input order as soon as they become available. The enumeration runs ahead of the
+ * printed results by at most the number of slots of the pool.
+ *
+ * \returns SC_TRUE if all images were scanned successfully.
+ */
+static ScBool worker_pool_scan_inputs(WorkerPool *pool, InputEnumerator *enumerator)
+{
+    size_t *chunk = malloc(pool->chunk_size * sizeof(size_t));
+    if (chunk == NULL) {
+        printf("Out of memory while scheduling the images.\n");
+        return SC_FALSE;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->run_start_seconds = now_seconds();
+    pthread_mutex_unlock(&pool->lock);
+
+    ScBool success = SC_TRUE;
+    ScBool exhausted = SC_FALSE;
+    uint64_t next_sequence_number = 0;
+    uint64_t printed_count = 0;
+    while (!exhausted || printed_count < next_sequence_number) {
+        if (!exhausted &&
+            next_sequence_number - printed_count + pool->chunk_size <= pool->slot_count) {
+            const size_t count = worker_pool_schedule_chunk(pool, enumerator,
+                                                            next_sequence_number, chunk);
+            next_sequence_number += count;
+            exhausted = count < pool->chunk_size;
+            continue;
+        }
+
+        BatchSlot *slot = &pool->slots[printed_count % pool->slot_count];
+        const double wait_start = now_seconds();
+        pthread_mutex_lock(&pool->lock);
+        while (!slot->result.done) {
+            pthread_cond_wait(&pool->result_ready, &pool->lock);
+        }
+        pthread_mutex_unlock(&pool->lock);
+        const double report_start = now_seconds();
+        pool->report_statistics.input_wait_seconds += report_start - wait_start;
+
+        fwrite(slot->result.output.text, 1, slot->result.output.length, stdout);
+        if (slot->result.failed) {
+            success = SC_FALSE;
+        }
+        free(slot->input.file_name);
+        slot->input.file_name = NULL;
+        printed_count++;
+        pool->report_statistics.busy_seconds += now_seconds() - report_start;
+        pool->report_statistics.items++;
+    }
+    fflush(stdout);
+
+    free(chunk);
+    return success;
+}
+
+static void print_stage_statistics(const char *name, const StageStatistics *statistics,
+                                   double thread_seconds)
+{
+    if (thread_seconds <= 0.0) {
+        return;
+    }
+    printf("  %-7s %8llu images, busy %5.1f%%, waiting for input %5.1f%%, "
+           "waiting for next stage %5.1f%%\n", name,
+           (unsigned long long)statistics->items,
+           100.0 * statistics->busy_seconds / thread_seconds,
+           100.0 * statistics->input_wait_seconds / thread_seconds,
+           100.0 * statistics->output_wait_seconds / thread_seconds);
+}
+
+/**
+ * Prints how much of the run time the stages spent working and waiting. The stage
+ * that is busy while the others wait is the bottleneck.
+ */
+static void worker_pool_print_statistics(const WorkerPool *pool, double run_seconds)
+{
+    StageStatistics decode = { 0, 0.0, 0.0, 0.0 };
+    StageStatistics scan = { 0, 0.0, 0.0, 0.0 };
+    uint64_t occupancy_sum = 0;
+    for (size_t i = 0; i < pool->worker_count; ++i) {
+        const ScanWorker *worker = &pool->workers[i];
+        decode.items += worker->decode_statistics.items;
+        decode.busy_seconds += worker->decode_statistics.busy_seconds;
+        decode.input_wait_seconds += worker->decode_statistics.input_wait_seconds;
+        decode.output_wait_seconds += worker->decode_statistics.output_wait_seconds;
+        scan.items += worker->scan_statistics.items;
+        scan.busy_seconds += worker->scan_statistics.busy_seconds;
+        scan.input_wait_seconds += worker->scan_statistics.input_wait_seconds;
+        occupancy_sum += worker->queue_occupancy_sum;
+    }
+
+    const double worker_seconds = run_seconds * pool->worker_count;
+    printf("Pipeline statistics (%.3f s, %zu workers):\n", run_seconds, pool->worker_count);
+    print_stage_statistics("decode", &decode, worker_seconds);
+    print_stage_statistics("scan", &scan, worker_seconds);
+    print_stage_statistics("report", &pool->report_statistics, run_seconds);
+    if (scan.items > 0) {
+        printf("  decode queue occupancy: %.2f of %d\n",
+               (double)occupancy_sum / scan.items, DECODE_QUEUE_SIZE);
+    }
+
+    const char *bottleneck = "input enumeration";
+    if (decode.output_wait_seconds > scan.input_wait_seconds &&
+        decode.output_wait_seconds > decode.input_wait_seconds) {
+        bottleneck = "scan";
+    } else if (scan.input_wait_seconds > decode.input_wait_seconds) {
+        bottleneck = "decode";
+    }
+    if (pool->report_statistics.busy_seconds > 0.5 * run_seconds) {
+        bottleneck = "report";
+    }
+    printf("  bottleneck: %s\n", bottleneck);
+}
+
+/**
+ * Request of the daemon mode. Either path or shm_name is set.
+ */
+typedef struct ScanRequest {
+    // The "id" member of the request as JSON text. It is copied into the response.
+    char id[64];
+    char path[PATH_MAX];
+    char shm_name[NAME_MAX];
+    ScImageLayout layout;
+    uint32_t width;
+    uint32_t height;
+    uint32_t first_plane_offset;
+    uint32_t first_plane_row_bytes;
+    uint32_t second_plane_offset;
+    uint32_t second_plane_row_bytes;
+    uint32_t memory_size;
+} ScanRequest;
+
+/**
+ * Connection of a client to the daemon. The main thread reads the requests, the
+ * workers write the responses. The last one to drop its reference closes it.
+ */
+typedef struct DaemonClient {
+    int fd;
+    int reference_count;
+    pthread_mutex_t write_lock;
+    char request[DAEMON_MAX_REQUEST_LENGTH];
+    size_t request_length;
+    // Set while the rest of an overlong request line is skipped.
+    ScBool discarding;
+} DaemonClient;
+
+typedef struct DaemonJob {
+    DaemonClient *client;
+    char *line;
+} DaemonJob;
+
+/**
+ * Shared memory buffer mapped by a daemon worker. The last mapping is kept, so
+ * that clients that reuse one buffer do not pay for mapping it again.
+ */
+typedef struct SharedBuffer {
+    char name[NAME_MAX];
+    dev_t device;
+    ino_t inode;
+    const uint8_t *data;
+    size_t size;
+} SharedBuffer;
+
+struct Daemon;
+
+typedef struct DaemonWorker {
+    struct Daemon *daemon;
+    pthread_t thread;
+    ScBool thread_started;
+    ScanWorker scan;
+    GrayImage image;
+    SharedBuffer shared_buffer;
+    TextBuffer response;
+} DaemonWorker;
+
+typedef struct Daemon {
+    DaemonWorker *workers;
+    size_t worker_count;
+    const ScBarcodeScannerSettings *settings;
+
+    DaemonJob jobs[DAEMON_JOB_QUEUE_SIZE];
+    size_t job_head;
+    size_t job_count;
+
+    pthread_mutex_t lock;
+    pthread_cond_t job_available;
+    pthread_cond_t job_space_available;
+    size_t ready_count;
+    ScBool setup_failed;
+    ScBool shutting_down;
+} Daemon;
+
+static volatile sig_atomic_t daemon_running;
+
+static void stop_daemon(int signo)
+{
+    (void)signo;
+    daemon_running = 0;
+}
+
+typedef struct ImageLayoutName {
+    const char *name;
+    ScImageLayout layout;
+    // Bytes per pixel of the first plane.
+    uint32_t pixel_bytes;
+} ImageLayoutName;
+
+// Layouts of shared memory requests.
+static const ImageLayoutName IMAGE_LAYOUT_NAMES[] = {
+    { "gray", SC_IMAGE_LAYOUT_GRAY_8U, 1 },
+    { "rgb", SC_IMAGE_LAYOUT_RGB_8U, 3 },
+    { "rgba", SC_IMAGE_LAYOUT_RGBA_8U, 4 },
+    { "argb", SC_IMAGE_LAYOUT_ARGB_8U, 4 },
+    { "ypcbcr", SC_IMAGE_LAYOUT_YPCBCR_8U, 1 },
+    { "nv12", SC_IMAGE_LAYOUT_YPCBCR_8U, 1 },
+    { "ypcrcb", SC_IMAGE_LAYOUT_YPCRCB_8U, 1 },
+    { "nv21", SC_IMAGE_LAYOUT_YPCRCB_8U, 1 },
+    { "yuyv", SC_IMAGE_LAYOUT_YUYV_8U, 2 },
+    { "uyvy", SC_IMAGE_LAYOUT_UYVY_8U, 2 },
+    { "i420", SC_IMAGE_LAYOUT_I420_8U, 1 },
+};
+#define IMAGE_LAYOUT_NAME_COUNT (sizeof(IMAGE_LAYOUT_NAMES) / sizeof(IMAGE_LAYOUT_NAMES[0]))
+
+static const ImageLayoutName *find_image_layout(ScImageLayout layout)
+{
+    for (size_t i = 0; i < IMAGE_LAYOUT_NAME_COUNT; ++i) {
+        if (IMAGE_LAYOUT_NAMES[i].layout == layout) {
+            return &IMAGE_LAYOUT_NAMES[i];
         }
+    }
+    return NULL;
+}
 
-        // Fill the image description for our loaded image.
-        const uint32_t image_memory_size = row_stride * image_height;
-        sc_image_description_set_layout(image_descr, SC_IMAGE_LAYOUT_RGB_8U);
-        sc_image_description_set_width(image_descr, image_width);
-        sc_image_description_set_height(image_descr, image_height);
-        sc_image_description_set_first_plane_row_bytes(image_descr, row_stride);
-        sc_image_description_set_memory_size(image_descr, image_memory_size);
-
-        // Signal to the context that a new sequence of frames starts. This call is mandatory,
-        // even if we are only going to process one image. Scanning will fail with
-        // SC_RECOGNITION_CONTEXT_STATUS_FRAME_SEQUENCE_NOT_STARTED otherwise.
-        sc_recognition_context_start_new_frame_sequence(context);
-
-        ScProcessFrameResult result =
-                sc_recognition_context_process_frame(context, image_descr,
-                                                     image_data);
-        if (result.status != SC_RECOGNITION_CONTEXT_STATUS_SUCCESS) {
-            printf("Processing frame failed with error %d: '%s'\n", result.status,
-                    sc_context_status_flag_get_message(result.status));
-            return_code = -1;
-            goto cleanup;
+static ScBool parse_image_layout(const char *name, ScImageLayout *layout)
+{
+    for (size_t i = 0; i < IMAGE_LAYOUT_NAME_COUNT; ++i) {
+        if (strcasecmp(name, IMAGE_LAYOUT_NAMES[i].name) == 0) {
+            *layout = IMAGE_LAYOUT_NAMES[i].layout;
+            return SC_TRUE;
         }
+    }
+    return SC_FALSE;
+}
 
-        // Signal to the context that the frame sequence is finished.
-        sc_recognition_context_end_frame_sequence(context);
+/**
+ * Checks that the planes described by a shared memory request lie within its
+ * memory_size. Rows without a given stride are taken to be unpadded.
+ */
+static ScBool validate_shared_image(ScanRequest *request, const char **error)
+{
+    const ImageLayoutName *layout = find_image_layout(request->layout);
+    const uint64_t used_row_bytes = (uint64_t)request->width * layout->pixel_bytes;
+    if (request->first_plane_row_bytes == 0) {
+        request->first_plane_row_bytes = (uint32_t)used_row_bytes;
+    }
+    if (request->first_plane_row_bytes < used_row_bytes) {
+        *error = "first_plane_row_bytes is smaller than a row";
+        return SC_FALSE;
+    }
+    const uint64_t chroma_height = (request->height + 1) / 2;
+    uint64_t end = request->first_plane_offset +
+                   (uint64_t)request->first_plane_row_bytes * request->height;
+    if (request->layout == SC_IMAGE_LAYOUT_YPCBCR_8U ||
+        request->layout == SC_IMAGE_LAYOUT_YPCRCB_8U) {
+        if (request->second_plane_row_bytes == 0) {
+            request->second_plane_row_bytes = request->first_plane_row_bytes;
+        }
+        if (request->second_plane_row_bytes < used_row_bytes + (request->width & 1)) {
+            *error = "second_plane_row_bytes is smaller than a row";
+            return SC_FALSE;
+        }
+        const uint64_t second_plane_end = request->second_plane_offset +
+                                          (uint64_t)request->second_plane_row_bytes * chroma_height;
+        if (second_plane_end > end) {
+            end = second_plane_end;
+        }
+    } else if (request->layout == SC_IMAGE_LAYOUT_I420_8U) {
+        // The chroma planes of I420 follow the luma plane and have no stride of their own.
+        if (request->first_plane_row_bytes != request->width) {
+            *error = "I420 images can not have padded rows";
+            return SC_FALSE;
+        }
+        end += 2 * (uint64_t)((request->width + 1) / 2) * chroma_height;
+    }
+    if (end > request->memory_size) {
+        *error = "the image planes exceed memory_size";
+        return SC_FALSE;
+    }
+    return SC_TRUE;
+}
 
-        // Retrieve the barcode scanner object to get the list of codes that were recognized in
-        // the last frame.
-        ScBarcodeScannerSession *session = sc_barcode_scanner_get_session(scanner);
+/**
+ * Parses one request line of the daemon protocol, e.g.
+ * {"id": 7, "path": "/data/image.png"} or
+ * {"id": 8, "shm": "/frame", "layout": "nv12", "width": 1280, "height": 720,
+ *  "first_plane_row_bytes": 1280, "second_plane_offset": 921600,
+ *  "second_plane_row_bytes": 1280, "memory_size": 1382400}
+ */
+static ScBool parse_scan_request(const char *line, ScanRequest *request, const char **error)
+{
+    memset(request, 0, sizeof(ScanRequest));
+    strcpy(request->id, "null");
 
-        // Get the list of codes that have been found in the last process frame call.
-        ScBarcodeArray * new_codes =
-                sc_barcode_scanner_session_get_newly_recognized_codes(session);
-        uint32_t num_codes = sc_barcode_array_get_size(new_codes);
-        if (num_codes == 0) {
-            printf("no 1d or 2d barcodes found\n");
+    const char *p = json_skip_whitespace(line);
+    if (*p++ != '{') {
+        *error = "request is not a JSON object";
+        return SC_FALSE;
+    }
+    p = json_skip_whitespace(p);
+    while (*p != '}') {
+        char key[32];
+        size_t length;
+        p = json_parse_string(p, key, sizeof(key), &length);
+        if (p == NULL || *(p = json_skip_whitespace(p)) != ':') {
+            *error = "malformed JSON";
+            return SC_FALSE;
         }
+        p = json_skip_whitespace(p + 1);
 
-        for (uint32_t i = 0; i < num_codes; ++i) {
-            const ScBarcode * barcode = sc_barcode_array_get_item_at(new_codes, i);
-            ScByteArray data = sc_barcode_get_data(barcode);
-            ScSymbology symbology = sc_barcode_get_symbology(barcode);
-            const char *symbology_name = sc_symbology_to_string(symbology);
-            // For simplicity it is assumed that the barcode contains textual data, even
-            // though it is possible to encode binary data in QR codes that contain null-
-            // bytes at any position. For applications expecting binary data, use
-            // sc_byte_array_get_data_size() to determine the length of the returned data.
-            printf("barcode: symbology=%s, data='%s'\n", symbology_name, data.str);
+        const char *value_end = json_skip_value(p);
+        if (value_end == NULL) {
+            *error = "malformed JSON";
+            return SC_FALSE;
+        }
+        if (strcmp(key, "id") == 0) {
+            const size_t length = value_end - p;
+            if (length >= sizeof(request->id)) {
+                *error = "id too long";
+                return SC_FALSE;
+            }
+            memcpy(request->id, p, length);
+            request->id[length] = '\0';
+        } else if (strcmp(key, "path") == 0) {
+            if (json_parse_string(p, request->path, sizeof(request->path), &length) == NULL) {
+                *error = "invalid path";
+                return SC_FALSE;
+            }
+        } else if (strcmp(key, "shm") == 0) {
+            if (json_parse_string(p, request->shm_name, sizeof(request->shm_name), &length) == NULL) {
+                *error = "invalid shm name";
+                return SC_FALSE;
+            }
+        } else if (strcmp(key, "layout") == 0) {
+            char name[16];
+            if (*p == '"') {
+                if (json_parse_string(p, name, sizeof(name), &length) == NULL ||
+                    !parse_image_layout(name, &request->layout)) {
+                    *error = "unknown layout";
+                    return SC_FALSE;
+                }
+            } else {
+                char *number_end;
+                const unsigned long value = strtoul(p, &number_end, 10);
+                if (number_end != value_end || value > UINT32_MAX ||
+                    find_image_layout((ScImageLayout)value) == NULL) {
+                    *error = "unknown layout";
+                    return SC_FALSE;
+                }
+                request->layout = (ScImageLayout)value;
+            }
+        } else {
+            static const char * const numeric_keys[] = {
+                "width", "height", "first_plane_offset", "first_plane_row_bytes",
+                "second_plane_offset", "second_plane_row_bytes", "memory_size"
+            };
+            uint32_t * const numeric_values[] = {
+                &request->width, &request->height, &request->first_plane_offset,
+                &request->first_plane_row_bytes, &request->second_plane_offset,
+                &request->second_plane_row_bytes, &request->memory_size
+            };
+            for (size_t i = 0; i < sizeof(numeric_keys) / sizeof(numeric_keys[0]); ++i) {
+                if (strcmp(key, numeric_keys[i]) == 0) {
+                    char *number_end;
+                    const unsigned long value = strtoul(p, &number_end, 10);
+                    if (number_end != value_end || value > UINT32_MAX) {
+                        *error = "invalid number";
+                        return SC_FALSE;
+                    }
+                    *numeric_values[i] = (uint32_t)value;
+                }
+            }
+            // Unknown members are ignored.
         }
-        sc_barcode_array_release(new_codes);
 
-        free(image_data);
-        image_data = NULL;
+        p = json_skip_whitespace(value_end);
+        if (*p == ',') {
+            p = json_skip_whitespace(p + 1);
+        } else if (*p != '}') {
+            *error = "malformed JSON";
+            return SC_FALSE;
+        }
     }
 
-cleanup:
-    // Cleanup allocated data and objects. These functions all check for null values,
-    // so it's save to pass in null objects.
-    sc_barcode_scanner_release(scanner);
-    sc_barcode_scanner_settings_release(settings);
-    sc_recognition_context_release(context);
-    sc_image_description_release(image_descr);
+    if ((request->path[0] == '\0') == (request->shm_name[0] == '\0')) {
+        *error = "either path or shm is required";
+        return SC_FALSE;
+    }
+    if (request->shm_name[0] != '\0' &&
+        (request->layout == SC_IMAGE_LAYOUT_UNKNOWN || request->width == 0 ||
+         request->height == 0 || request->memory_size == 0)) {
+        *error = "shm requests need layout, width, height and memory_size";
+        return SC_FALSE;
+    }
+    if (request->shm_name[0] != '\0' && !validate_shared_image(request, error)) {
+        return SC_FALSE;
+    }
+    return SC_TRUE;
+}
+
+static void text_buffer_append_json_string(TextBuffer *buffer, const char *data, size_t length)
+{
+    text_buffer_printf(buffer, "\"");
+    for (size_t i = 0; i < length; ++i) {
+        const unsigned char c = (unsigned char)data[i];
+        if (c == '"' || c == '\\') {
+            text_buffer_printf(buffer, "\\%c", c);
+        } else if (c < 0x20) {
+            text_buffer_printf(buffer, "\\u%04x", c);
+        } else {
+            text_buffer_printf(buffer, "%c", c);
+        }
+    }
+    text_buffer_printf(buffer, "\"");
+}
+
+static void daemon_client_release(DaemonClient *client)
+{
+    if (__atomic_sub_fetch(&client->reference_count, 1, __ATOMIC_ACQ_REL) == 0) {
+        close(client->fd);
+        pthread_mutex_destroy(&client->write_lock);
+        free(client);
+    }
+}
+
+/**
+ * Writes one complete response line. Responses of different workers to the same
+ * client are not interleaved.
+ */
+static void daemon_client_send(DaemonClient *client, const TextBuffer *response)
+{
+    pthread_mutex_lock(&client->write_lock);
+    size_t written = 0;
+    while (written < response->length) {
+        const ssize_t result = write(client->fd, response->text + written,
+                                     response->length - written);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            // The client is gone, the main thread notices it as well.
+            break;
+        }
+        written += result;
+    }
+    pthread_mutex_unlock(&client->write_lock);
+}
+
+static void shared_buffer_unmap(SharedBuffer *buffer)
+{
+    if (buffer->data != NULL) {
+        munmap((void *)buffer->data, buffer->size);
+    }
+    memset(buffer, 0, sizeof(SharedBuffer));
+}
+
+/**
+ * Maps the named POSIX shared memory object. The previous mapping is reused if the
+ * request refers to the same object.
+ */
+static const char *shared_buffer_map(SharedBuffer *buffer, const char *name)
+{
+    const int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        return strerror(errno);
+    }
+    struct stat buffer_stat;
+    if (fstat(fd, &buffer_stat) != 0) {
+        close(fd);
+        return strerror(errno);
+    }
+    if (buffer->data != NULL && strcmp(buffer->name, name) == 0 &&
+        buffer->device == buffer_stat.st_dev && buffer->inode == buffer_stat.st_ino &&
+        buffer->size == (size_t)buffer_stat.st_size) {
+        close(fd);
+        return NULL;
+    }
+
+    shared_buffer_unmap(buffer);
+    if (buffer_stat.st_size == 0) {
+        close(fd);
+        return "shared memory object is empty";
+    }
+    void *data = mmap(NULL, buffer_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return strerror(errno);
+    }
+    snprintf(buffer->name, sizeof(buffer->name), "%s", name);
+    buffer->device = buffer_stat.st_dev;
+    buffer->inode = buffer_stat.st_ino;
+    buffer->data = data;
+    buffer->size = buffer_stat.st_size;
+    return NULL;
+}
+
+/**
+ * Loads or maps the image of the request and fills the image description.
+ *
+ * \returns the image data or NULL on failure.
+ */
+static const uint8_t *daemon_worker_prepare_image(DaemonWorker *worker, const ScanRequest *request,
+                                                  const char **error)
+{
+    if (request->path[0] != '\0') {
+        TextBuffer load_messages = { NULL, 0, 0 };
+        const ScBool loaded = load_image(request->path, &worker->image, &load_messages);
+        text_buffer_free(&load_messages);
+        if (!loaded) {
+            *error = "could not load image";
+            return NULL;
+        }
+        scan_worker_describe_gray_image(&worker->scan, &worker->image);
+        return worker->image.data;
+    }
+
+    *error = shared_buffer_map(&worker->shared_buffer, request->shm_name);
+    if (*error != NULL) {
+        return NULL;
+    }
+    if (request->memory_size > worker->shared_buffer.size) {
+        *error = "memory_size exceeds the shared memory object";
+        return NULL;
+    }
+
+    ScImageDescription *image_descr = worker->scan.image_descr;
+    sc_image_description_set_layout(image_descr, request->layout);
+    sc_image_description_set_width(image_descr, request->width);
+    sc_image_description_set_height(image_descr, request->height);
+    sc_image_description_set_first_plane_offset(image_descr, request->first_plane_offset);
+    sc_image_description_set_first_plane_row_bytes(image_descr, request->first_plane_row_bytes);
+    sc_image_description_set_second_plane_offset(image_descr, request->second_plane_offset);
+    sc_image_description_set_second_plane_row_bytes(image_descr, request->second_plane_row_bytes);
+    sc_image_description_set_memory_size(image_descr, request->memory_size);
+    return worker->shared_buffer.data;
+}
+
+/**
+ * Handles one request line and writes the NDJSON response into the response buffer
+ * of the worker.
+ */
+static void daemon_worker_handle(DaemonWorker *worker, const char *line)
+{
+    TextBuffer *response = &worker->response;
+    response->length = 0;
+
+    ScanRequest request;
+    const char *error = NULL;
+    if (!parse_scan_request(line, &request, &error)) {
+        text_buffer_printf(response, "{\"id\":%s,\"status\":\"error\",\"message\":", request.id);
+        text_buffer_append_json_string(response, error, strlen(error));
+        text_buffer_printf(response, "}\n");
+        return;
+    }
+
+    const uint8_t *image_data = daemon_worker_prepare_image(worker, &request, &error);
+    if (image_data == NULL) {
+        text_buffer_printf(response, "{\"id\":%s,\"status\":\"error\",\"message\":", request.id);
+        text_buffer_append_json_string(response, error, strlen(error));
+        text_buffer_printf(response, "}\n");
+        return;
+    }
+
+    const double recognition_start = now_seconds();
+    ScContextStatusFlag status;
+    ScBarcodeArray *new_codes = scan_worker_process_frame(&worker->scan, image_data, &status);
+    const double recognition_ms = (now_seconds() - recognition_start) * 1000.0;
+    if (new_codes == NULL) {
+        const char *message = sc_context_status_flag_get_message(status);
+        text_buffer_printf(response, "{\"id\":%s,\"status\":\"error\",\"code\":%d,\"message\":",
+                           request.id, status);
+        text_buffer_append_json_string(response, message, strlen(message));
+        text_buffer_printf(response, "}\n");
+        return;
+    }
+
+    text_buffer_printf(response, "{\"id\":%s,\"status\":\"ok\",\"recognition_ms\":%.3f,\"codes\":[",
+                       request.id, recognition_ms);
+    const uint32_t num_codes = sc_barcode_array_get_size(new_codes);
+    for (uint32_t i = 0; i < num_codes; ++i) {
+        const ScBarcode *barcode = sc_barcode_array_get_item_at(new_codes, i);
+        const ScByteArray data = sc_barcode_get_data(barcode);
+        const char *symbology_name = sc_symbology_to_string(sc_barcode_get_symbology(barcode));
+        const ScQuadrilateral location = sc_barcode_get_location(barcode);
+        text_buffer_printf(response, "%s{\"symbology\":", i > 0 ? "," : "");
+        text_buffer_append_json_string(response, symbology_name, strlen(symbology_name));
+        text_buffer_printf(response, ",\"data\":");
+        text_buffer_append_json_string(response, data.str, data.length);
+        text_buffer_printf(response, ",\"location\":[[%d,%d],[%d,%d],[%d,%d],[%d,%d]]}",
+                           location.top_left.x, location.top_left.y,
+                           location.top_right.x, location.top_right.y,
+                           location.bottom_right.x, location.bottom_right.y,
+                           location.bottom_left.x, location.bottom_left.y);
+    }
+    text_buffer_printf(response, "]}\n");
+    sc_barcode_array_release(new_codes);
+}
+
+static void *daemon_worker_run(void *argument)
+{
+    DaemonWorker *worker = argument;
+    Daemon *daemon = worker->daemon;
+
+    // The context and the scanner are set up once and then serve all requests.
+    const ScBool setup_succeeded = scan_worker_setup(&worker->scan, daemon->settings);
+
+    pthread_mutex_lock(&daemon->lock);
+    daemon->ready_count++;
+    if (!setup_succeeded) {
+        daemon->setup_failed = SC_TRUE;
+    }
+    pthread_cond_broadcast(&daemon->job_available);
+    pthread_mutex_unlock(&daemon->lock);
+
+    for (;;) {
+        pthread_mutex_lock(&daemon->lock);
+        while (!daemon->shutting_down && daemon->job_count == 0) {
+            pthread_cond_wait(&daemon->job_available, &daemon->lock);
+        }
+        if (daemon->job_count == 0) {
+            pthread_mutex_unlock(&daemon->lock);
+            break;
+        }
+        const DaemonJob job = daemon->jobs[daemon->job_head];
+        daemon->job_head = (daemon->job_head + 1) % DAEMON_JOB_QUEUE_SIZE;
+        daemon->job_count--;
+        pthread_cond_signal(&daemon->job_space_available);
+        pthread_mutex_unlock(&daemon->lock);
+
+        if (setup_succeeded) {
+            daemon_worker_handle(worker, job.line);
+            daemon_client_send(job.client, &worker->response);
+        }
+        free(job.line);
+        daemon_client_release(job.client);
+    }
+
+    shared_buffer_unmap(&worker->shared_buffer);
+    gray_image_free(&worker->image);
+    text_buffer_free(&worker->response);
+    scan_worker_teardown(&worker->scan);
+    return NULL;
+}
+
+/**
+ * Queues a request line. Blocks while all workers are busy and the queue is full,
+ * which stops the main thread from reading further requests.
+ */
+static void daemon_submit(Daemon *daemon, DaemonClient *client, const char *line, size_t length)
+{
+    char *line_copy = strndup(line, length);
+    if (line_copy == NULL) {
+        return;
+    }
+    __atomic_add_fetch(&client->reference_count, 1, __ATOMIC_RELAXED);
+
+    pthread_mutex_lock(&daemon->lock);
+    while (daemon->job_count == DAEMON_JOB_QUEUE_SIZE) {
+        pthread_cond_wait(&daemon->job_space_available, &daemon->lock);
+    }
+    DaemonJob *job = &daemon->jobs[(daemon->job_head + daemon->job_count) % DAEMON_JOB_QUEUE_SIZE];
+    job->client = client;
+    job->line = line_copy;
+    daemon->job_count++;
+    pthread_cond_signal(&daemon->job_available);
+    pthread_mutex_unlock(&daemon->lock);
+}
+
+/**
+ * Reads from the client and submits all complete request lines.
+ *
+ * \returns SC_FALSE when the client has closed the connection.
+ */
+static ScBool daemon_read_requests(Daemon *daemon, DaemonClient *client)
+{
+    const ssize_t read_bytes = read(client->fd, client->request + client->request_length,
+                                    sizeof(client->request) - client->request_length);
+    if (read_bytes < 0 && (errno == EINTR || errno == EAGAIN)) {
+        return SC_TRUE;
+    }
+    if (read_bytes <= 0) {
+        return SC_FALSE;
+    }
+    client->request_length += read_bytes;
+
+    size_t line_start = 0;
+    for (size_t i = client->request_length - read_bytes; i < client->request_length; ++i) {
+        if (client->request[i] != '\n') {
+            continue;
+        }
+        if (!client->discarding && i > line_start) {
+            daemon_submit(daemon, client, client->request + line_start, i - line_start);
+        }
+        client->discarding = SC_FALSE;
+        line_start = i + 1;
+    }
+    memmove(client->request, client->request + line_start, client->request_length - line_start);
+    client->request_length -= line_start;
+
+    if (client->request_length == sizeof(client->request)) {
+        // The line does not fit into the buffer. It is dropped up to the next newline.
+        TextBuffer response = { NULL, 0, 0 };
+        text_buffer_printf(&response, "{\"id\":null,\"status\":\"error\","
+                                      "\"message\":\"request too long\"}\n");
+        daemon_client_send(client, &response);
+        text_buffer_free(&response);
+        client->discarding = SC_TRUE;
+        client->request_length = 0;
+    }
+    return SC_TRUE;
+}
+
+static int daemon_listen(const char *socket_path)
+{
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(address.sun_path)) {
+        printf("Socket path '%s' is too long.\n", socket_path);
+        return -1;
+    }
+    strcpy(address.sun_path, socket_path);
+
+    const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        printf("Could not create socket: %s\n", strerror(errno));
+        return -1;
+    }
+    // Remove the socket of a previous run.
+    unlink(socket_path);
+    if (bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+        listen(fd, DAEMON_MAX_CLIENTS) != 0) {
+        printf("Could not listen on '%s': %s\n", socket_path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void daemon_release(Daemon *daemon)
+{
+    pthread_mutex_lock(&daemon->lock);
+    daemon->shutting_down = SC_TRUE;
+    pthread_cond_broadcast(&daemon->job_available);
+    pthread_mutex_unlock(&daemon->lock);
+
+    for (size_t i = 0; i < daemon->worker_count; ++i) {
+        if (daemon->workers[i].thread_started) {
+            pthread_join(daemon->workers[i].thread, NULL);
+        }
+    }
+    pthread_mutex_destroy(&daemon->lock);
+    pthread_cond_destroy(&daemon->job_available);
+    pthread_cond_destroy(&daemon->job_space_available);
+    free(daemon->workers);
+}
+
+/**
+ * Runs the scan daemon. Every worker keeps its warmed up recognition context and
+ * barcode scanner for the whole lifetime of the daemon. Requests are read from the
+ * clients of the Unix domain socket and handed to the next free worker, responses are
+ * written back as one JSON object per line. Responses to requests of the same client
+ * may arrive in a different order than the requests, the id of the request is copied
+ * into the response.
+ */
+static int run_daemon(const char *socket_path, size_t worker_count,
+                      const ScBarcodeScannerSettings *settings)
+{
+    Daemon daemon;
+    memset(&daemon, 0, sizeof(daemon));
+    daemon.settings = settings;
+    daemon.workers = calloc(worker_count, sizeof(DaemonWorker));
+    if (daemon.workers == NULL) {
+        return -1;
+    }
+    daemon.worker_count = worker_count;
+    pthread_mutex_init(&daemon.lock, NULL);
+    pthread_cond_init(&daemon.job_available, NULL);
+    pthread_cond_init(&daemon.job_space_available, NULL);
+
+    size_t started_count = 0;
+    for (size_t i = 0; i < worker_count; ++i) {
+        DaemonWorker *worker = &daemon.workers[i];
+        worker->daemon = &daemon;
+        if (pthread_create(&worker->thread, NULL, daemon_worker_run, worker) != 0) {
+            printf("Could not start worker thread.\n");
+            daemon.setup_failed = SC_TRUE;
+            break;
+        }
+        worker->thread_started = SC_TRUE;
+        started_count++;
+    }
 
-    free(image_data);
-    for (InputImage const *current_image = images; current_image != NULL;) {
-        InputImage const *next_image = current_image->next;
+    pthread_mutex_lock(&daemon.lock);
+    while (daemon.ready_count < started_count) {
+        pthread_cond_wait(&daemon.job_available, &daemon.lock);
+    }
+    const ScBool setup_failed = daemon.setup_failed;
+    pthread_mutex_unlock(&daemon.lock);
+
+    const int listen_fd = setup_failed ? -1 : daemon_listen(socket_path);
+    if (listen_fd < 0) {
+        daemon_release(&daemon);
+        return -1;
+    }
+
+    // Writes to clients that have disconnected must not terminate the daemon.
+    signal(SIGPIPE, SIG_IGN);
+    daemon_running = 1;
+    signal(SIGINT, stop_daemon);
+    signal(SIGTERM, stop_daemon);
+    printf("Scan daemon with %zu warmed up scanners listening on '%s'.\n",
+           worker_count, socket_path);
+    fflush(stdout);
+
+    struct pollfd poll_fds[DAEMON_MAX_CLIENTS + 1];
+    DaemonClient *clients[DAEMON_MAX_CLIENTS + 1];
+    size_t poll_count = 1;
+    poll_fds[0].fd = listen_fd;
+    poll_fds[0].events = POLLIN;
+    clients[0] = NULL;
+
+    while (daemon_running) {
+        if (poll(poll_fds, poll_count, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            printf("poll failed: %s\n", strerror(errno));
+            break;
+        }
+
+        for (size_t i = poll_count; i-- > 1;) {
+            if (poll_fds[i].revents == 0) {
+                continue;
+            }
+            if (daemon_read_requests(&daemon, clients[i])) {
+                continue;
+            }
+            // Pending jobs keep the client alive until their responses are written.
+            daemon_client_release(clients[i]);
+            poll_count--;
+            poll_fds[i] = poll_fds[poll_count];
+            clients[i] = clients[poll_count];
+        }
+
+        if (poll_fds[0].revents & POLLIN) {
+            const int client_fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+            if (client_fd < 0) {
+                continue;
+            }
+            DaemonClient *client = poll_count <= DAEMON_MAX_CLIENTS ?
+                                   calloc(1, sizeof(DaemonClient)) : NULL;
+            if (client == NULL) {
+                close(client_fd);
+                continue;
+            }
+            client->fd = client_fd;
+            client->reference_count = 1;
+            pthread_mutex_init(&client->write_lock, NULL);
+            poll_fds[poll_count].fd = client_fd;
+            poll_fds[poll_count].events = POLLIN;
+            clients[poll_count] = client;
+            poll_count++;
+        }
+    }
+
+    printf("Scan daemon shutting down.\n");
+    // Queued requests are still answered before the workers stop.
+    daemon_release(&daemon);
+    for (size_t i = 1; i < poll_count; ++i) {
+        daemon_client_release(clients[i]);
+    }
+    close(listen_fd);
+    unlink(socket_path);
+    return 0;
+}
+
+static void print_usage(const char *program_name)
+{
+    printf("Usage: %s [-j worker-count] [--stats] [--tile size [--tile-overlap pixels]]\n"
+           "           image-or-directory...\n"
+           "       %s [-j worker-count] --daemon socket-path\n", program_name, program_name);
+}
+
+int main(int argc, char *argv[])
+{
+    long worker_count = 1;
+    ScBool print_statistics = SC_FALSE;
+    const char *daemon_socket_path = NULL;
+    long tile_size = 0;
+    long tile_overlap = DEFAULT_TILE_OVERLAP;
+
+    static const struct option long_options[] = {
+        { "jobs", required_argument, NULL, 'j' },
+        { "stats", no_argument, NULL, 's' },
+        { "daemon", required_argument, NULL, 'd' },
+        { "tile", required_argument, NULL, 't' },
+        { "tile-overlap", required_argument, NULL, 'o' },
+        { "help", no_argument, NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+    int option;
+    while ((option = getopt_long(argc, argv, "j:sd:h", long_options, NULL)) != -1) {
+        switch (option) {
+            case 't':
+                tile_size = strtol(optarg, NULL, 10);
+                if (tile_size < MIN_TILE_SIZE || tile_size > UINT16_MAX) {
+                    printf("The tile size must be between %d and %d pixels.\n", MIN_TILE_SIZE, UINT16_MAX);
+                    return -1;
+                }
+                break;
+            case 'o':
+                tile_overlap = strtol(optarg, NULL, 10);
+                if (tile_overlap < 0) {
+                    printf("The tile overlap must not be negative.\n");
+                    return -1;
+                }
+                break;
+            case 'd':
+                daemon_socket_path = optarg;
+                break;
+            case 's':
+                print_statistics = SC_TRUE;
+                break;
+            case 'j':
+                worker_count = strtol(optarg, NULL, 10);
+                if (worker_count < 1 || worker_count > MAX_WORKER_COUNT) {
+                    printf("The number of workers must be between 1 and %d.\n", MAX_WORKER_COUNT);
+                    return -1;
+                }
+                break;
+            case 'h':
+                print_usage(argv[0]);
+                return 0;
+            default:
+                print_usage(argv[0]);
+                return -1;
+        }
+    }
+
+    if (optind >= argc && daemon_socket_path == NULL) {
+        printf("Please provide paths to image files or directories as arguments.\n");
+        return -1;
+    }
+    if (tile_size > 0 && tile_overlap * 2 > tile_size) {
+        printf("The tile overlap must not be more than half of the tile size.\n");
+        return -1;
+    }
+    printf("Scandit SDK Version: %s\n", SC_VERSION_STRING);
+
+    int return_code = 0;
+
+    ScBarcodeScannerSettings *settings = NULL;
+    TilePool *tile_pool = NULL;
+    WorkerPool *pool = NULL;
+
+    InputEnumerator enumerator;
+    input_enumerator_init(&enumerator, argc - optind, (char const * const *)argv + optind);
+
+    // Initialize the image decoders up front. SDL_image would do this lazily on the first
+    // load, which is not safe while several workers load images at the same time.
+    IMG_Init(IMG_INIT_JPG | IMG_INIT_PNG | IMG_INIT_TIF);
+
+    settings = create_scanner_settings();
+    if (settings == NULL) {
+        printf("Could not initialize settings.\n");
+        return_code = -1;
+        goto cleanup;
+    }
 
-        free((char *)current_image->file_name);
-        free((char *)current_image);
+    if (daemon_socket_path != NULL) {
+        return_code = run_daemon(daemon_socket_path, worker_count, settings);
+        goto cleanup;
+    }
+
+    if (tile_size > 0) {
+        // The tile helpers use the cores that are not taken by the workers. The
+        // workers scan tiles themselves as well.
+        const long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+        const size_t helper_count = cpu_count > worker_count ? (size_t)(cpu_count - worker_count) : 1;
+        tile_pool = tile_pool_new((uint32_t)tile_size, (uint32_t)tile_overlap, helper_count, settings);
+        if (tile_pool == NULL) {
+            return_code = -1;
+            goto cleanup;
+        }
+    }
+
+    // Every worker creates its own recognition context and barcode scanner.
+    pool = worker_pool_new(worker_count, settings, tile_pool);
+    if (pool == NULL) {
+        return_code = -1;
+        goto cleanup;
+    }
 
-        current_image = next_image;
+    if (!worker_pool_scan_inputs(pool, &enumerator)) {
+        return_code = -1;
     }
+    if (print_statistics) {
+        worker_pool_print_statistics(pool, now_seconds() - pool->run_start_seconds);
+    }
+
+cleanup:
+    worker_pool_release(pool);
+    tile_pool_release(tile_pool);
+    sc_barcode_scanner_settings_release(settings);
+    input_enumerator_release(&enumerator);
+    IMG_Quit();
 
     return return_code;
 }
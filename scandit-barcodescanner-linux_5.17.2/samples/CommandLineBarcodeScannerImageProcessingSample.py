@@ -1,41 +1,41 @@
 #!/usr/bin/env python
 # This example configures the SDK for a single image use case without any resource restrictions.
+#
+# Given a single image the codes of that image are printed. Given directories, glob
+# patterns or several images, all images are scanned by a pool of worker processes
+# and the codes are printed in the order of the images:
+#
+#   python3 CommandLineBarcodeScannerImageProcessingSample.py -j 8 /path/to/images "*.png"
 
 from __future__ import print_function
-import sys
+import argparse
+import collections
+import concurrent.futures
+import ctypes
+import glob
+import multiprocessing
+import os
+import queue
 import tempfile
 import sdl2.ext
 import scanditsdk as sc
+import scanditsdk_buffers
 
-if __name__ == "__main__":
-    if len(sys.argv) < 2:
-        print("Please provide a path to an image file as argument.")
-        exit(1)
+# Image files the batch mode picks up in directories.
+IMAGE_EXTENSIONS = (".png", ".jpg", ".jpeg", ".tif", ".bmp", ".pgm")
 
-    image_path = sys.argv[1]
-    image_surface = sdl2.ext.load_image(image_path, enforce="SDL")
-
-    # We convert the image to RGB for consistency.
-    # Gray or any YUV formats are recommended if speed is critical.
-    rgb_image_surface = sdl2.SDL_ConvertSurfaceFormat(
-        image_surface, sdl2.SDL_PIXELFORMAT_RGB24, 0
-    )
-
-    descr = sc.ImageDescription()
-    descr.width = rgb_image_surface.contents.w
-    descr.height = rgb_image_surface.contents.h
-    descr.first_plane_row_bytes = rgb_image_surface.contents.pitch
-    descr.layout = sc.IMAGE_LAYOUT_RGB_8U
-    descr.memory_size = rgb_image_surface.contents.pitch * rgb_image_surface.contents.h
 
+def create_context():
     # Create a recognition context. Files created by the recognition context and the
     # attached scanner will be written to a temporary directory. In production environment,
     # it should be replaced with writable path which does not get removed between reboots.
     writable_temporary_directory = tempfile.gettempdir()
-    context = sc.RecognitionContext(
+    return sc.RecognitionContext(
         "-- INSERT YOUR LICENSE KEY HERE --", writable_temporary_directory
     )
 
+
+def create_settings():
     # Use the single frame preset.
     settings = sc.BarcodeScannerSettings(preset=sc.PRESET_ENABLE_SINGLE_FRAME_MODE)
 
@@ -62,11 +62,38 @@ if __name__ == "__main__":
     symbology_settings = settings.symbologies[sc.SYMBOLOGY_EAN13]
     symbology_settings.color_inverted_enabled = True
 
-    scanner = sc.BarcodeScanner(context, settings)
+    return settings
+
+
+def load_rgb_image(image_path):
+    # We convert the image to RGB for consistency.
+    # Gray or any YUV formats are recommended if speed is critical.
+    image_surface = sdl2.ext.load_image(image_path, enforce="SDL")
+    rgb_image_surface = sdl2.SDL_ConvertSurfaceFormat(
+        image_surface, sdl2.SDL_PIXELFORMAT_RGB24, 0
+    )
+    sdl2.SDL_FreeSurface(image_surface)
+    if not rgb_image_surface:
+        raise RuntimeError("Could not convert '{}' to RGB".format(image_path))
+    return rgb_image_surface
+
+
+def scan_single_image(image_path):
+    rgb_image_surface = load_rgb_image(image_path)
+
+    # Wrap the pixels of the surface as a (rows, row bytes) buffer without copying them.
+    # NumPy arrays of shape (height, width, 3) can be passed directly instead.
+    surface = rgb_image_surface.contents
+    pixels = (ctypes.c_uint8 * (surface.pitch * surface.h)).from_address(surface.pixels)
+    frame = memoryview(pixels).cast("B", (surface.h, surface.pitch))
+
+    context = create_context()
+    scanner = sc.BarcodeScanner(context, create_settings())
     scanner.wait_for_setup_completed()
 
-    frame_seq = context.start_new_frame_sequence()
-    status = frame_seq.process_frame(descr, rgb_image_surface.contents.pixels)
+    # The image description is filled in from the shape and strides of the buffer.
+    frame_seq = scanditsdk_buffers.BufferFrameSequence(context)
+    status = frame_seq.process_frame(frame, sc.IMAGE_LAYOUT_RGB_8U, width=surface.w)
     frame_seq.end()
 
     if status.status != sc.RECOGNITION_CONTEXT_STATUS_SUCCESS:
@@ -77,7 +104,8 @@ if __name__ == "__main__":
         )
         exit(2)
 
-    codes = scanner.session.newly_recognized_codes
+    # All codes are read at once, see scanditsdk_buffers.RecognizedCodes.
+    codes = scanditsdk_buffers.newly_recognized_codes(scanner.session)
     if len(codes):
         for code in codes:
             print(
@@ -97,3 +125,218 @@ if __name__ == "__main__":
             print("Top right corner: ", code.location.top_right, sep="")
     else:
         print("No barcode found.")
+
+
+def collect_image_paths(arguments):
+    # Directories are searched recursively, glob patterns are expanded and
+    # everything else is taken as an image path.
+    for argument in arguments:
+        if os.path.isdir(argument):
+            for directory, directories, files in os.walk(argument):
+                directories.sort()
+                for name in sorted(files):
+                    if name.lower().endswith(IMAGE_EXTENSIONS):
+                        yield os.path.join(directory, name)
+        elif glob.has_magic(argument):
+            for path in sorted(glob.glob(argument, recursive=True)):
+                if os.path.isfile(path):
+                    yield path
+        else:
+            yield argument
+
+
+class ImageSlot(object):
+    """
+    A shared-memory buffer the images are decoded into. The workers map the same
+    memory and scan the image in place. A slot grows when an image does not fit.
+    """
+
+    def __init__(self, index):
+        self.index = index
+        self.memory = None
+        self.pixels = None
+
+    def reserve(self, size):
+        # Imported here, shared memory needs Python 3.8 but single images do not.
+        from multiprocessing import shared_memory
+
+        if self.memory is not None and self.memory.size >= size:
+            return
+        self.release()
+        self.memory = shared_memory.SharedMemory(create=True, size=size)
+        self.pixels = (ctypes.c_uint8 * self.memory.size).from_buffer(self.memory.buf)
+
+    def release(self):
+        if self.memory is not None:
+            # The ctypes view must be gone before the memory can be closed.
+            self.pixels = None
+            self.memory.close()
+            self.memory.unlink()
+            self.memory = None
+
+
+# The context and scanner of a worker process, created once by init_worker().
+_worker = None
+
+
+def init_worker():
+    global _worker
+    context = create_context()
+    scanner = sc.BarcodeScanner(context, create_settings())
+    scanner.wait_for_setup_completed()
+    _worker = {"context": context, "scanner": scanner, "slots": {}}
+
+
+def attach_slot(index, name):
+    from multiprocessing import resource_tracker, shared_memory
+
+    slots = _worker["slots"]
+    memory = slots.get(index)
+    if memory is None or memory.name != name:
+        if memory is not None:
+            memory.close()
+        # The process that created the memory also removes it. Before Python 3.13
+        # attaching always registers the memory for removal at exit.
+        try:
+            memory = shared_memory.SharedMemory(name=name, track=False)
+        except TypeError:
+            memory = shared_memory.SharedMemory(name=name)
+            # The tracker knows the memory by its POSIX name, with the leading slash
+            # that SharedMemory.name leaves out.
+            resource_tracker.unregister("/" + memory.name.lstrip("/"), "shared_memory")
+        slots[index] = memory
+    return memory
+
+
+def scan_slot(index, name, width, height, pitch):
+    memory = attach_slot(index, name)
+    view = memory.buf[: height * pitch]
+    frame = view.cast("B", (height, pitch))
+    try:
+        frame_seq = scanditsdk_buffers.BufferFrameSequence(_worker["context"])
+        status = frame_seq.process_frame(frame, sc.IMAGE_LAYOUT_RGB_8U, width=width)
+        frame_seq.end()
+    finally:
+        frame.release()
+        view.release()
+
+    if status.status != sc.RECOGNITION_CONTEXT_STATUS_SUCCESS:
+        return "Processing frame failed with code {}: {}".format(
+            status.status, status.get_status_flag_message()
+        )
+
+    codes = scanditsdk_buffers.newly_recognized_codes(_worker["scanner"].session)
+    return [
+        (
+            code.data,
+            code.symbology_string,
+            tuple((corner.x, corner.y) for corner in code.location.all_corners),
+        )
+        for code in codes
+    ]
+
+
+def decode_into_slot(image_path, slot):
+    # Runs on a decoder thread. SDL releases the GIL while it decodes.
+    rgb_image_surface = load_rgb_image(image_path)
+    try:
+        surface = rgb_image_surface.contents
+        slot.reserve(surface.pitch * surface.h)
+        ctypes.memmove(slot.pixels, surface.pixels, surface.pitch * surface.h)
+        return surface.w, surface.h, surface.pitch
+    finally:
+        sdl2.SDL_FreeSurface(rgb_image_surface)
+
+
+def print_batch_result(image_path, result):
+    if isinstance(result, str):
+        print("{}: {}".format(image_path, result))
+        return False
+    if not result:
+        print("{}: No barcode found.".format(image_path))
+    for data, symbology, corners in result:
+        print("{}: {} ({}) at {}".format(image_path, data, symbology, corners))
+    return True
+
+
+def scan_batch(arguments, jobs):
+    # Every image is decoded on a decoder thread into a free shared-memory slot and
+    # scanned by one of the worker processes. There are twice as many slots as
+    # workers, so the next images are decoded while the current ones are scanned.
+    slots = [ImageSlot(index) for index in range(2 * jobs)]
+    free_slots = queue.Queue()
+    for slot in slots:
+        free_slots.put(slot)
+
+    def submit(image_path, slot, pool):
+        try:
+            width, height, pitch = decode_into_slot(image_path, slot)
+        except Exception as error:
+            free_slots.put(slot)
+            return error
+        return pool.apply_async(
+            scan_slot,
+            (slot.index, slot.memory.name, width, height, pitch),
+            callback=lambda result: free_slots.put(slot),
+            error_callback=lambda error: free_slots.put(slot),
+        )
+
+    def finish(image_path, future):
+        pending = future.result()
+        try:
+            result = pending if isinstance(pending, Exception) else pending.get()
+        except Exception as error:
+            result = error
+        if isinstance(result, Exception):
+            result = "Scanning failed: {}".format(result)
+        return print_batch_result(image_path, result)
+
+    all_succeeded = True
+    pool = multiprocessing.Pool(jobs, initializer=init_worker)
+    decoders = concurrent.futures.ThreadPoolExecutor(jobs)
+    try:
+        # The results are printed in the order of the images as soon as they are in.
+        in_flight = collections.deque()
+        image_count = 0
+        for image_path in collect_image_paths(arguments):
+            image_count += 1
+            if len(in_flight) == len(slots):
+                all_succeeded &= finish(*in_flight.popleft())
+            slot = free_slots.get()
+            in_flight.append(
+                (image_path, decoders.submit(submit, image_path, slot, pool))
+            )
+        while in_flight:
+            all_succeeded &= finish(*in_flight.popleft())
+        if image_count == 0:
+            print("No images found.")
+            all_succeeded = False
+    finally:
+        decoders.shutdown()
+        pool.close()
+        pool.join()
+        for slot in slots:
+            slot.release()
+    return all_succeeded
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Scan barcodes in image files.")
+    parser.add_argument(
+        "-j",
+        "--jobs",
+        type=int,
+        default=0,
+        help="number of worker processes, scans images in batch mode (default: cores)",
+    )
+    parser.add_argument("images", nargs="*", help="images, directories or globs")
+    args = parser.parse_args()
+
+    if not args.images:
+        print("Please provide a path to an image file as argument.")
+        exit(1)
+
+    if args.jobs == 0 and len(args.images) == 1 and os.path.isfile(args.images[0]):
+        scan_single_image(args.images[0])
+    elif not scan_batch(args.images, args.jobs or multiprocessing.cpu_count()):
+        exit(2)
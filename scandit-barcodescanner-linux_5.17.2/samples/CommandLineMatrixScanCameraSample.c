@@ -16,12 +16,37 @@
  * Example:
  * ./CommandLineMatrixScanCameraSample /dev/video1 1920 1080
  *
+ * The tracker callbacks do not print anything themselves. They update a table of
+ * tracked objects that is indexed by the tracking id, and the events of a frame are
+ * merged into one delta per object (appeared, updated, predicted or lost). A reporter
+ * thread prints the deltas. If it falls behind, the deltas of the following frames
+ * are merged until it is ready again, so the frame loop is never slowed down by
+ * the output.
+ *
+ * With --replay a recording made by the camera sample with --record is played back
+ * in place of the camera, at the recorded pace or with --replay-pace max as fast as
+ * possible. The frames are tracked straight from the mapped recording.
+ *
+ * Example:
+ * ./CommandLineMatrixScanCameraSample --replay shelf.rec
+ *
  * \copyright Copyright (c) 2018 Scandit AG. All rights reserved.
  */
 
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <pthread.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
 
 #include <Scandit/ScRecognitionContext.h>
 #include <Scandit/ScBarcodeScanner.h>
@@ -29,6 +54,8 @@
 #include <Scandit/ScObjectTracker.h>
 #include <Scandit/ScTrackedObject.h>
 
+#include "FrameRecording.h"
+
 // Please insert your app key here:
 #define SCANDIT_SDK_LICENSE_KEY "-- INSERT YOUR LICENSE KEY HERE --"
 
@@ -36,6 +63,92 @@
 #define DEFAULT_RESOLUTION_WIDTH 1280
 #define DEFAULT_RESOLUTION_HEIGHT 720
 
+// Maximum number of objects in the tracked object table. Objects that appear while
+// the table is full are counted and ignored.
+#define TRACKED_OBJECT_CAPACITY 256
+// Size of the id index, a power of two and at least twice the capacity.
+#define TRACKED_OBJECT_INDEX_SIZE 512
+// The barcode data is stored in the table, longer data is truncated.
+#define TRACKED_OBJECT_DATA_SIZE 128
+
+// Events merged into the delta of an object.
+#define TRACKED_OBJECT_APPEARED 0x01
+#define TRACKED_OBJECT_UPDATED 0x02
+#define TRACKED_OBJECT_PREDICTED 0x04
+#define TRACKED_OBJECT_LOST 0x08
+
+typedef struct {
+    uint32_t id;
+    // Incremented whenever the slot is reused for another object, so a (slot, generation)
+    // pair kept by a consumer can be checked for staleness.
+    uint32_t generation;
+    // Events since the last published delta.
+    uint32_t events;
+    ScBool live;
+    ScBool dirty;
+    ScBool recognized;
+    ScSymbology symbology;
+    ScQuadrilateral location;
+    ScQuadrilateral predicted_location;
+    float predicted_dt;
+    unsigned long long appeared_frame;
+    unsigned long long updated_frame;
+    char data[TRACKED_OBJECT_DATA_SIZE];
+} TrackedObject;
+
+typedef struct {
+    // The frames merged into this delta.
+    unsigned long long first_frame;
+    unsigned long long last_frame;
+    // Number of objects tracked after the last frame.
+    uint32_t live_count;
+    uint32_t change_count;
+    TrackedObject changes[TRACKED_OBJECT_CAPACITY];
+    uint32_t slots[TRACKED_OBJECT_CAPACITY];
+} TrackedObjectDelta;
+
+typedef struct {
+    // Owned by the frame loop thread.
+    TrackedObject objects[TRACKED_OBJECT_CAPACITY];
+    // Maps the hashed tracking id to a slot, -1 marks an empty entry.
+    int32_t index[TRACKED_OBJECT_INDEX_SIZE];
+    uint32_t free_slots[TRACKED_OBJECT_CAPACITY];
+    uint32_t free_count;
+    uint32_t live_count;
+    uint32_t dirty_slots[TRACKED_OBJECT_CAPACITY];
+    uint32_t dirty_count;
+    unsigned long long frame;
+    unsigned long long delta_first_frame;
+    unsigned long long dropped_objects;
+
+    // Shared with the reporter thread.
+    pthread_mutex_t lock;
+    pthread_cond_t delta_ready;
+    // Signalled by the reporter when it is done with a delta.
+    pthread_cond_t delta_done;
+    ScBool delta_pending;
+    ScBool stopping;
+    unsigned long long published_deltas;
+    unsigned long long merged_frames;
+    TrackedObjectDelta delta;
+} TrackedObjectStore;
+
+/**
+ * Plays back a recording in place of the camera. The recording is mapped into
+ * memory and the frames are handed out without copying.
+ */
+typedef struct FrameReplay {
+    const uint8_t *data;
+    size_t size;
+    // Offsets of the frame records.
+    uint64_t *offsets;
+    uint64_t frame_count;
+    uint64_t next_frame;
+    // Frames are handed out at the recorded pace, otherwise as fast as they are taken.
+    ScBool realtime;
+    double start_time;
+} FrameReplay;
+
 static volatile ScBool process_frames;
 
 static void catch_exit(int signo) {
@@ -57,58 +170,465 @@ static void print_all_discrete_resolutions(const ScCamera *cam) {
     }
 }
 
+// Initializes the store. The id index starts out empty and all slots are free.
+static ScBool tracked_object_store_init(TrackedObjectStore *store) {
+    memset(store, 0, sizeof(*store));
+    for (uint32_t i = 0; i < TRACKED_OBJECT_INDEX_SIZE; i++) {
+        store->index[i] = -1;
+    }
+    // Hand out the low slots first.
+    for (uint32_t i = 0; i < TRACKED_OBJECT_CAPACITY; i++) {
+        store->free_slots[i] = TRACKED_OBJECT_CAPACITY - 1 - i;
+    }
+    store->free_count = TRACKED_OBJECT_CAPACITY;
+    if (pthread_mutex_init(&store->lock, NULL) != 0) {
+        return SC_FALSE;
+    }
+    if (pthread_cond_init(&store->delta_ready, NULL) != 0) {
+        pthread_mutex_destroy(&store->lock);
+        return SC_FALSE;
+    }
+    if (pthread_cond_init(&store->delta_done, NULL) != 0) {
+        pthread_cond_destroy(&store->delta_ready);
+        pthread_mutex_destroy(&store->lock);
+        return SC_FALSE;
+    }
+    return SC_TRUE;
+}
+
+static void tracked_object_store_destroy(TrackedObjectStore *store) {
+    pthread_cond_destroy(&store->delta_done);
+    pthread_cond_destroy(&store->delta_ready);
+    pthread_mutex_destroy(&store->lock);
+}
+
+static uint32_t tracked_object_hash(uint32_t id) {
+    return (id * 2654435761u) & (TRACKED_OBJECT_INDEX_SIZE - 1);
+}
+
+// Returns the index position of the object with the given id or -1.
+static int32_t tracked_object_index_find(const TrackedObjectStore *store, uint32_t id) {
+    for (uint32_t i = tracked_object_hash(id);; i = (i + 1) & (TRACKED_OBJECT_INDEX_SIZE - 1)) {
+        const int32_t slot = store->index[i];
+        if (slot < 0) {
+            return -1;
+        }
+        if (store->objects[slot].id == id) {
+            return (int32_t)i;
+        }
+    }
+}
+
+static TrackedObject *tracked_object_store_find(TrackedObjectStore *store, uint32_t id) {
+    const int32_t position = tracked_object_index_find(store, id);
+    return position < 0 ? NULL : &store->objects[store->index[position]];
+}
+
+// Removes an id from the index. The following entries of the probe sequence are moved
+// back into the hole, so lookups never need tombstones.
+static void tracked_object_index_remove(TrackedObjectStore *store, uint32_t id) {
+    const int32_t position = tracked_object_index_find(store, id);
+    if (position < 0) {
+        return;
+    }
+    const uint32_t mask = TRACKED_OBJECT_INDEX_SIZE - 1;
+    uint32_t hole = (uint32_t)position;
+    for (uint32_t i = (hole + 1) & mask; store->index[i] >= 0; i = (i + 1) & mask) {
+        const uint32_t home = tracked_object_hash(store->objects[store->index[i]].id);
+        // The entry may fill the hole if the hole lies on its probe sequence.
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            store->index[hole] = store->index[i];
+            hole = i;
+        }
+    }
+    store->index[hole] = -1;
+}
+
+// Records events for an object. Each slot is listed at most once per delta.
+static void tracked_object_mark(TrackedObjectStore *store, TrackedObject *object, uint32_t events) {
+    object->events |= events;
+    if (!object->dirty) {
+        object->dirty = SC_TRUE;
+        store->dirty_slots[store->dirty_count++] = (uint32_t)(object - store->objects);
+    }
+}
+
+static void tracked_object_free(TrackedObjectStore *store, TrackedObject *object) {
+    object->events = 0;
+    object->live = SC_FALSE;
+    store->free_slots[store->free_count++] = (uint32_t)(object - store->objects);
+    store->live_count--;
+}
+
+// Copies the barcode data once, when the object is recognized for the first time.
+static void tracked_object_copy_barcode(TrackedObject *object, const ScTrackedObject *obj) {
+    const ScBarcode *barcode = sc_tracked_object_get_barcode(obj);
+    if (object->recognized || barcode == NULL || !sc_barcode_is_recognized(barcode)) {
+        return;
+    }
+    ScByteArray data = sc_barcode_get_data(barcode);
+    uint32_t length = data.length;
+    if (length > TRACKED_OBJECT_DATA_SIZE - 1) {
+        length = TRACKED_OBJECT_DATA_SIZE - 1;
+    }
+    memcpy(object->data, data.str, length);
+    object->data[length] = '\0';
+    object->symbology = sc_barcode_get_symbology(barcode);
+    object->recognized = SC_TRUE;
+}
+
+// The tracker callbacks are invoked from sc_recognition_context_process_frame on the
+// frame loop thread. They only update the store, the output is done by the reporter thread.
+
 void on_appeared(const ScTrackedObject* obj, void *user_data) {
     // This callback gets emitted when a new object appears in the camera feed.
     // Use this callback to start to draw a location.
+    TrackedObjectStore *store = (TrackedObjectStore *)user_data;
     const uint32_t id = sc_tracked_object_get_id(obj);
-    const ScBarcode *barcode = sc_tracked_object_get_barcode(obj);
-    if (sc_barcode_is_recognized(barcode)) {
-        ScByteArray data = sc_barcode_get_data(barcode);
-        printf("Barcode #%u: %s '%s' appeared.\n", id, sc_symbology_to_string(sc_barcode_get_symbology(barcode)), data.str);
-    } else {
-        printf("Object #%u appeared.\n", id);
+    TrackedObject *object = tracked_object_store_find(store, id);
+    if (object == NULL) {
+        if (store->free_count == 0) {
+            store->dropped_objects++;
+            return;
+        }
+        const uint32_t slot = store->free_slots[--store->free_count];
+        object = &store->objects[slot];
+        const uint32_t generation = object->generation + 1;
+        const ScBool dirty = object->dirty;
+        memset(object, 0, sizeof(*object));
+        object->id = id;
+        object->generation = generation;
+        object->dirty = dirty;
+        object->live = SC_TRUE;
+        object->appeared_frame = store->frame;
+        store->live_count++;
+
+        uint32_t i = tracked_object_hash(id);
+        while (store->index[i] >= 0) {
+            i = (i + 1) & (TRACKED_OBJECT_INDEX_SIZE - 1);
+        }
+        store->index[i] = (int32_t)slot;
     }
+    object->location = sc_tracked_object_get_location(obj);
+    object->updated_frame = store->frame;
+    tracked_object_copy_barcode(object, obj);
+    tracked_object_mark(store, object, TRACKED_OBJECT_APPEARED);
 }
 
 void on_updated(const ScTrackedObject* obj, void *user_data) {
     // This callback gets emitted when an existing object has been found
     // in a new location.
-    const uint32_t id = sc_tracked_object_get_id(obj);
-    const ScBarcode *barcode = sc_tracked_object_get_barcode(obj);
-    if (sc_barcode_is_recognized(barcode)) {
-        ScByteArray data = sc_barcode_get_data(barcode);
-        printf("Barcode #%u: %s '%s' was updated.\n", id, sc_symbology_to_string(sc_barcode_get_symbology(barcode)), data.str);
-    } else {
-        printf("Object #%u was updated.\n", id);
+    TrackedObjectStore *store = (TrackedObjectStore *)user_data;
+    TrackedObject *object = tracked_object_store_find(store, sc_tracked_object_get_id(obj));
+    if (object == NULL) {
+        // The object did not fit into the table when it appeared.
+        return;
     }
+    object->location = sc_tracked_object_get_location(obj);
+    object->updated_frame = store->frame;
+    tracked_object_copy_barcode(object, obj);
+    tracked_object_mark(store, object, TRACKED_OBJECT_UPDATED);
 }
 
 void on_lost(ScTrackedObjectType type, uint32_t tracking_id, void *user_data) {
     // This callback gets emitted when an object was no longer found.
     // Use this callback to disable your drawing task.
     // Be aware that it also gets triggered on objects that have not been recognized.
-    printf("Object #%u was lost.\n", tracking_id);
+    TrackedObjectStore *store = (TrackedObjectStore *)user_data;
+    TrackedObject *object = tracked_object_store_find(store, tracking_id);
+    if (object == NULL) {
+        return;
+    }
+    tracked_object_index_remove(store, tracking_id);
+    if (object->events & TRACKED_OBJECT_APPEARED) {
+        // The consumers never saw this object, drop it without a trace.
+        tracked_object_free(store, object);
+    } else {
+        // Keep the slot until the loss has been published.
+        object->events = 0;
+        tracked_object_mark(store, object, TRACKED_OBJECT_LOST);
+    }
 }
 
 void on_predicted(uint32_t tracking_id, ScQuadrilateral quadrilateral,
                   float dt, void *user_data) {
     // Use this callback to update the drawing location of an object. Predictions
     // are made even if the object was not found for a certain time.
+    TrackedObjectStore *store = (TrackedObjectStore *)user_data;
+    TrackedObject *object = tracked_object_store_find(store, tracking_id);
+    if (object == NULL) {
+        return;
+    }
+    object->predicted_location = quadrilateral;
+    object->predicted_dt = dt;
+    tracked_object_mark(store, object, TRACKED_OBJECT_PREDICTED);
 }
 
-int main(int argc, const char *argv[]) {
-    // Handle ctrl+c events.
-    if (signal(SIGINT, catch_exit) == SIG_ERR) {
-        printf("Could not set up signal handler.\n");
-        return -1;
+// Publishes the changes since the last delta. Called with the lock held while no
+// delta is pending.
+static void tracked_object_store_publish(TrackedObjectStore *store) {
+    TrackedObjectDelta *delta = &store->delta;
+    delta->first_frame = store->delta_first_frame;
+    delta->last_frame = store->frame - 1;
+    delta->change_count = 0;
+    for (uint32_t i = 0; i < store->dirty_count; i++) {
+        TrackedObject *object = &store->objects[store->dirty_slots[i]];
+        object->dirty = SC_FALSE;
+        if (object->events == 0) {
+            // Appeared and lost within this delta.
+            continue;
+        }
+        delta->changes[delta->change_count] = *object;
+        delta->slots[delta->change_count] = store->dirty_slots[i];
+        delta->change_count++;
+        if (object->events & TRACKED_OBJECT_LOST) {
+            tracked_object_free(store, object);
+        }
+        object->events = 0;
+    }
+    delta->live_count = store->live_count;
+    store->dirty_count = 0;
+    store->delta_first_frame = store->frame;
+    if (delta->change_count > 0) {
+        store->delta_pending = SC_TRUE;
+        store->published_deltas++;
+        pthread_cond_signal(&store->delta_ready);
     }
+}
 
+// Called after every processed frame. Publishes the changes since the last delta if
+// the reporter is done with the previous one. Otherwise the events stay in the store
+// and are merged with the ones of the next frame, the frame loop never waits.
+static void tracked_object_store_end_frame(TrackedObjectStore *store) {
+    store->frame++;
+    if (store->dirty_count == 0) {
+        return;
+    }
+    pthread_mutex_lock(&store->lock);
+    if (store->delta_pending) {
+        store->merged_frames++;
+    } else {
+        tracked_object_store_publish(store);
+    }
+    pthread_mutex_unlock(&store->lock);
+}
+
+// Called once after the last frame. Waits for the reporter to finish the pending
+// delta and publishes the changes that were merged while it was busy.
+static void tracked_object_store_flush(TrackedObjectStore *store) {
+    pthread_mutex_lock(&store->lock);
+    if (store->dirty_count > 0) {
+        while (store->delta_pending) {
+            pthread_cond_wait(&store->delta_done, &store->lock);
+        }
+        tracked_object_store_publish(store);
+    }
+    pthread_mutex_unlock(&store->lock);
+}
+
+static void print_tracked_object_change(const TrackedObject *object) {
+    const char *event = NULL;
+    if (object->events & TRACKED_OBJECT_LOST) {
+        printf("Object #%u was lost.\n", object->id);
+        return;
+    } else if (object->events & TRACKED_OBJECT_APPEARED) {
+        event = "appeared";
+    } else if (object->events & TRACKED_OBJECT_UPDATED) {
+        event = "was updated";
+    } else {
+        // Only a new prediction. A drawing consumer would move the location to
+        // object->predicted_location here.
+        return;
+    }
+    if (object->recognized) {
+        printf("Barcode #%u: %s '%s' %s.\n", object->id, sc_symbology_to_string(object->symbology),
+               object->data, event);
+    } else {
+        printf("Object #%u %s.\n", object->id, event);
+    }
+}
+
+// The reporter thread consumes the published deltas. The delta is not touched by the
+// frame loop while it is pending, so it can be read without holding the lock.
+static void *reporter_thread_run(void *arg) {
+    TrackedObjectStore *store = (TrackedObjectStore *)arg;
+    for (;;) {
+        pthread_mutex_lock(&store->lock);
+        while (!store->delta_pending && !store->stopping) {
+            pthread_cond_wait(&store->delta_ready, &store->lock);
+        }
+        if (!store->delta_pending) {
+            pthread_mutex_unlock(&store->lock);
+            break;
+        }
+        pthread_mutex_unlock(&store->lock);
+
+        const TrackedObjectDelta *delta = &store->delta;
+        for (uint32_t i = 0; i < delta->change_count; i++) {
+            print_tracked_object_change(&delta->changes[i]);
+        }
+        fflush(stdout);
+
+        pthread_mutex_lock(&store->lock);
+        store->delta_pending = SC_FALSE;
+        pthread_cond_signal(&store->delta_done);
+        pthread_mutex_unlock(&store->lock);
+    }
+    return NULL;
+}
+
+static double now_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+static void frame_replay_close(FrameReplay *replay) {
+    if (replay == NULL) {
+        return;
+    }
+    munmap((void *)replay->data, replay->size);
+    free(replay->offsets);
+    free(replay);
+}
+
+/**
+ * Maps a recording and reads its index. The records of a recording that was not closed
+ * properly are found by walking the file.
+ */
+static FrameReplay *frame_replay_open(const char *path, ScBool realtime) {
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        printf("Could not open the recording '%s': %s\n", path, strerror(errno));
+        return NULL;
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || (size_t)file_stat.st_size < sizeof(RecordingHeader)) {
+        printf("'%s' is not a frame recording.\n", path);
+        close(fd);
+        return NULL;
+    }
+    void *data = mmap(NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        printf("Could not map the recording '%s': %s\n", path, strerror(errno));
+        return NULL;
+    }
+    // The frames are read once from start to end.
+    madvise(data, file_stat.st_size, MADV_SEQUENTIAL);
+
+    FrameReplay *replay = calloc(1, sizeof(FrameReplay));
+    if (replay == NULL) {
+        munmap(data, file_stat.st_size);
+        return NULL;
+    }
+    replay->data = data;
+    replay->size = file_stat.st_size;
+    replay->realtime = realtime;
+
+    const RecordingHeader *header = data;
+    if (memcmp(header->magic, RECORDING_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != RECORDING_VERSION || header->alignment != RECORDING_ALIGNMENT) {
+        printf("'%s' is not a frame recording of version %d.\n", path, RECORDING_VERSION);
+        frame_replay_close(replay);
+        return NULL;
+    }
+
+    if (header->index_offset != 0) {
+        if (header->index_offset > replay->size ||
+            (replay->size - header->index_offset) / sizeof(uint64_t) < header->frame_count) {
+            printf("The index of the recording '%s' is damaged.\n", path);
+            frame_replay_close(replay);
+            return NULL;
+        }
+        replay->frame_count = header->frame_count;
+        replay->offsets = malloc((header->frame_count + 1) * sizeof(uint64_t));
+        if (replay->offsets != NULL) {
+            memcpy(replay->offsets, replay->data + header->index_offset,
+                   header->frame_count * sizeof(uint64_t));
+        }
+    } else {
+        uint64_t capacity = 1024;
+        replay->offsets = malloc(capacity * sizeof(uint64_t));
+        uint64_t offset = recording_align(sizeof(RecordingHeader));
+        uint64_t end;
+        while (replay->offsets != NULL &&
+               (end = frame_record_end(replay->data, replay->size, offset)) != 0) {
+            if (replay->frame_count == capacity) {
+                capacity *= 2;
+                uint64_t *offsets = realloc(replay->offsets, capacity * sizeof(uint64_t));
+                if (offsets == NULL) {
+                    break;
+                }
+                replay->offsets = offsets;
+            }
+            replay->offsets[replay->frame_count++] = offset;
+            offset = recording_align(end);
+        }
+        printf("The recording '%s' was not closed properly, %llu complete frames found.\n",
+               path, (unsigned long long)replay->frame_count);
+    }
+    if (replay->offsets == NULL) {
+        frame_replay_close(replay);
+        return NULL;
+    }
+    for (uint64_t i = 0; i < replay->frame_count; ++i) {
+        if (frame_record_end(replay->data, replay->size, replay->offsets[i]) == 0) {
+            printf("Frame %llu of the recording '%s' is damaged.\n", (unsigned long long)i, path);
+            frame_replay_close(replay);
+            return NULL;
+        }
+    }
+    return replay;
+}
+
+/**
+ * Returns the next frame of the recording and fills the image description. In real
+ * time mode this waits until the frame is due.
+ *
+ * \returns the frame data or NULL at the end of the recording.
+ */
+static const uint8_t *frame_replay_next(FrameReplay *replay, ScImageDescription *image_descr) {
+    if (replay->next_frame == replay->frame_count) {
+        return NULL;
+    }
+    const uint64_t offset = replay->offsets[replay->next_frame++];
+    const FrameRecord *record = (const FrameRecord *)(replay->data + offset);
+
+    if (replay->realtime) {
+        if (replay->next_frame == 1) {
+            replay->start_time = now_seconds();
+        }
+        const double due = replay->start_time + record->capture_time_ns * 1e-9;
+        const double wait = due - now_seconds();
+        if (wait > 0.0) {
+            struct timespec delay = { (time_t)wait, (long)((wait - (time_t)wait) * 1e9) };
+            nanosleep(&delay, NULL);
+        }
+    }
+
+    sc_image_description_set_layout(image_descr, (ScImageLayout)record->layout);
+    sc_image_description_set_width(image_descr, record->width);
+    sc_image_description_set_height(image_descr, record->height);
+    sc_image_description_set_first_plane_offset(image_descr, record->first_plane_offset);
+    sc_image_description_set_first_plane_row_bytes(image_descr, record->first_plane_row_bytes);
+    sc_image_description_set_second_plane_offset(image_descr, record->second_plane_offset);
+    sc_image_description_set_second_plane_row_bytes(image_descr, record->second_plane_row_bytes);
+    sc_image_description_set_memory_size(image_descr, record->memory_size);
+    return replay->data + recording_align(offset + sizeof(FrameRecord));
+}
+
+/**
+ * Creates the camera, sets the desired resolution if the camera supports it and starts
+ * streaming.
+ */
+static ScCamera *create_camera(const char *device_path, ScSize desired_resolution) {
     // Create the camera object.
     ScCamera *camera = NULL;
-    if (argc > 1) {
+    if (device_path != NULL) {
         // Setup the camera from a device path. E.g. /dev/video1
         // We use 4 image buffers.
-        camera = sc_camera_new_from_path(argv[1], 4);
+        camera = sc_camera_new_from_path(device_path, 4);
     } else {
         // When no parameters are given, the camera is automatically detected.
         camera = sc_camera_new();
@@ -116,15 +636,7 @@ int main(int argc, const char *argv[]) {
 
     if (camera == NULL) {
         printf("No camera available.\n");
-        return -1;
-    }
-
-    uint32_t resolution_width = DEFAULT_RESOLUTION_WIDTH;
-    uint32_t resolution_height = DEFAULT_RESOLUTION_HEIGHT;
-    // Read the desired resolution form the command line.
-    if (argc == 4) {
-        resolution_width = atoi(argv[2]);
-        resolution_height = atoi(argv[3]);
+        return NULL;
     }
 
     // Get the supported resolutions and check
@@ -144,12 +656,12 @@ int main(int argc, const char *argv[]) {
              resolutions_found = sc_camera_query_supported_resolutions(camera, &resolutions[0], resolutions_size);
             if (!resolutions_found) {
                 printf("There was an error getting the discrete resolution capabilities of the camera.\n");
-                return -1;
+                return NULL;
             }
 
             for (int i = 0; i < resolutions_found; i++) {
-                if (resolutions[i].width == resolution_width &&
-                    resolutions[i].height == resolution_height) {
+                if (resolutions[i].width == desired_resolution.width &&
+                    resolutions[i].height == desired_resolution.height) {
                     supported = SC_TRUE;
                     break;
                 }
@@ -162,51 +674,105 @@ int main(int argc, const char *argv[]) {
             // explanation.
             if (!sc_camera_query_supported_resolutions_stepwise(camera, &swres)) {
                 printf("There was an error getting the stepwise resolution capabilities of the camera.\n");
-                return -1;
+                return NULL;
             }
 
             printf("This camera uses step-wise resolutions:\n");
             printf("\tx: %u:%u:%u\n", swres.min_width, swres.step_width, swres.max_width);
             printf("\ty: %u:%u:%u\n", swres.min_height, swres.step_height, swres.max_height);
 
-            if (swres.min_width <= resolution_width &&
-                resolution_width <= swres.max_width &&
-                swres.min_height <= resolution_height &&
-                resolution_height <= swres.max_height &&
-                resolution_width % swres.step_width == 0 &&
-                resolution_height % swres.step_height == 0) {
+            if (swres.min_width <= desired_resolution.width &&
+                desired_resolution.width <= swres.max_width &&
+                swres.min_height <= desired_resolution.height &&
+                desired_resolution.height <= swres.max_height &&
+                desired_resolution.width % swres.step_width == 0 &&
+                desired_resolution.height % swres.step_height == 0) {
                 supported = SC_TRUE;
             }
             break;
 
         default:
             printf("Could not get camera resolution mode.\n");
-            return -1;
+            return NULL;
     }
 
     // Set the resolution
     if (!supported) {
-        printf("%dx%d is not supported by this camera.\nPlease specify a supported resolution on the command line or in the source code.\n", resolution_width, resolution_height);
+        printf("%dx%d is not supported by this camera.\nPlease specify a supported resolution on the command line or in the source code.\n", desired_resolution.width, desired_resolution.height);
         sc_camera_release(camera);
-        return -1;
+        return NULL;
     }
 
-    ScSize desired_resolution;
-    desired_resolution.width = resolution_width;
-    desired_resolution.height =  resolution_height;
     if (!sc_camera_request_resolution(camera, desired_resolution)) {
         printf("Setting resolution failed.\n");
         sc_camera_release(camera);
-        return -1;
+        return NULL;
     }
 
     // Start streaming.
     if (!sc_camera_start_stream(camera)) {
         printf("Start the camera failed.\n");
         sc_camera_release(camera);
+        return NULL;
+    }
+    return camera;
+}
+
+int main(int argc, const char *argv[]) {
+    // Handle ctrl+c events.
+    if (signal(SIGINT, catch_exit) == SIG_ERR) {
+        printf("Could not set up signal handler.\n");
         return -1;
     }
 
+    const char *replay_path = NULL;
+    ScBool replay_realtime = SC_TRUE;
+    static const struct option long_options[] = {
+        { "replay", required_argument, NULL, 'p' },
+        { "replay-pace", required_argument, NULL, 'P' },
+        { NULL, 0, NULL, 0 }
+    };
+    int option;
+    while ((option = getopt_long(argc, (char * const *)argv, "p:P:", long_options, NULL)) != -1) {
+        if (option == 'p') {
+            replay_path = optarg;
+        } else if (option == 'P' && strcmp(optarg, "realtime") == 0) {
+            replay_realtime = SC_TRUE;
+        } else if (option == 'P' && strcmp(optarg, "max") == 0) {
+            replay_realtime = SC_FALSE;
+        } else {
+            printf("Usage: %s [--replay file [--replay-pace realtime|max]] "
+                   "[device-path [width height]]\n", argv[0]);
+            return -1;
+        }
+    }
+    const int argument_count = argc - optind;
+    const char * const *arguments = argv + optind;
+
+    ScSize desired_resolution;
+    desired_resolution.width = DEFAULT_RESOLUTION_WIDTH;
+    desired_resolution.height = DEFAULT_RESOLUTION_HEIGHT;
+    // Read the desired resolution form the command line.
+    if (argument_count == 3) {
+        desired_resolution.width = atoi(arguments[1]);
+        desired_resolution.height = atoi(arguments[2]);
+    }
+
+    // The frames come either from the camera or from a recording of the camera sample.
+    ScCamera *camera = NULL;
+    FrameReplay *replay = NULL;
+    if (replay_path != NULL) {
+        replay = frame_replay_open(replay_path, replay_realtime);
+        if (replay == NULL) {
+            return -1;
+        }
+    } else {
+        camera = create_camera(argument_count > 0 ? arguments[0] : NULL, desired_resolution);
+        if (camera == NULL) {
+            return -1;
+        }
+    }
+
     // Create a recognition context. Files created by the recognition context and the
     // attached scanners will be written to this directory.  In production environment,
     // it should be replaced with writable path which does not get removed between reboots
@@ -215,6 +781,7 @@ int main(int argc, const char *argv[]) {
     if (context == NULL) {
         printf("Could not initialize context.\n");
         sc_camera_release(camera);
+        frame_replay_close(replay);
         return -1;
     }
 
@@ -226,6 +793,7 @@ int main(int argc, const char *argv[]) {
     if (settings == NULL) {
         sc_recognition_context_release(context);
         sc_camera_release(camera);
+        frame_replay_close(replay);
         return -1;
     }
     sc_barcode_scanner_settings_set_symbology_enabled(settings, SC_SYMBOLOGY_EAN13, SC_TRUE);
@@ -257,12 +825,36 @@ int main(int argc, const char *argv[]) {
     if (scanner == NULL) {
         sc_recognition_context_release(context);
         sc_camera_release(camera);
+        frame_replay_close(replay);
         return -1;
     }
 
     // The scanner is setup asynchronous.
     // We could wait here using sc_barcode_scanner_wait_for_setup_completed if needed.
 
+    // The tracked object table is filled by the tracker callbacks and read by the reporter thread.
+    TrackedObjectStore *store = (TrackedObjectStore *)malloc(sizeof(TrackedObjectStore));
+    if (store == NULL || !tracked_object_store_init(store)) {
+        printf("Could not initialize the tracked object table.\n");
+        free(store);
+        sc_barcode_scanner_release(scanner);
+        sc_recognition_context_release(context);
+        sc_camera_release(camera);
+        frame_replay_close(replay);
+        return -1;
+    }
+    pthread_t reporter_thread;
+    if (pthread_create(&reporter_thread, NULL, reporter_thread_run, store) != 0) {
+        printf("Could not start the reporter thread.\n");
+        tracked_object_store_destroy(store);
+        free(store);
+        sc_barcode_scanner_release(scanner);
+        sc_recognition_context_release(context);
+        sc_camera_release(camera);
+        frame_replay_close(replay);
+        return -1;
+    }
+
     // Setup the object tracker and it's callbacks used for MatrixScan.
     ScObjectTrackerCallbacks callbacks = {
             on_appeared,
@@ -270,9 +862,9 @@ int main(int argc, const char *argv[]) {
             on_lost,
             on_predicted
     };
-    // We don't pass custom data to the callbacks in this simple example.
+    // The callbacks get the tracked object table as custom data.
     // The tracker is enabled by default.
-    ScObjectTracker *tracker = sc_object_tracker_new(context, &callbacks, NULL);
+    ScObjectTracker *tracker = sc_object_tracker_new(context, &callbacks, store);
 
     // ... but it can be disabled on demand.
     //sc_object_tracker_set_enabled(tracker, SC_FALSE);
@@ -285,9 +877,10 @@ int main(int argc, const char *argv[]) {
     process_frames = SC_TRUE;
     while (process_frames) {
         // Get the latest camera frame data and description
-        const uint8_t *image_data = sc_camera_get_frame(camera, image_descr);
+        const uint8_t *image_data = replay != NULL ? frame_replay_next(replay, image_descr) :
+                                                     sc_camera_get_frame(camera, image_descr);
         if (image_data == NULL) {
-            printf("Frame access failed. Exiting.\n");
+            printf(replay != NULL ? "End of the recording.\n" : "Frame access failed. Exiting.\n");
             break;
         }
 
@@ -297,18 +890,36 @@ int main(int argc, const char *argv[]) {
             printf("Processing frame failed with error %d: '%s'\n", result.status,
                    sc_context_status_flag_get_message(result.status));
         }
+        tracked_object_store_end_frame(store);
 
         // Signal the camera that we are done reading the image buffer.
-        sc_camera_enqueue_frame_data(camera, image_data);
+        if (camera != NULL) {
+            sc_camera_enqueue_frame_data(camera, image_data);
+        }
     }
 
     // Signal to the context that the frame sequence is finished.
     sc_recognition_context_end_frame_sequence(context);
 
+    // Let the reporter print the last delta and stop it.
+    tracked_object_store_flush(store);
+    pthread_mutex_lock(&store->lock);
+    store->stopping = SC_TRUE;
+    pthread_cond_signal(&store->delta_ready);
+    pthread_mutex_unlock(&store->lock);
+    pthread_join(reporter_thread, NULL);
+
+    printf("Frames: %llu, published deltas: %llu, frames merged into later deltas: %llu, "
+           "objects dropped because the table was full: %llu\n",
+           store->frame, store->published_deltas, store->merged_frames, store->dropped_objects);
+
     // Cleanup all objects.
     sc_image_description_release(image_descr);
     sc_object_tracker_release(tracker);
+    tracked_object_store_destroy(store);
+    free(store);
     sc_barcode_scanner_release(scanner);
     sc_recognition_context_release(context);
     sc_camera_release(camera);
+    frame_replay_close(replay);
 }
@@ -0,0 +1,589 @@
+/**
+ * \file CommandLineMultiCameraSample.c
+ *
+ * This Scandit SDK sample application demonstrates how to scan barcodes from many
+ * V4L2 cameras in one process. This sample does not include a user interface.
+ * Scanned codes will be shown on the command line together with the camera they
+ * were seen by.
+ *
+ * The cameras share a small pool of scanner workers. Only the workers own a
+ * recognition context and a barcode scanner, so adding a camera adds a capture
+ * thread with a small stack and the camera buffers, but no scanner.
+ *
+ * Every camera has a capture thread that keeps the newest frame (older frames that
+ * were not scanned in time go back to the camera) and signals it through an eventfd.
+ * The main thread waits on the eventfds of all cameras with epoll and queues the
+ * cameras that have a new frame. An idle worker takes the next camera from the queue
+ * and scans its newest frame. A camera is never queued twice, so a busy camera can not
+ * starve the others, and at most one frame per camera is scanned at a time.
+ *
+ * The cameras are not synchronized, every frame is scanned as its own frame sequence.
+ *
+ * Example:
+ * ./CommandLineMultiCameraSample -j 2 --resolution 1280x720 /dev/video0 /dev/video2 /dev/video4
+ *
+ * \copyright Copyright (c) 2018 Scandit AG. All rights reserved.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <Scandit/ScRecognitionContext.h>
+#include <Scandit/ScBarcodeScanner.h>
+#include <Scandit/ScCamera.h>
+
+// Please insert your app key here:
+#define SCANDIT_SDK_LICENSE_KEY "-- INSERT YOUR LICENSE KEY HERE --"
+
+// Please insert the desired default camera resolution here:
+#define DEFAULT_RESOLUTION_WIDTH 1280
+#define DEFAULT_RESOLUTION_HEIGHT 720
+
+#define MAX_CAMERA_COUNT 64
+#define MAX_WORKER_COUNT 64
+
+// One buffer waits, one is scanned, the others are filled by the camera.
+#define CAMERA_BUFFER_COUNT 4
+
+// The capture threads only wait for frames and hand them over.
+#define CAPTURE_THREAD_STACK_SIZE (128 * 1024)
+
+typedef struct CameraSource {
+    const char *path;
+    // The output lock of the station, the capture thread prints too.
+    pthread_mutex_t *output_lock;
+    ScCamera *camera;
+    // Signaled by the capture thread when a new frame is pending and by the workers
+    // when they are done with a frame.
+    int event_fd;
+    pthread_t capture_thread;
+    ScBool capture_thread_started;
+
+    pthread_mutex_t lock;
+    const uint8_t *pending_frame;
+    ScImageDescription *pending_descr;
+    // Buffers the workers are done with. They are re-queued by the capture thread.
+    const uint8_t *returned_frames[CAMERA_BUFFER_COUNT];
+    uint32_t returned_count;
+    ScBool capture_running;
+
+    // Owned by the dispatcher: the camera is in the queue or being scanned.
+    ScBool scheduled;
+    // Set by a worker when it is done with the camera.
+    ScBool scan_finished;
+
+    uint64_t captured_count;
+    uint64_t dropped_count;
+    uint64_t scanned_count;
+} CameraSource;
+
+typedef struct Station {
+    CameraSource cameras[MAX_CAMERA_COUNT];
+    size_t camera_count;
+
+    const ScBarcodeScannerSettings *settings;
+    pthread_t workers[MAX_WORKER_COUNT];
+    size_t worker_count;
+
+    // Cameras that have a frame waiting for a worker.
+    pthread_mutex_t lock;
+    pthread_cond_t camera_ready;
+    size_t ready_cameras[MAX_CAMERA_COUNT];
+    size_t ready_head;
+    size_t ready_count;
+    ScBool shutting_down;
+
+    // Printing is serialized, so that lines of different workers do not mix.
+    pthread_mutex_t output_lock;
+} Station;
+
+static volatile sig_atomic_t process_frames;
+static int stop_event_fd = -1;
+
+static void catch_exit(int signo) {
+    process_frames = 0;
+    const uint64_t one = 1;
+    // write() is async-signal-safe, it wakes up the dispatcher.
+    if (write(stop_event_fd, &one, sizeof(one)) < 0) {
+        // Nothing that could be done here.
+    }
+}
+
+static void signal_event(int fd)
+{
+    const uint64_t one = 1;
+    while (write(fd, &one, sizeof(one)) < 0 && errno == EINTR) {
+    }
+}
+
+/**
+ * Prints a line about the camera, prefixed with its path.
+ */
+static void camera_source_printf(const CameraSource *source, const char *format, ...)
+{
+    va_list arguments;
+    va_start(arguments, format);
+    pthread_mutex_lock(source->output_lock);
+    printf("[%s] ", source->path);
+    vprintf(format, arguments);
+    fflush(stdout);
+    pthread_mutex_unlock(source->output_lock);
+    va_end(arguments);
+}
+
+static void *capture_thread_run(void *argument)
+{
+    CameraSource *source = argument;
+    ScImageDescription *capture_descr = sc_image_description_new();
+
+    while (process_frames) {
+        // Blocks until the camera delivers the next frame.
+        const uint8_t *frame = sc_camera_get_frame(source->camera, capture_descr);
+        if (frame == NULL) {
+            camera_source_printf(source, "Frame access failed.\n");
+            break;
+        }
+
+        pthread_mutex_lock(&source->lock);
+        source->captured_count++;
+        if (source->pending_frame != NULL) {
+            // No worker picked up the previous frame in time.
+            sc_camera_enqueue_frame_data(source->camera, source->pending_frame);
+            source->dropped_count++;
+        }
+        for (uint32_t i = 0; i < source->returned_count; ++i) {
+            sc_camera_enqueue_frame_data(source->camera, source->returned_frames[i]);
+        }
+        source->returned_count = 0;
+
+        ScImageDescription *descr = source->pending_descr;
+        source->pending_descr = capture_descr;
+        capture_descr = descr;
+        source->pending_frame = frame;
+        pthread_mutex_unlock(&source->lock);
+
+        signal_event(source->event_fd);
+    }
+
+    pthread_mutex_lock(&source->lock);
+    source->capture_running = SC_FALSE;
+    pthread_mutex_unlock(&source->lock);
+    sc_image_description_release(capture_descr);
+    return NULL;
+}
+
+static ScBool camera_source_open(CameraSource *source, const char *path, ScSize resolution,
+                                 pthread_mutex_t *output_lock)
+{
+    source->path = path;
+    source->output_lock = output_lock;
+    source->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (source->event_fd < 0) {
+        camera_source_printf(source, "Could not create eventfd: %s\n", strerror(errno));
+        return SC_FALSE;
+    }
+    pthread_mutex_init(&source->lock, NULL);
+    source->pending_descr = sc_image_description_new();
+
+    source->camera = sc_camera_new_from_path(path, CAMERA_BUFFER_COUNT);
+    if (source->camera == NULL) {
+        camera_source_printf(source, "No camera available.\n");
+        return SC_FALSE;
+    }
+    if (!sc_camera_request_resolution(source->camera, resolution)) {
+        camera_source_printf(source, "%ux%u is not supported by this camera.\n",
+                             resolution.width, resolution.height);
+        return SC_FALSE;
+    }
+    if (!sc_camera_start_stream(source->camera)) {
+        camera_source_printf(source, "Start the camera failed.\n");
+        return SC_FALSE;
+    }
+
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    pthread_attr_setstacksize(&attributes, CAPTURE_THREAD_STACK_SIZE);
+    source->capture_running = SC_TRUE;
+    source->capture_thread_started =
+            pthread_create(&source->capture_thread, &attributes, capture_thread_run, source) == 0;
+    pthread_attr_destroy(&attributes);
+    if (!source->capture_thread_started) {
+        camera_source_printf(source, "Could not start capture thread.\n");
+        source->capture_running = SC_FALSE;
+        return SC_FALSE;
+    }
+    return SC_TRUE;
+}
+
+static void camera_source_close(CameraSource *source)
+{
+    if (source->capture_thread_started) {
+        // The capture thread stops after its next frame.
+        pthread_join(source->capture_thread, NULL);
+    }
+    if (source->camera != NULL) {
+        sc_camera_stop_stream(source->camera);
+        sc_camera_release(source->camera);
+    }
+    if (source->event_fd >= 0) {
+        close(source->event_fd);
+        pthread_mutex_destroy(&source->lock);
+    }
+    sc_image_description_release(source->pending_descr);
+}
+
+/**
+ * Takes the newest frame of the camera. The description of the frame is swapped
+ * into *image_descr.
+ */
+static const uint8_t *camera_source_take(CameraSource *source, ScImageDescription **image_descr)
+{
+    pthread_mutex_lock(&source->lock);
+    const uint8_t *frame = source->pending_frame;
+    if (frame != NULL) {
+        ScImageDescription *descr = source->pending_descr;
+        source->pending_descr = *image_descr;
+        *image_descr = descr;
+        source->pending_frame = NULL;
+    }
+    pthread_mutex_unlock(&source->lock);
+    return frame;
+}
+
+/**
+ * Gives the frame back after scanning. frame is NULL if the camera had no frame.
+ */
+static void camera_source_return(CameraSource *source, const uint8_t *frame)
+{
+    pthread_mutex_lock(&source->lock);
+    if (frame != NULL) {
+        if (source->capture_running) {
+            source->returned_frames[source->returned_count++] = frame;
+        }
+        source->scanned_count++;
+    }
+    source->scan_finished = SC_TRUE;
+    pthread_mutex_unlock(&source->lock);
+    // The dispatcher checks whether a newer frame arrived in the meantime.
+    signal_event(source->event_fd);
+}
+
+static ScBarcodeScannerSettings *create_scanner_settings(void)
+{
+    // The default preset is optimized for real-time frame processing using a camera.
+    ScBarcodeScannerSettings *settings = sc_barcode_scanner_settings_new_with_preset(SC_PRESET_NONE);
+    if (settings == NULL) {
+        return NULL;
+    }
+    sc_barcode_scanner_settings_set_symbology_enabled(settings, SC_SYMBOLOGY_EAN13, SC_TRUE);
+    sc_barcode_scanner_settings_set_symbology_enabled(settings, SC_SYMBOLOGY_UPCA, SC_TRUE);
+    sc_barcode_scanner_settings_set_symbology_enabled(settings, SC_SYMBOLOGY_QR, SC_TRUE);
+    sc_barcode_scanner_settings_set_symbology_enabled(settings, SC_SYMBOLOGY_CODE128, SC_TRUE);
+
+    // Conveyor cameras see many codes in a row, but each frame at most a few.
+    sc_barcode_scanner_settings_set_max_number_of_codes_per_frame(settings, 4);
+
+    // Only keep codes for one frame and do not accumulate anything. Frames of
+    // different cameras are scanned by the same scanner.
+    sc_barcode_scanner_settings_set_code_duplicate_filter(settings, 0);
+    sc_barcode_scanner_settings_set_code_caching_duration(settings, 0);
+    sc_barcode_scanner_settings_set_focus_mode(settings, SC_CAMERA_FOCUS_MODE_FIXED);
+    return settings;
+}
+
+static void *scan_worker_run(void *argument)
+{
+    Station *station = argument;
+
+    // Every worker has its own context and scanner, they are shared by all cameras.
+    ScRecognitionContext *context =
+            sc_recognition_context_new(SCANDIT_SDK_LICENSE_KEY, "/tmp", NULL);
+    ScBarcodeScanner *scanner = context != NULL ?
+            sc_barcode_scanner_new_with_settings(context, station->settings) : NULL;
+    ScImageDescription *image_descr = sc_image_description_new();
+    if (scanner == NULL) {
+        printf("Could not initialize scanner.\n");
+    } else {
+        sc_barcode_scanner_wait_for_setup_completed(scanner);
+    }
+    ScBarcodeScannerSession *session = scanner != NULL ? sc_barcode_scanner_get_session(scanner) : NULL;
+
+    for (;;) {
+        pthread_mutex_lock(&station->lock);
+        while (station->ready_count == 0 && !station->shutting_down) {
+            pthread_cond_wait(&station->camera_ready, &station->lock);
+        }
+        if (station->shutting_down) {
+            pthread_mutex_unlock(&station->lock);
+            break;
+        }
+        CameraSource *source = &station->cameras[station->ready_cameras[station->ready_head]];
+        station->ready_head = (station->ready_head + 1) % MAX_CAMERA_COUNT;
+        station->ready_count--;
+        pthread_mutex_unlock(&station->lock);
+
+        // The newest frame of the camera, it may be newer than the one that queued it.
+        const uint8_t *image_data = camera_source_take(source, &image_descr);
+        if (image_data == NULL) {
+            camera_source_return(source, NULL);
+            continue;
+        }
+        if (session == NULL) {
+            camera_source_return(source, image_data);
+            continue;
+        }
+
+        sc_recognition_context_start_new_frame_sequence(context);
+        ScProcessFrameResult result =
+                sc_recognition_context_process_frame(context, image_descr, image_data);
+        sc_recognition_context_end_frame_sequence(context);
+
+        // The buffer is not needed for reading the results.
+        camera_source_return(source, image_data);
+
+        if (result.status != SC_RECOGNITION_CONTEXT_STATUS_SUCCESS) {
+            pthread_mutex_lock(&station->output_lock);
+            printf("[%s] Processing frame failed with error %d: '%s'\n", source->path,
+                   result.status, sc_context_status_flag_get_message(result.status));
+            pthread_mutex_unlock(&station->output_lock);
+            continue;
+        }
+
+        ScBarcodeArray *new_codes = sc_barcode_scanner_session_get_newly_recognized_codes(session);
+        const uint32_t code_count = sc_barcode_array_get_size(new_codes);
+        pthread_mutex_lock(&station->output_lock);
+        for (uint32_t i = 0; i < code_count; i++) {
+            const ScBarcode *code = sc_barcode_array_get_item_at(new_codes, i);
+            ScByteArray data = sc_barcode_get_data(code);
+            printf("[%s] Barcode found: %s '%s'\n", source->path,
+                   sc_symbology_to_string(sc_barcode_get_symbology(code)), data.str);
+        }
+        fflush(stdout);
+        pthread_mutex_unlock(&station->output_lock);
+        sc_barcode_array_release(new_codes);
+    }
+
+    sc_image_description_release(image_descr);
+    sc_barcode_scanner_release(scanner);
+    sc_recognition_context_release(context);
+    return NULL;
+}
+
+/**
+ * Handles an event of a camera: a new frame or a finished scan. The camera is
+ * queued for the workers if it has a frame and is not queued or scanned already.
+ */
+static void station_dispatch(Station *station, size_t camera_index)
+{
+    CameraSource *source = &station->cameras[camera_index];
+    uint64_t events;
+    if (read(source->event_fd, &events, sizeof(events)) < 0) {
+        // EAGAIN, the event was already consumed.
+    }
+
+    pthread_mutex_lock(&source->lock);
+    if (source->scan_finished) {
+        source->scan_finished = SC_FALSE;
+        source->scheduled = SC_FALSE;
+    }
+    const ScBool schedule = !source->scheduled && source->pending_frame != NULL;
+    if (schedule) {
+        source->scheduled = SC_TRUE;
+    }
+    pthread_mutex_unlock(&source->lock);
+
+    if (schedule) {
+        pthread_mutex_lock(&station->lock);
+        const size_t tail = (station->ready_head + station->ready_count) % MAX_CAMERA_COUNT;
+        station->ready_cameras[tail] = camera_index;
+        station->ready_count++;
+        pthread_cond_signal(&station->camera_ready);
+        pthread_mutex_unlock(&station->lock);
+    }
+}
+
+static ScBool parse_resolution(const char *text, ScSize *resolution)
+{
+    unsigned width;
+    unsigned height;
+    if (sscanf(text, "%ux%u", &width, &height) != 2 || width == 0 || height == 0) {
+        return SC_FALSE;
+    }
+    resolution->width = width;
+    resolution->height = height;
+    return SC_TRUE;
+}
+
+static void print_usage(const char *program_name)
+{
+    printf("Usage: %s [-j worker-count] [--resolution WIDTHxHEIGHT] device-path...\n",
+           program_name);
+}
+
+int main(int argc, char *argv[]) {
+    long worker_count = sysconf(_SC_NPROCESSORS_ONLN) / 2;
+    ScSize resolution = { DEFAULT_RESOLUTION_WIDTH, DEFAULT_RESOLUTION_HEIGHT };
+
+    static const struct option long_options[] = {
+        { "jobs", required_argument, NULL, 'j' },
+        { "resolution", required_argument, NULL, 'r' },
+        { "help", no_argument, NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+    int option;
+    while ((option = getopt_long(argc, argv, "j:r:h", long_options, NULL)) != -1) {
+        switch (option) {
+            case 'j':
+                worker_count = atol(optarg);
+                break;
+            case 'r':
+                if (!parse_resolution(optarg, &resolution)) {
+                    print_usage(argv[0]);
+                    return -1;
+                }
+                break;
+            case 'h':
+                print_usage(argv[0]);
+                return 0;
+            default:
+                print_usage(argv[0]);
+                return -1;
+        }
+    }
+    const int camera_count = argc - optind;
+    if (camera_count < 1 || camera_count > MAX_CAMERA_COUNT) {
+        print_usage(argv[0]);
+        return -1;
+    }
+    if (worker_count < 1) {
+        worker_count = 1;
+    } else if (worker_count > MAX_WORKER_COUNT) {
+        worker_count = MAX_WORKER_COUNT;
+    }
+
+    int return_code = 0;
+    int epoll_fd = -1;
+    ScBarcodeScannerSettings *settings = NULL;
+    Station *station = calloc(1, sizeof(Station));
+    if (station == NULL) {
+        return -1;
+    }
+    pthread_mutex_init(&station->lock, NULL);
+    pthread_mutex_init(&station->output_lock, NULL);
+    pthread_cond_init(&station->camera_ready, NULL);
+    for (int i = 0; i < MAX_CAMERA_COUNT; ++i) {
+        station->cameras[i].event_fd = -1;
+    }
+
+    stop_event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (stop_event_fd < 0 || epoll_fd < 0) {
+        printf("Could not set up epoll: %s\n", strerror(errno));
+        return_code = -1;
+        goto cleanup;
+    }
+
+    // Handle ctrl+c events.
+    process_frames = 1;
+    if (signal(SIGINT, catch_exit) == SIG_ERR || signal(SIGTERM, catch_exit) == SIG_ERR) {
+        printf("Could not set up signal handler.\n");
+        return_code = -1;
+        goto cleanup;
+    }
+
+    settings = create_scanner_settings();
+    if (settings == NULL) {
+        return_code = -1;
+        goto cleanup;
+    }
+    station->settings = settings;
+    for (long i = 0; i < worker_count; ++i) {
+        if (pthread_create(&station->workers[i], NULL, scan_worker_run, station) != 0) {
+            printf("Could not start worker thread.\n");
+            return_code = -1;
+            goto cleanup;
+        }
+        station->worker_count++;
+    }
+
+    struct epoll_event event = { .events = EPOLLIN, .data.u64 = MAX_CAMERA_COUNT };
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, stop_event_fd, &event) != 0) {
+        printf("Could not watch the stop event: %s\n", strerror(errno));
+        return_code = -1;
+        goto cleanup;
+    }
+    for (int i = 0; i < camera_count; ++i) {
+        CameraSource *source = &station->cameras[i];
+        station->camera_count++;
+        if (!camera_source_open(source, argv[optind + i], resolution, &station->output_lock)) {
+            return_code = -1;
+            goto cleanup;
+        }
+        event.data.u64 = i;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, source->event_fd, &event) != 0) {
+            camera_source_printf(source, "Could not watch the camera: %s\n", strerror(errno));
+            return_code = -1;
+            goto cleanup;
+        }
+    }
+    printf("Scanning %d cameras with %zu workers.\n", camera_count, station->worker_count);
+
+    while (process_frames) {
+        struct epoll_event ready_events[MAX_CAMERA_COUNT + 1];
+        const int ready = epoll_wait(epoll_fd, ready_events, MAX_CAMERA_COUNT + 1, -1);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            printf("epoll_wait failed: %s\n", strerror(errno));
+            break;
+        }
+        for (int i = 0; i < ready; ++i) {
+            if (ready_events[i].data.u64 < MAX_CAMERA_COUNT) {
+                station_dispatch(station, (size_t)ready_events[i].data.u64);
+            }
+        }
+    }
+    printf("Stopping.\n");
+
+cleanup:
+    process_frames = 0;
+    pthread_mutex_lock(&station->lock);
+    station->shutting_down = SC_TRUE;
+    pthread_cond_broadcast(&station->camera_ready);
+    pthread_mutex_unlock(&station->lock);
+    for (size_t i = 0; i < station->worker_count; ++i) {
+        pthread_join(station->workers[i], NULL);
+    }
+    for (size_t i = 0; i < station->camera_count; ++i) {
+        CameraSource *source = &station->cameras[i];
+        camera_source_close(source);
+        camera_source_printf(source, "captured %llu frames, scanned %llu, dropped %llu\n",
+                             (unsigned long long)source->captured_count,
+                             (unsigned long long)source->scanned_count,
+                             (unsigned long long)source->dropped_count);
+    }
+    sc_barcode_scanner_settings_release(settings);
+    if (epoll_fd >= 0) {
+        close(epoll_fd);
+    }
+    if (stop_event_fd >= 0) {
+        close(stop_event_fd);
+    }
+    pthread_mutex_destroy(&station->lock);
+    pthread_mutex_destroy(&station->output_lock);
+    pthread_cond_destroy(&station->camera_ready);
+    free(station);
+    return return_code;
+}
@@ -0,0 +1,157 @@
+/**
+ * \file FrameRecording.h
+ *
+ * \brief File format of the camera frame recordings
+ *
+ * The camera sample writes recordings with --record. The camera and the MatrixScan
+ * samples replay them with --replay and the benchmark scans them as part of its corpus.
+ * All of them check every record with frame_record_end() before a frame is handed to
+ * the scanner, so a damaged or hand-made recording can not make it read outside the
+ * mapped file.
+ *
+ * \copyright Copyright (c) 2018 Scandit AG. All rights reserved.
+ */
+
+#ifndef SC_SAMPLES_FRAME_RECORDING_H
+#define SC_SAMPLES_FRAME_RECORDING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <Scandit/ScImageDescription.h>
+
+// Frame recordings start with a RecordingHeader. Every frame follows as a FrameRecord
+// and the frame data, both aligned to RECORDING_ALIGNMENT bytes, so that a mapped
+// recording can be passed to the scanner in place. Closing a recording appends an
+// index with the file offsets of all records and writes it to the header.
+#define RECORDING_MAGIC "SCFRAMES"
+#define RECORDING_VERSION 1
+#define RECORDING_ALIGNMENT 64
+
+typedef struct RecordingHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t alignment;
+    // Both 0 if the recording was not closed properly. Replay then walks the records.
+    uint64_t frame_count;
+    uint64_t index_offset;
+    uint8_t reserved[32];
+} RecordingHeader;
+
+typedef struct FrameRecord {
+    // The ScImageDescription of the frame. Offsets are relative to the frame data.
+    uint32_t layout;
+    uint32_t width;
+    uint32_t height;
+    uint32_t first_plane_offset;
+    uint32_t first_plane_row_bytes;
+    uint32_t second_plane_offset;
+    uint32_t second_plane_row_bytes;
+    uint32_t memory_size;
+    // Capture time relative to the first frame of the recording.
+    uint64_t capture_time_ns;
+    // Unix time of the capture.
+    uint64_t wall_time_ns;
+    uint64_t sequence;
+    uint8_t reserved[8];
+} FrameRecord;
+
+static inline uint64_t recording_align(uint64_t offset)
+{
+    return (offset + RECORDING_ALIGNMENT - 1) & ~(uint64_t)(RECORDING_ALIGNMENT - 1);
+}
+
+/**
+ * Returns the end of a plane of rows that starts at offset. Zero row bytes stand for
+ * unpadded rows, as in ScImageDescription.
+ */
+static inline uint64_t frame_record_plane_end(uint64_t offset, uint64_t row_bytes, uint64_t rows,
+                                              uint64_t used_row_bytes)
+{
+    if (row_bytes == 0) {
+        row_bytes = used_row_bytes;
+    }
+    return offset + (rows - 1) * row_bytes + used_row_bytes;
+}
+
+/**
+ * Checks that the layout of a record is known and that all planes its description
+ * names, with their rows as wide as the image, lie within its memory_size bytes.
+ */
+static inline int frame_record_is_valid(const FrameRecord *record)
+{
+    const uint64_t width = record->width;
+    const uint64_t height = record->height;
+    const uint64_t chroma_width = (width + 1) / 2;
+    const uint64_t chroma_height = (height + 1) / 2;
+    uint64_t bytes_per_pixel;
+    switch (record->layout) {
+        case SC_IMAGE_LAYOUT_GRAY_8U:
+        case SC_IMAGE_LAYOUT_YPCBCR_8U:
+        case SC_IMAGE_LAYOUT_YPCRCB_8U:
+        case SC_IMAGE_LAYOUT_I420_8U:
+            bytes_per_pixel = 1;
+            break;
+        case SC_IMAGE_LAYOUT_YUYV_8U:
+        case SC_IMAGE_LAYOUT_UYVY_8U:
+            bytes_per_pixel = 2;
+            break;
+        case SC_IMAGE_LAYOUT_RGB_8U:
+            bytes_per_pixel = 3;
+            break;
+        case SC_IMAGE_LAYOUT_RGBA_8U:
+        case SC_IMAGE_LAYOUT_ARGB_8U:
+            bytes_per_pixel = 4;
+            break;
+        default:
+            return 0;
+    }
+    if (width == 0 || height == 0) {
+        return 0;
+    }
+    const uint64_t used_row_bytes = width * bytes_per_pixel;
+    if (record->first_plane_row_bytes != 0 && record->first_plane_row_bytes < used_row_bytes) {
+        return 0;
+    }
+    uint64_t end = frame_record_plane_end(record->first_plane_offset, record->first_plane_row_bytes,
+                                          height, used_row_bytes);
+    if (record->layout == SC_IMAGE_LAYOUT_YPCBCR_8U || record->layout == SC_IMAGE_LAYOUT_YPCRCB_8U) {
+        // Interleaved chroma samples, one pair for every two pixels of every second row.
+        const uint64_t chroma_row_bytes = 2 * chroma_width;
+        if (record->second_plane_row_bytes != 0 && record->second_plane_row_bytes < chroma_row_bytes) {
+            return 0;
+        }
+        const uint64_t second_end = frame_record_plane_end(record->second_plane_offset,
+                                                           record->second_plane_row_bytes,
+                                                           chroma_height, chroma_row_bytes);
+        end = second_end > end ? second_end : end;
+    } else if (record->layout == SC_IMAGE_LAYOUT_I420_8U) {
+        // The description has no offsets for the U and V planes, they directly follow
+        // the unpadded luma plane.
+        if (record->first_plane_row_bytes != 0 && record->first_plane_row_bytes != width) {
+            return 0;
+        }
+        end = record->first_plane_offset + width * height + 2 * chroma_width * chroma_height;
+    }
+    return end <= record->memory_size;
+}
+
+/**
+ * Checks that the record at offset and its frame lie within the recording of the
+ * given size and returns the end of the frame data, or 0 if the record is damaged.
+ */
+static inline uint64_t frame_record_end(const uint8_t *recording, size_t size, uint64_t offset)
+{
+    if (offset % RECORDING_ALIGNMENT != 0 || offset > size || size - offset < sizeof(FrameRecord)) {
+        return 0;
+    }
+    const FrameRecord *record = (const FrameRecord *)(recording + offset);
+    const uint64_t data_offset = recording_align(offset + sizeof(FrameRecord));
+    if (data_offset > size || size - data_offset < record->memory_size ||
+        !frame_record_is_valid(record)) {
+        return 0;
+    }
+    return data_offset + record->memory_size;
+}
+
+#endif // SC_SAMPLES_FRAME_RECORDING_H
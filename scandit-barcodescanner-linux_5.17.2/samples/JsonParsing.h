@@ -0,0 +1,170 @@
+/**
+ * \file JsonParsing.h
+ *
+ * \brief Parsing of the JSON request and payload lines
+ *
+ * Shared by the daemon mode of the image processing sample and the batch mode of the
+ * generator sample. Only what their one line JSON objects need is parsed: strings,
+ * which are decoded to UTF-8, and values that are skipped.
+ *
+ * \copyright Copyright (c) 2018 Scandit AG. All rights reserved.
+ */
+
+#ifndef SC_SAMPLES_JSON_PARSING_H
+#define SC_SAMPLES_JSON_PARSING_H
+
+#include <ctype.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+static inline const char *json_skip_whitespace(const char *p)
+{
+    while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') {
+        ++p;
+    }
+    return p;
+}
+
+/**
+ * Reads the four hex digits of a \u escape starting at p.
+ *
+ * \returns the position after the digits or NULL if they are not four hex digits.
+ */
+static inline const char *json_parse_hex4(const char *p, uint32_t *value)
+{
+    *value = 0;
+    for (int i = 0; i < 4; ++i) {
+        const unsigned char digit = (unsigned char)p[i];
+        if (!isxdigit(digit)) {
+            return NULL;
+        }
+        *value = (*value << 4) | (uint32_t)(isdigit(digit) ? digit - '0' : tolower(digit) - 'a' + 10);
+    }
+    return p + 4;
+}
+
+/**
+ * Parses the JSON string starting at p into target as UTF-8 and stores its length in
+ * *length. Escaped surrogate pairs are combined into one code point. Lone surrogates
+ * and \u0000, which would end the string early, are rejected.
+ *
+ * \returns the position after the string or NULL if it is invalid or too long.
+ */
+static inline const char *json_parse_string(const char *p, char *target, size_t target_size,
+                                            size_t *length)
+{
+    if (*p++ != '"') {
+        return NULL;
+    }
+    *length = 0;
+    while (*p != '"') {
+        uint32_t character = (unsigned char)*p++;
+        int escaped = 0;
+        if (character == '\0') {
+            return NULL;
+        }
+        if (character == '\\') {
+            escaped = 1;
+            const char escape = *p++;
+            switch (escape) {
+                case '"': case '\\': case '/': character = (uint32_t)escape; break;
+                case 'b': character = '\b'; break;
+                case 'f': character = '\f'; break;
+                case 'n': character = '\n'; break;
+                case 'r': character = '\r'; break;
+                case 't': character = '\t'; break;
+                case 'u': {
+                    if ((p = json_parse_hex4(p, &character)) == NULL || character == 0 ||
+                        (character >= 0xDC00 && character <= 0xDFFF)) {
+                        return NULL;
+                    }
+                    if (character >= 0xD800 && character <= 0xDBFF) {
+                        uint32_t low;
+                        if (p[0] != '\\' || p[1] != 'u' || (p = json_parse_hex4(p + 2, &low)) == NULL ||
+                            low < 0xDC00 || low > 0xDFFF) {
+                            return NULL;
+                        }
+                        character = 0x10000 + ((character - 0xD800) << 10) + (low - 0xDC00);
+                    }
+                    break;
+                }
+                default:
+                    return NULL;
+            }
+        }
+        // Unescaped bytes are copied as they are, escaped code points are encoded.
+        char encoded[4];
+        size_t encoded_length = 0;
+        if (character < 0x80 || !escaped) {
+            encoded[encoded_length++] = (char)character;
+        } else if (character < 0x800) {
+            encoded[encoded_length++] = (char)(0xC0 | (character >> 6));
+            encoded[encoded_length++] = (char)(0x80 | (character & 0x3F));
+        } else if (character < 0x10000) {
+            encoded[encoded_length++] = (char)(0xE0 | (character >> 12));
+            encoded[encoded_length++] = (char)(0x80 | ((character >> 6) & 0x3F));
+            encoded[encoded_length++] = (char)(0x80 | (character & 0x3F));
+        } else {
+            encoded[encoded_length++] = (char)(0xF0 | (character >> 18));
+            encoded[encoded_length++] = (char)(0x80 | ((character >> 12) & 0x3F));
+            encoded[encoded_length++] = (char)(0x80 | ((character >> 6) & 0x3F));
+            encoded[encoded_length++] = (char)(0x80 | (character & 0x3F));
+        }
+        if (*length + encoded_length >= target_size) {
+            return NULL;
+        }
+        memcpy(target + *length, encoded, encoded_length);
+        *length += encoded_length;
+    }
+    target[*length] = '\0';
+    return p + 1;
+}
+
+/**
+ * Skips the JSON value starting at p, including nested objects and arrays.
+ *
+ * \returns the position after the value or NULL if it is invalid.
+ */
+static inline const char *json_skip_value(const char *p)
+{
+    int depth = 0;
+    do {
+        p = json_skip_whitespace(p);
+        if (*p == '"') {
+            for (++p; *p != '"'; ++p) {
+                if (*p == '\0' || (*p == '\\' && *++p == '\0')) {
+                    return NULL;
+                }
+            }
+            ++p;
+        } else if (*p == '{' || *p == '[') {
+            ++depth;
+            ++p;
+            continue;
+        } else if (*p == '}' || *p == ']') {
+            if (depth == 0) {
+                return NULL;
+            }
+            --depth;
+            ++p;
+        } else if (*p == ',' || *p == ':') {
+            if (depth == 0) {
+                return NULL;
+            }
+            ++p;
+            continue;
+        } else {
+            const char *start = p;
+            while (*p != '\0' && strchr(" \t\r\n,:{}[]\"", *p) == NULL) {
+                ++p;
+            }
+            if (p == start) {
+                return NULL;
+            }
+        }
+    } while (depth > 0);
+    return p;
+}
+
+#endif // SC_SAMPLES_JSON_PARSING_H
@@ -0,0 +1,222 @@
+/**
+ * \file LumaConversion.h
+ *
+ * \brief Conversion of RGB and packed YUV rows to 8 bit luma
+ *
+ * Shared by the image processing sample and the benchmark, so that the benchmark
+ * measures the conversion the sample does. Rows are converted with AVX2 (chosen at
+ * run time) or NEON where available, the remaining pixels with the scalar code, which
+ * gives the same results.
+ *
+ * \copyright Copyright (c) 2018 Scandit AG. All rights reserved.
+ */
+
+#ifndef SC_SAMPLES_LUMA_CONVERSION_H
+#define SC_SAMPLES_LUMA_CONVERSION_H
+
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// ITU-R BT.601 luma weights in 1/128 steps. They fit the signed 8 bit multipliers of
+// pmaddubsw, so the vector and the scalar conversion give the same results.
+#define LUMA_WEIGHT_R 38
+#define LUMA_WEIGHT_G 75
+#define LUMA_WEIGHT_B 15
+
+static inline uint8_t rgb_to_luma(uint32_t r, uint32_t g, uint32_t b)
+{
+    return (uint8_t)((LUMA_WEIGHT_R * r + LUMA_WEIGHT_G * g + LUMA_WEIGHT_B * b + 64) >> 7);
+}
+
+/**
+ * Byte positions of the color channels in a 3 or 4 byte pixel.
+ */
+typedef struct PixelChannels {
+    uint32_t bytes_per_pixel;
+    uint32_t r;
+    uint32_t g;
+    uint32_t b;
+} PixelChannels;
+
+static inline void pixels_to_luma_scalar(const uint8_t *source, uint8_t *target, uint32_t count,
+                                         const PixelChannels *channels)
+{
+    for (uint32_t x = 0; x < count; ++x) {
+        const uint8_t *pixel = source + x * channels->bytes_per_pixel;
+        target[x] = rgb_to_luma(pixel[channels->r], pixel[channels->g], pixel[channels->b]);
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+/**
+ * Converts blocks of 16 pixels and returns the number of converted pixels. The
+ * weighted sums of a pixel are built with pmaddubsw and phaddw. 3 byte pixels are
+ * first spread out to 4 bytes per pixel.
+ */
+__attribute__((target("avx2")))
+static inline uint32_t pixels_to_luma_avx2(const uint8_t *source, uint8_t *target, uint32_t count,
+                                           const PixelChannels *channels)
+{
+    int8_t weights[4] = { 0, 0, 0, 0 };
+    weights[channels->r] = LUMA_WEIGHT_R;
+    weights[channels->g] = LUMA_WEIGHT_G;
+    weights[channels->b] = LUMA_WEIGHT_B;
+    const __m256i weight_vector = _mm256_setr_epi8(
+            weights[0], weights[1], weights[2], weights[3], weights[0], weights[1], weights[2], weights[3],
+            weights[0], weights[1], weights[2], weights[3], weights[0], weights[1], weights[2], weights[3],
+            weights[0], weights[1], weights[2], weights[3], weights[0], weights[1], weights[2], weights[3],
+            weights[0], weights[1], weights[2], weights[3], weights[0], weights[1], weights[2], weights[3]);
+    const __m256i spread = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+                                            0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m256i rounding = _mm256_set1_epi16(64);
+
+    uint32_t x = 0;
+    // The last load of 3 byte pixels reads 4 bytes beyond the block.
+    const uint32_t end = channels->bytes_per_pixel == 4 ? count : (count > 2 ? count - 2 : 0);
+    for (; x + 16 <= end; x += 16) {
+        __m256i low;
+        __m256i high;
+        if (channels->bytes_per_pixel == 4) {
+            low = _mm256_loadu_si256((const __m256i *)(source + x * 4));
+            high = _mm256_loadu_si256((const __m256i *)(source + x * 4 + 32));
+        } else {
+            // Pixels 0-3 and 4-7 into the two lanes of low, 8-11 and 12-15 into high.
+            const uint8_t *pixels = source + x * 3;
+            low = _mm256_inserti128_si256(
+                    _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)pixels)),
+                    _mm_loadu_si128((const __m128i *)(pixels + 12)), 1);
+            high = _mm256_inserti128_si256(
+                    _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)(pixels + 24))),
+                    _mm_loadu_si128((const __m128i *)(pixels + 36)), 1);
+            low = _mm256_shuffle_epi8(low, spread);
+            high = _mm256_shuffle_epi8(high, spread);
+        }
+        // The weights add up to 128, the sums fit into signed 16 bit.
+        __m256i luma = _mm256_hadd_epi16(_mm256_maddubs_epi16(low, weight_vector),
+                                         _mm256_maddubs_epi16(high, weight_vector));
+        luma = _mm256_srli_epi16(_mm256_add_epi16(luma, rounding), 7);
+        // The lanes hold pixels 0-3, 8-11 and 4-7, 12-15.
+        const __m128i packed = _mm_packus_epi16(_mm256_castsi256_si128(luma),
+                                                _mm256_extracti128_si256(luma, 1));
+        _mm_storeu_si128((__m128i *)(target + x), _mm_shuffle_epi32(packed, _MM_SHUFFLE(3, 1, 2, 0)));
+    }
+    return x;
+}
+
+/**
+ * Extracts the luma bytes of 4:2:2 pixels in blocks of 32 pixels. luma_offset is 0
+ * for YUYV and 1 for UYVY.
+ */
+__attribute__((target("avx2")))
+static inline uint32_t packed_yuv_to_luma_avx2(const uint8_t *source, uint8_t *target, uint32_t count,
+                                               uint32_t luma_offset)
+{
+    const __m256i mask = _mm256_set1_epi16(0x00ff);
+    uint32_t x = 0;
+    for (; x + 32 <= count; x += 32) {
+        __m256i low = _mm256_loadu_si256((const __m256i *)(source + x * 2));
+        __m256i high = _mm256_loadu_si256((const __m256i *)(source + x * 2 + 32));
+        if (luma_offset == 0) {
+            low = _mm256_and_si256(low, mask);
+            high = _mm256_and_si256(high, mask);
+        } else {
+            low = _mm256_srli_epi16(low, 8);
+            high = _mm256_srli_epi16(high, 8);
+        }
+        const __m256i luma = _mm256_permute4x64_epi64(_mm256_packus_epi16(low, high),
+                                                      _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_si256((__m256i *)(target + x), luma);
+    }
+    return x;
+}
+#endif
+
+#if defined(__ARM_NEON)
+static inline uint32_t pixels_to_luma_neon(const uint8_t *source, uint8_t *target, uint32_t count,
+                                           const PixelChannels *channels)
+{
+    const uint8x8_t weight_r = vdup_n_u8(LUMA_WEIGHT_R);
+    const uint8x8_t weight_g = vdup_n_u8(LUMA_WEIGHT_G);
+    const uint8x8_t weight_b = vdup_n_u8(LUMA_WEIGHT_B);
+    uint32_t x = 0;
+    for (; x + 16 <= count; x += 16) {
+        uint8x16_t r;
+        uint8x16_t g;
+        uint8x16_t b;
+        if (channels->bytes_per_pixel == 4) {
+            const uint8x16x4_t pixels = vld4q_u8(source + x * 4);
+            r = pixels.val[channels->r];
+            g = pixels.val[channels->g];
+            b = pixels.val[channels->b];
+        } else {
+            const uint8x16x3_t pixels = vld3q_u8(source + x * 3);
+            r = pixels.val[channels->r];
+            g = pixels.val[channels->g];
+            b = pixels.val[channels->b];
+        }
+        uint16x8_t low = vmull_u8(vget_low_u8(r), weight_r);
+        low = vmlal_u8(low, vget_low_u8(g), weight_g);
+        low = vmlal_u8(low, vget_low_u8(b), weight_b);
+        uint16x8_t high = vmull_u8(vget_high_u8(r), weight_r);
+        high = vmlal_u8(high, vget_high_u8(g), weight_g);
+        high = vmlal_u8(high, vget_high_u8(b), weight_b);
+        vst1q_u8(target + x, vcombine_u8(vrshrn_n_u16(low, 7), vrshrn_n_u16(high, 7)));
+    }
+    return x;
+}
+
+static inline uint32_t packed_yuv_to_luma_neon(const uint8_t *source, uint8_t *target, uint32_t count,
+                                               uint32_t luma_offset)
+{
+    uint32_t x = 0;
+    for (; x + 16 <= count; x += 16) {
+        const uint8x16x2_t pixels = vld2q_u8(source + x * 2);
+        vst1q_u8(target + x, pixels.val[luma_offset]);
+    }
+    return x;
+}
+#endif
+
+/**
+ * Converts a row of RGB pixels to luma, with AVX2 or NEON where available.
+ */
+static inline void pixels_to_luma(const uint8_t *source, uint8_t *target, uint32_t count,
+                                  const PixelChannels *channels)
+{
+    uint32_t converted = 0;
+#if defined(__x86_64__) || defined(__i386__)
+    if (__builtin_cpu_supports("avx2")) {
+        converted = pixels_to_luma_avx2(source, target, count, channels);
+    }
+#elif defined(__ARM_NEON)
+    converted = pixels_to_luma_neon(source, target, count, channels);
+#endif
+    pixels_to_luma_scalar(source + converted * channels->bytes_per_pixel, target + converted,
+                          count - converted, channels);
+}
+
+/**
+ * Copies the luma bytes of a row of YUYV (luma_offset 0) or UYVY (luma_offset 1) pixels.
+ */
+static inline void packed_yuv_to_luma(const uint8_t *source, uint8_t *target, uint32_t count,
+                                      uint32_t luma_offset)
+{
+    uint32_t x = 0;
+#if defined(__x86_64__) || defined(__i386__)
+    if (__builtin_cpu_supports("avx2")) {
+        x = packed_yuv_to_luma_avx2(source, target, count, luma_offset);
+    }
+#elif defined(__ARM_NEON)
+    x = packed_yuv_to_luma_neon(source, target, count, luma_offset);
+#endif
+    for (; x < count; ++x) {
+        target[x] = source[x * 2 + luma_offset];
+    }
+}
+
+#endif // SC_SAMPLES_LUMA_CONVERSION_H
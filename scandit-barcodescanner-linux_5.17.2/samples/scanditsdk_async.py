@@ -0,0 +1,163 @@
+# Scans camera frames on a background thread and delivers the results to asyncio.
+#
+# Camera.frame of the scanditsdk bindings returns a CameraFrame that gives its buffer
+# back to the camera only when Python garbage-collects it, and capture stops while the
+# application handles the codes of the previous frame. AsyncCameraScanner captures and
+# scans on its own thread instead: every buffer is handed back to the camera as soon as
+# the frame is processed and the results are put into an asyncio queue. ctypes releases
+# the GIL while the thread waits for a frame and while the frame is processed, so a slow
+# consumer mostly leaves the frame rate alone. Reading the codes of a frame holds the
+# GIL, however, and a consumer that keeps the GIL busy with Python code still slows
+# the capture thread down.
+
+import asyncio
+import collections
+import ctypes as ct
+import threading
+
+import scanditsdk as sc
+import scanditsdk_buffers
+
+_ = ct.CDLL(sc._lib_path)
+
+_.sc_camera_start_stream.argtypes = [ct.c_void_p]
+_.sc_camera_start_stream.restype = ct.c_int32
+_.sc_camera_stop_stream.argtypes = [ct.c_void_p]
+_.sc_camera_stop_stream.restype = ct.c_int32
+_.sc_camera_get_frame.argtypes = [ct.c_void_p, ct.c_void_p]
+_.sc_camera_get_frame.restype = ct.c_void_p
+_.sc_camera_enqueue_frame_data.argtypes = [ct.c_void_p, ct.c_void_p]
+_.sc_camera_enqueue_frame_data.restype = ct.c_int32
+_.sc_recognition_context_start_new_frame_sequence.argtypes = [ct.c_void_p]
+_.sc_recognition_context_end_frame_sequence.argtypes = [ct.c_void_p]
+_.sc_recognition_context_process_frame.argtypes = [
+    ct.c_void_p,
+    ct.c_void_p,
+    ct.c_void_p,
+]
+_.sc_recognition_context_process_frame.restype = sc.ProcessFrameResult
+
+"""
+The result of one scanned frame. codes is a scanditsdk_buffers.RecognizedCodes.
+"""
+CameraScan = collections.namedtuple("CameraScan", "frame_id status codes")
+
+_STOPPED = object()
+
+
+class AsyncCameraScanner(object):
+    """
+    Asynchronous iterator over the frames scanned from a camera.
+
+        async with AsyncCameraScanner(camera, context, scanner) as frames:
+            async for scan in frames:
+                for code in scan.codes:
+                    print(code.data)
+
+    Only frames with codes are delivered unless all_frames is set. If the application
+    falls more than queue_size results behind, the oldest results are dropped and
+    counted in dropped, but capture never waits for the application. A failed frame
+    ends the iteration with a RuntimeError.
+    """
+
+    def __init__(self, camera, context, scanner, queue_size=8, all_frames=False):
+        self._camera = camera
+        self._context = context
+        self._scanner = scanner
+        self._queue_size = queue_size
+        self._all_frames = all_frames
+        self._queue = None
+        self._loop = None
+        self._thread = None
+        self._stopping = threading.Event()
+        # Set once the end of the iteration was delivered.
+        self._stopped = False
+        self.dropped = 0
+
+    def start(self):
+        self._loop = asyncio.get_running_loop()
+        self._queue = asyncio.Queue(self._queue_size)
+        self._stopping.clear()
+        self._stopped = False
+        if not _.sc_camera_start_stream(self._camera.handle):
+            raise RuntimeError("Failed to start camera stream")
+        self._thread = threading.Thread(target=self._run, name="camera-scanner")
+        self._thread.daemon = True
+        self._thread.start()
+
+    async def stop(self):
+        self._stopping.set()
+        if self._thread is not None:
+            # The thread returns after the frame it is waiting for.
+            await self._loop.run_in_executor(None, self._thread.join)
+            self._thread = None
+            _.sc_camera_stop_stream(self._camera.handle)
+
+    async def __aenter__(self):
+        self.start()
+        return self
+
+    async def __aexit__(self, exc_type, exc, traceback):
+        await self.stop()
+
+    def __aiter__(self):
+        return self
+
+    async def __anext__(self):
+        # Nothing follows the end of the iteration, the queue would wait forever.
+        if self._stopped:
+            raise StopAsyncIteration
+        item = await self._queue.get()
+        if item is _STOPPED:
+            self._stopped = True
+            raise StopAsyncIteration
+        if isinstance(item, Exception):
+            # The thread posts nothing after an error.
+            self._stopped = True
+            raise item
+        return item
+
+    def _post(self, item):
+        # Runs on the event loop.
+        if self._queue.full():
+            self._queue.get_nowait()
+            self.dropped += 1
+        self._queue.put_nowait(item)
+
+    def _run(self):
+        camera = self._camera.handle
+        context = self._context.handle
+        # One description for all frames, sc_camera_get_frame() fills it in.
+        description = sc.ImageDescription()
+        item = _STOPPED
+        _.sc_recognition_context_start_new_frame_sequence(context)
+        try:
+            while not self._stopping.is_set():
+                data = _.sc_camera_get_frame(camera, description.handle)
+                if not data:
+                    item = RuntimeError("Failed to retrieve data from the camera")
+                    break
+                try:
+                    status = _.sc_recognition_context_process_frame(
+                        context, description.handle, data
+                    )
+                finally:
+                    _.sc_camera_enqueue_frame_data(camera, data)
+
+                if status.status != sc.RECOGNITION_CONTEXT_STATUS_SUCCESS:
+                    item = RuntimeError(
+                        "Processing frame failed with code {}: {}".format(
+                            status.status, status.get_status_flag_message()
+                        )
+                    )
+                    break
+                codes = scanditsdk_buffers.newly_recognized_codes(self._scanner.session)
+                if len(codes) or self._all_frames:
+                    scan = CameraScan(status.frame_id, status.status, codes)
+                    self._loop.call_soon_threadsafe(self._post, scan)
+        except Exception as error:
+            item = error
+        finally:
+            _.sc_recognition_context_end_frame_sequence(context)
+            # Posted last, so it can not be dropped for a later result.
+            self._loop.call_soon_threadsafe(self._post, item)
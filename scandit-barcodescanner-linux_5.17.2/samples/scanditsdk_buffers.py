@@ -0,0 +1,310 @@
+# Helpers for the Python samples to pass frames to the scanner without copying them
+# and to collect the recognized codes of a frame into one array of records.
+#
+# The scanditsdk bindings expect a raw ctypes pointer and a hand-filled ImageDescription
+# for every frame, and every attribute of a barcode is a separate call into the SDK.
+# BufferFrameSequence takes any object that supports the buffer protocol instead, for
+# example a NumPy array, a memoryview or a ctypes array, and describes the frame from
+# the shape and strides of the buffer.
+# ctypes releases the GIL for the duration of every call into the SDK, so other Python
+# threads keep running while a frame is processed.
+
+import collections
+import ctypes as ct
+
+import scanditsdk as sc
+
+_ = ct.CDLL(sc._lib_path)
+
+_.sc_recognition_context_start_new_frame_sequence.argtypes = [ct.c_void_p]
+_.sc_recognition_context_end_frame_sequence.argtypes = [ct.c_void_p]
+_.sc_recognition_context_process_frame.argtypes = [
+    ct.c_void_p,
+    ct.c_void_p,
+    ct.c_void_p,
+]
+_.sc_recognition_context_process_frame.restype = sc.ProcessFrameResult
+_.sc_barcode_scanner_session_get_newly_recognized_codes.argtypes = [ct.c_void_p]
+_.sc_barcode_scanner_session_get_newly_recognized_codes.restype = ct.c_void_p
+_.sc_barcode_array_get_size.argtypes = [ct.c_void_p]
+_.sc_barcode_array_get_size.restype = ct.c_uint32
+_.sc_barcode_array_get_item_at.argtypes = [ct.c_void_p, ct.c_uint32]
+_.sc_barcode_array_get_item_at.restype = ct.c_void_p
+_.sc_barcode_array_release.argtypes = [ct.c_void_p]
+_.sc_barcode_get_symbology.argtypes = [ct.c_void_p]
+_.sc_barcode_get_symbology.restype = ct.c_int
+_.sc_barcode_get_location.argtypes = [ct.c_void_p]
+_.sc_barcode_get_location.restype = sc.Quadrilateral
+_.sc_barcode_get_data.argtypes = [ct.c_void_p]
+_.sc_barcode_get_data.restype = sc.ByteArray
+_.sc_barcode_get_data_encoding.argtypes = [ct.c_void_p]
+_.sc_barcode_get_data_encoding.restype = sc._EncodingRangeArray
+_.sc_encoding_array_free.argtypes = [sc._EncodingRangeArray]
+_.sc_symbology_to_string.argtypes = [ct.c_int]
+_.sc_symbology_to_string.restype = ct.c_char_p
+
+
+class _PyBuffer(ct.Structure):
+    # Py_buffer as filled in by PyObject_GetBuffer().
+    _fields_ = [
+        ("buf", ct.c_void_p),
+        ("obj", ct.c_void_p),
+        ("len", ct.c_ssize_t),
+        ("itemsize", ct.c_ssize_t),
+        ("readonly", ct.c_int),
+        ("ndim", ct.c_int),
+        ("format", ct.c_char_p),
+        ("shape", ct.POINTER(ct.c_ssize_t)),
+        ("strides", ct.POINTER(ct.c_ssize_t)),
+        ("suboffsets", ct.POINTER(ct.c_ssize_t)),
+        ("internal", ct.c_void_p),
+    ]
+
+
+# PyBUF_RECORDS_RO: shape and strides of a possibly read-only buffer.
+_PYBUF_RECORDS_RO = 0x001C
+
+_get_buffer = ct.pythonapi.PyObject_GetBuffer
+_get_buffer.argtypes = [ct.py_object, ct.POINTER(_PyBuffer), ct.c_int]
+_get_buffer.restype = ct.c_int
+_release_buffer = ct.pythonapi.PyBuffer_Release
+_release_buffer.argtypes = [ct.POINTER(_PyBuffer)]
+_release_buffer.restype = None
+
+# Bytes per pixel of the packed layouts. The 4:2:0 layouts are passed as one
+# (height * 3 / 2, row bytes) gray buffer with the chroma rows below the luma rows.
+# The U and V planes of I420 are half as wide as the luma plane and follow it without
+# padding, so I420 rows can not be padded.
+_PACKED_LAYOUTS = {
+    0x0001: 1,  # GRAY_8U
+    0x0002: 3,  # RGB_8U
+    0x0004: 4,  # RGBA_8U
+    0x0100: 4,  # ARGB_8U
+    0x0020: 2,  # YUYV_8U
+    0x0040: 2,  # UYVY_8U
+}
+_BIPLANAR_LAYOUTS = (0x0008, 0x0010)  # YPCBCR_8U (NV12), YPCRCB_8U (NV21)
+_I420_LAYOUT = 0x0080
+_CHANNEL_LAYOUTS = {1: 0x0001, 3: 0x0002, 4: 0x0004}
+
+
+def _layout_value(layout):
+    # The layout constants of the bindings are ctypes integers.
+    return getattr(layout, "value", layout)
+
+
+class BufferFrameSequence(object):
+    """
+    A frame sequence that takes its frames from buffer-protocol objects.
+
+    Gray frames are (height, width) buffers, RGB and RGBA frames (height, width, 3)
+    and (height, width, 4) buffers. The pixels of a row must be adjacent but the rows
+    may be padded, e.g. a NumPy view of a part of a larger image is scanned in place.
+    Other layouts are given explicitly and are passed as (rows, row bytes) buffers.
+    The image description is created once and only updated when the geometry of the
+    frames changes.
+    """
+
+    def __init__(self, context):
+        self._context = context
+        self._description = sc.ImageDescription()
+        self._geometry = None
+        _.sc_recognition_context_start_new_frame_sequence(context.handle)
+
+    def process_frame(self, frame, layout=None, width=None):
+        """
+        Processes the frame in the buffer without copying it. Only needed if the layout
+        can not be told from the shape, e.g. YUYV or NV12 frames, and the width only if
+        the rows of such a frame are padded.
+        """
+        view = _PyBuffer()
+        _get_buffer(frame, ct.byref(view), _PYBUF_RECORDS_RO)
+        try:
+            self._describe(view, layout, width)
+            return _.sc_recognition_context_process_frame(
+                self._context.handle, self._description.handle, view.buf
+            )
+        finally:
+            _release_buffer(ct.byref(view))
+
+    def end(self):
+        _.sc_recognition_context_end_frame_sequence(self._context.handle)
+        self._context = None
+
+    def _describe(self, view, layout, width):
+        if view.itemsize != 1:
+            raise ValueError("frames must be buffers of 8 bit samples")
+        if view.ndim not in (2, 3):
+            raise ValueError("frames must be 2 or 3 dimensional buffers")
+
+        rows = view.shape[0]
+        row_bytes = view.strides[0]
+        if rows <= 0 or row_bytes <= 0:
+            raise ValueError("frames must be non-empty buffers with positive strides")
+        if view.ndim == 3:
+            channels = view.shape[2]
+            if view.strides[2] != 1 or view.strides[1] != channels:
+                raise ValueError("the pixels of a frame row must be adjacent")
+            if layout is None:
+                if channels not in _CHANNEL_LAYOUTS:
+                    raise ValueError(
+                        "the layout of {} channels is ambiguous".format(channels)
+                    )
+                layout = _CHANNEL_LAYOUTS[channels]
+            used_row_bytes = view.shape[1] * channels
+        else:
+            if view.strides[1] != 1:
+                raise ValueError("the pixels of a frame row must be adjacent")
+            used_row_bytes = view.shape[1]
+        layout = _layout_value(layout if layout is not None else 0x0001)
+
+        if layout in _PACKED_LAYOUTS:
+            if width is None:
+                width = used_row_bytes // _PACKED_LAYOUTS[layout]
+            height = rows
+        elif layout in _BIPLANAR_LAYOUTS or layout == _I420_LAYOUT:
+            if width is None:
+                width = used_row_bytes
+            height = rows * 2 // 3
+        else:
+            raise ValueError("unsupported image layout {}".format(layout))
+        if row_bytes < used_row_bytes:
+            raise ValueError("the rows of a frame must not overlap")
+        if layout == _I420_LAYOUT and (row_bytes != width or used_row_bytes != width):
+            raise ValueError("I420 frames must not be padded")
+
+        memory_size = (rows - 1) * row_bytes + used_row_bytes
+        geometry = (layout, width, height, row_bytes, memory_size)
+        if geometry == self._geometry:
+            return
+
+        description = self._description
+        description.layout = layout
+        description.width = width
+        description.height = height
+        description.first_plane_offset = 0
+        description.first_plane_row_bytes = row_bytes
+        if layout in _BIPLANAR_LAYOUTS:
+            description.second_plane_offset = height * row_bytes
+            description.second_plane_row_bytes = row_bytes
+        else:
+            description.second_plane_offset = 0
+            description.second_plane_row_bytes = 0
+        description.memory_size = memory_size
+        self._geometry = geometry
+
+
+class CodeRecord(ct.Structure):
+    """
+    One recognized code. The data is stored in the data buffer of the RecognizedCodes.
+    """
+
+    _fields_ = [
+        ("symbology", ct.c_int),
+        ("location", sc.Quadrilateral),
+        ("data_offset", ct.c_uint32),
+        ("data_size", ct.c_uint32),
+    ]
+
+
+Code = collections.namedtuple("Code", "symbology symbology_string data location")
+
+_symbology_strings = {}
+
+
+def symbology_to_string(symbology):
+    name = _symbology_strings.get(symbology)
+    if name is None:
+        name = _.sc_symbology_to_string(symbology).decode("utf-8")
+        _symbology_strings[symbology] = name
+    return name
+
+
+class RecognizedCodes(object):
+    """
+    The codes recognized in a frame as one array of CodeRecord structures and one
+    buffer with the raw data of all codes. With NumPy installed, as_numpy() returns
+    the records as a structured array without copying them.
+    """
+
+    def __init__(self, records, data, texts):
+        self.records = records
+        self.data = data
+        self._texts = texts
+
+    def __len__(self):
+        return len(self.records)
+
+    def __getitem__(self, index):
+        record = self.records[index]
+        return Code(
+            record.symbology,
+            symbology_to_string(record.symbology),
+            self._texts[index],
+            record.location,
+        )
+
+    def __iter__(self):
+        for index in range(len(self.records)):
+            yield self[index]
+
+    def raw_data(self, index):
+        record = self.records[index]
+        return self.data[record.data_offset : record.data_offset + record.data_size]
+
+    def as_numpy(self):
+        import numpy
+
+        if not len(self.records):
+            return numpy.zeros(0, dtype=numpy.ctypeslib.as_ctypes_type(CodeRecord))
+        return numpy.ctypeslib.as_array(self.records)
+
+
+def _decode(barcode, raw):
+    # Almost all codes are UTF-8. Only look up the encoding ranges of the others,
+    # the same way the Barcode.data property of the bindings does.
+    try:
+        return raw.decode("utf-8")
+    except UnicodeDecodeError:
+        pass
+    encodings = _.sc_barcode_get_data_encoding(barcode)
+    text = ""
+    for i in range(encodings.size):
+        encoding = encodings.data[i]
+        name = encoding.name.data.c_str.decode("utf-8")
+        text += raw[encoding.start : encoding.end].decode(name, "ignore")
+    _.sc_encoding_array_free(encodings)
+    return text
+
+
+def newly_recognized_codes(session):
+    """
+    Reads all codes recognized in the last frame of the session.
+
+    This is still a loop over the codes with several ctypes calls per code: symbology,
+    location and data are read with one call each and packed into one CodeRecord array.
+    Unlike session.newly_recognized_codes no wrapper object is created and retained
+    per code.
+    """
+    array = _.sc_barcode_scanner_session_get_newly_recognized_codes(session.handle)
+    try:
+        count = _.sc_barcode_array_get_size(array)
+        records = (CodeRecord * count)()
+        chunks = []
+        texts = []
+        offset = 0
+        for i in range(count):
+            barcode = _.sc_barcode_array_get_item_at(array, i)
+            record = records[i]
+            record.symbology = _.sc_barcode_get_symbology(barcode)
+            record.location = _.sc_barcode_get_location(barcode)
+            data = _.sc_barcode_get_data(barcode)
+            raw = ct.string_at(data.bytes, data.size) if data.size else b""
+            record.data_offset = offset
+            record.data_size = len(raw)
+            offset += len(raw)
+            chunks.append(raw)
+            texts.append(_decode(barcode, raw))
+        return RecognizedCodes(records, b"".join(chunks), texts)
+    finally:
+        _.sc_barcode_array_release(array)